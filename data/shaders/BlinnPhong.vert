@@ -3,11 +3,10 @@
 // The program in this file will be run separately for each vertex in the model
 
 // This is the per-vertex input
-layout(location = 0) in vec3 vPosition;
+layout(location = 0) in vec4 vPosition;
 layout(location = 1) in vec3 vNormalIn;
 layout(location = 2) in vec2 vTexCoordIn;
-layout(location = 3) in vec3 vTangentIn;
-layout(location = 4) in vec3 vBitangentIn;
+layout(location = 3) in vec4 vTangentIn; // Bitangent sign in w
 
 // These variables will be the same for every vertex in the model
 uniform mat4 MVPMat;
@@ -20,25 +19,39 @@ out vec3 normalV;
 out vec3 positionV;
 out mat3 TBN;
 
+// Quantised meshes store normals and tangents octahedral encoded, and position w as 0 where float positions read as 1
+vec3 OctahedralDecode(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (n.z < 0.0) n.xy = (1.0 - abs(e.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(n);
+}
+
 // The actual program, which will run on the graphics card
 void main()
 {
+	bool quantised = vPosition.w == 0.0;
+	vec3 position = vPosition.xyz;
+	vec3 normal = quantised ? OctahedralDecode(vNormalIn.xy) : vNormalIn;
+	vec4 tangent = quantised ? vec4(OctahedralDecode(vTangentIn.xy), vTangentIn.w) : vTangentIn;
+
 	// Viewing transformation
 	// Incoming vertex position is multiplied by: modelling matrix, then viewing matrix, then projection matrix
 	// gl_position is a special output variable
-	gl_Position =  MVPMat * vec4(vPosition, 1);
-	positionV =  vec3(modelMat * vec4(vPosition, 1));
+	gl_Position =  MVPMat * vec4(position, 1);
+	positionV =  vec3(modelMat * vec4(position, 1));
 	
 	// Pass through the texture coordinate
 	texCoordV = vTexCoordIn;
 	
 	// The surface normal is multiplied by the model and viewing matrices
 	// This doesn't need to 'move' so we cast down to a 3x3 matrix
-	normalV = mat3(modelMat) * vNormalIn;
+	normalV = mat3(modelMat) * normal;
 
 	// Calculate TBN matrix for normal mapping
-    vec3 T = normalize(vec3(modelMat * vec4(vTangentIn, 0.0)));
-    vec3 B = normalize(vec3(modelMat * vec4(vBitangentIn, 0.0)));
-    vec3 N = normalize(vec3(modelMat * vec4(vNormalIn, 0.0)));
+    // The bitangent is rebuilt from the normal and tangent, flipped where the texture is mirrored
+    vec3 T = normalize(vec3(modelMat * vec4(tangent.xyz, 0.0)));
+    vec3 N = normalize(vec3(modelMat * vec4(normal, 0.0)));
+    vec3 B = cross(N, T) * tangent.w;
     TBN = mat3(T,B,N);
 }
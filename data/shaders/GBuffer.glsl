@@ -0,0 +1,49 @@
+// The G-buffer layout shared by the PBR shaders' G-buffer pass and the deferred lighting pass, see DeferredShading.
+// Target 0 holds albedo and metalness. Target 1 holds the world space normal and roughness,
+// either as three half floats or, with OCTAHEDRAL_NORMALS, as two 10 bit octahedral coordinates.
+
+// Selects the G-buffer pass with octahedral normals, as one define so it can be one shader variant
+#ifdef GBUFFER_OCTAHEDRAL
+#define GBUFFER
+#define OCTAHEDRAL_NORMALS
+#endif
+
+#ifdef OCTAHEDRAL_NORMALS
+// Fold the lower hemisphere of the octahedron over the upper, giving coordinates in [-1, 1]
+vec2 OctahedralEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.xy;
+    if (n.z < 0.0) e = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return e;
+}
+
+vec3 OctahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0) n.xy = (1.0 - abs(e.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+vec4 PackNormalRoughness(vec3 normal, float roughness)
+{
+    return vec4(OctahedralEncode(normal) * 0.5 + 0.5, roughness, 1.0);
+}
+
+void UnpackNormalRoughness(vec4 encoded, out vec3 normal, out float roughness)
+{
+    normal = OctahedralDecode(encoded.xy * 2.0 - 1.0);
+    roughness = encoded.z;
+}
+#else
+vec4 PackNormalRoughness(vec3 normal, float roughness)
+{
+    return vec4(normal, roughness);
+}
+
+void UnpackNormalRoughness(vec4 encoded, out vec3 normal, out float roughness)
+{
+    normal = normalize(encoded.xyz);
+    roughness = encoded.w;
+}
+#endif
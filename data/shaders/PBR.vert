@@ -1,15 +1,44 @@
 #version 430 core
 
 // Per-vertex inputs
-layout(location = 0) in vec3 vPositionIn;
+layout(location = 0) in vec4 vPositionIn;
 layout(location = 1) in vec3 vNormalIn;
 layout(location = 2) in vec2 vTexCoordIn;
-layout(location = 3) in vec3 vTangentIn;
-layout(location = 4) in vec3 vBitangentIn;
+layout(location = 3) in vec4 vTangentIn; // Bitangent sign in w
+
+// Per-view data, see ViewUniforms
+layout(std140, binding = 0) uniform ViewBlock
+{
+    mat4 viewMat;
+    mat4 projMat;
+    mat4 viewProjMat;
+    vec4 camPos;
+};
+
+#ifdef INSTANCED
+// Per-instance inputs, see ModelInstance
+layout(location = 4) in mat4 instanceModelMat; // Takes locations 4 to 7
+layout(location = 8) in vec3 instanceAlbedo;
+layout(location = 9) in vec2 instanceRoughnessMetalness;
+layout(location = 10) in uint instanceMaterialIndex;
+#else
+// Per-object data, see ObjectData
+struct ObjectData
+{
+    mat4 modelMat;
+    mat4 normalMat;
+    mat4 MVPMat;
+    uint materialIndex;
+};
+
+layout(std430, binding = 5) readonly buffer ObjectBlock
+{
+    ObjectData objects[];
+};
 
 // Uniforms
-uniform mat4 MVPMat;
-uniform mat4 modelMat;
+uniform uint objectIndex;
+#endif
 
 // Vertex shader outputs
 out vec2 texCoordV;
@@ -17,24 +46,71 @@ out vec3 normalV;
 out vec3 positionV;
 out mat3 TBN;
 
+#ifdef INSTANCED
+// Per-instance material properties, for fragment shaders which read them
+flat out vec3 albedoV;
+flat out vec2 roughnessMetalnessV;
+#endif
+
+#ifdef RESIDENT_TEXTURES
+// The MaterialRecord fragment shaders read their maps from
+flat out uint materialIndexV;
+#endif
+
 // BE WARY OF SPACES (EYE-SPACE VS WORLD SPACE)
 
+// Quantised meshes store normals and tangents octahedral encoded, and position w as 0 where float positions read as 1
+vec3 OctahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0) n.xy = (1.0 - abs(e.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
 
 void main()
 {
+#ifdef INSTANCED
+    mat4 modelMat = instanceModelMat;
+    // Instances may be scaled unevenly, which the model matrix alone would skew normals by
+    mat3 normalMat = transpose(inverse(mat3(modelMat)));
+    mat4 MVPMat = viewProjMat * modelMat;
+
+    albedoV = instanceAlbedo;
+    roughnessMetalnessV = instanceRoughnessMetalness;
+#else
+    mat4 modelMat = objects[objectIndex].modelMat;
+    mat3 normalMat = mat3(objects[objectIndex].normalMat);
+    mat4 MVPMat = objects[objectIndex].MVPMat;
+#endif
+
+#ifdef RESIDENT_TEXTURES
+#ifdef INSTANCED
+    materialIndexV = instanceMaterialIndex;
+#else
+    materialIndexV = objects[objectIndex].materialIndex;
+#endif
+#endif
+
+    bool quantised = vPositionIn.w == 0.0;
+    vec3 position = vPositionIn.xyz;
+    vec3 normal = quantised ? OctahedralDecode(vNormalIn.xy) : vNormalIn;
+    vec4 tangent = quantised ? vec4(OctahedralDecode(vTangentIn.xy), vTangentIn.w) : vTangentIn;
+
     // Transform position
-    gl_Position = MVPMat * vec4(vPositionIn, 1);
+    gl_Position = MVPMat * vec4(position, 1);
 
     // Pass through tex coords
     texCoordV = vTexCoordIn;
 
     // Interpolated normal
-    positionV = vec3(modelMat * vec4(vPositionIn, 1));
-    normalV = vec3(mat3(modelMat) * vNormalIn);
+    positionV = vec3(modelMat * vec4(position, 1));
+    normalV = normalMat * normal;
 
     // Calculate TBN matrix for normal mapping
-    vec3 T = normalize(vec3(modelMat * vec4(vTangentIn, 0.0)));
-    vec3 B = normalize(vec3(modelMat * vec4(vBitangentIn, 0.0)));
-    vec3 N = normalize(vec3(modelMat * vec4(vNormalIn, 0.0)));
+    // The bitangent is rebuilt from the normal and tangent, flipped where the texture is mirrored
+    vec3 T = normalize(vec3(modelMat * vec4(tangent.xyz, 0.0)));
+    vec3 N = normalize(normalMat * normal);
+    vec3 B = cross(N, T) * tangent.w;
     TBN = mat3(T,B,N);
 }
\ No newline at end of file
@@ -1,5 +1,9 @@
 #version 430 core
 
+#ifdef BINDLESS
+#extension GL_ARB_bindless_texture : require
+#endif
+
 // TESTING BRDF with point lighting. IBL to come.
 
 // These are the per-fragment inputs
@@ -9,8 +13,14 @@ in vec3 normalV;
 in vec2 texCoordV;
 in mat3 TBN;
 
-// Uniforms
-uniform vec3 camPos;
+// Per-view data, see ViewUniforms
+layout(std140, binding = 0) uniform ViewBlock
+{
+    mat4 viewMat;
+    mat4 projMat;
+    mat4 viewProjMat;
+    vec4 camPos;
+};
 
 //Test uniforms, constant properties
 uniform vec3 albedo;
@@ -18,12 +28,75 @@ uniform float metalness;
 uniform float roughness;
 uniform float ambientOcclusion;
 
+#ifdef RESIDENT_TEXTURES
+// Per-material maps, see MaterialRecord. Each is a bindless handle or a texture pool index and layer.
+flat in uint materialIndexV;
+
+struct MaterialRecord
+{
+    uvec2 maps[5];
+};
+
+layout(std430, binding = 6) readonly buffer MaterialBlock
+{
+    MaterialRecord materials[];
+};
+
+#define ALBEDO_MAP 0u
+#define NORMAL_MAP 1u
+#define METALNESS_MAP 2u
+#define ROUGHNESS_MAP 3u
+#define AMBIENT_OCCLUSION_MAP 4u
+
+#ifdef BINDLESS
+vec4 SampleMap(uint map, vec2 uv)
+{
+    return texture(sampler2D(materials[materialIndexV].maps[map]), uv);
+}
+#else
+// Pools are indexed with constants, as the pool can differ between instances of one draw
+layout(binding = 8) uniform sampler2DArray texturePools[8];
+
+vec4 SampleMap(uint map, vec2 uv)
+{
+    uvec2 slot = materials[materialIndexV].maps[map];
+    vec3 coord = vec3(uv, float(slot.y));
+
+    // Pools hold a single level, so no derivatives are needed inside the switch
+    switch (slot.x)
+    {
+    case 0u: return textureLod(texturePools[0], coord, 0.0);
+    case 1u: return textureLod(texturePools[1], coord, 0.0);
+    case 2u: return textureLod(texturePools[2], coord, 0.0);
+    case 3u: return textureLod(texturePools[3], coord, 0.0);
+    case 4u: return textureLod(texturePools[4], coord, 0.0);
+    case 5u: return textureLod(texturePools[5], coord, 0.0);
+    case 6u: return textureLod(texturePools[6], coord, 0.0);
+    default: return textureLod(texturePools[7], coord, 0.0);
+    }
+}
+#endif
+#else
 // This is another input to allow us to access a texture
 layout(location = 0) uniform sampler2D albedoMap;
 layout(location = 1) uniform sampler2D normalMap;
 layout(location = 2) uniform sampler2D metalnessMap;
 layout(location = 3) uniform sampler2D roughnessMap;
 layout(location = 4) uniform sampler2D ambientOcclusionMap;
+
+#define ALBEDO_MAP albedoMap
+#define NORMAL_MAP normalMap
+#define METALNESS_MAP metalnessMap
+#define ROUGHNESS_MAP roughnessMap
+#define AMBIENT_OCCLUSION_MAP ambientOcclusionMap
+
+vec4 SampleMap(sampler2D map, vec2 uv)
+{
+    return texture(map, uv);
+}
+#endif
+
+// Environment maps are bound the same either way
 layout(location = 5) uniform samplerCube irradianceMap;
 layout(location = 6) uniform samplerCube prefilterMap;
 layout(location = 7) uniform sampler2D brdfLUT;
@@ -89,22 +162,22 @@ float GeometrySmith(vec3 normal, vec3 viewDir, vec3 lightDir, float roughness)
 
 void main()
 {
-    vec3 viewDir = normalize(camPos - positionV);
+    vec3 viewDir = normalize(camPos.xyz - positionV);
 
     // Sample albedo
-    vec3 texAlbedo = vec3(texture(albedoMap,vec2(texCoordV.x,1-texCoordV.y)));
+    vec3 texAlbedo = vec3(SampleMap(ALBEDO_MAP,vec2(texCoordV.x,1-texCoordV.y)));
 
     //vec3 normal = normalize(normalV);
     // Use TBN to transform tangent space normals
-    vec3 normal = vec3(texture(normalMap, vec2(texCoordV.x, texCoordV.y)));
+    vec3 normal = vec3(SampleMap(NORMAL_MAP, vec2(texCoordV.x, texCoordV.y)));
     normal = normal * 2.0 - 1.0;
     normal = normalize(TBN * normal);
 
     // Sample metalness
-    float texMetalness = texture(metalnessMap, vec2(texCoordV.x, texCoordV.y)).x;
+    float texMetalness = SampleMap(METALNESS_MAP, vec2(texCoordV.x, texCoordV.y)).x;
 
     // Sample roughness
-    float texRoughness = texture(roughnessMap, vec2(texCoordV.x, texCoordV.y)).x;
+    float texRoughness = SampleMap(ROUGHNESS_MAP, vec2(texCoordV.x, texCoordV.y)).x;
 
     // Need surface reflection at zero incidence (from directly above)
     // We approximate dielectrics to 0.04 and interpolate based on metalness.
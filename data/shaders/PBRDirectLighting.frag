@@ -1,5 +1,12 @@
 #version 430 core
 
+#ifdef BINDLESS
+#extension GL_ARB_bindless_texture : require
+#endif
+
+#include "GBuffer.glsl"
+#include "PBRLighting.glsl"
+
 // TESTING BRDF with point lighting. IBL to come.
 
 // These are the per-fragment inputs
@@ -9,8 +16,14 @@ in vec3 normalV;
 in vec2 texCoordV;
 in mat3 TBN;
 
-// Uniforms
-uniform vec3 camPos;
+// Per-view data, see ViewUniforms
+layout(std140, binding = 0) uniform ViewBlock
+{
+    mat4 viewMat;
+    mat4 projMat;
+    mat4 viewProjMat;
+    vec4 camPos;
+};
 
 //Test uniforms, constant properties
 uniform vec3 albedo;
@@ -18,54 +31,90 @@ uniform float metalness;
 uniform float roughness;
 uniform float ambientOcclusion;
 
+#ifdef RESIDENT_TEXTURES
+// Per-material maps, see MaterialRecord. Each is a bindless handle or a texture pool index and layer.
+flat in uint materialIndexV;
+
+struct MaterialRecord
+{
+    uvec2 maps[5];
+};
+
+layout(std430, binding = 6) readonly buffer MaterialBlock
+{
+    MaterialRecord materials[];
+};
+
+#define ALBEDO_MAP 0u
+#define NORMAL_MAP 1u
+#define METALNESS_MAP 2u
+#define ROUGHNESS_MAP 3u
+#define AMBIENT_OCCLUSION_MAP 4u
+
+#ifdef BINDLESS
+vec4 SampleMap(uint map, vec2 uv)
+{
+    return texture(sampler2D(materials[materialIndexV].maps[map]), uv);
+}
+#else
+// Pools are indexed with constants, as the pool can differ between instances of one draw
+layout(binding = 8) uniform sampler2DArray texturePools[8];
+
+vec4 SampleMap(uint map, vec2 uv)
+{
+    uvec2 slot = materials[materialIndexV].maps[map];
+    vec3 coord = vec3(uv, float(slot.y));
+
+    // Pools hold a single level, so no derivatives are needed inside the switch
+    switch (slot.x)
+    {
+    case 0u: return textureLod(texturePools[0], coord, 0.0);
+    case 1u: return textureLod(texturePools[1], coord, 0.0);
+    case 2u: return textureLod(texturePools[2], coord, 0.0);
+    case 3u: return textureLod(texturePools[3], coord, 0.0);
+    case 4u: return textureLod(texturePools[4], coord, 0.0);
+    case 5u: return textureLod(texturePools[5], coord, 0.0);
+    case 6u: return textureLod(texturePools[6], coord, 0.0);
+    default: return textureLod(texturePools[7], coord, 0.0);
+    }
+}
+#endif
+#else
 // This is another input to allow us to access a texture
 layout(location = 0) uniform sampler2D albedoMap;
 layout(location = 1) uniform sampler2D normalMap;
 layout(location = 2) uniform sampler2D metalnessMap;
 layout(location = 3) uniform sampler2D roughnessMap;
 layout(location = 4) uniform sampler2D ambientOcclusionMap;
+
+#define ALBEDO_MAP albedoMap
+#define NORMAL_MAP normalMap
+#define METALNESS_MAP metalnessMap
+#define ROUGHNESS_MAP roughnessMap
+#define AMBIENT_OCCLUSION_MAP ambientOcclusionMap
+
+vec4 SampleMap(sampler2D map, vec2 uv)
+{
+    return texture(map, uv);
+}
+#endif
+
+// Environment maps are bound the same either way
 layout(location = 5) uniform samplerCube irradianceMap;
 layout(location = 6) uniform samplerCube prefilterMap;
 layout(location = 7) uniform sampler2D brdfLUT;
 
+#ifdef GBUFFER
+// Surface properties for the deferred lighting pass, see GBuffer.glsl
+layout(location = 0) out vec4 albedoMetalnessG;
+layout(location = 1) out vec4 normalRoughnessG;
+#else
 // This is the output, it is the fragment's (pixel's) colour
 out vec4 fragColour;
+#endif
 
-// Define PI
-const float PI = 3.14159265359;
 const float e = 2.71828;
 
-// https://learnopengl.com/PBR/Lighting
-// Calculate the ratio between specular and diffuse reflection.
-vec3 fresnelSchlick(float cosTheta, vec3 F0)
-{
-    return F0 + (1.0 - F0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
-}
-
-// https://learnopengl.com/PBR/Lighting
-// Fresnel schlick but with injected roughness. To be used when sampling an irradiance map as we will have no one halfway vector.
-// Uses technique described by Sebastien Lagarde.
-vec3 fresnelSchlickRoughness(float cosTheta, vec3 F0, float roughness)
-{
-    return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
-}
-
-// https://learnopengl.com/PBR/Lighting
-// DistributionGGX (NDF)
-float DistributionGGX(vec3 normal, vec3 halfVec, float roughness)
-{
-    float a = roughness * roughness;
-    float a2 = a*a;
-    float nDotH = max(dot(normal, halfVec), 0.0);
-    float nDotH2 = nDotH * nDotH;
-
-    float num = a2;
-    float denom = (nDotH2 * (a2 - 1.0) + 1.0);
-    denom = PI * denom * denom;
-
-    return num / denom;
-}
-
 // Beckmann Distribution (NDF)
 float BeckmannDistribution(float NDotH, float roughness)
 {
@@ -76,55 +125,30 @@ float BeckmannDistribution(float NDotH, float roughness)
     return (numerator / denom);
 }
 
-// https://learnopengl.com/PBR/Lighting
-// GeometrySchlickGGX
-float GeometrySchlickGGX(float nDotV, float roughness)
-{
-    float r = (roughness + 1.0);
-    float k = (r*r) / 8.0;
-
-    float num = nDotV;
-    float denom = nDotV * (1.0 - k) + k;
-
-    return num / denom;
-}
-
-// https://learnopengl.com/PBR/Lighting
-// GeometrySmith
-float GeometrySmith(vec3 normal, vec3 viewDir, vec3 lightDir, float roughness)
-{
-    float nDotV = max(dot(normal, viewDir), 0.0);
-    float nDotL = max(dot(normal, lightDir), 0.0);
-    float ggx2 = GeometrySchlickGGX(nDotV, roughness);
-    float ggx1 = GeometrySchlickGGX(nDotL, roughness);
-
-    return ggx1 * ggx2;
-}
-
 void main()
 {
-    vec3 viewDir = normalize(camPos - positionV);
+    vec3 viewDir = normalize(camPos.xyz - positionV);
 
     // Sample albedo
-    vec3 texAlbedo = vec3(texture(albedoMap,vec2(texCoordV.x,1-texCoordV.y)));
+    vec3 texAlbedo = vec3(SampleMap(ALBEDO_MAP,vec2(texCoordV.x,1-texCoordV.y)));
 
     //vec3 normal = normalize(normalV);
     // Use TBN to transform tangent space normals
-    vec3 normal = vec3(texture(normalMap, vec2(texCoordV.x, texCoordV.y)));
+    vec3 normal = vec3(SampleMap(NORMAL_MAP, vec2(texCoordV.x, texCoordV.y)));
     normal = normal * 2.0 - 1.0;
     normal = normalize(TBN * normal);
 
     // Sample metalness
-    float texMetalness = texture(metalnessMap, vec2(texCoordV.x, texCoordV.y)).x;
+    float texMetalness = SampleMap(METALNESS_MAP, vec2(texCoordV.x, texCoordV.y)).x;
 
     // Sample roughness
-    float texRoughness = texture(roughnessMap, vec2(texCoordV.x, texCoordV.y)).x;
-
-    // Need surface reflection at zero incidence (from directly above)
-    // We approximate dielectrics to 0.04 and interpolate based on metalness.
-    vec3 F0 = vec3(0.04);
-    F0 = mix(F0, texAlbedo, texMetalness);
+    float texRoughness = SampleMap(ROUGHNESS_MAP, vec2(texCoordV.x, texCoordV.y)).x;
 
+#ifdef GBUFFER
+    // Lit later, with every light touching this pixel
+    albedoMetalnessG = vec4(texAlbedo, texMetalness);
+    normalRoughnessG = PackNormalRoughness(normal, texRoughness);
+#else
     // Test 4 set lights
     vec3 lightPositions[1] = vec3[1]
     (
@@ -146,35 +170,12 @@ void main()
     for(int i = 0; i < 1; i++)
     {
         vec3 lightDir = normalize(lightPositions[i] - positionV);
-        vec3 halfVec = normalize(viewDir + lightDir);
 
         float distance = length(lightPositions[i] - positionV);
         float attenuation = 5.0 / (distance * distance);
         vec3 radiance = lightColours[i] * attenuation;
 
-        // Calculate fresnel
-        vec3 F = fresnelSchlick(max(dot(halfVec, viewDir), 0.0), F0);
-
-        // Calculate geometry occlusion
-        float G = GeometrySmith(normal, viewDir, lightDir, texRoughness);
-        // Calculate normal distribution
-        float NDF = DistributionGGX(normal, halfVec, texRoughness);
-        //float NDF = BeckmannDistribution(max(dot(normal, halfVec), 0.0), texRoughness);
-
-        // Fresnel corrensponds to kS (the energy of light that gets reflected)
-        vec3 kS = F;
-        // Ratio of refraction (remaining after reflection)
-        vec3 kD = vec3(1.0) - kS; 
-        kD *= 1.0 - texMetalness;
-
-        // Calculate Cook-Torrance BRDF
-        vec3 numerator = NDF * G * F;
-        float denominator = 4.0 * max(dot(normal, viewDir), 0.0) * max(dot(normal, lightDir), 0.0) + 0.0001; // + 0.0001 to prevent divide by zero
-        vec3 specular = numerator / denominator;
-
-        // Calculate outgoing reflectance value
-        float nDotL = max(dot(normal, lightDir), 0.0);
-        Lo += (kD * texAlbedo / PI + specular) * radiance * nDotL;
+        Lo += CookTorrance(normal, viewDir, lightDir, radiance, texAlbedo, texMetalness, texRoughness);
     }
 
     // Fake ambient
@@ -183,10 +184,6 @@ void main()
     // Final lit colour
     vec3 colour = ambient + Lo;
 
-    // tone map and gamma correct to increase dynamic range using 
-    // Reinhard operator seeing as we have no postprocessing for now
-    colour = colour / (colour + vec3(1.0));
-    colour = pow(colour, vec3(1.0/2.2));
-
-    fragColour = vec4(colour, 1.0);
-}
\ No newline at end of file
+    fragColour = vec4(ToneMap(colour), 1.0);
+#endif
+}
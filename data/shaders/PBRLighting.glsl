@@ -0,0 +1,127 @@
+// Lighting functions shared by the forward PBR shaders and the deferred lighting pass.
+// Included with #include "PBRLighting.glsl", see Shader.
+
+// Define PI
+const float PI = 3.14159265359;
+
+// https://learnopengl.com/PBR/Lighting
+// Calculate the ratio between specular and diffuse reflection.
+vec3 fresnelSchlick(float cosTheta, vec3 F0)
+{
+    return F0 + (1.0 - F0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
+}
+
+// https://learnopengl.com/PBR/Lighting
+// Fresnel schlick but with injected roughness. To be used when sampling an irradiance map as we will have no one halfway vector.
+// Uses technique described by Sebastien Lagarde.
+vec3 fresnelSchlickRoughness(float cosTheta, vec3 F0, float roughness)
+{
+    return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
+}
+
+// https://learnopengl.com/PBR/Lighting
+// DistributionGGX (NDF)
+float DistributionGGX(vec3 normal, vec3 halfVec, float roughness)
+{
+    float a = roughness * roughness;
+    float a2 = a*a;
+    float nDotH = max(dot(normal, halfVec), 0.0);
+    float nDotH2 = nDotH * nDotH;
+
+    float num = a2;
+    float denom = (nDotH2 * (a2 - 1.0) + 1.0);
+    denom = PI * denom * denom;
+
+    return num / denom;
+}
+
+// https://learnopengl.com/PBR/Lighting
+// GeometrySchlickGGX
+float GeometrySchlickGGX(float nDotV, float roughness)
+{
+    float r = (roughness + 1.0);
+    float k = (r*r) / 8.0;
+
+    float num = nDotV;
+    float denom = nDotV * (1.0 - k) + k;
+
+    return num / denom;
+}
+
+// https://learnopengl.com/PBR/Lighting
+// GeometrySmith
+float GeometrySmith(vec3 normal, vec3 viewDir, vec3 lightDir, float roughness)
+{
+    float nDotV = max(dot(normal, viewDir), 0.0);
+    float nDotL = max(dot(normal, lightDir), 0.0);
+    float ggx2 = GeometrySchlickGGX(nDotV, roughness);
+    float ggx1 = GeometrySchlickGGX(nDotL, roughness);
+
+    return ggx1 * ggx2;
+}
+
+// Outgoing radiance towards the viewer from one light, through the Cook-Torrance BRDF
+vec3 CookTorrance(vec3 normal, vec3 viewDir, vec3 lightDir, vec3 radiance, vec3 albedo, float metalness, float roughness)
+{
+    vec3 halfVec = normalize(viewDir + lightDir);
+
+    // Need surface reflection at zero incidence (from directly above)
+    // We approximate dielectrics to 0.04 and interpolate based on metalness.
+    vec3 F0 = mix(vec3(0.04), albedo, metalness);
+
+    // Calculate fresnel
+    vec3 F = fresnelSchlick(max(dot(halfVec, viewDir), 0.0), F0);
+
+    // Calculate geometry occlusion
+    float G = GeometrySmith(normal, viewDir, lightDir, roughness);
+    // Calculate normal distribution
+    float NDF = DistributionGGX(normal, halfVec, roughness);
+
+    // Fresnel corrensponds to kS (the energy of light that gets reflected)
+    vec3 kS = F;
+    // Ratio of refraction (remaining after reflection)
+    vec3 kD = vec3(1.0) - kS;
+    kD *= 1.0 - metalness;
+
+    // Calculate Cook-Torrance BRDF
+    vec3 numerator = NDF * G * F;
+    float denominator = 4.0 * max(dot(normal, viewDir), 0.0) * max(dot(normal, lightDir), 0.0) + 0.0001; // + 0.0001 to prevent divide by zero
+    vec3 specular = numerator / denominator;
+
+    // Calculate outgoing reflectance value
+    float nDotL = max(dot(normal, lightDir), 0.0);
+    return (kD * albedo / PI + specular) * radiance * nDotL;
+}
+
+// https://learnopengl.com/PBR/Specular-IBL
+// Diffuse and specular light from the environment, through the irradiance map, prefiltered environment map and BRDF lookup texture
+vec3 ImageBasedLighting(vec3 normal, vec3 viewDir, vec3 albedo, float metalness, float roughness, samplerCube irradianceMap, samplerCube prefilterMap, sampler2D brdfLUT)
+{
+    vec3 F0 = mix(vec3(0.04), albedo, metalness);
+
+    // Get prefiltered reflection colour
+    vec3 R = reflect(-viewDir, normal);
+    const float MAX_REFLECTION_LOD = 4.0; // Using 5 mip levels
+    vec3 prefilteredColour = textureLod(prefilterMap, R, roughness * MAX_REFLECTION_LOD).rgb;
+
+    // Sample brdfLookup texture using material roughness and angle between normal and view
+    vec3 F = fresnelSchlickRoughness(max(dot(normal, viewDir), 0.0), F0, roughness);
+    vec2 envBRDF = texture(brdfLUT, vec2(max(dot(normal, viewDir), 0.0), roughness)).rg;
+    vec3 specular = prefilteredColour * (F * envBRDF.x + envBRDF.y);
+
+    // Separate diffuse and specular component of irradiance map
+    vec3 kS = F;
+    vec3 kD = 1.0 - kS;
+    vec3 irradiance = texture(irradianceMap, normal).rgb;
+    vec3 diffuse = irradiance * albedo;
+
+    return kD * diffuse + specular;
+}
+
+// Tone map and gamma correct to increase dynamic range using
+// Reinhard operator seeing as we have no postprocessing for now
+vec3 ToneMap(vec3 colour)
+{
+    colour = colour / (colour + vec3(1.0));
+    return pow(colour, vec3(1.0/2.2));
+}
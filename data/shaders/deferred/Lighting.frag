@@ -0,0 +1,119 @@
+#version 430 core
+
+#include "../GBuffer.glsl"
+#include "../PBRLighting.glsl"
+
+// Shades each pixel of the G-buffer with the lights LightTiles.comp found touching its tile, see DeferredShading
+
+// Matches LIGHT_TILE_SIZE and MAX_LIGHTS_PER_TILE
+const uint LIGHT_TILE_SIZE = 16u;
+const uint MAX_LIGHTS_PER_TILE = 256u;
+
+// Per-view data, see ViewUniforms
+layout(std140, binding = 0) uniform ViewBlock
+{
+    mat4 viewMat;
+    mat4 projMat;
+    mat4 viewProjMat;
+    vec4 camPos;
+};
+
+// See LightData
+struct LightData
+{
+    vec4 positionRadius;
+    vec4 colourSpotOffset;
+    vec4 directionSpotScale;
+};
+
+layout(std430, binding = 7) readonly buffer LightBlock
+{
+    LightData lights[];
+};
+
+layout(std430, binding = 8) readonly buffer TileBlock
+{
+    uint tileLights[];
+};
+
+layout(binding = 0) uniform sampler2D albedoMetalnessMap;
+layout(binding = 1) uniform sampler2D normalRoughnessMap;
+layout(binding = 2) uniform sampler2D depthMap;
+
+#ifdef IMAGE_BASED_LIGHTING
+// Bound to the same units as the forward shaders use
+layout(binding = 5) uniform samplerCube irradianceMap;
+layout(binding = 6) uniform samplerCube prefilterMap;
+layout(binding = 7) uniform sampler2D brdfLUT;
+#endif
+
+uniform mat4 invViewProjMat;
+uniform uint tileCountX;
+
+out vec4 fragColour;
+
+// Inverse square falloff, windowed to reach zero at the light's radius so that it can be culled there
+float Attenuation(float distance, float radius)
+{
+    float window = clamp(1.0 - pow(distance / radius, 4.0), 0.0, 1.0);
+    return window * window / max(distance * distance, 0.0001);
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+
+    // Nothing was drawn here, so whatever is behind shows through
+    float depth = texelFetch(depthMap, pixel, 0).r;
+    if (depth >= 1.0) discard;
+
+#ifdef WRITE_DEPTH
+    // For targets whose depth the G-buffer's can't be copied into, so that forward draws are still hidden behind what is shaded
+    gl_FragDepth = depth;
+#endif
+
+    vec4 albedoMetalness = texelFetch(albedoMetalnessMap, pixel, 0);
+    vec3 albedo = albedoMetalness.rgb;
+    float metalness = albedoMetalness.a;
+
+    vec3 normal;
+    float roughness;
+    UnpackNormalRoughness(texelFetch(normalRoughnessMap, pixel, 0), normal, roughness);
+
+    // World space position, from the depth
+    vec2 ndc = gl_FragCoord.xy / vec2(textureSize(depthMap, 0)) * 2.0 - 1.0;
+    vec4 world = invViewProjMat * vec4(ndc, depth * 2.0 - 1.0, 1.0);
+    vec3 position = world.xyz / world.w;
+
+    vec3 viewDir = normalize(camPos.xyz - position);
+
+    // Reflectance, from only the lights touching this tile
+    uint tile = (uint(pixel.y) / LIGHT_TILE_SIZE) * tileCountX + uint(pixel.x) / LIGHT_TILE_SIZE;
+    uint first = tile * (MAX_LIGHTS_PER_TILE + 1u);
+    uint count = tileLights[first];
+
+    vec3 Lo = vec3(0.0);
+    for (uint i = 0u; i < count; i++)
+    {
+        LightData light = lights[tileLights[first + 1u + i]];
+
+        vec3 toLight = light.positionRadius.xyz - position;
+        float distance = length(toLight);
+        vec3 lightDir = toLight / max(distance, 0.0001);
+
+        // Point lights have a spot scale of 0 and offset of 1, so are lit all round
+        float spot = clamp(dot(-lightDir, light.directionSpotScale.xyz) * light.directionSpotScale.w + light.colourSpotOffset.w, 0.0, 1.0);
+        vec3 radiance = light.colourSpotOffset.rgb * Attenuation(distance, light.positionRadius.w) * spot * spot;
+
+        Lo += CookTorrance(normal, viewDir, lightDir, radiance, albedo, metalness, roughness);
+    }
+
+#ifdef IMAGE_BASED_LIGHTING
+    vec3 ambient = ImageBasedLighting(normal, viewDir, albedo, metalness, roughness, irradianceMap, prefilterMap, brdfLUT);
+#else
+    // Fake ambient, as the direct lighting shader has
+    vec3 ambient = vec3(0.001) * albedo;
+#endif
+
+    fragColour = vec4(ToneMap(ambient + Lo), 1.0);
+}
@@ -0,0 +1,287 @@
+// Compares the memory mapped OBJ parser against the original getline/stringstream loader,
+// and measures how the chunked parser scales with thread count.
+// Usage: obj_benchmark [--synthetic-mb N] [--skip-legacy] [--skip-scaling] [--keep-synthetic] [file.obj ...]
+// With no files given, the lantern model and a synthetic 1 GB OBJ are measured.
+
+#include <ePBR/OBJParser.h>
+#include <ePBR/ThreadPool.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Streams
+{
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+};
+
+// The loop Mesh::LoadOBJ used before the mapped parser, kept as the baseline.
+// Polygons are fan triangulated here too so that the outputs can be compared on quad meshes.
+bool LegacyLoadOBJ(const std::string& _filename, Streams& _out)
+{
+	std::ifstream inputFile(_filename);
+	if (!inputFile.is_open()) return false;
+
+	std::vector<glm::vec2> rawUVData;
+	std::vector<glm::vec3> rawPositionData;
+	std::vector<glm::vec3> rawNormalData;
+
+	std::string currentLine;
+
+	while (std::getline(inputFile, currentLine))
+	{
+		std::stringstream currentLineStream(currentLine);
+
+		if (!currentLine.substr(0, 2).compare(0, 2, "vt"))
+		{
+			std::string junk;
+			float x, y;
+			currentLineStream >> junk >> x >> y;
+			rawUVData.push_back(glm::vec2(x, y));
+		}
+		else if (!currentLine.substr(0, 2).compare(0, 2, "vn"))
+		{
+			std::string junk;
+			float x, y, z;
+			currentLineStream >> junk >> x >> y >> z;
+			rawNormalData.push_back(glm::vec3(x, y, z));
+		}
+		else if (!currentLine.substr(0, 2).compare(0, 1, "v"))
+		{
+			std::string junk;
+			float x, y, z;
+			currentLineStream >> junk >> x >> y >> z;
+			rawPositionData.push_back(glm::vec3(x, y, z));
+		}
+		else if (!currentLine.substr(0, 2).compare(0, 1, "f"))
+		{
+			std::string junk;
+			std::vector<std::string> verts;
+			std::string vert;
+
+			currentLineStream >> junk;
+			while (currentLineStream >> vert) verts.push_back(vert);
+
+			for (size_t tri = 2; tri < verts.size(); tri++)
+			{
+				const size_t corners[3] = { 0, tri - 1, tri };
+				for (size_t i : corners)
+				{
+					std::stringstream currentSection(verts[i]);
+
+					unsigned int posID = 0;
+					unsigned int uvID = 0;
+					unsigned int normID = 0;
+
+					if (verts[i].find('/') == std::string::npos)
+					{
+						currentSection >> posID;
+					}
+					else if (verts[i].find("//") != std::string::npos)
+					{
+						char junkChar;
+						currentSection >> posID >> junkChar >> junkChar >> normID;
+					}
+					else
+					{
+						char junkChar;
+						currentSection >> posID >> junkChar >> uvID >> junkChar >> normID;
+					}
+
+					if (posID > 0) _out.positions.push_back(rawPositionData[posID - 1]);
+					if (uvID > 0) _out.uvs.push_back(rawUVData[uvID - 1]);
+					if (normID > 0) _out.normals.push_back(rawNormalData[normID - 1]);
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+// Pool used by MappedLoadOBJ, nullptr for the serial path
+ePBR::ThreadPool* g_pool = nullptr;
+
+bool MappedLoadOBJ(const std::string& _filename, Streams& _out)
+{
+	ePBR::OBJData data;
+	if (!ePBR::LoadOBJFile(_filename, data, g_pool)) return false;
+
+	ePBR::AssembleOBJStreams(data, _out.positions, _out.uvs, _out.normals, g_pool);
+	return true;
+}
+
+template <typename T>
+bool SameBits(const std::vector<T>& _a, const std::vector<T>& _b)
+{
+	return _a.size() == _b.size() && (_a.empty() || memcmp(_a.data(), _b.data(), _a.size() * sizeof(T)) == 0);
+}
+
+bool SameStreams(const Streams& _a, const Streams& _b)
+{
+	return SameBits(_a.positions, _b.positions) && SameBits(_a.uvs, _b.uvs) && SameBits(_a.normals, _b.normals);
+}
+
+// Write a triangulated, fully attributed grid of roughly _targetBytes.
+void WriteSyntheticOBJ(const std::string& _filename, size_t _targetBytes)
+{
+	// Each grid vertex costs ~105 bytes of v/vt/vn text and ~110 bytes of face text
+	const size_t side = (size_t)std::sqrt((double)_targetBytes / 215.0) + 2;
+
+	FILE* file = fopen(_filename.c_str(), "wb");
+	if (!file) throw std::runtime_error("Could not create " + _filename);
+
+	std::vector<char> buffer(1 << 20);
+	setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+
+	fprintf(file, "# Synthetic benchmark grid, %zu x %zu vertices\n", side, side);
+
+	for (size_t y = 0; y < side; y++)
+	{
+		for (size_t x = 0; x < side; x++)
+		{
+			float u = (float)x / (side - 1);
+			float v = (float)y / (side - 1);
+			fprintf(file, "v %.6f %.6f %.6f\n", u * 100.0f - 50.0f, std::sin(u * 40.0f) * std::cos(v * 40.0f), v * 100.0f - 50.0f);
+			fprintf(file, "vt %.6f %.6f\n", u, v);
+			fprintf(file, "vn %.6f %.6f %.6f\n", 0.0f, 1.0f, 0.0f);
+		}
+	}
+
+	for (size_t y = 0; y + 1 < side; y++)
+	{
+		for (size_t x = 0; x + 1 < side; x++)
+		{
+			size_t a = y * side + x + 1;
+			size_t b = a + 1;
+			size_t c = a + side;
+			size_t d = c + 1;
+			fprintf(file, "f %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\n", a, a, a, c, c, c, b, b, b);
+			fprintf(file, "f %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\n", b, b, b, c, c, c, d, d, d);
+		}
+	}
+
+	fclose(file);
+}
+
+double Measure(bool (*_loader)(const std::string&, Streams&), const std::string& _filename, Streams& _out)
+{
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	bool loaded = _loader(_filename, _out);
+	std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - begin;
+
+	if (!loaded) throw std::runtime_error("Could not open " + _filename);
+	return seconds.count();
+}
+
+void Report(const char* _name, double _seconds, size_t _bytes, size_t _vertices)
+{
+	printf("  %-8s %9.3f s %10.1f MB/s %14.0f vertices/s\n", _name, _seconds, _bytes / 1.0e6 / _seconds, _vertices / _seconds);
+}
+
+// Parse with 1, 2, 4 ... threads up to the hardware thread count and check every result matches the serial parse
+void BenchmarkScaling(const std::string& _filename, size_t _bytes, const Streams& _serial, double _serialSeconds)
+{
+	unsigned int hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+	for (unsigned int threads = 2; ; threads = std::min(threads * 2, hardwareThreads))
+	{
+		ePBR::ThreadPool pool(threads);
+		g_pool = &pool;
+
+		Streams parallel;
+		double seconds = Measure(MappedLoadOBJ, _filename, parallel);
+		g_pool = nullptr;
+
+		char name[32];
+		snprintf(name, sizeof(name), "%u thr", threads);
+		Report(name, seconds, _bytes, parallel.positions.size());
+
+		double speedup = _serialSeconds / seconds;
+		printf("  %-8s speedup %.2fx, efficiency %3.0f%%, streams %s\n", "", speedup, 100.0 * speedup / threads, SameStreams(parallel, _serial) ? "identical" : "DIFFER");
+
+		if (threads >= hardwareThreads) break;
+	}
+}
+
+void Benchmark(const std::string& _filename, bool _runLegacy, bool _runScaling)
+{
+	size_t bytes = (size_t)std::filesystem::file_size(_filename);
+	printf("%s (%.1f MB)\n", _filename.c_str(), bytes / 1.0e6);
+
+	Streams mapped;
+	double mappedSeconds = Measure(MappedLoadOBJ, _filename, mapped);
+	Report("mapped", mappedSeconds, bytes, mapped.positions.size());
+
+	if (_runScaling) BenchmarkScaling(_filename, bytes, mapped, mappedSeconds);
+
+	if (!_runLegacy) return;
+
+	Streams legacy;
+	double legacySeconds = Measure(LegacyLoadOBJ, _filename, legacy);
+	Report("legacy", legacySeconds, bytes, legacy.positions.size());
+
+	printf("  speedup %.1fx, streams %s\n", legacySeconds / mappedSeconds, SameStreams(mapped, legacy) ? "identical" : "DIFFER");
+}
+
+int main(int argc, char* argv[])
+{
+	std::string pwd(argv[0]);
+	pwd = pwd.substr(0, pwd.find_last_of("\\/") + 1);
+
+	size_t syntheticMB = 1024;
+	bool runLegacy = true;
+	bool runScaling = true;
+	bool keepSynthetic = false;
+	std::vector<std::string> files;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--synthetic-mb") && i + 1 < argc) syntheticMB = (size_t)std::stoull(argv[++i]);
+		else if (!strcmp(argv[i], "--skip-legacy")) runLegacy = false;
+		else if (!strcmp(argv[i], "--skip-scaling")) runScaling = false;
+		else if (!strcmp(argv[i], "--keep-synthetic")) keepSynthetic = true;
+		else files.push_back(argv[i]);
+	}
+
+	try
+	{
+		if (!files.empty())
+		{
+			for (const std::string& file : files) Benchmark(file, runLegacy, runScaling);
+			return 0;
+		}
+
+		Benchmark(pwd + "data/models/old_lantern/lantern_obj.obj", runLegacy, runScaling);
+
+		if (syntheticMB > 0)
+		{
+			std::string synthetic = (std::filesystem::temp_directory_path() / "epbr_synthetic.obj").string();
+			printf("Writing %zu MB synthetic OBJ...\n", syntheticMB);
+			WriteSyntheticOBJ(synthetic, syntheticMB * 1000000);
+
+			Benchmark(synthetic, runLegacy, runScaling);
+
+			if (!keepSynthetic) std::filesystem::remove(synthetic);
+		}
+	}
+	catch (std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
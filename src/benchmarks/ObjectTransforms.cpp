@@ -0,0 +1,134 @@
+// Compares batched SIMD object transforms against computing each object's matrices one at a time with glm,
+// as the render queue used to, at 10k, 100k and 1M objects.
+// Usage: transform_benchmark [--repeats N] [count ...]
+
+#include <ePBR/ObjectTransforms.h>
+#include <ePBR/ThreadPool.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Translated, rotated and non-uniformly scaled, so the normal matrix is more than the rotation
+std::vector<glm::mat4> MakeModelMatrices(size_t _count)
+{
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	std::vector<glm::mat4> matrices(_count);
+	for (glm::mat4& matrix : matrices)
+	{
+		glm::vec3 axis = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) + glm::vec3(0.0f, 0.0f, 2.0f));
+		matrix = glm::translate(glm::mat4(1.0f), glm::vec3(unit(random), unit(random), unit(random)) * 100.0f);
+		matrix = glm::rotate(matrix, unit(random) * 3.14159f, axis);
+		matrix = glm::scale(matrix, glm::vec3(1.5f) + glm::vec3(unit(random), unit(random), unit(random)));
+	}
+	return matrices;
+}
+
+// What every object cost before batching: a general inverse for the normal matrix and a matrix product for the MVP
+void ComputeScalar(const std::vector<glm::mat4>& _models, const glm::mat4& _viewProj, std::vector<ePBR::ObjectData>& _objects)
+{
+	for (size_t i = 0; i < _models.size(); i++)
+	{
+		_objects[i].modelMatrix = _models[i];
+		_objects[i].normalMatrix = glm::transpose(glm::inverse(_models[i]));
+		_objects[i].mvpMatrix = _viewProj * _models[i];
+		_objects[i].materialIndex = 0;
+	}
+}
+
+// Best of several runs, in seconds
+template <typename Function>
+double Measure(int _repeats, Function _function)
+{
+	double best = 1.0e30;
+	for (int i = 0; i < _repeats; i++)
+	{
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		_function();
+		std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - begin;
+		best = std::min(best, seconds.count());
+	}
+	return best;
+}
+
+void Report(const char* _name, double _seconds, size_t _count, double _baseline)
+{
+	printf("  %-10s %9.3f ms %8.1f ns/object %10.1f M objects/s  %5.2fx\n", _name, _seconds * 1.0e3, _seconds * 1.0e9 / _count, _count / _seconds / 1.0e6, _baseline / _seconds);
+}
+
+// Largest difference from the scalar results, relative to each element's size
+float Compare(const std::vector<ePBR::ObjectData>& _a, const std::vector<ePBR::ObjectData>& _b)
+{
+	float error = 0.0f;
+	for (size_t i = 0; i < _a.size(); i++)
+	{
+		for (int column = 0; column < 4; column++)
+		{
+			for (int row = 0; row < 4; row++)
+			{
+				if (column < 3 && row < 3)
+				{
+					float normal = _a[i].normalMatrix[column][row];
+					error = std::max(error, std::fabs(normal - _b[i].normalMatrix[column][row]) / (1.0f + std::fabs(normal)));
+				}
+
+				float mvp = _a[i].mvpMatrix[column][row];
+				error = std::max(error, std::fabs(mvp - _b[i].mvpMatrix[column][row]) / (1.0f + std::fabs(mvp)));
+			}
+		}
+	}
+	return error;
+}
+
+void Benchmark(size_t _count, int _repeats, ePBR::ThreadPool& _pool)
+{
+	printf("%zu objects\n", _count);
+
+	std::vector<glm::mat4> models = MakeModelMatrices(_count);
+	glm::mat4 viewProj = glm::perspective(1.0f, 16.0f / 9.0f, 0.1f, 1000.0f) * glm::lookAt(glm::vec3(0.0f, 50.0f, 200.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	std::vector<ePBR::ObjectData> scalar(_count);
+	std::vector<ePBR::ObjectData> batched(_count);
+	std::vector<ePBR::ObjectData> pooled(_count);
+
+	double scalarSeconds = Measure(_repeats, [&]() { ComputeScalar(models, viewProj, scalar); });
+	double batchedSeconds = Measure(_repeats, [&]() { ePBR::ComputeObjectData(models.data(), nullptr, _count, viewProj, batched.data()); });
+	double pooledSeconds = Measure(_repeats, [&]() { ePBR::ComputeObjectData(models.data(), nullptr, _count, viewProj, pooled.data(), &_pool); });
+
+	Report("scalar", scalarSeconds, _count, scalarSeconds);
+	Report("batched", batchedSeconds, _count, scalarSeconds);
+
+	char name[32];
+	snprintf(name, sizeof(name), "%u thr", _pool.GetThreadCount());
+	Report(name, pooledSeconds, _count, scalarSeconds);
+
+	printf("  max relative error %.2e, %.2e\n", Compare(scalar, batched), Compare(scalar, pooled));
+}
+
+int main(int argc, char* argv[])
+{
+	int repeats = 5;
+	std::vector<size_t> counts;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--repeats") && i + 1 < argc) repeats = std::max(1, std::stoi(argv[++i]));
+		else counts.push_back((size_t)std::stoull(argv[i]));
+	}
+	if (counts.empty()) counts = { 10000, 100000, 1000000 };
+
+	ePBR::ThreadPool pool;
+	for (size_t count : counts) Benchmark(count, repeats, pool);
+
+	return 0;
+}
@@ -13,6 +13,9 @@ struct Scene
 {
 	std::vector<std::shared_ptr<ePBR::Model>> models;
 	std::vector<glm::vec3> modelPositions;
+	std::vector<ePBR::TransformID> modelTransforms; // Placed at modelPositions when the scenes are set up
+	std::vector<ePBR::ModelInstance> instances; // If set, each model is drawn once per instance rather than at its position
+	std::vector<ePBR::Light> lights; // If set, the models are queued and lit by these with deferred shading
 	float cameraDistance;
 };
 
@@ -29,7 +32,6 @@ int main(int argc, char* argv[])
 	// Set up matrices
 	glm::mat4 viewMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(0, 0, -3.5f));
 	glm::mat4 projectionMatrix = glm::perspective(45.0f, (float)context.GetWindowWidth() / context.GetWindowHeight(), 0.1f, 100.0f);
-	glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(0,0,0));
 
 	// Set up renderer
 	ePBR::Renderer renderer(context.GetWindowWidth(), context.GetWindowHeight());
@@ -38,6 +40,10 @@ int main(int argc, char* argv[])
 	SDL_GL_SetSwapInterval(0); // Disable vsync
 	glm::vec3 camPos(0);
 
+	// Only used by Flush(), so scenes drawn otherwise are unaffected
+	std::shared_ptr<ePBR::DeferredShading> deferredShading = context.CreateDeferredShading();
+	renderer.SetDeferredShading(deferredShading);
+
 	// Load Shaders
 	std::shared_ptr<ePBR::Shader> comboPBRShader, IBLOnlyShader, directLightingOnlyShader, noSamplersShader, blinnPhongShader;
 	IBLOnlyShader = std::make_shared<ePBR::Shader>(pwd + "data\\shaders\\PBR.vert", pwd + "data\\shaders\\PBRIBL.frag");
@@ -102,7 +108,12 @@ int main(int argc, char* argv[])
 
 	// Set up mesh
 	std::shared_ptr<ePBR::Mesh> modelMesh = std::make_shared<ePBR::Mesh>();
-	modelMesh->LoadOBJ(pwd + "data\\models\\sphere\\triangulated.obj");
+	ePBR::ImportOptions importOptions;
+	importOptions.optimiseMesh = true;
+	importOptions.quantiseVertices = true;
+	importOptions.buildMeshlets = true;
+	importOptions.generateLODs = true;
+	modelMesh->LoadOBJ(pwd + "data\\models\\sphere\\triangulated.obj", importOptions);
 
 	// Set up model
 	std::shared_ptr<ePBR::Model> testModel = std::make_shared<ePBR::Model>();
@@ -113,23 +124,25 @@ int main(int argc, char* argv[])
 	Scene arrayOfSpheresScene;
 	arrayOfSpheresScene.cameraDistance = 7.0f;
 	int sphereSpacing(1.85f);
+	std::shared_ptr<ePBR::PBRMaterial> sphereArrayMaterial = std::make_shared<ePBR::PBRMaterial>();
+	std::shared_ptr<ePBR::Model> sphereArrayModel = std::make_shared<ePBR::Model>();
+	*sphereArrayMaterial = *IBLMaterial;
+	*sphereArrayModel = *testModel;
+	sphereArrayMaterial->SetShader(noSamplersShader);
+	sphereArrayModel->SetMaterial(0, sphereArrayMaterial);
+	arrayOfSpheresScene.models.push_back(sphereArrayModel);
+	arrayOfSpheresScene.modelPositions.push_back(glm::vec3(0.0f));
 	for (int x = 0; x < 5; x++) 
 		{
 			for (int y = 0; y < 5; y++) 
 			{
-				std::shared_ptr<ePBR::PBRMaterial> mat = std::make_shared<ePBR::PBRMaterial>();
-				std::shared_ptr<ePBR::Model> model = std::make_shared<ePBR::Model>();
-				* mat = * IBLMaterial;
-				*model = *testModel;
-
-				mat->SetAlbedo(glm::vec3(1.0f, 0.0f, 0.0f));
-				mat->SetMetalness(0.95f - (x / 5.0f));
-				mat->SetRoughness((y / 5.0f) + 0.05f);
-				mat->SetShader(noSamplersShader);
-				model->SetMaterial(0, mat);
-
-				arrayOfSpheresScene.models.push_back(model);
-				arrayOfSpheresScene.modelPositions.push_back(glm::vec3( ((-2 * sphereSpacing) + (sphereSpacing * x)), ((-2 * sphereSpacing) + (sphereSpacing * y)), 0.0f ));
+				ePBR::ModelInstance instance;
+				instance.modelMatrix = glm::translate(glm::mat4(1), glm::vec3( ((-2 * sphereSpacing) + (sphereSpacing * x)), ((-2 * sphereSpacing) + (sphereSpacing * y)), 0.0f ));
+				instance.albedo = glm::vec3(1.0f, 0.0f, 0.0f);
+				instance.metalness = 0.95f - (x / 5.0f);
+				instance.roughness = (y / 5.0f) + 0.05f;
+
+				arrayOfSpheresScene.instances.push_back(instance);
 			}
 		}
 
@@ -147,6 +160,41 @@ int main(int argc, char* argv[])
 	modelComparisonScene.models = {sph1, sph2, sph3};
 	modelComparisonScene.modelPositions = { glm::vec3(-2, 0, 0) , glm::vec3(0, 0, 0), glm::vec3(2, 0, 0) };
 	modelComparisonScene.cameraDistance = 4.0f;
+
+	// A floor of spheres lit by rings of small coloured lights, each pixel shaded once by only the lights near it
+	Scene deferredLightsScene;
+	deferredLightsScene.cameraDistance = 12.0f;
+	std::shared_ptr<ePBR::Model> deferredSphere(new ePBR::Model());
+	*deferredSphere = *testModel;
+	deferredSphere->SetMaterial(0, directLightingMaterial);
+	for (int x = -3; x <= 3; x++)
+	{
+		for (int z = -3; z <= 3; z++)
+		{
+			deferredLightsScene.models.push_back(deferredSphere);
+			deferredLightsScene.modelPositions.push_back(glm::vec3(x * 2.0f, 0.0f, z * 2.0f));
+		}
+	}
+	for (int i = 0; i < 64; i++)
+	{
+		// Hues spread round the colour wheel. Positions are set each frame.
+		float hue = i * glm::two_pi<float>() / 64.0f;
+		ePBR::Light light;
+		light.colour = 4.0f * glm::vec3(0.5f + 0.5f * glm::cos(hue), 0.5f + 0.5f * glm::cos(hue - 2.1f), 0.5f + 0.5f * glm::cos(hue + 2.1f));
+		light.radius = 3.0f;
+		deferredLightsScene.lights.push_back(light);
+	}
+
+	// Every scene's models get a node, so their world matrices are only recomputed when they move
+	ePBR::TransformHierarchy transforms;
+	for (Scene* scene : { &arrayOfSpheresScene, &singleSphereScene, &modelComparisonScene, &deferredLightsScene })
+	{
+		for (const glm::vec3& position : scene->modelPositions)
+		{
+			scene->modelTransforms.push_back(transforms.Create());
+			transforms.SetPosition(scene->modelTransforms.back(), position);
+		}
+	}
 	// SCENE SETUP COMPLETE
 
 	// Controls
@@ -246,13 +294,47 @@ int main(int argc, char* argv[])
 		renderer.SetProjectionMat(projectionMatrix);
 		renderer.SetViewMat(viewMatrix);
 
-		// Draw all objects in scene
-		for (int i = 0; i < currentScene->models.size(); i++) 
+		// Draw all objects in scene. Instanced scenes draw every copy of a model in one go, lit scenes are queued and shaded deferred, the rest go out as one indirect submission.
+		if (!currentScene->instances.empty())
 		{
-			modelMatrix = glm::translate(glm::mat4(1), currentScene->modelPositions[i]);
-			renderer.SetModelMat(modelMatrix);
-			renderer.SetModel(currentScene->models[i]);
-			renderer.Draw();
+			renderer.SetInstances(currentScene->instances);
+			for (size_t i = 0; i < currentScene->models.size(); i++) 
+			{
+				renderer.SetModel(currentScene->models[i]);
+				renderer.Draw();
+			}
+		}
+		else if (!currentScene->lights.empty())
+		{
+			transforms.Update(&ePBR::ThreadPool::GetShared());
+
+			// Lights circle the floor in rings, alternately one way and the other, so tiles gain and lose them as they pass
+			float seconds = currentTime / 1000.0f;
+			std::vector<ePBR::Light>& lights = currentScene->lights;
+			for (size_t i = 0; i < lights.size(); i++)
+			{
+				float ring = 1.0f + (i % 4) * 1.75f;
+				float angle = i * 0.4f + seconds * ((i % 2) ? 0.5f : -0.5f);
+				lights[i].position = glm::vec3(ring * glm::cos(angle), 0.75f, ring * glm::sin(angle));
+			}
+			deferredShading->SetLights(lights);
+
+			for (size_t i = 0; i < currentScene->models.size(); i++)
+			{
+				renderer.Queue(currentScene->models[i], transforms.GetWorldMatrix(currentScene->modelTransforms[i]));
+			}
+			renderer.Flush();
+		}
+		else
+		{
+			transforms.Update(&ePBR::ThreadPool::GetShared());
+
+			std::vector<glm::mat4> modelMatrices;
+			for (size_t i = 0; i < currentScene->models.size(); i++) 
+			{
+				modelMatrices.push_back(transforms.GetWorldMatrix(currentScene->modelTransforms[i]));
+			}
+			renderer.DrawScene(currentScene->models, modelMatrices);
 		}
 
 		if (showIMGUI)
@@ -304,6 +386,10 @@ int main(int argc, char* argv[])
 				{
 					currentScene = &arrayOfSpheresScene;
 				}
+				else if (currentScene != &deferredLightsScene && ImGui::Button("Switch to deferred lights scene"))
+				{
+					currentScene = &deferredLightsScene;
+				}
 
 				// Environment map switching
 				ImGui::Text("Manage environment map:");
@@ -341,6 +427,12 @@ int main(int argc, char* argv[])
 
 				// Display FPS
 				ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+				const ePBR::CullingStats& cullingStats = renderer.GetCullingStats();
+				ImGui::Text("Culling: %zu visible, %zu culled of %zu", cullingStats.visible, cullingStats.tested - cullingStats.visible, cullingStats.tested);
+				if (!currentScene->lights.empty()) ImGui::Text("Deferred shading: %zu lights", currentScene->lights.size());
+				ePBR::StateCache& stateCache = ePBR::StateCache::GetShared();
+				ImGui::Text("GL state calls: %zu issued, %zu elided", stateCache.GetStats().issued, stateCache.GetStats().elided);
+				stateCache.ResetStats();
 
 				// We've finished adding stuff to the window
 				ImGui::End();
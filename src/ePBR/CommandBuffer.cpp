@@ -0,0 +1,35 @@
+#include "CommandBuffer.h"
+#include "Mesh.h"
+
+namespace ePBR
+{
+	void CommandBuffer::Add(Mesh* _mesh, Material* _material, const glm::mat4& _modelMatrix, size_t _lod)
+	{
+		DrawPacket packet;
+		packet.mesh = _mesh;
+		packet.material = _material;
+		packet.modelMatrix = _modelMatrix;
+		packet.lod = _lod;
+
+		// Quantised positions are relative to the mesh bounds, so objects are mapped to model space first
+		packet.objectMatrix = _modelMatrix * _mesh->GetPositionDecode();
+
+		glm::vec3 center = (_mesh->GetBoundsMin() + _mesh->GetBoundsMax()) * 0.5f;
+		packet.center = glm::vec3(_modelMatrix * glm::vec4(center, 1.0f));
+
+		m_packets.push_back(packet);
+
+		if (_material != m_lastMaterial)
+		{
+			m_materials.insert(_material);
+			m_lastMaterial = _material;
+		}
+	}
+
+	void CommandBuffer::Clear()
+	{
+		m_packets.clear();
+		m_materials.clear();
+		m_lastMaterial = nullptr;
+	}
+}
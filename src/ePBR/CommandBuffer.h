@@ -0,0 +1,68 @@
+#ifndef EPBR_COMMAND_BUFFER
+#define EPBR_COMMAND_BUFFER
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace ePBR
+{
+	class Mesh;
+	class Material;
+
+	/// @brief One recorded mesh draw. Holds no OpenGL state, only what the submitting thread needs to key and issue it.
+	struct DrawPacket
+	{
+		Mesh* mesh;
+		Material* material;
+		glm::mat4 modelMatrix; // Without the mesh's position decode
+		size_t lod;
+
+		// Model matrix with the position decode, as the shader reads it
+		glm::mat4 objectMatrix;
+
+		// World space centre of the mesh bounds, for depth sorting
+		glm::vec3 center;
+	};
+
+	/// @brief A linear buffer of draw packets, recorded by one thread at a time and submitted later by a RenderQueue.
+	/// @details Recording makes no OpenGL calls, so each worker thread can fill a buffer of its own while another thread owns the context.
+	/// Normal and model view projection matrices are left to RenderQueue::Submit(), which computes them for every packet in one batch. Buffers keep their memory between frames.
+	class CommandBuffer
+	{
+	public:
+		/// @brief Record a mesh draw.
+		/// @param _mesh The mesh. Must outlive the next RenderQueue::Submit().
+		/// @param _material The material to draw it with. Must outlive the next RenderQueue::Submit().
+		/// @param _modelMatrix The model matrix, without the mesh's position decode.
+		/// @param _lod The level of detail to draw.
+		void Add(Mesh* _mesh, Material* _material, const glm::mat4& _modelMatrix, size_t _lod);
+
+		/// @brief Empty the buffer, keeping its memory.
+		void Clear();
+
+		/// @brief Get the number of recorded packets.
+		/// @return The number of packets.
+		size_t GetCount() const { return m_packets.size(); }
+
+		/// @brief Get the recorded packets, in the order they were added.
+		/// @return The packets.
+		const std::vector<DrawPacket>& GetPackets() const { return m_packets; }
+
+		/// @brief Get every material recorded since the last Clear(), each once.
+		/// @return The materials.
+		const std::unordered_set<Material*>& GetMaterials() const { return m_materials; }
+
+	private:
+		std::vector<DrawPacket> m_packets;
+		std::unordered_set<Material*> m_materials;
+
+		// Skips the set lookup for runs of one material, which is how models record
+		Material* m_lastMaterial = nullptr;
+	};
+}
+
+#endif // EPBR_COMMAND_BUFFER
@@ -10,8 +10,12 @@
 #include "PBRMaterial.h"
 #include "Model.h"
 #include "CubeMap.h"
+#include "StateCache.h"
+#include "GpuCuller.h"
+#include "DeferredShading.h"
 #include "Mesh.h"
 #include "Shader.h"
+#include "StreamBuffer.h"
 
 #include <iostream>
 #include <stdexcept>
@@ -66,6 +70,10 @@ namespace ePBR
 		// You can experiment with the numbers to see what they do
 		int winPosX = 10;
 		int winPosY = 10;
+		// Attributes which choose the window's pixel format have to be set before it is created
+		// Deferred shading copies depth into the window, which needs the same depth and stencil sizes as its G-buffer
+		SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
+		SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 8);
 		m_window = SDL_CreateWindow("ePBR",  // The first parameter is the window title
 			winPosX, winPosY,
 			m_windowWidth, m_windowHeight,
@@ -156,6 +164,9 @@ namespace ePBR
 	void Context::DisplayFrame() 
 	{
 		SDL_GL_SwapWindow(m_window);
+
+		// Every draw of the frame is issued, so stream buffers can fence it and move on
+		StreamBuffer::EndFrameAll();
 	}
 
 	std::shared_ptr<CubeMap> Context::GenerateCubemap(std::shared_ptr<Texture> _equirectangularMap) 
@@ -187,19 +198,20 @@ namespace ePBR
 			m_skyboxEnvironmentMapLocation = glGetUniformLocation(m_skyboxShader->GetID(), "environmentMap");
 		}
 	
-		glUseProgram(m_skyboxShader->GetID());
+		StateCache& cache = StateCache::GetShared();
+		cache.UseProgram(m_skyboxShader->GetID());
 
 		// Env map
 		glUniform1i(m_skyboxEnvironmentMapLocation, 0);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, _environmentMap->m_mapID);
+		cache.BindTexture(0, GL_TEXTURE_CUBE_MAP, _environmentMap->m_mapID);
 
 		// Matrices
 		glUniformMatrix4fv(m_skyboxProjectionPos, 1, false, glm::value_ptr(_projectionMat));
 		glUniformMatrix4fv(m_skyboxViewPos, 1, false, glm::value_ptr(_viewMat));
 
 		// Ensure that we draw behind everything else!
-		glDisable(GL_DEPTH_TEST);
+		cache.SetDepthTest(false);
+		cache.SetCullFace(false);
 
 		m_unitCube->Draw();
 	}
@@ -293,6 +305,7 @@ namespace ePBR
 		glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
 		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		StateCache::GetShared().Invalidate();
 
 		return conv;
 	}
@@ -382,6 +395,7 @@ namespace ePBR
 		}
 
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		StateCache::GetShared().Invalidate();
 		return prefilterMap;
 	}
 
@@ -426,10 +440,30 @@ namespace ePBR
 		quad.Draw();
 
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		StateCache::GetShared().Invalidate();
 
 		return m_BRDFLUT;
 	}
 
+	std::shared_ptr<GpuCuller> Context::CreateGpuCuller()
+	{
+		return std::make_shared<GpuCuller>(
+			m_pwd + "data/shaders/culling/GpuCull.comp",
+			m_pwd + "data/shaders/culling/HiZBuild.comp",
+			m_pwd + "data/shaders/culling/CompactDraws.comp"
+			);
+	}
+
+	std::shared_ptr<DeferredShading> Context::CreateDeferredShading(bool _octahedralNormals)
+	{
+		return std::make_shared<DeferredShading>(
+			m_pwd + "data/shaders/deferred/LightTiles.comp",
+			m_pwd + "data/shaders/deferred/Lighting.vert",
+			m_pwd + "data/shaders/deferred/Lighting.frag",
+			_octahedralNormals
+			);
+	}
+
 	Context::Context(std::string _projectWorkingDirectory) :
 		m_SDL_Renderer(NULL),
 		m_window(NULL),
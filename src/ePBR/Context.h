@@ -17,6 +17,8 @@ namespace ePBR
 	class Texture;
 	class Mesh;
 	class Shader;
+	class GpuCuller;
+	class DeferredShading;
 
 	class Context 
 	{
@@ -83,6 +85,7 @@ namespace ePBR
 		int GetWindowHeight() const { return m_windowHeight; }
 
 		/// @brief Disply the rendered frame in the target SDL window. Should be called after all render calls.
+		/// @details Also ends the frame of every StreamBuffer, fencing the regions this frame drew from.
 		void DisplayFrame();
 
 		/// @brief Generate a CubeMap from an equirecatangular environment map.
@@ -110,6 +113,15 @@ namespace ePBR
 		/// @return The BRDF lookup texture.
 		std::shared_ptr<Texture> GetBRDFLookupTexture();
 
+		/// @brief Load the compute shaders for culling on the GPU. Needs OpenGL 4.3.
+		/// @return A new GpuCuller, for Renderer::SetGpuCuller().
+		std::shared_ptr<GpuCuller> CreateGpuCuller();
+
+		/// @brief Load the shaders for tiled deferred shading. Needs OpenGL 4.3.
+		/// @param _octahedralNormals Whether the G-buffer stores normals in 32 bits rather than 64, see DeferredShading.
+		/// @return A new DeferredShading, for Renderer::SetDeferredShading().
+		std::shared_ptr<DeferredShading> CreateDeferredShading(bool _octahedralNormals = true);
+
 		/// @brief Construct an ePBR context. Init() will need to be called before rendering can be done.
 		/// @param _projectWorkingDirectory The project working directory - the location of the program's executable and data directory.
 		Context(std::string _projectWorkingDirectory);
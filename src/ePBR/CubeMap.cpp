@@ -2,6 +2,7 @@
 #include "Texture.h"
 #include "Shader.h"
 #include "Mesh.h"
+#include "StateCache.h"
 
 #include <GL/glew.h>
 #include <glm/ext.hpp>
@@ -96,6 +97,7 @@ namespace ePBR
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
 		glBindRenderbuffer(GL_RENDERBUFFER, 0);
 		glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+		StateCache::GetShared().Invalidate();
 	}
 
 	CubeMap::~CubeMap() 
@@ -103,5 +105,6 @@ namespace ePBR
 		glDeleteTextures(1, &m_mapID);
 		glDeleteRenderbuffers(1, &m_renderBufferID);
 		glDeleteFramebuffers(1, &m_frameBufferID);
+		StateCache::GetShared().Invalidate();
 	}
 }
\ No newline at end of file
@@ -0,0 +1,192 @@
+#include "Culling.h"
+#include "Simd.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ePBR
+{
+	namespace
+	{
+		// Spheres per task. Small enough to balance across threads, large enough that a task outweighs handing it out.
+		const size_t CULL_CHUNK_SIZE = 4096;
+
+		int CountLanes(int _mask)
+		{
+			return (_mask & 1) + ((_mask >> 1) & 1) + ((_mask >> 2) & 1) + ((_mask >> 3) & 1);
+		}
+	}
+
+	BoundingSphere TransformSphere(const BoundingSphere& _sphere, const glm::mat4& _matrix)
+	{
+		glm::mat3 linear(_matrix);
+		float scale = std::sqrt(std::max(glm::dot(linear[0], linear[0]), std::max(glm::dot(linear[1], linear[1]), glm::dot(linear[2], linear[2]))));
+
+		BoundingSphere moved;
+		moved.center = glm::vec3(_matrix * glm::vec4(_sphere.center, 1.0f));
+		moved.radius = _sphere.radius * scale;
+		return moved;
+	}
+
+	void ExtractFrustumPlanes(const glm::mat4& _matrix, glm::vec4 _planes[6])
+	{
+		// Clip space bounds are -w <= x, y, z <= w, so each plane is the last row plus or minus another
+		glm::vec4 row[4];
+		for (int r = 0; r < 4; r++) row[r] = glm::vec4(_matrix[0][r], _matrix[1][r], _matrix[2][r], _matrix[3][r]);
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			_planes[axis * 2] = row[3] + row[axis];
+			_planes[axis * 2 + 1] = row[3] - row[axis];
+		}
+
+		for (int p = 0; p < 6; p++)
+		{
+			float length = glm::length(glm::vec3(_planes[p]));
+			if (length > 0.0f) _planes[p] /= length;
+		}
+	}
+
+	FrustumCuller::FrustumCuller() :
+		m_count(0)
+	{
+	}
+
+	void FrustumCuller::Clear()
+	{
+		m_count = 0;
+		m_centerX.clear();
+		m_centerY.clear();
+		m_centerZ.clear();
+		m_radius.clear();
+	}
+
+	size_t FrustumCuller::Add(const BoundingSphere& _sphere)
+	{
+		// Grow a whole batch at a time. Unused lanes hold empty spheres at the origin and are ignored.
+		if (m_count % 4 == 0)
+		{
+			m_centerX.resize(m_count + 4, 0.0f);
+			m_centerY.resize(m_count + 4, 0.0f);
+			m_centerZ.resize(m_count + 4, 0.0f);
+			m_radius.resize(m_count + 4, 0.0f);
+		}
+
+		m_centerX[m_count] = _sphere.center.x;
+		m_centerY[m_count] = _sphere.center.y;
+		m_centerZ[m_count] = _sphere.center.z;
+		m_radius[m_count] = _sphere.radius;
+		return m_count++;
+	}
+
+	const CullingStats& FrustumCuller::Cull(const glm::mat4& _viewMatrix, const glm::mat4& _projMatrix, const glm::vec3& _camPos, const CullingOptions& _options, ThreadPool* _pool)
+	{
+		m_visible.resize(m_count);
+
+		glm::vec4 planes[6];
+		ExtractFrustumPlanes(_projMatrix * _viewMatrix, planes);
+
+		// Viewport heights covered by a unit of diameter at unit distance. Clip space y spans 2.
+		float projScale = _projMatrix[1][1];
+
+		size_t chunkCount = (m_count + CULL_CHUNK_SIZE - 1) / CULL_CHUNK_SIZE;
+		m_chunkStats.assign(chunkCount, CullingStats());
+
+		auto cullChunk = [&](size_t _chunk)
+		{
+			size_t begin = _chunk * CULL_CHUNK_SIZE;
+			m_chunkStats[_chunk] = CullRange(begin, std::min(begin + CULL_CHUNK_SIZE, m_count), planes, _camPos, _options, projScale);
+		};
+
+		if (_pool && chunkCount > 1) _pool->ParallelFor(chunkCount, cullChunk);
+		else for (size_t c = 0; c < chunkCount; c++) cullChunk(c);
+
+		m_stats = CullingStats();
+		for (const CullingStats& chunk : m_chunkStats)
+		{
+			m_stats.tested += chunk.tested;
+			m_stats.visible += chunk.visible;
+			m_stats.frustumCulled += chunk.frustumCulled;
+			m_stats.distanceCulled += chunk.distanceCulled;
+			m_stats.sizeCulled += chunk.sizeCulled;
+		}
+
+		return m_stats;
+	}
+
+	CullingStats FrustumCuller::CullRange(size_t _begin, size_t _end, const glm::vec4 _planes[6], const glm::vec3& _camPos, const CullingOptions& _options, float _projScale)
+	{
+		Float4 planeX[6], planeY[6], planeZ[6], planeW[6];
+		for (int p = 0; p < 6; p++)
+		{
+			planeX[p] = Float4(_planes[p].x);
+			planeY[p] = Float4(_planes[p].y);
+			planeZ[p] = Float4(_planes[p].z);
+			planeW[p] = Float4(_planes[p].w);
+		}
+
+		Float4 camX(_camPos.x), camY(_camPos.y), camZ(_camPos.z);
+		Float4 zero(0.0f);
+		Float4 maxDistance(_options.maxDistance);
+		Float4 projScale(_projScale);
+		Float4 minScreenSize(_options.minScreenSize);
+		bool distanceTest = _options.maxDistance > 0.0f;
+		bool sizeTest = _options.minScreenSize > 0.0f;
+
+		CullingStats stats;
+		for (size_t i = _begin; i < _end; i += 4)
+		{
+			Float4 x = Float4::LoadUnaligned(&m_centerX[i]);
+			Float4 y = Float4::LoadUnaligned(&m_centerY[i]);
+			Float4 z = Float4::LoadUnaligned(&m_centerZ[i]);
+			Float4 radius = Float4::LoadUnaligned(&m_radius[i]);
+			Float4 negRadius = zero - radius;
+
+			// Outside when wholly behind any one plane
+			Float4 outside = (planeX[0] * x + planeY[0] * y + planeZ[0] * z + planeW[0]) < negRadius;
+			for (int p = 1; p < 6; p++)
+			{
+				outside = outside | ((planeX[p] * x + planeY[p] * y + planeZ[p] * z + planeW[p]) < negRadius);
+			}
+
+			Float4 dx = x - camX, dy = y - camY, dz = z - camZ;
+			Float4 distanceSquared = dx * dx + dy * dy + dz * dz;
+
+			// Nearest point past the limit: |c - cam| > maxDistance + r, compared squared
+			int farMask = 0;
+			if (distanceTest)
+			{
+				Float4 limit = maxDistance + radius;
+				farMask = MoveMask(distanceSquared > limit * limit);
+			}
+
+			// Projected diameter r * P11 / d below the limit, compared squared to avoid the root
+			int smallMask = 0;
+			if (sizeTest)
+			{
+				Float4 projected = radius * projScale;
+				smallMask = MoveMask(projected * projected < minScreenSize * minScreenSize * distanceSquared);
+			}
+
+			int laneMask = (int)(0xF >> (4 - std::min<size_t>(4, _end - i)));
+			int outsideMask = MoveMask(outside) & laneMask;
+			farMask &= laneMask & ~outsideMask;
+			smallMask &= laneMask & ~outsideMask & ~farMask;
+			int visibleMask = laneMask & ~(outsideMask | farMask | smallMask);
+
+			for (size_t lane = 0; lane < 4 && i + lane < _end; lane++)
+			{
+				m_visible[i + lane] = (unsigned char)((visibleMask >> lane) & 1);
+			}
+
+			stats.tested += CountLanes(laneMask);
+			stats.visible += CountLanes(visibleMask);
+			stats.frustumCulled += CountLanes(outsideMask);
+			stats.distanceCulled += CountLanes(farMask);
+			stats.sizeCulled += CountLanes(smallMask);
+		}
+
+		return stats;
+	}
+}
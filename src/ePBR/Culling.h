@@ -0,0 +1,108 @@
+#ifndef EPBR_CULLING
+#define EPBR_CULLING
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace ePBR
+{
+	class ThreadPool;
+
+	/// @brief A sphere enclosing some geometry.
+	struct BoundingSphere
+	{
+		glm::vec3 center = glm::vec3(0.0f);
+		float radius = 0.0f;
+	};
+
+	/// @brief Move a bounding sphere by a matrix, growing it by the matrix's largest stretch so it still encloses the geometry.
+	/// @param _sphere The sphere.
+	/// @param _matrix The matrix.
+	/// @return The moved sphere.
+	BoundingSphere TransformSphere(const BoundingSphere& _sphere, const glm::mat4& _matrix);
+
+	/// @brief Get the six planes of the frustum a matrix projects into clip space, pointing inwards and normalised so that plane distances are in the matrix's source units.
+	/// @param _matrix The matrix to clip space, such as a view projection or model view projection matrix.
+	/// @param _planes Receives the left, right, bottom, top, near and far planes, as (normal, distance).
+	void ExtractFrustumPlanes(const glm::mat4& _matrix, glm::vec4 _planes[6]);
+
+	/// @brief Culling tests made on top of the frustum test.
+	struct CullingOptions
+	{
+		/// @brief Cull spheres whose nearest point is further from the camera than this. 0 culls nothing by distance.
+		float maxDistance = 0.0f;
+
+		/// @brief Cull spheres whose diameter covers less than this fraction of the viewport height. 0 culls nothing by size.
+		float minScreenSize = 0.0f;
+	};
+
+	/// @brief The outcome of one culling pass. Each sphere counts towards the first test it failed.
+	struct CullingStats
+	{
+		size_t tested = 0;
+		size_t visible = 0;
+		size_t frustumCulled = 0;
+		size_t distanceCulled = 0;
+		size_t sizeCulled = 0;
+		size_t occlusionCulled = 0;
+	};
+
+	/// @brief Tests many world space bounding spheres against a camera at once.
+	/// @details Spheres are held as structure of arrays so that each SIMD instruction tests four at a time against a plane.
+	/// Large sets are split into chunks which run on a ThreadPool.
+	class FrustumCuller
+	{
+	public:
+		FrustumCuller();
+
+		/// @brief Remove every sphere.
+		void Clear();
+
+		/// @brief Add a sphere to be tested.
+		/// @param _sphere The sphere, in world space.
+		/// @return The sphere's index, for IsVisible().
+		size_t Add(const BoundingSphere& _sphere);
+
+		/// @brief Get the number of spheres added since the last Clear().
+		/// @return The number of spheres.
+		size_t GetCount() const { return m_count; }
+
+		/// @brief Test every sphere against a camera.
+		/// @param _viewMatrix The view matrix.
+		/// @param _projMatrix The projection matrix.
+		/// @param _camPos The position of the camera.
+		/// @param _options Tests to make on top of the frustum test.
+		/// @param _pool The pool to split large sets across, or nullptr to run on the calling thread alone.
+		/// @return How many spheres passed and failed each test.
+		const CullingStats& Cull(const glm::mat4& _viewMatrix, const glm::mat4& _projMatrix, const glm::vec3& _camPos, const CullingOptions& _options, ThreadPool* _pool = nullptr);
+
+		/// @brief Get whether a sphere passed the last Cull().
+		/// @param _index The index Add() returned for the sphere.
+		/// @return Whether it may be visible.
+		bool IsVisible(size_t _index) const { return m_visible[_index] != 0; }
+
+		/// @brief Get the results of the last Cull().
+		/// @return How many spheres passed and failed each test.
+		const CullingStats& GetStats() const { return m_stats; }
+
+	private:
+		// Test spheres [_begin, _end), where _begin is a multiple of four
+		CullingStats CullRange(size_t _begin, size_t _end, const glm::vec4 _planes[6], const glm::vec3& _camPos, const CullingOptions& _options, float _projScale);
+
+		size_t m_count;
+
+		// Padded to a multiple of four, so every batch loads whole
+		std::vector<float> m_centerX;
+		std::vector<float> m_centerY;
+		std::vector<float> m_centerZ;
+		std::vector<float> m_radius;
+
+		std::vector<unsigned char> m_visible;
+		std::vector<CullingStats> m_chunkStats;
+		CullingStats m_stats;
+	};
+}
+
+#endif // EPBR_CULLING
@@ -0,0 +1,229 @@
+#include "DeferredShading.h"
+#include "CubeMap.h"
+#include "RenderTexture.h"
+#include "ShaderBlocks.h"
+#include "StateCache.h"
+#include "Texture.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include <glm/gtc/type_ptr.hpp>
+
+namespace ePBR
+{
+	DeferredShading::DeferredShading(const std::string& _tilesPath, const std::string& _lightingVertexPath, const std::string& _lightingFragmentPath, bool _octahedralNormals) :
+		m_target(nullptr),
+		m_targetWidth(0),
+		m_targetHeight(0),
+		m_lightBuffer(MAX_LIGHTS_PER_FRAME * sizeof(LightData)),
+		m_storageAlignment(4),
+		m_tileBuffer(0),
+		m_tileCountX(0),
+		m_tileCountY(0),
+		m_emptyVertexArray(0),
+		m_windowDepthChecked(false),
+		m_windowDepthMatches(false)
+	{
+		static_assert(sizeof(LightData) == 48, "LightData must match the std430 layout of the deferred shaders");
+
+		// Albedo and metalness, then normal and roughness. Octahedral normals fit in 32 bits where half floats take 64.
+		m_gbufferDefine = _octahedralNormals ? "GBUFFER_OCTAHEDRAL" : "GBUFFER";
+		m_gbufferFormats = { GL_RGBA8, (GLenum)(_octahedralNormals ? GL_RGB10_A2 : GL_RGBA16F) };
+
+		std::vector<std::string> defines;
+		if (_octahedralNormals) defines.push_back("OCTAHEDRAL_NORMALS");
+
+		m_tilesShader.reset(new ComputeShader(_tilesPath));
+		m_lightingShader = std::make_shared<Shader>(_lightingVertexPath, _lightingFragmentPath, defines);
+		m_environmentLightingShader = m_lightingShader->GetVariant("IMAGE_BASED_LIGHTING");
+
+		GLint alignment = 0;
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		m_storageAlignment = std::max<size_t>(4, (size_t)alignment);
+
+		glGenBuffers(1, &m_tileBuffer);
+		glGenVertexArrays(1, &m_emptyVertexArray);
+	}
+
+	DeferredShading::~DeferredShading()
+	{
+		glDeleteBuffers(1, &m_tileBuffer);
+		glDeleteVertexArrays(1, &m_emptyVertexArray);
+		StateCache::GetShared().Invalidate();
+	}
+
+	void DeferredShading::SetEnvironment(std::shared_ptr<CubeMap> _irradianceMap, std::shared_ptr<CubeMap> _prefilterMap, std::shared_ptr<Texture> _brdfLUT)
+	{
+		m_irradianceMap = _irradianceMap;
+		m_prefilterMap = _prefilterMap;
+		m_brdfLUT = _brdfLUT;
+	}
+
+	void DeferredShading::Begin(const RenderTexture* _target, int _width, int _height)
+	{
+		m_target = _target;
+		m_targetWidth = _target ? (int)_target->GetWidth() : _width;
+		m_targetHeight = _target ? (int)_target->GetHeight() : _height;
+
+		if (!m_gbuffer)
+		{
+			m_gbuffer = std::make_shared<RenderTexture>(m_targetWidth, m_targetHeight, m_gbufferFormats);
+		}
+		else if ((int)m_gbuffer->GetWidth() != m_targetWidth || (int)m_gbuffer->GetHeight() != m_targetHeight)
+		{
+			m_gbuffer->Resize(m_targetWidth, m_targetHeight);
+		}
+
+		m_gbuffer->Bind();
+		glViewport(0, 0, m_targetWidth, m_targetHeight);
+
+		// Pixels left at the far plane are skipped by the lighting pass, so nothing else needs a meaningful clear value
+		StateCache::GetShared().SetDepthWrite(true);
+		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	}
+
+	void DeferredShading::Shade(const glm::mat4& _viewMatrix, const glm::mat4& _projMatrix, const glm::vec3& _camPos)
+	{
+		if (!m_gbuffer) return;
+
+		StateCache& cache = StateCache::GetShared();
+
+		GLuint tileCountX = ((GLuint)m_targetWidth + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE;
+		GLuint tileCountY = ((GLuint)m_targetHeight + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE;
+		ReserveTiles(tileCountX, tileCountY);
+
+		// Cones are turned into a scale and offset of the angle's cosine, so the shaders treat point and spot lights alike
+		size_t lightCount = std::min(m_lights.size(), MAX_LIGHTS_PER_FRAME);
+		m_lightData.resize(lightCount);
+		for (size_t i = 0; i < lightCount; i++)
+		{
+			const Light& light = m_lights[i];
+
+			float spotScale = 0.0f;
+			float spotOffset = 1.0f;
+			if (light.spot)
+			{
+				float cosInner = std::cos(light.innerAngle);
+				float cosOuter = std::cos(light.outerAngle);
+				spotScale = 1.0f / std::max(cosInner - cosOuter, 0.0001f);
+				spotOffset = -cosOuter * spotScale;
+			}
+
+			m_lightData[i].positionRadius = glm::vec4(light.position, light.radius);
+			m_lightData[i].colourSpotOffset = glm::vec4(light.colour, spotOffset);
+			m_lightData[i].directionSpotScale = glm::vec4(glm::normalize(light.direction), spotScale);
+		}
+
+		if (lightCount)
+		{
+			size_t lightsOffset = m_lightBuffer.Write(m_lightData.data(), lightCount * sizeof(LightData), m_storageAlignment);
+			if (lightsOffset == StreamBuffer::NO_SPACE)
+			{
+				static bool warned = false;
+				if (!warned)
+				{
+					std::cerr << "WARNING: More lights were shaded this frame than MAX_LIGHTS_PER_FRAME. Some passes have been shaded without them." << std::endl;
+					warned = true;
+				}
+				lightCount = 0;
+			}
+			else
+			{
+				glBindBufferRange(GL_SHADER_STORAGE_BUFFER, LIGHT_STORAGE_BINDING, m_lightBuffer.GetID(), lightsOffset, lightCount * sizeof(LightData));
+			}
+		}
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_TILE_STORAGE_BINDING, m_tileBuffer);
+
+		SetViewUniforms(_viewMatrix, _projMatrix, _camPos);
+
+		// One work group per tile finds its depth range, then the lights whose bounds reach into it
+		GLuint tilesProgram = m_tilesShader->GetID();
+		cache.UseProgram(tilesProgram);
+		glUniform1ui(glGetUniformLocation(tilesProgram, "lightCount"), (GLuint)lightCount);
+		glUniformMatrix4fv(glGetUniformLocation(tilesProgram, "invProjMat"), 1, GL_FALSE, glm::value_ptr(glm::inverse(_projMatrix)));
+		cache.BindTexture(2, GL_TEXTURE_2D, m_gbuffer->GetDepthTextureID());
+		glDispatchCompute(tileCountX, tileCountY, 1);
+
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+		// Depth goes across first, so forward draws after this are hidden behind what was shaded
+		GLuint targetFramebuffer = m_target ? m_target->GetFBOID() : 0;
+		bool copyDepth = m_target || MatchesWindowDepth();
+		if (copyDepth)
+		{
+			cache.BindFramebuffer(m_gbuffer->GetFBOID());
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, targetFramebuffer);
+			glBlitFramebuffer(0, 0, m_targetWidth, m_targetHeight, 0, 0, m_targetWidth, m_targetHeight, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+		}
+		cache.BindFramebuffer(targetFramebuffer);
+
+		// One full screen triangle, shading over whatever the target already holds. Without the copy, it writes depth as it goes, over the cleared target.
+		bool environment = m_irradianceMap && m_prefilterMap && m_brdfLUT;
+		std::shared_ptr<Shader> lightingShader = environment ? m_environmentLightingShader : m_lightingShader;
+		if (!copyDepth) lightingShader = lightingShader->GetVariant("WRITE_DEPTH");
+		GLuint lightingProgram = lightingShader->GetID();
+		cache.UseProgram(lightingProgram);
+		cache.SetBlend(false);
+		cache.SetDepthTest(!copyDepth);
+		cache.SetDepthWrite(!copyDepth);
+
+		glUniformMatrix4fv(glGetUniformLocation(lightingProgram, "invViewProjMat"), 1, GL_FALSE, glm::value_ptr(glm::inverse(_projMatrix * _viewMatrix)));
+		glUniform1ui(glGetUniformLocation(lightingProgram, "tileCountX"), tileCountX);
+
+		const GLenum gbufferTargets[3] = { GL_TEXTURE_2D, GL_TEXTURE_2D, GL_TEXTURE_2D };
+		const GLuint gbufferTextures[3] = { m_gbuffer->GetTextureID(0), m_gbuffer->GetTextureID(1), m_gbuffer->GetDepthTextureID() };
+		cache.BindTextures(0, 3, gbufferTargets, gbufferTextures);
+
+		// The same units the forward shaders read their environment maps from
+		if (environment)
+		{
+			const GLenum environmentTargets[3] = { GL_TEXTURE_CUBE_MAP, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_2D };
+			const GLuint environmentTextures[3] = { m_irradianceMap->GetMapID(), m_prefilterMap->GetMapID(), m_brdfLUT->GetID() };
+			cache.BindTextures(5, 3, environmentTargets, environmentTextures);
+		}
+
+		cache.BindVertexArray(m_emptyVertexArray);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+
+		// Ready for forward draws against the copied depth
+		cache.SetDepthTest(true);
+		cache.SetDepthWrite(true);
+	}
+
+	bool DeferredShading::MatchesWindowDepth()
+	{
+		if (m_windowDepthChecked) return m_windowDepthMatches;
+		m_windowDepthChecked = true;
+
+		// A window without depth or stencil reports no attachment for it, and nothing else may be asked of one
+		StateCache::GetShared().BindFramebuffer(0);
+		GLint depthType = GL_NONE;
+		GLint stencilType = GL_NONE;
+		glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, GL_DEPTH, GL_FRAMEBUFFER_ATTACHMENT_OBJECT_TYPE, &depthType);
+		glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, GL_STENCIL, GL_FRAMEBUFFER_ATTACHMENT_OBJECT_TYPE, &stencilType);
+		if (depthType == GL_NONE || stencilType == GL_NONE) return m_windowDepthMatches;
+
+		GLint depthSize = 0;
+		GLint stencilSize = 0;
+		glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, GL_DEPTH, GL_FRAMEBUFFER_ATTACHMENT_DEPTH_SIZE, &depthSize);
+		glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, GL_STENCIL, GL_FRAMEBUFFER_ATTACHMENT_STENCIL_SIZE, &stencilSize);
+		m_windowDepthMatches = depthSize == 24 && stencilSize == 8;
+		return m_windowDepthMatches;
+	}
+
+	void DeferredShading::ReserveTiles(GLuint _tileCountX, GLuint _tileCountY)
+	{
+		if (_tileCountX == m_tileCountX && _tileCountY == m_tileCountY) return;
+
+		// Each tile's count, then room for its light indices
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_tileBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, (size_t)_tileCountX * _tileCountY * (MAX_LIGHTS_PER_TILE + 1) * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+		m_tileCountX = _tileCountX;
+		m_tileCountY = _tileCountY;
+	}
+}
@@ -0,0 +1,165 @@
+#ifndef EPBR_DEFERRED_SHADING
+#define EPBR_DEFERRED_SHADING
+
+#include "Shader.h"
+#include "StreamBuffer.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+namespace ePBR
+{
+	class CubeMap;
+	class RenderTexture;
+	class Texture;
+
+	/// @brief The shader storage binding the deferred shaders read lights from.
+	const GLuint LIGHT_STORAGE_BINDING = 7;
+
+	/// @brief The shader storage binding the deferred shaders read and write each tile's lights through.
+	const GLuint LIGHT_TILE_STORAGE_BINDING = 8;
+
+	/// @brief The width and height in pixels of the screen tiles lights are culled against.
+	const GLuint LIGHT_TILE_SIZE = 16;
+
+	/// @brief The most lights one tile can be shaded with. Any more touching it are left out.
+	const GLuint MAX_LIGHTS_PER_TILE = 256;
+
+	/// @brief The most lights DeferredShading uploads in one frame.
+	const size_t MAX_LIGHTS_PER_FRAME = 1 << 14;
+
+	/// @brief A light for DeferredShading to shade with.
+	struct Light
+	{
+		/// @brief World space position.
+		glm::vec3 position = glm::vec3(0.0f);
+
+		/// @brief Radiance one unit away. Falls off with the square of the distance.
+		glm::vec3 colour = glm::vec3(1.0f);
+
+		/// @brief Distance at which the light fades out entirely, and beyond which it is culled.
+		float radius = 10.0f;
+
+		/// @brief Whether the light shines in a cone around its direction rather than all round.
+		bool spot = false;
+
+		/// @brief World space direction a spot light shines in.
+		glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f);
+
+		/// @brief Angles from a spot light's direction, in radians, within which it is at full strength and beyond which it is dark.
+		float innerAngle = 0.5f;
+		float outerAngle = 0.7f;
+	};
+
+	/// @brief Shades opaque geometry once per pixel with any number of point and spot lights, rather than once per fragment drawn.
+	/// @details Materials draw their albedo, metalness, normal and roughness into a G-buffer with the variant named by GetGBufferDefine(), see Material::SetGBufferVariant().
+	/// Shade() then finds the lights touching each 16 pixel square tile on the GPU, from the depth range of the G-buffer within it, and shades every covered pixel
+	/// in one full screen pass with the same Cook-Torrance and image based lighting functions as the forward shaders. Shading costs screen pixels times the lights touching them, whatever the overdraw.
+	/// Transparent materials and those without a G-buffer variant are left to forward shading after Shade(), which copies the G-buffer's depth into the target for them to test against.
+	class DeferredShading
+	{
+	public:
+		/// @brief Load the deferred shaders and create an empty G-buffer.
+		/// @param _tilesPath The path to the light tile compute shader.
+		/// @param _lightingVertexPath The path to the full screen lighting vertex shader.
+		/// @param _lightingFragmentPath The path to the lighting fragment shader.
+		/// @param _octahedralNormals Whether to store normals as two 10 bit octahedral coordinates, halving the bytes per pixel of the normal target, rather than three half floats.
+		DeferredShading(const std::string& _tilesPath, const std::string& _lightingVertexPath, const std::string& _lightingFragmentPath, bool _octahedralNormals);
+		~DeferredShading();
+
+		DeferredShading(const DeferredShading&) = delete;
+		DeferredShading& operator=(const DeferredShading&) = delete;
+
+		/// @brief Bind the G-buffer, sized to match the target, and clear it, ready for materials to draw into with their G-buffer variants.
+		/// @param _target The render target Shade() will shade into, or nullptr for the window. Must outlive the next Shade().
+		/// @param _width The width of the target.
+		/// @param _height The height of the target.
+		void Begin(const RenderTexture* _target, int _width, int _height);
+
+		/// @brief Shade everything drawn into the G-buffer since Begin() into its target, with the set lights and environment.
+		/// @details Pixels nothing was drawn to are left as they are. Leaves the target bound, with the G-buffer's depth in it, depth testing on and blending off.
+		/// Depth is copied across when the target's format matches the G-buffer's. A window whose doesn't must have been cleared, as the lighting pass writes depth into it instead.
+		/// @param _viewMatrix The view matrix the G-buffer was drawn with.
+		/// @param _projMatrix The projection matrix the G-buffer was drawn with.
+		/// @param _camPos The position of the camera.
+		void Shade(const glm::mat4& _viewMatrix, const glm::mat4& _projMatrix, const glm::vec3& _camPos);
+
+		/// @brief Get the define materials' G-buffer variants are compiled with, for Material::SetGBufferVariant().
+		/// @return GBUFFER_OCTAHEDRAL with octahedral normals, otherwise GBUFFER.
+		const std::string& GetGBufferDefine() const { return m_gbufferDefine; }
+
+		/// @brief Set the lights to shade with. Only the first MAX_LIGHTS_PER_FRAME are used.
+		/// @param _newLights The lights.
+		void SetLights(const std::vector<Light>& _newLights) { m_lights = _newLights; }
+
+		/// @brief Get the lights shaded with.
+		/// @return The lights.
+		const std::vector<Light>& GetLights() const { return m_lights; }
+
+		/// @brief Set the maps to light every pixel with its environment, as the forward image based lighting shader does.
+		/// @param _irradianceMap The irradiance CubeMap, or nullptr for a faint flat ambient instead.
+		/// @param _prefilterMap The prefiltered environment CubeMap.
+		/// @param _brdfLUT The BRDF lookup texture.
+		void SetEnvironment(std::shared_ptr<CubeMap> _irradianceMap, std::shared_ptr<CubeMap> _prefilterMap, std::shared_ptr<Texture> _brdfLUT);
+
+		/// @brief Get the G-buffer: albedo and metalness, then normal and roughness, then depth.
+		/// @return The G-buffer, or nullptr before the first Begin().
+		std::shared_ptr<RenderTexture> GetGBuffer() const { return m_gbuffer; }
+
+	private:
+		// A light laid out as an element of the std430 LightBlock. Point lights have a spot scale of 0 and offset of 1.
+		struct LightData
+		{
+			glm::vec4 positionRadius;
+			glm::vec4 colourSpotOffset;
+			glm::vec4 directionSpotScale;
+		};
+
+		// Resize the tile lists to cover a target
+		void ReserveTiles(GLuint _tileCountX, GLuint _tileCountY);
+
+		// Whether the window's depth buffer has the G-buffer's 24 bit depth and 8 bit stencil, which copying depth across needs. Asked of GL once.
+		bool MatchesWindowDepth();
+
+		std::unique_ptr<ComputeShader> m_tilesShader;
+		std::shared_ptr<Shader> m_lightingShader;
+		std::shared_ptr<Shader> m_environmentLightingShader;
+
+		std::string m_gbufferDefine;
+		std::vector<GLenum> m_gbufferFormats;
+		std::shared_ptr<RenderTexture> m_gbuffer;
+
+		// Where Shade() shades into, from Begin()
+		const RenderTexture* m_target;
+		int m_targetWidth;
+		int m_targetHeight;
+
+		// Lights for each frame, and the tile lists built from them
+		StreamBuffer m_lightBuffer;
+		size_t m_storageAlignment;
+		GLuint m_tileBuffer;
+		GLuint m_tileCountX;
+		GLuint m_tileCountY;
+
+		// Core profiles can't draw without a vertex array, even one with no attributes
+		GLuint m_emptyVertexArray;
+
+		// From MatchesWindowDepth(), as the window's formats don't change
+		bool m_windowDepthChecked;
+		bool m_windowDepthMatches;
+
+		std::vector<Light> m_lights;
+		std::vector<LightData> m_lightData;
+
+		std::shared_ptr<CubeMap> m_irradianceMap;
+		std::shared_ptr<CubeMap> m_prefilterMap;
+		std::shared_ptr<Texture> m_brdfLUT;
+	};
+}
+
+#endif // EPBR_DEFERRED_SHADING
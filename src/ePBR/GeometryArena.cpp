@@ -0,0 +1,373 @@
+#include "GeometryArena.h"
+#include "Instancing.h"
+#include "StateCache.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace ePBR
+{
+	namespace
+	{
+		// Arenas start with room for this many vertices and indices, then double
+		const size_t MIN_ARENA_VERTICES = 1 << 16;
+		const size_t MIN_ARENA_INDICES = 1 << 18;
+
+		// Arenas keyed by index type then vertex format, kept only while something uses them
+		std::map<std::vector<unsigned int>, std::weak_ptr<GeometryArena>>& GetSharedArenas()
+		{
+			static std::map<std::vector<unsigned int>, std::weak_ptr<GeometryArena>> arenas;
+			return arenas;
+		}
+
+		std::vector<unsigned int> GetArenaKey(const VertexLayout& _layout, GLenum _indexType)
+		{
+			std::vector<unsigned int> key = { _indexType, _layout.stride };
+			for (const VertexAttribute& attribute : _layout.attributes)
+			{
+				key.insert(key.end(), { attribute.location, (unsigned int)attribute.components, attribute.type, attribute.normalised, attribute.offset });
+			}
+			return key;
+		}
+
+		size_t GrowCapacity(size_t _capacity, size_t _needed, size_t _minimum)
+		{
+			size_t capacity = std::max(_capacity, _minimum);
+			while (capacity < _needed) capacity *= 2;
+			return capacity;
+		}
+	}
+
+	RangeAllocator::RangeAllocator(size_t _capacity)
+	{
+		m_capacity = 0;
+		m_freeSize = 0;
+		Grow(_capacity);
+	}
+
+	size_t RangeAllocator::Allocate(size_t _size)
+	{
+		auto fit = m_freeBySize.lower_bound(_size);
+		if (_size == 0 || fit == m_freeBySize.end()) return NO_SPACE;
+
+		size_t offset = fit->second;
+		size_t size = fit->first;
+		RemoveFreeRange(m_freeByOffset.find(offset));
+
+		// Give back whatever is left over
+		if (size > _size) AddFreeRange(offset + _size, size - _size);
+
+		return offset;
+	}
+
+	void RangeAllocator::Free(size_t _offset, size_t _size)
+	{
+		if (_size == 0) return;
+
+		// Merge with the free ranges either side
+		auto next = m_freeByOffset.lower_bound(_offset);
+		if (next != m_freeByOffset.end() && next->first == _offset + _size)
+		{
+			_size += next->second;
+			RemoveFreeRange(next);
+		}
+
+		auto previous = m_freeByOffset.lower_bound(_offset);
+		if (previous != m_freeByOffset.begin())
+		{
+			--previous;
+			if (previous->first + previous->second == _offset)
+			{
+				_offset = previous->first;
+				_size += previous->second;
+				RemoveFreeRange(previous);
+			}
+		}
+
+		AddFreeRange(_offset, _size);
+	}
+
+	void RangeAllocator::Grow(size_t _capacity)
+	{
+		if (_capacity <= m_capacity) return;
+
+		size_t oldCapacity = m_capacity;
+		m_capacity = _capacity;
+		Free(oldCapacity, _capacity - oldCapacity);
+	}
+
+	void RangeAllocator::Reset(size_t _capacity, size_t _used)
+	{
+		m_freeByOffset.clear();
+		m_freeBySize.clear();
+		m_freeSize = 0;
+
+		m_capacity = _capacity;
+		if (_used < _capacity) AddFreeRange(_used, _capacity - _used);
+	}
+
+	void RangeAllocator::AddFreeRange(size_t _offset, size_t _size)
+	{
+		m_freeByOffset[_offset] = _size;
+		m_freeBySize.insert({ _size, _offset });
+		m_freeSize += _size;
+	}
+
+	void RangeAllocator::RemoveFreeRange(std::map<size_t, size_t>::iterator _range)
+	{
+		// Several ranges can share a size, so find the one with this offset
+		auto sized = m_freeBySize.equal_range(_range->second);
+		for (auto it = sized.first; it != sized.second; ++it)
+		{
+			if (it->second == _range->first)
+			{
+				m_freeBySize.erase(it);
+				break;
+			}
+		}
+
+		m_freeSize -= _range->second;
+		m_freeByOffset.erase(_range);
+	}
+
+	GeometryAllocation::~GeometryAllocation()
+	{
+		m_arena->Free(this);
+	}
+
+	std::shared_ptr<GeometryArena> GeometryArena::GetShared(const VertexLayout& _layout, GLenum _indexType)
+	{
+		std::weak_ptr<GeometryArena>& shared = GetSharedArenas()[GetArenaKey(_layout, _indexType)];
+
+		std::shared_ptr<GeometryArena> arena = shared.lock();
+		if (!arena)
+		{
+			arena = std::make_shared<GeometryArena>(_layout, _indexType);
+			shared = arena;
+		}
+
+		return arena;
+	}
+
+	void GeometryArena::CompactShared(float _maxFragmentation)
+	{
+		for (auto& shared : GetSharedArenas())
+		{
+			std::shared_ptr<GeometryArena> arena = shared.second.lock();
+			if (arena && arena->GetFragmentation() > _maxFragmentation) arena->Compact();
+		}
+	}
+
+	GeometryArena::GeometryArena(const VertexLayout& _layout, GLenum _indexType)
+	{
+		m_layout = _layout;
+		m_indexType = _indexType;
+
+		glGenVertexArrays(1, &m_vertexArrayID);
+		if (!m_vertexArrayID)
+		{
+			throw std::exception();
+		}
+
+		// Buffers are created with the first allocation
+		m_vertexBufferID = 0;
+		m_indexBufferID = 0;
+	}
+
+	GeometryArena::~GeometryArena()
+	{
+		glDeleteVertexArrays(1, &m_vertexArrayID);
+		StateCache::GetShared().Invalidate();
+		if (m_vertexBufferID) glDeleteBuffers(1, &m_vertexBufferID);
+		if (m_indexBufferID) glDeleteBuffers(1, &m_indexBufferID);
+	}
+
+	std::shared_ptr<GeometryAllocation> GeometryArena::Allocate(const void* _vertices, size_t _vertexCount, const void* _indices, size_t _indexCount)
+	{
+		// Empty ranges take no space, so they never make the arena grow
+		size_t firstVertex = _vertexCount ? m_vertices.Allocate(_vertexCount) : 0;
+		size_t firstIndex = _indexCount ? m_indices.Allocate(_indexCount) : 0;
+
+		bool verticesFull = firstVertex == RangeAllocator::NO_SPACE;
+		bool indicesFull = firstIndex == RangeAllocator::NO_SPACE;
+		if (verticesFull || indicesFull)
+		{
+			// Only the buffer which ran out grows. That leaves its new space in one free range at the end, so this can't fail.
+			Reserve(verticesFull ? _vertexCount : 0, indicesFull ? _indexCount : 0);
+			if (verticesFull) firstVertex = m_vertices.Allocate(_vertexCount);
+			if (indicesFull) firstIndex = m_indices.Allocate(_indexCount);
+		}
+
+		// Upload through the copy target, as binding the element buffer would change whichever vertex array is bound
+		if (_vertexCount)
+		{
+			glBindBuffer(GL_COPY_WRITE_BUFFER, m_vertexBufferID);
+			glBufferSubData(GL_COPY_WRITE_BUFFER, firstVertex * m_layout.stride, _vertexCount * m_layout.stride, _vertices);
+		}
+		if (_indexCount)
+		{
+			glBindBuffer(GL_COPY_WRITE_BUFFER, m_indexBufferID);
+			glBufferSubData(GL_COPY_WRITE_BUFFER, firstIndex * GetIndexSize(), _indexCount * GetIndexSize(), _indices);
+		}
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+		std::shared_ptr<GeometryAllocation> allocation = std::make_shared<GeometryAllocation>();
+		allocation->m_arena = shared_from_this();
+		allocation->m_firstVertex = firstVertex;
+		allocation->m_vertexCount = _vertexCount;
+		allocation->m_firstIndex = firstIndex;
+		allocation->m_indexCount = _indexCount;
+
+		m_allocations.push_back(allocation.get());
+		return allocation;
+	}
+
+	void GeometryArena::Free(GeometryAllocation* _allocation)
+	{
+		m_vertices.Free(_allocation->m_firstVertex, _allocation->m_vertexCount);
+		m_indices.Free(_allocation->m_firstIndex, _allocation->m_indexCount);
+
+		auto it = std::find(m_allocations.begin(), m_allocations.end(), _allocation);
+		if (it != m_allocations.end())
+		{
+			*it = m_allocations.back();
+			m_allocations.pop_back();
+		}
+	}
+
+	void GeometryArena::Compact()
+	{
+		// Pack in the current order, so that meshes loaded together stay together
+		std::vector<GeometryAllocation*> byVertex = m_allocations;
+		std::sort(byVertex.begin(), byVertex.end(), [](const GeometryAllocation* _a, const GeometryAllocation* _b) { return _a->m_firstVertex < _b->m_firstVertex; });
+
+		std::vector<BufferMove> vertexMoves;
+		size_t vertexCount = 0;
+		for (GeometryAllocation* allocation : byVertex)
+		{
+			vertexMoves.push_back({ allocation->m_firstVertex * m_layout.stride, vertexCount * m_layout.stride, allocation->m_vertexCount * m_layout.stride });
+			allocation->m_firstVertex = vertexCount;
+			vertexCount += allocation->m_vertexCount;
+		}
+
+		std::vector<GeometryAllocation*> byIndex = m_allocations;
+		std::sort(byIndex.begin(), byIndex.end(), [](const GeometryAllocation* _a, const GeometryAllocation* _b) { return _a->m_firstIndex < _b->m_firstIndex; });
+
+		std::vector<BufferMove> indexMoves;
+		size_t indexCount = 0;
+		for (GeometryAllocation* allocation : byIndex)
+		{
+			if (allocation->m_indexCount == 0) continue;
+
+			indexMoves.push_back({ allocation->m_firstIndex * GetIndexSize(), indexCount * GetIndexSize(), allocation->m_indexCount * GetIndexSize() });
+			allocation->m_firstIndex = indexCount;
+			indexCount += allocation->m_indexCount;
+		}
+
+		// Keep the minimum size, so that a nearly empty arena doesn't grow again on the next load
+		size_t vertexCapacity = std::max(vertexCount, std::min(m_vertices.GetCapacity(), MIN_ARENA_VERTICES));
+		size_t indexCapacity = std::max(indexCount, std::min(m_indices.GetCapacity(), MIN_ARENA_INDICES));
+
+		m_vertexBufferID = Reallocate(m_vertexBufferID, vertexCapacity * m_layout.stride, vertexMoves);
+		m_indexBufferID = Reallocate(m_indexBufferID, indexCapacity * GetIndexSize(), indexMoves);
+
+		m_vertices.Reset(vertexCapacity, vertexCount);
+		m_indices.Reset(indexCapacity, indexCount);
+
+		BindLayout();
+	}
+
+	float GeometryArena::GetFragmentation() const
+	{
+		auto fragmentation = [](const RangeAllocator& _allocator)
+		{
+			return _allocator.GetFreeSize() ? 1.0f - (float)_allocator.GetLargestFreeRange() / _allocator.GetFreeSize() : 0.0f;
+		};
+
+		return std::max(fragmentation(m_vertices), fragmentation(m_indices));
+	}
+
+	size_t GeometryArena::GetUsedBytes() const
+	{
+		return (m_vertices.GetCapacity() - m_vertices.GetFreeSize()) * m_layout.stride + (m_indices.GetCapacity() - m_indices.GetFreeSize()) * GetIndexSize();
+	}
+
+	size_t GeometryArena::GetCapacityBytes() const
+	{
+		return m_vertices.GetCapacity() * m_layout.stride + m_indices.GetCapacity() * GetIndexSize();
+	}
+
+	GLuint GeometryArena::Reallocate(GLuint _buffer, size_t _bytes, const std::vector<BufferMove>& _moves)
+	{
+		GLuint buffer;
+		glGenBuffers(1, &buffer);
+		if (!buffer)
+		{
+			throw std::exception();
+		}
+
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, _bytes, nullptr, GL_STATIC_DRAW);
+
+		// Copied on the GPU, so the old contents never come back to the CPU
+		if (_buffer)
+		{
+			glBindBuffer(GL_COPY_READ_BUFFER, _buffer);
+			for (const BufferMove& move : _moves)
+			{
+				if (move.bytes) glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, move.from, move.to, move.bytes);
+			}
+			glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+			glDeleteBuffers(1, &_buffer);
+		}
+
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		return buffer;
+	}
+
+	void GeometryArena::Reserve(size_t _vertexCount, size_t _indexCount)
+	{
+		// Enough for the request even if none of the existing free space can be used. A count of 0 leaves that buffer as it is.
+		if (_vertexCount)
+		{
+			size_t vertexCapacity = GrowCapacity(m_vertices.GetCapacity(), m_vertices.GetCapacity() + _vertexCount, MIN_ARENA_VERTICES);
+			m_vertexBufferID = Reallocate(m_vertexBufferID, vertexCapacity * m_layout.stride, { { 0, 0, m_vertices.GetCapacity() * m_layout.stride } });
+			m_vertices.Grow(vertexCapacity);
+		}
+
+		if (_indexCount)
+		{
+			size_t indexCapacity = GrowCapacity(m_indices.GetCapacity(), m_indices.GetCapacity() + _indexCount, MIN_ARENA_INDICES);
+			m_indexBufferID = Reallocate(m_indexBufferID, indexCapacity * GetIndexSize(), { { 0, 0, m_indices.GetCapacity() * GetIndexSize() } });
+			m_indices.Grow(indexCapacity);
+		}
+
+		BindLayout();
+	}
+
+	void GeometryArena::BindLayout()
+	{
+		StateCache::GetShared().BindVertexArray(m_vertexArrayID);
+
+		// Nothing to point at until the first vertices arrive, which may be after the first indices
+		glBindBuffer(GL_ARRAY_BUFFER, m_vertexBufferID);
+		if (m_vertexBufferID)
+		{
+			for (const VertexAttribute& attribute : m_layout.attributes)
+			{
+				glVertexAttribPointer(attribute.location, attribute.components, attribute.type, attribute.normalised, m_layout.stride, (void*)(size_t)attribute.offset);
+				glEnableVertexAttribArray(attribute.location);
+			}
+		}
+
+		// Instanced draws of any mesh in the arena read their instances from the same buffer
+		BindInstanceAttributes();
+
+		// The element buffer binding is part of the vertex array's state
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBufferID);
+
+		StateCache::GetShared().BindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+}
@@ -0,0 +1,212 @@
+#ifndef EPBR_GEOMETRY_ARENA
+#define EPBR_GEOMETRY_ARENA
+
+#include "VertexFormat.h"
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <GL/glew.h>
+
+namespace ePBR
+{
+	/// @brief Hands out ranges of a linear space, in whatever unit the caller counts in.
+	/// @details Free ranges are kept in a list sorted by size, so allocation takes the best fit in logarithmic time. Freed ranges merge with free neighbours.
+	class RangeAllocator
+	{
+	public:
+		/// @brief Returned by Allocate() when no free range is large enough.
+		static const size_t NO_SPACE = (size_t)-1;
+
+		/// @param _capacity The size of the space, all of it free.
+		RangeAllocator(size_t _capacity = 0);
+
+		/// @brief Take the smallest free range which fits.
+		/// @param _size The size to allocate. Must not be 0.
+		/// @return The offset of the range, or NO_SPACE.
+		size_t Allocate(size_t _size);
+
+		/// @brief Return a range to the free list.
+		/// @param _offset The offset Allocate() returned.
+		/// @param _size The size it was allocated with.
+		void Free(size_t _offset, size_t _size);
+
+		/// @brief Extend the space. The new end is free.
+		/// @param _capacity The new size of the space. Must be at least the current size.
+		void Grow(size_t _capacity);
+
+		/// @brief Forget every allocation, then treat a prefix of the space as allocated and the rest as free.
+		/// @param _capacity The new size of the space.
+		/// @param _used The size of the allocated prefix.
+		void Reset(size_t _capacity, size_t _used);
+
+		/// @brief Get the size of the space.
+		/// @return The capacity.
+		size_t GetCapacity() const { return m_capacity; }
+
+		/// @brief Get the total size of every free range.
+		/// @return The free size.
+		size_t GetFreeSize() const { return m_freeSize; }
+
+		/// @brief Get the size of the largest free range.
+		/// @return The size, or 0 if the space is full.
+		size_t GetLargestFreeRange() const { return m_freeBySize.empty() ? 0 : m_freeBySize.rbegin()->first; }
+
+	private:
+		void AddFreeRange(size_t _offset, size_t _size);
+		void RemoveFreeRange(std::map<size_t, size_t>::iterator _range);
+
+		size_t m_capacity;
+		size_t m_freeSize;
+		std::map<size_t, size_t> m_freeByOffset; // Offset to size, for merging neighbours
+		std::multimap<size_t, size_t> m_freeBySize; // Size to offset, for best fit
+	};
+
+	class GeometryArena;
+
+	/// @brief One mesh's vertices and indices within a GeometryArena. The space is returned to the arena when this is destroyed.
+	/// @details Offsets change when the arena is compacted, so read them when drawing rather than keeping them.
+	class GeometryAllocation
+	{
+	public:
+		~GeometryAllocation();
+
+		/// @brief Get the arena holding this geometry.
+		/// @return The arena.
+		GeometryArena& GetArena() const { return *m_arena; }
+
+		/// @brief Get the vertex this geometry's indices count from, for glDrawElementsBaseVertex.
+		/// @return The base vertex.
+		GLint GetBaseVertex() const { return (GLint)m_firstVertex; }
+
+		/// @brief Get the number of vertices.
+		/// @return The vertex count.
+		unsigned int GetVertexCount() const { return (unsigned int)m_vertexCount; }
+
+		/// @brief Get the position of the first index within the arena's index buffer, in indices.
+		/// @return The first index.
+		unsigned int GetFirstIndex() const { return (unsigned int)m_firstIndex; }
+
+		/// @brief Get the number of indices. 0 if the geometry is not indexed.
+		/// @return The index count.
+		unsigned int GetIndexCount() const { return (unsigned int)m_indexCount; }
+
+	private:
+		friend class GeometryArena;
+
+		std::shared_ptr<GeometryArena> m_arena;
+		size_t m_firstVertex;
+		size_t m_vertexCount;
+		size_t m_firstIndex;
+		size_t m_indexCount;
+	};
+
+	/// @brief Large vertex and index buffers shared by every mesh of one vertex format, with one vertex array object bound to them.
+	/// @details Meshes are sub-allocated with RangeAllocator, and drawn with base vertex and first index offsets so that no vertex array needs switching between them.
+	/// The buffers double in size when full, copying their contents on the GPU. Compact() closes the gaps freed meshes leave behind.
+	class GeometryArena : public std::enable_shared_from_this<GeometryArena>
+	{
+	public:
+		/// @brief Get the arena shared by every mesh with a vertex format and index type, creating it if there is none.
+		/// @details The arena lives as long as any allocation from it.
+		/// @param _layout The vertex format.
+		/// @param _indexType GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+		/// @return The arena.
+		static std::shared_ptr<GeometryArena> GetShared(const VertexLayout& _layout, GLenum _indexType);
+
+		/// @brief Compact every shared arena whose free space is more fragmented than a threshold.
+		/// @param _maxFragmentation The fragmentation to allow, from 0 to 1. See GetFragmentation().
+		static void CompactShared(float _maxFragmentation);
+
+		/// @param _layout The vertex format of every mesh in the arena.
+		/// @param _indexType GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+		GeometryArena(const VertexLayout& _layout, GLenum _indexType);
+		~GeometryArena();
+
+		/// @brief Copy a mesh's vertices and indices into the arena, growing it if there is no room.
+		/// @param _vertices Vertices in the arena's format.
+		/// @param _vertexCount The number of vertices.
+		/// @param _indices Indices of the arena's type, relative to the first vertex. May be nullptr if _indexCount is 0.
+		/// @param _indexCount The number of indices.
+		/// @return The allocation, which frees the space when destroyed.
+		std::shared_ptr<GeometryAllocation> Allocate(const void* _vertices, size_t _vertexCount, const void* _indices, size_t _indexCount);
+
+		/// @brief Move every allocation down to close the gaps between them, into buffers no larger than they need.
+		void Compact();
+
+		/// @brief Get how scattered the free space is. 0 when it is all in one range, approaching 1 as it splits into many small ones.
+		/// @return The fragmentation of the vertex or index space, whichever is worse.
+		float GetFragmentation() const;
+
+		/// @brief Get the bytes of vertex and index buffer in use.
+		/// @return The bytes.
+		size_t GetUsedBytes() const;
+
+		/// @brief Get the bytes of vertex and index buffer allocated on the GPU.
+		/// @return The bytes.
+		size_t GetCapacityBytes() const;
+
+		/// @brief Get the vertex array object every mesh of this arena draws with. It is always ready to bind.
+		/// @return The ID.
+		GLuint GetVertexArrayID() const { return m_vertexArrayID; }
+
+		/// @brief Get the buffer holding every vertex.
+		/// @return The ID.
+		GLuint GetVertexBufferID() const { return m_vertexBufferID; }
+
+		/// @brief Get the buffer holding every index.
+		/// @return The ID.
+		GLuint GetIndexBufferID() const { return m_indexBufferID; }
+
+		/// @brief Get the vertex format of this arena.
+		/// @return The layout.
+		const VertexLayout& GetLayout() const { return m_layout; }
+
+		/// @brief Get the type of this arena's indices.
+		/// @return GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+		GLenum GetIndexType() const { return m_indexType; }
+
+		/// @brief Get the size of one index.
+		/// @return The size in bytes.
+		size_t GetIndexSize() const { return m_indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint); }
+
+	private:
+		friend class GeometryAllocation;
+
+		void Free(GeometryAllocation* _allocation);
+
+		// A range of bytes to carry over from an old buffer to a new one
+		struct BufferMove
+		{
+			size_t from;
+			size_t to;
+			size_t bytes;
+		};
+
+		// Replace a buffer with one of a new size, copying ranges of the old one across on the GPU. Returns the new buffer.
+		GLuint Reallocate(GLuint _buffer, size_t _bytes, const std::vector<BufferMove>& _moves);
+
+		// Grow the buffers so that the given numbers of vertices and indices will fit. Only buffers given a count other than 0 are touched.
+		void Reserve(size_t _vertexCount, size_t _indexCount);
+
+		// Point the vertex array at the current buffers
+		void BindLayout();
+
+		VertexLayout m_layout;
+		GLenum m_indexType;
+
+		GLuint m_vertexArrayID;
+		GLuint m_vertexBufferID;
+		GLuint m_indexBufferID;
+
+		// In vertices and indices
+		RangeAllocator m_vertices;
+		RangeAllocator m_indices;
+
+		std::vector<GeometryAllocation*> m_allocations;
+	};
+}
+
+#endif // EPBR_GEOMETRY_ARENA
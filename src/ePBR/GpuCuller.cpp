@@ -0,0 +1,349 @@
+#include "GpuCuller.h"
+#include "GeometryArena.h"
+#include "Material.h"
+#include "Mesh.h"
+#include "RenderTexture.h"
+#include "StateCache.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace ePBR
+{
+	namespace
+	{
+		// Matches local_size_x of the culling and compaction shaders, and both sizes of the Hi-Z shader
+		const GLuint CULL_GROUP_SIZE = 64;
+		const GLuint HIZ_GROUP_SIZE = 8;
+
+		// Marks instances whose mesh is drawn on the CPU instead
+		const GLuint NO_DRAW = 0xFFFFFFFFu;
+
+		// Room for two phases of 48 byte records, compacted commands and group counts, plus one of inputs, with slack for aligning each
+		const size_t CULL_BUFFER_BYTES = MAX_INDIRECT_DRAWS_PER_FRAME * (2 * 48 + 2 * sizeof(DrawElementsIndirectCommand) + 2 * sizeof(GLuint))
+			+ MAX_INSTANCES_PER_FRAME * (sizeof(ModelInstance) + sizeof(GLuint)) + 16 * 1024;
+
+		GeometryArena* GetArena(const Mesh* _mesh)
+		{
+			return _mesh->GetGeometry() ? &_mesh->GetGeometry()->GetArena() : nullptr;
+		}
+
+		GLuint GroupsFor(size_t _count, GLuint _groupSize)
+		{
+			return (GLuint)((_count + _groupSize - 1) / _groupSize);
+		}
+	}
+
+	GpuCuller::GpuCuller(const std::string& _cullPath, const std::string& _hiZPath, const std::string& _compactPath) :
+		m_buffer(CULL_BUFFER_BYTES),
+		m_storageAlignment(4),
+		m_hiZ(0),
+		m_hiZWidth(0),
+		m_hiZHeight(0),
+		m_hiZLevels(0),
+		m_history(0),
+		m_historySize(0)
+	{
+		static_assert(sizeof(DrawRecord) == 48, "DrawRecord must match the std430 layout of the culling shaders");
+
+		m_cullShader.reset(new ComputeShader(_cullPath));
+		m_cullPhaseOneShader.reset(new ComputeShader(_cullPath, { "PHASE_ONE" }));
+		m_cullPhaseTwoShader.reset(new ComputeShader(_cullPath, { "PHASE_TWO" }));
+		m_hiZCopyShader.reset(new ComputeShader(_hiZPath, { "COPY_DEPTH" }));
+		m_hiZReduceShader.reset(new ComputeShader(_hiZPath));
+
+		// Without count draws, commands which lost every instance are left in place and draw nothing
+		if (StateCache::HasExtension("GL_ARB_indirect_parameters"))
+		{
+			m_compactShader.reset(new ComputeShader(_compactPath));
+		}
+
+		GLint alignment = 0;
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		m_storageAlignment = std::max<size_t>(4, (size_t)alignment);
+
+		glGenBuffers(1, &m_history);
+	}
+
+	GpuCuller::~GpuCuller()
+	{
+		glDeleteBuffers(1, &m_history);
+		if (m_hiZ) glDeleteTextures(1, &m_hiZ);
+		StateCache::GetShared().Invalidate();
+	}
+
+	size_t GpuCuller::Submit(IndirectDrawList& _list, const glm::mat4& _viewMatrix, const glm::mat4& _projMatrix, const glm::vec3& _camPos, const RenderTexture* _target)
+	{
+		if (_list.m_draws.empty()) return 0;
+
+		// Read before sorting, while the draws are still in the order that placed their instances
+		bool forgetHistory = UpdateHistoryLayout(_list.m_draws);
+		_list.SortDraws();
+
+		const std::vector<IndirectDrawList::Draw>& draws = _list.m_draws;
+		size_t instanceCount = _list.m_instances.size();
+
+		// Every instance is drawn from the output region at the same slot it was read from, so a draw's base instance is fixed before culling
+		m_records.clear();
+		m_groups.clear();
+		m_instanceDraws.assign(instanceCount, NO_DRAW);
+		for (size_t first = 0; first < draws.size();)
+		{
+			GeometryArena* arena = GetArena(draws[first].mesh);
+			Material* material = draws[first].material;
+			size_t batch = draws[first].batch;
+
+			size_t end = first + 1;
+			while (end < draws.size() && GetArena(draws[end].mesh) == arena && draws[end].batch == batch) end++;
+
+			Group group = { arena, material, first, end - first, m_records.size(), 0, arena != nullptr };
+			for (size_t i = first; i < end && arena; i++)
+			{
+				const IndirectDrawList::Draw& draw = draws[i];
+
+				DrawRecord record;
+				if (!IndirectDrawList::MakeCommand(draw, (GLuint)draw.firstInstance, record.command)) continue;
+				record.command.instanceCount = 0;
+				record.firstInstance = (GLuint)draw.firstInstance;
+				record.group = (GLuint)m_groups.size();
+				record.groupFirstRecord = (GLuint)group.firstRecord;
+
+				// Instance matrices already hold the position decode, so bounds are moved back into stored positions
+				BoundingSphere bounds = TransformSphere(draw.mesh->GetBoundingSphere(), glm::inverse(draw.mesh->GetPositionDecode()));
+				record.bounds = glm::vec4(bounds.center, bounds.radius);
+
+				std::fill(m_instanceDraws.begin() + draw.firstInstance, m_instanceDraws.begin() + draw.firstInstance + draw.instanceCount, (GLuint)m_records.size());
+				m_records.push_back(record);
+			}
+			group.recordCount = m_records.size() - group.firstRecord;
+			m_groups.push_back(group);
+
+			first = end;
+		}
+
+		size_t inputOffset = m_buffer.Write(_list.m_instances.data(), instanceCount * sizeof(ModelInstance), m_storageAlignment);
+		size_t drawsOffset = m_buffer.Write(m_instanceDraws.data(), instanceCount * sizeof(GLuint), m_storageAlignment);
+		if (m_records.empty() || inputOffset == StreamBuffer::NO_SPACE || drawsOffset == StreamBuffer::NO_SPACE)
+		{
+			return _list.Submit(_viewMatrix, _projMatrix, _camPos);
+		}
+
+		ReserveHistory(instanceCount, forgetHistory);
+
+		size_t calls = 0;
+		if (_target)
+		{
+			if (!RunPhase(_list, *m_cullPhaseOneShader, false, inputOffset, drawsOffset, _viewMatrix, _projMatrix, _camPos, calls))
+			{
+				return calls + _list.Submit(_viewMatrix, _projMatrix, _camPos);
+			}
+
+			BuildHiZ(*_target);
+
+			// Whatever phase one drew is drawn again, in full, if the second phase has no room
+			if (!RunPhase(_list, *m_cullPhaseTwoShader, true, inputOffset, drawsOffset, _viewMatrix, _projMatrix, _camPos, calls))
+			{
+				return calls + _list.Submit(_viewMatrix, _projMatrix, _camPos);
+			}
+		}
+		else if (!RunPhase(_list, *m_cullShader, false, inputOffset, drawsOffset, _viewMatrix, _projMatrix, _camPos, calls))
+		{
+			return calls + _list.Submit(_viewMatrix, _projMatrix, _camPos);
+		}
+
+		_list.Clear();
+		return calls;
+	}
+
+	bool GpuCuller::RunPhase(IndirectDrawList& _list, const ComputeShader& _shader, bool _phaseTwo, size_t _inputOffset, size_t _drawsOffset,
+		const glm::mat4& _viewMatrix, const glm::mat4& _projMatrix, const glm::vec3& _camPos, size_t& _calls)
+	{
+		size_t instanceCount = _list.m_instances.size();
+		size_t recordCount = m_records.size();
+
+		// Offsets into the instance buffer must be whole instances to be base instances, and aligned to bind as storage
+		size_t outputAlignment = std::lcm(sizeof(ModelInstance), m_storageAlignment);
+		size_t outputOffset = GetInstanceBuffer().Allocate(instanceCount * sizeof(ModelInstance), outputAlignment);
+		if (outputOffset == StreamBuffer::NO_SPACE) return false;
+
+		GLuint outputBase = (GLuint)(outputOffset / sizeof(ModelInstance));
+		for (DrawRecord& record : m_records) record.command.baseInstance = outputBase + record.firstInstance;
+
+		size_t recordOffset = m_buffer.Write(m_records.data(), recordCount * sizeof(DrawRecord), m_storageAlignment);
+		if (recordOffset == StreamBuffer::NO_SPACE) return false;
+
+		size_t commandOffset = 0;
+		size_t countOffset = 0;
+		if (m_compactShader)
+		{
+			m_groupCounts.assign(m_groups.size(), 0);
+			countOffset = m_buffer.Write(m_groupCounts.data(), m_groupCounts.size() * sizeof(GLuint), m_storageAlignment);
+			commandOffset = m_buffer.Allocate(recordCount * sizeof(DrawElementsIndirectCommand), m_storageAlignment);
+			if (countOffset == StreamBuffer::NO_SPACE || commandOffset == StreamBuffer::NO_SPACE) return false;
+		}
+
+		// Cull
+		StateCache& cache = StateCache::GetShared();
+		GLuint program = _shader.GetID();
+		cache.UseProgram(program);
+		glUniform1ui(glGetUniformLocation(program, "instanceCount"), (GLuint)instanceCount);
+
+		glm::vec4 planes[6];
+		ExtractFrustumPlanes(_projMatrix * _viewMatrix, planes);
+		glUniform4fv(glGetUniformLocation(program, "frustumPlanes"), 6, &planes[0].x);
+
+		if (_phaseTwo)
+		{
+			glm::mat4 viewProjection = _projMatrix * _viewMatrix;
+			glUniformMatrix4fv(glGetUniformLocation(program, "viewProjMat"), 1, GL_FALSE, &viewProjection[0][0]);
+			glUniform1i(glGetUniformLocation(program, "hiZLevels"), m_hiZLevels);
+			glUniform1i(glGetUniformLocation(program, "hiZ"), 0);
+			cache.BindTexture(0, GL_TEXTURE_2D, m_hiZ);
+		}
+
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, m_buffer.GetID(), recordOffset, recordCount * sizeof(DrawRecord));
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 1, m_buffer.GetID(), _inputOffset, instanceCount * sizeof(ModelInstance));
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 2, m_buffer.GetID(), _drawsOffset, instanceCount * sizeof(GLuint));
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 3, GetInstanceBuffer().GetID(), outputOffset, instanceCount * sizeof(ModelInstance));
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 4, m_history, 0, instanceCount * sizeof(GLuint));
+		glDispatchCompute(GroupsFor(instanceCount, CULL_GROUP_SIZE), 1, 1);
+
+		// Pack the commands which kept any instances
+		if (m_compactShader)
+		{
+			glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+			program = m_compactShader->GetID();
+			cache.UseProgram(program);
+			glUniform1ui(glGetUniformLocation(program, "recordCount"), (GLuint)recordCount);
+
+			glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 1, m_buffer.GetID(), commandOffset, recordCount * sizeof(DrawElementsIndirectCommand));
+			glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 2, m_buffer.GetID(), countOffset, m_groupCounts.size() * sizeof(GLuint));
+			glDispatchCompute(GroupsFor(recordCount, CULL_GROUP_SIZE), 1, 1);
+		}
+
+		glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+
+		// Draw
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_buffer.GetID());
+		if (m_compactShader) glBindBuffer(GL_PARAMETER_BUFFER_ARB, m_buffer.GetID());
+
+		const std::vector<IndirectDrawList::Draw>& draws = _list.m_draws;
+		for (size_t g = 0; g < m_groups.size(); g++)
+		{
+			Group& group = m_groups[g];
+
+			// Draws the GPU can't cull go out whole, once
+			if (!_phaseTwo)
+			{
+				if (group.instanced && group.recordCount > 0) group.instanced = group.material->ApplyInstanced(_viewMatrix, _projMatrix, _camPos);
+
+				for (size_t d = group.firstDraw; d < group.firstDraw + group.drawCount; d++)
+				{
+					if (!group.instanced || m_instanceDraws[draws[d].firstInstance] == NO_DRAW) _list.DrawSeparately(&draws[d], 1, _viewMatrix, _projMatrix, _camPos);
+				}
+			}
+			else if (group.instanced && group.recordCount > 0)
+			{
+				group.material->ApplyInstanced(_viewMatrix, _projMatrix, _camPos);
+			}
+
+			if (!group.instanced || group.recordCount == 0) continue;
+
+			// Left bound, as with Mesh::Draw(). The shaders use no buffers at these bindings.
+			StateCache::GetShared().BindVertexArray(group.arena->GetVertexArrayID());
+			if (m_compactShader)
+			{
+				glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, group.arena->GetIndexType(), (const void*)(commandOffset + group.firstRecord * sizeof(DrawElementsIndirectCommand)),
+					(GLintptr)(countOffset + g * sizeof(GLuint)), (GLsizei)group.recordCount, 0);
+			}
+			else
+			{
+				glMultiDrawElementsIndirect(GL_TRIANGLES, group.arena->GetIndexType(), (const void*)(recordOffset + group.firstRecord * sizeof(DrawRecord)), (GLsizei)group.recordCount, sizeof(DrawRecord));
+			}
+			_calls++;
+		}
+
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		if (m_compactShader) glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+
+		return true;
+	}
+
+	void GpuCuller::BuildHiZ(const RenderTexture& _target)
+	{
+		int width = _target.GetWidth();
+		int height = _target.GetHeight();
+
+		// Immutable storage can't be resized, so a new size gets a new texture
+		if (!m_hiZ || width != m_hiZWidth || height != m_hiZHeight)
+		{
+			if (m_hiZ) glDeleteTextures(1, &m_hiZ);
+			StateCache::GetShared().Invalidate();
+
+			m_hiZWidth = width;
+			m_hiZHeight = height;
+			m_hiZLevels = 1;
+			while ((std::max(width, height) >> m_hiZLevels) > 0) m_hiZLevels++;
+
+			glGenTextures(1, &m_hiZ);
+			StateCache::GetShared().BindTexture(0, GL_TEXTURE_2D, m_hiZ);
+			glTexStorage2D(GL_TEXTURE_2D, m_hiZLevels, GL_R32F, width, height);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		}
+
+		// Finish writing depth before reading it
+		glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT);
+
+		StateCache& cache = StateCache::GetShared();
+		GLuint program = m_hiZCopyShader->GetID();
+		cache.UseProgram(program);
+		glUniform1i(glGetUniformLocation(program, "depth"), 0);
+		cache.BindTexture(0, GL_TEXTURE_2D, _target.GetDepthTextureID());
+		glBindImageTexture(0, m_hiZ, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		glDispatchCompute(GroupsFor(width, HIZ_GROUP_SIZE), GroupsFor(height, HIZ_GROUP_SIZE), 1);
+
+		cache.UseProgram(m_hiZReduceShader->GetID());
+		for (int level = 1; level < m_hiZLevels; level++)
+		{
+			glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+			glBindImageTexture(1, m_hiZ, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+			glBindImageTexture(0, m_hiZ, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+			glDispatchCompute(GroupsFor(std::max(1, width >> level), HIZ_GROUP_SIZE), GroupsFor(std::max(1, height >> level), HIZ_GROUP_SIZE), 1);
+		}
+
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	}
+
+	void GpuCuller::ReserveHistory(size_t _instanceCount, bool _forget)
+	{
+		if (_instanceCount <= m_historySize && !_forget) return;
+
+		// Everything starts hidden, so phase one draws nothing new and phase two tests it all
+		m_historySize = std::max(_instanceCount, m_historySize);
+		std::vector<GLuint> zeros(m_historySize, 0);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_history);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, zeros.size() * sizeof(GLuint), zeros.data(), GL_DYNAMIC_COPY);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+
+	bool GpuCuller::UpdateHistoryLayout(const std::vector<IndirectDrawList::Draw>& _draws)
+	{
+		bool changed = _draws.size() != m_historyLayout.size();
+		m_historyLayout.resize(_draws.size());
+		for (size_t i = 0; i < _draws.size(); i++)
+		{
+			HistoryDraw& draw = m_historyLayout[i];
+			if (draw.mesh != _draws[i].mesh || draw.material != _draws[i].material || draw.instanceCount != _draws[i].instanceCount)
+			{
+				draw = { _draws[i].mesh, _draws[i].material, _draws[i].instanceCount };
+				changed = true;
+			}
+		}
+		return changed;
+	}
+}
@@ -0,0 +1,128 @@
+#ifndef EPBR_GPU_CULLER
+#define EPBR_GPU_CULLER
+
+#include "IndirectDraw.h"
+#include "Shader.h"
+#include "StreamBuffer.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+namespace ePBR
+{
+	class GeometryArena;
+	class Material;
+	class Mesh;
+	class RenderTexture;
+
+	/// @brief Culls and submits an IndirectDrawList on the GPU, so no per-instance work is left on the CPU.
+	/// @details A compute shader tests every instance's bounding sphere and appends the survivors to their draw's command, which the multi-draw calls then read.
+	/// Given a RenderTexture, culling runs in two phases. The first draws whatever was visible last frame. A Hi-Z pyramid is then built from the depth buffer that leaves,
+	/// and the second phase tests every instance against it, drawing those which have just come into view and remembering what is visible for the next frame.
+	/// Without one, instances are tested against the frustum alone. Where GL_ARB_indirect_parameters is available, empty commands are compacted away and the draws read their count from the GPU.
+	/// Draws which IndirectDrawList::Submit() would draw one at a time are drawn the same way here, without culling.
+	class GpuCuller
+	{
+	public:
+		/// @brief Load the culling shaders.
+		/// @param _cullPath The path to the culling compute shader.
+		/// @param _hiZPath The path to the Hi-Z pyramid compute shader.
+		/// @param _compactPath The path to the draw compaction compute shader.
+		GpuCuller(const std::string& _cullPath, const std::string& _hiZPath, const std::string& _compactPath);
+		~GpuCuller();
+
+		GpuCuller(const GpuCuller&) = delete;
+		GpuCuller& operator=(const GpuCuller&) = delete;
+
+		/// @brief Cull and draw everything in a list, then empty it. Falls back to IndirectDrawList::Submit() when the frame's buffers are full.
+		/// @param _list The list.
+		/// @param _viewMatrix The view matrix.
+		/// @param _projMatrix The projection matrix.
+		/// @param _camPos The position of the camera.
+		/// @param _target The bound render target, whose depth texture feeds the Hi-Z pyramid, or nullptr to test the frustum alone.
+		/// @return The number of multi-draw calls made.
+		size_t Submit(IndirectDrawList& _list, const glm::mat4& _viewMatrix, const glm::mat4& _projMatrix, const glm::vec3& _camPos, const RenderTexture* _target);
+
+		/// @brief Get whether empty commands are compacted away and counted on the GPU, through GL_ARB_indirect_parameters.
+		/// @return Whether count draws are used.
+		bool IsCountDrawSupported() const { return m_compactShader != nullptr; }
+
+	private:
+		// One draw's indirect command followed by what the culling shader needs to fill it. Matches DrawRecord in the shaders, laid out std430.
+		struct DrawRecord
+		{
+			DrawElementsIndirectCommand command;
+			GLuint firstInstance;
+			GLuint group;
+			GLuint groupFirstRecord;
+			glm::vec4 bounds;
+		};
+
+		// What places a draw's instances in the list, so a list laid out the same way puts each instance in the same slot as before
+		struct HistoryDraw
+		{
+			Mesh* mesh;
+			Material* material;
+			size_t instanceCount;
+		};
+
+		// Draws sharing an arena and material, and the range of their records
+		struct Group
+		{
+			GeometryArena* arena;
+			Material* material;
+			size_t firstDraw;
+			size_t drawCount;
+			size_t firstRecord;
+			size_t recordCount;
+			bool instanced;
+		};
+
+		// Dispatch one culling shader over every instance and draw the survivors, along with the draws it can't cull unless this is the second phase. False when the frame's buffers are full.
+		bool RunPhase(IndirectDrawList& _list, const ComputeShader& _shader, bool _phaseTwo, size_t _inputOffset, size_t _drawsOffset,
+			const glm::mat4& _viewMatrix, const glm::mat4& _projMatrix, const glm::vec3& _camPos, size_t& _calls);
+
+		// Fill the pyramid from a render target's depth texture, resizing it to match
+		void BuildHiZ(const RenderTexture& _target);
+
+		// Grow the visibility history to cover a number of instances, or forget all of it. New and forgotten instances start hidden.
+		void ReserveHistory(size_t _instanceCount, bool _forget);
+
+		// Whether a list was built from different draws, in a different order, than the last one submitted, so its instance slots name other instances
+		bool UpdateHistoryLayout(const std::vector<IndirectDrawList::Draw>& _draws);
+
+		std::unique_ptr<ComputeShader> m_cullShader;
+		std::unique_ptr<ComputeShader> m_cullPhaseOneShader;
+		std::unique_ptr<ComputeShader> m_cullPhaseTwoShader;
+		std::unique_ptr<ComputeShader> m_hiZCopyShader;
+		std::unique_ptr<ComputeShader> m_hiZReduceShader;
+		std::unique_ptr<ComputeShader> m_compactShader;
+
+		// Records, inputs and compacted commands for each frame
+		StreamBuffer m_buffer;
+		size_t m_storageAlignment;
+
+		GLuint m_hiZ;
+		int m_hiZWidth;
+		int m_hiZHeight;
+		int m_hiZLevels;
+
+		// Whether each instance was visible last frame, by its position in the list, and the draws in the order they were added which placed them there
+		GLuint m_history;
+		size_t m_historySize;
+		std::vector<HistoryDraw> m_historyLayout;
+
+		// Kept between submits to save reallocating them
+		std::vector<DrawRecord> m_records;
+		std::vector<Group> m_groups;
+		std::vector<GLuint> m_instanceDraws;
+		std::vector<GLuint> m_groupCounts;
+	};
+}
+
+#endif // EPBR_GPU_CULLER
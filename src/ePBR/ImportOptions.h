@@ -0,0 +1,29 @@
+#ifndef EPBR_IMPORT_OPTIONS
+#define EPBR_IMPORT_OPTIONS
+
+namespace ePBR
+{
+	/// @brief Settings for turning a mesh file into GPU geometry.
+	struct ImportOptions
+	{
+		/// @brief Reorder triangles and vertices for the post-transform cache, overdraw and vertex fetch, and print what was gained.
+		bool optimiseMesh = false;
+
+		/// @brief Store positions, normals, tangents and texture coordinates in 16 bit, octahedral and half float formats, and print the error against floats.
+		bool quantiseVertices = false;
+
+		/// @brief Split meshes into meshlets of up to 64 vertices and 124 triangles, so that off-screen and back-facing clusters are skipped when drawing.
+		bool buildMeshlets = false;
+
+		/// @brief Simplify meshes into up to four coarser levels of detail, each with about half the triangles, for Model to switch between by screen size.
+		bool generateLODs = false;
+
+		/// @brief Keep each mesh's coarsest level of detail, or its full surface, on the CPU so that Renderer can hide meshes behind it without asking the GPU.
+		bool buildOccluders = false;
+
+		/// @brief Read the imported geometry from a .epbrmesh cache next to the source file when one matches, and write one when not.
+		bool useCache = true;
+	};
+}
+
+#endif // EPBR_IMPORT_OPTIONS
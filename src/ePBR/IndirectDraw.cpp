@@ -0,0 +1,162 @@
+#include "IndirectDraw.h"
+#include "GeometryArena.h"
+#include "Material.h"
+#include "Mesh.h"
+#include "StateCache.h"
+#include "StreamBuffer.h"
+
+#include <algorithm>
+
+namespace ePBR
+{
+	namespace
+	{
+		StreamBuffer& GetIndirectCommandBuffer()
+		{
+			// Created on first use, as it needs a GL context, and left for the context to clean up
+			static StreamBuffer* buffer = new StreamBuffer(MAX_INDIRECT_DRAWS_PER_FRAME * sizeof(DrawElementsIndirectCommand));
+			return *buffer;
+		}
+
+		// Draws which can share a multi-draw call: same vertex array and index type, and same material batch. Null for meshes with their own vertex array.
+		GeometryArena* GetArena(const Mesh* _mesh)
+		{
+			return _mesh->GetGeometry() ? &_mesh->GetGeometry()->GetArena() : nullptr;
+		}
+	}
+
+	void IndirectDrawList::Add(Mesh* _mesh, Material* _material, const ModelInstance* _instances, size_t _count, size_t _lod)
+	{
+		if (_count == 0) return;
+
+		m_draws.push_back({ _mesh, _material, _material->GetBatchID(), m_instances.size(), _count, _lod });
+		m_instances.insert(m_instances.end(), _instances, _instances + _count);
+
+		// Draws of different materials can share a multi-draw, so each instance says which it belongs to
+		GLuint materialIndex = _material->GetMaterialIndex();
+		for (size_t i = m_instances.size() - _count; i < m_instances.size(); i++) m_instances[i].materialIndex = materialIndex;
+	}
+
+	size_t IndirectDrawList::Submit(glm::mat4 _viewMatrix, glm::mat4 _projMatrix, glm::vec3 _camPos)
+	{
+		if (m_draws.empty()) return 0;
+
+		SortDraws();
+
+		// Every instance goes up at once. Aligned to whole instances, so the offset is a base instance.
+		size_t instanceOffset = GetInstanceBuffer().Write(m_instances.data(), m_instances.size() * sizeof(ModelInstance), sizeof(ModelInstance));
+		GLuint baseInstance = (GLuint)(instanceOffset / sizeof(ModelInstance));
+
+		size_t calls = 0;
+		for (size_t first = 0; first < m_draws.size();)
+		{
+			GeometryArena* arena = GetArena(m_draws[first].mesh);
+			Material* material = m_draws[first].material;
+			size_t batch = m_draws[first].batch;
+
+			size_t end = first + 1;
+			while (end < m_draws.size() && GetArena(m_draws[end].mesh) == arena && m_draws[end].batch == batch) end++;
+
+			if (!arena || instanceOffset == StreamBuffer::NO_SPACE || !material->ApplyInstanced(_viewMatrix, _projMatrix, _camPos))
+			{
+				DrawSeparately(&m_draws[first], end - first, _viewMatrix, _projMatrix, _camPos);
+				first = end;
+				continue;
+			}
+
+			m_commands.clear();
+			for (size_t i = first; i < end; i++)
+			{
+				const Draw& draw = m_draws[i];
+
+				DrawElementsIndirectCommand command;
+				if (!MakeCommand(draw, baseInstance + (GLuint)draw.firstInstance, command))
+				{
+					draw.mesh->DrawInstanced(draw.instanceCount, baseInstance + (GLuint)draw.firstInstance, draw.lod);
+					continue;
+				}
+
+				m_commands.push_back(command);
+			}
+
+			if (m_commands.empty())
+			{
+				first = end;
+				continue;
+			}
+
+			size_t commandOffset = GetIndirectCommandBuffer().Write(m_commands.data(), m_commands.size() * sizeof(DrawElementsIndirectCommand), sizeof(GLuint));
+			if (commandOffset == StreamBuffer::NO_SPACE)
+			{
+				DrawSeparately(&m_draws[first], end - first, _viewMatrix, _projMatrix, _camPos);
+				first = end;
+				continue;
+			}
+
+			// Left bound, as with Mesh::Draw()
+			StateCache::GetShared().BindVertexArray(arena->GetVertexArrayID());
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, GetIndirectCommandBuffer().GetID());
+			glMultiDrawElementsIndirect(GL_TRIANGLES, arena->GetIndexType(), (const void*)commandOffset, (GLsizei)m_commands.size(), 0);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+			calls++;
+
+			first = end;
+		}
+
+		Clear();
+		return calls;
+	}
+
+	void IndirectDrawList::Clear()
+	{
+		m_draws.clear();
+		m_instances.clear();
+	}
+
+	void IndirectDrawList::SortDraws()
+	{
+		std::sort(m_draws.begin(), m_draws.end(), [](const Draw& _a, const Draw& _b)
+		{
+			GeometryArena* arenaA = GetArena(_a.mesh);
+			GeometryArena* arenaB = GetArena(_b.mesh);
+			return arenaA != arenaB ? std::less<GeometryArena*>()(arenaA, arenaB) : _a.batch < _b.batch;
+		});
+	}
+
+	bool IndirectDrawList::MakeCommand(const Draw& _draw, GLuint _baseInstance, DrawElementsIndirectCommand& _command)
+	{
+		const GeometryAllocation& geometry = *_draw.mesh->GetGeometry();
+		if (geometry.GetIndexCount() == 0) return false;
+
+		_command.count = geometry.GetIndexCount();
+		_command.instanceCount = (GLuint)_draw.instanceCount;
+		_command.firstIndex = geometry.GetFirstIndex();
+		_command.baseVertex = geometry.GetBaseVertex();
+		_command.baseInstance = _baseInstance;
+
+		// The index buffer holds every level, so point at just the one asked for
+		const std::vector<MeshLOD>& lods = _draw.mesh->GetLODs();
+		if (!lods.empty())
+		{
+			const MeshLOD& lod = lods[std::min(_draw.lod, lods.size() - 1)];
+			_command.count = lod.indexCount;
+			_command.firstIndex += lod.indexOffset;
+		}
+
+		return true;
+	}
+
+	void IndirectDrawList::DrawSeparately(const Draw* _draws, size_t _count, glm::mat4 _viewMatrix, glm::mat4 _projMatrix, glm::vec3 _camPos)
+	{
+		for (size_t i = 0; i < _count; i++)
+		{
+			const Draw& draw = _draws[i];
+			for (size_t j = draw.firstInstance; j < draw.firstInstance + draw.instanceCount; j++)
+			{
+				glm::mat4 modelMatrix = m_instances[j].modelMatrix;
+				draw.material->Apply(modelMatrix, _viewMatrix, _projMatrix, _camPos);
+				draw.mesh->Draw(draw.lod);
+			}
+		}
+	}
+}
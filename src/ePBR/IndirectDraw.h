@@ -0,0 +1,89 @@
+#ifndef EPBR_INDIRECT_DRAW
+#define EPBR_INDIRECT_DRAW
+
+#include "Instancing.h"
+
+#include <cstddef>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+namespace ePBR
+{
+	class Mesh;
+	class Material;
+
+	/// @brief The most indirect draw commands which can be submitted in one frame, across every IndirectDrawList.
+	const size_t MAX_INDIRECT_DRAWS_PER_FRAME = 1 << 14;
+
+	/// @brief One draw as glMultiDrawElementsIndirect reads it from the indirect buffer.
+	struct DrawElementsIndirectCommand
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	/// @brief Gathers a frame's mesh draws, then submits them with one glMultiDrawElementsIndirect call per geometry arena and material batch.
+	/// @details Each draw's transform and material modifiers are ModelInstance values in the instance buffer, which the instanced shaders fetch through the base instance of their command.
+	/// Meshes with their own vertex array, meshes without indices and materials without an instanced variant are drawn one at a time instead.
+	class IndirectDrawList
+	{
+	public:
+		/// @brief Add copies of a mesh to the list.
+		/// @param _mesh The mesh. Must outlive the next Submit().
+		/// @param _material The material to draw it with. Must outlive the next Submit().
+		/// @param _instances The copies, with the mesh's position decode already applied to their model matrices.
+		/// @param _count The number of copies.
+		/// @param _lod The level of detail to draw every copy at.
+		void Add(Mesh* _mesh, Material* _material, const ModelInstance* _instances, size_t _count, size_t _lod);
+
+		/// @brief Draw everything in the list, then empty it.
+		/// @param _viewMatrix The view matrix.
+		/// @param _projMatrix The projection matrix.
+		/// @param _camPos The position of the camera.
+		/// @return The number of multi-draw calls made.
+		size_t Submit(glm::mat4 _viewMatrix, glm::mat4 _projMatrix, glm::vec3 _camPos);
+
+		/// @brief Empty the list without drawing it.
+		void Clear();
+
+		/// @brief Get the number of meshes in the list.
+		/// @return The number of draws.
+		size_t GetDrawCount() const { return m_draws.size(); }
+
+	private:
+		// Culls and submits lists on the GPU in place of Submit()
+		friend class GpuCuller;
+
+		struct Draw
+		{
+			Mesh* mesh;
+			Material* material;
+			size_t batch; // Material::GetBatchID()
+			size_t firstInstance;
+			size_t instanceCount;
+			size_t lod;
+		};
+
+		// Order the draws so that those which can share a multi-draw call are adjacent
+		void SortDraws();
+
+		// Fill in the command for a draw's level of detail. False for meshes without indices, which can't be in an elements command.
+		static bool MakeCommand(const Draw& _draw, GLuint _baseInstance, DrawElementsIndirectCommand& _command);
+
+		// Draw each instance of the draws with a separate call
+		void DrawSeparately(const Draw* _draws, size_t _count, glm::mat4 _viewMatrix, glm::mat4 _projMatrix, glm::vec3 _camPos);
+
+		std::vector<Draw> m_draws;
+		std::vector<ModelInstance> m_instances;
+
+		// Kept between submits to save reallocating it
+		std::vector<DrawElementsIndirectCommand> m_commands;
+	};
+}
+
+#endif // EPBR_INDIRECT_DRAW
@@ -0,0 +1,42 @@
+#include "Instancing.h"
+#include "StreamBuffer.h"
+
+#include <cstddef>
+
+namespace ePBR
+{
+	StreamBuffer& GetInstanceBuffer()
+	{
+		// Created on first use, as it needs a GL context, and left for the context to clean up
+		static StreamBuffer* buffer = new StreamBuffer(MAX_INSTANCES_PER_FRAME * sizeof(ModelInstance));
+		return *buffer;
+	}
+
+	void BindInstanceAttributes()
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, GetInstanceBuffer().GetID());
+
+		// A mat4 attribute is read as four vec4 columns
+		for (GLuint column = 0; column < 4; column++)
+		{
+			GLuint location = INSTANCE_ATTRIBUTE_LOCATION + column;
+			glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(ModelInstance), (void*)(offsetof(ModelInstance, modelMatrix) + column * sizeof(glm::vec4)));
+			glVertexAttribDivisor(location, 1);
+			glEnableVertexAttribArray(location);
+		}
+
+		glVertexAttribPointer(INSTANCE_ATTRIBUTE_LOCATION + 4, 3, GL_FLOAT, GL_FALSE, sizeof(ModelInstance), (void*)offsetof(ModelInstance, albedo));
+		glVertexAttribDivisor(INSTANCE_ATTRIBUTE_LOCATION + 4, 1);
+		glEnableVertexAttribArray(INSTANCE_ATTRIBUTE_LOCATION + 4);
+
+		glVertexAttribPointer(INSTANCE_ATTRIBUTE_LOCATION + 5, 2, GL_FLOAT, GL_FALSE, sizeof(ModelInstance), (void*)offsetof(ModelInstance, roughness));
+		glVertexAttribDivisor(INSTANCE_ATTRIBUTE_LOCATION + 5, 1);
+		glEnableVertexAttribArray(INSTANCE_ATTRIBUTE_LOCATION + 5);
+
+		glVertexAttribIPointer(INSTANCE_ATTRIBUTE_LOCATION + 6, 1, GL_UNSIGNED_INT, sizeof(ModelInstance), (void*)offsetof(ModelInstance, materialIndex));
+		glVertexAttribDivisor(INSTANCE_ATTRIBUTE_LOCATION + 6, 1);
+		glEnableVertexAttribArray(INSTANCE_ATTRIBUTE_LOCATION + 6);
+
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+}
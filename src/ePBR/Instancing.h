@@ -0,0 +1,39 @@
+#ifndef EPBR_INSTANCING
+#define EPBR_INSTANCING
+
+#include <cstddef>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+namespace ePBR
+{
+	class StreamBuffer;
+
+	/// @brief The first attribute location of the per-instance data. The model matrix takes this and the next three, then albedo, roughness/metalness and the material index follow.
+	const GLuint INSTANCE_ATTRIBUTE_LOCATION = 4;
+
+	/// @brief The most instances which can be drawn in one frame, across every instanced draw.
+	const size_t MAX_INSTANCES_PER_FRAME = 1 << 18;
+
+	/// @brief One copy of a model in an instanced draw, exactly as the instanced shaders read it.
+	/// @details The material values replace the material's own modifiers in the instanced variants of the PBR shaders.
+	struct ModelInstance
+	{
+		glm::mat4 modelMatrix = glm::mat4(1.0f);
+		glm::vec3 albedo = glm::vec3(1.0f);
+		float roughness = 0.0f;
+		float metalness = 0.0f;
+		GLuint materialIndex = 0; // Record of the material's resident textures, see TextureResidency
+	};
+
+	/// @brief Get the stream buffer every instanced draw writes its instances to, creating it on first use.
+	/// @return The buffer.
+	StreamBuffer& GetInstanceBuffer();
+
+	/// @brief Point the per-instance attributes of the bound vertex array at the start of the instance buffer, advancing once per instance.
+	/// @details Draws pick out their instances with a base instance rather than new pointers, so this only needs doing once per vertex array.
+	void BindInstanceAttributes();
+}
+
+#endif // EPBR_INSTANCING
@@ -1,6 +1,7 @@
 #include "LegacyMaterial.h"
 #include "Shader.h"
 #include "Texture.h"
+#include "StateCache.h"
 
 #include <glm/ext.hpp>
 
@@ -47,9 +48,9 @@ namespace ePBR
 		m_normalMapSamplerLocation = glGetUniformLocation(id, "normalMap");
 	}
 
-	void LegacyMaterial::Apply(glm::mat4 _modelMatrix, glm::mat4 _invModelMatrix, glm::mat4 _viewMatrix, glm::mat4 _projMatrix, glm::vec3 _camPos) 
+	void LegacyMaterial::Apply(glm::mat4 _modelMatrix, glm::mat4 _viewMatrix, glm::mat4 _projMatrix, glm::vec3 _camPos) 
 	{
-		glUseProgram(m_shaderProgram->GetID());
+		StateCache::GetShared().UseProgram(m_shaderProgram->GetID());
 
 		// Calculate MVP
 		glm::mat4 MVP = _projMatrix * _viewMatrix * _modelMatrix;
@@ -67,16 +68,14 @@ namespace ePBR
 
 		if (m_albedoTexture) 
 		{
-			glActiveTexture(GL_TEXTURE0);
 			glUniform1i(m_albedoSamplerLocation, 0);
-			glBindTexture(GL_TEXTURE_2D, m_albedoTexture->GetID());
+			StateCache::GetShared().BindTexture(0, GL_TEXTURE_2D, m_albedoTexture->GetID());
 		}
 
 		if (m_normalMap) 
 		{
-			glActiveTexture(GL_TEXTURE1);
 			glUniform1i(m_normalMapSamplerLocation, 1);
-			glBindTexture(GL_TEXTURE_2D, m_normalMap->GetID());
+			StateCache::GetShared().BindTexture(1, GL_TEXTURE_2D, m_normalMap->GetID());
 		}
 	}
 }
\ No newline at end of file
@@ -44,11 +44,10 @@ namespace ePBR
 
 		/// @brief Apply this material in preparation for drawing something it applies to.
 		/// @param _modelMatrix The model matrix of the object to draw.
-		/// @param _invModelMatrix The inverse model matrix of the object to draw.
 		/// @param _viewMatrix The view matrix which should be used to draw.
 		/// @param _projMatrix The projection matrix which should be used to draw.
 		/// @param _camPos The position of the camera corresponds to the view matrix.
-		void Apply(glm::mat4 _modelMatrix, glm::mat4 _invModelMatrix, glm::mat4 _viewMatrix, glm::mat4 _projMatrix, glm::vec3 _camPos);
+		void Apply(glm::mat4 _modelMatrix, glm::mat4 _viewMatrix, glm::mat4 _projMatrix, glm::vec3 _camPos);
 
 		/// @brief Set the albedo texture of this material.
 		/// @param _newTexture The new texture.
@@ -0,0 +1,148 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ePBR
+{
+#ifdef _WIN32
+	bool MappedFile::Open(const std::string& _filename)
+	{
+		Close();
+
+		HANDLE file = CreateFileA(_filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size))
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		m_fileHandle = file;
+		m_size = (size_t)size.QuadPart;
+		m_open = true;
+
+		// Mapping an empty file is an error on Windows, but an empty file is still a valid (empty) mapping for us
+		if (m_size == 0)
+		{
+			return true;
+		}
+
+		m_mappingHandle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (!m_mappingHandle)
+		{
+			Close();
+			return false;
+		}
+
+		m_data = (const char*)MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0);
+		if (!m_data)
+		{
+			Close();
+			return false;
+		}
+
+		return true;
+	}
+
+	void MappedFile::Close()
+	{
+		if (m_data) UnmapViewOfFile(m_data);
+		if (m_mappingHandle) CloseHandle((HANDLE)m_mappingHandle);
+		if (m_fileHandle) CloseHandle((HANDLE)m_fileHandle);
+
+		m_data = nullptr;
+		m_mappingHandle = nullptr;
+		m_fileHandle = nullptr;
+		m_size = 0;
+		m_open = false;
+	}
+
+	MappedFile::MappedFile() :
+		m_data(nullptr),
+		m_size(0),
+		m_open(false),
+		m_fileHandle(nullptr),
+		m_mappingHandle(nullptr)
+	{
+	}
+#else
+	bool MappedFile::Open(const std::string& _filename)
+	{
+		Close();
+
+		int fd = open(_filename.c_str(), O_RDONLY);
+		if (fd < 0)
+		{
+			return false;
+		}
+
+		struct stat fileInfo;
+		if (fstat(fd, &fileInfo) != 0)
+		{
+			close(fd);
+			return false;
+		}
+
+		m_fileDescriptor = fd;
+		m_size = (size_t)fileInfo.st_size;
+		m_open = true;
+
+		// mmap rejects zero length mappings, but an empty file is still a valid (empty) mapping for us
+		if (m_size == 0)
+		{
+			return true;
+		}
+
+		void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED)
+		{
+			Close();
+			return false;
+		}
+
+		// We nearly always stream through mapped files from front to back
+		madvise(data, m_size, MADV_SEQUENTIAL);
+
+		m_data = (const char*)data;
+		return true;
+	}
+
+	void MappedFile::Close()
+	{
+		if (m_data) munmap((void*)m_data, m_size);
+		if (m_fileDescriptor >= 0) close(m_fileDescriptor);
+
+		m_data = nullptr;
+		m_fileDescriptor = -1;
+		m_size = 0;
+		m_open = false;
+	}
+
+	MappedFile::MappedFile() :
+		m_data(nullptr),
+		m_size(0),
+		m_open(false),
+		m_fileDescriptor(-1)
+	{
+	}
+#endif
+
+	MappedFile::~MappedFile()
+	{
+		Close();
+	}
+}
@@ -0,0 +1,53 @@
+#ifndef EPBR_MAPPED_FILE
+#define EPBR_MAPPED_FILE
+
+#include <string>
+#include <cstddef>
+
+namespace ePBR
+{
+	/// @brief Read-only memory mapping of a whole file. The mapping is released when the object is destroyed or Close() is called.
+	class MappedFile
+	{
+	public:
+		/// @brief Map a file into memory, closing any previously mapped file.
+		/// @param _filename The path to the file to map.
+		/// @return Whether the file could be opened and mapped.
+		bool Open(const std::string& _filename);
+
+		/// @brief Release the current mapping, if any.
+		void Close();
+
+		/// @brief Get a pointer to the first byte of the mapped file. May be nullptr for empty files.
+		/// @return The start of the mapped data.
+		const char* GetData() const { return m_data; }
+
+		/// @brief Get the size of the mapped file.
+		/// @return The size in bytes.
+		size_t GetSize() const { return m_size; }
+
+		/// @brief Get whether a file is currently mapped.
+		/// @return Whether a file is currently mapped.
+		bool IsOpen() const { return m_open; }
+
+		MappedFile();
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+	private:
+		const char* m_data;
+		size_t m_size;
+		bool m_open;
+
+#ifdef _WIN32
+		void* m_fileHandle;
+		void* m_mappingHandle;
+#else
+		int m_fileDescriptor;
+#endif
+	};
+}
+
+#endif // EPBR_MAPPED_FILE
@@ -1,18 +1,25 @@
 #ifndef EPBR_MATERIAL
 #define EPBR_MATERIAL
 
+#include <cstddef>
 #include <memory>
+#include <string>
 #include <glm/glm.hpp>
+#include <GL/glew.h>
 
 namespace ePBR 
 {
 	class Shader;
+	struct ModelInstance;
 
 	class Material 
 	{
 	protected:
 		std::shared_ptr<Shader> m_shaderProgram;
 
+		// Drawn after everything opaque, blended, back to front
+		bool m_transparent = false;
+
 	public:
 		/// @brief Set this material's shader.
 		/// @param _newShader The new shader
@@ -20,11 +27,65 @@ namespace ePBR
 
 		/// @brief Apply this material in preparation for drawing something it applies to.
 		/// @param _modelMatrix The model matrix of the object to draw.
-		/// @param _invModelMatrix The inverse model matrix of the object to draw.
 		/// @param _viewMatrix The view matrix which should be used to draw.
 		/// @param _projMatrix The projection matrix which should be used to draw.
 		/// @param _camPos The position of the camera corresponds to the view matrix.
-		virtual void Apply(glm::mat4 _modelMatrix, glm::mat4 _invModelMatrix, glm::mat4 _viewMatrix, glm::mat4 _projMatrix, glm::vec3 _camPos) = 0;
+		virtual void Apply(glm::mat4 _modelMatrix, glm::mat4 _viewMatrix, glm::mat4 _projMatrix, glm::vec3 _camPos) = 0;
+
+		/// @brief Apply the instanced variant of this material, which reads each instance's model matrix and material modifiers from the instance buffer.
+		/// @param _viewMatrix The view matrix which should be used to draw.
+		/// @param _projMatrix The projection matrix which should be used to draw.
+		/// @param _camPos The position of the camera corresponds to the view matrix.
+		/// @return Whether the material has an instanced variant. If not, nothing is applied and instances must be drawn one at a time.
+		virtual bool ApplyInstanced(glm::mat4 /*_viewMatrix*/, glm::mat4 /*_projMatrix*/, glm::vec3 /*_camPos*/) { return false; }
+
+		/// @brief Copy the modifiers instanced variants read per instance rather than from the material, such as albedo, into an instance.
+		/// @param _instance The instance. By default it is left as it is.
+		virtual void GetInstanceModifiers(ModelInstance& /*_instance*/) const {}
+
+		/// @brief Apply only what differs from the last object drawn with this material, which must still be applied.
+		/// @details Lets a RenderQueue skip rebinding the program and textures between objects sharing a material. By default this applies everything.
+		/// @param _modelMatrix The model matrix of the object to draw.
+		/// @param _viewMatrix The view matrix which should be used to draw.
+		/// @param _projMatrix The projection matrix which should be used to draw.
+		/// @param _camPos The position of the camera corresponds to the view matrix.
+		virtual void ApplyObject(glm::mat4 _modelMatrix, glm::mat4 _viewMatrix, glm::mat4 _projMatrix, glm::vec3 _camPos) { Apply(_modelMatrix, _viewMatrix, _projMatrix, _camPos); }
+
+		/// @brief Select an object from those bound to OBJECT_STORAGE_BINDING rather than uploading its matrices, straight after Apply().
+		/// @details Lets a RenderQueue write every object's matrices in one go. By default the material doesn't read the object block.
+		/// @param _index The object's index within the bound range.
+		/// @return Whether the material reads the object block. If not, ApplyObject() must be used instead.
+		virtual bool ApplyObjectIndex(GLuint /*_index*/) { return false; }
+
+		/// @brief Get the shader program Apply() binds, so that draws sharing it can be sorted together.
+		/// @return The OpenGL ID of the program, or 0 if unknown.
+		virtual GLuint GetProgramID() { return 0; }
+
+		/// @brief Get a value shared by materials which bind the same textures, so that draws sharing them can be sorted together.
+		/// @return The value, or 0 if the material binds no textures.
+		virtual size_t GetTextureSetID() const { return 0; }
+
+		/// @brief Get the index of this material's record of resident textures, which instances and objects carry so that shaders can find its maps.
+		/// @return The index, or 0 if the material binds its textures instead.
+		virtual GLuint GetMaterialIndex() { return 0; }
+
+		/// @brief Get a value shared by materials which can be drawn in the same instanced multi-draw, as applying any one of them applies what all of them need.
+		/// @return The value. By default, unique to this material.
+		virtual size_t GetBatchID() { return (size_t)this; }
+
+		/// @brief Select the variant Apply() binds for a deferred G-buffer pass, which writes surface properties to the bound G-buffer rather than shading.
+		/// @details Lets a RenderQueue draw opaque meshes into a DeferredShading G-buffer. Materials without the variant stay forward, and are drawn after lighting.
+		/// @param _define The variant's define, from DeferredShading::GetGBufferDefine(), or empty to shade forward again.
+		/// @return Whether Apply() now writes to the G-buffer. By default, false.
+		virtual bool SetGBufferVariant(const std::string& /*_define*/) { return false; }
+
+		/// @brief Set whether this material is blended over what is behind it. Render queues draw transparent materials after opaque ones, back to front.
+		/// @param _transparent The new flag state.
+		void SetTransparent(bool _transparent) { m_transparent = _transparent; }
+
+		/// @brief Get whether this material is blended over what is behind it.
+		/// @return The flag state.
+		bool IsTransparent() const { return m_transparent; }
 	};
 }
 
@@ -1,236 +1,161 @@
 
 #include "Mesh.h"
-#include "VertexBuffer.h"
+#include "OBJParser.h"
+#include "ThreadPool.h"
+#include "VertexWelding.h"
+#include "MeshOptimisation.h"
+#include "MeshCache.h"
+#include "TangentGeneration.h"
+#include "VertexQuantisation.h"
+#include "Meshlets.h"
+#include "MeshSimplification.h"
+#include "Occlusion.h"
+#include "StateCache.h"
 
 #include <assimp/scene.h>
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 
-#include <fstream>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
-#include <sstream>
 #include <vector>
 
 
 namespace ePBR 
 {
 
-	Mesh::Mesh()
+	namespace
 	{
-		// Initialise stuff here
-		m_VAO = std::make_shared<VertexArray>();
-	}
+		// Parse, weld and optionally optimise an OBJ file, then generate its tangent frames, meshlets and levels of detail
+		bool ImportOBJ(const std::string& _filename, const ImportOptions& _options, MeshData& _out)
+		{
+			// Map and tokenise the file in place
+			OBJData objData;
+			if (!LoadOBJFile(_filename, objData, &ThreadPool::GetShared())) return false;
 
-	Mesh::~Mesh()
-	{
-	}
+			// Un-index faces into ordered vertex streams
+			AssembleOBJStreams(objData, _out.positions, _out.uvs, _out.normals, &ThreadPool::GetShared());
 
+			// Attributes only some corners reference can't be matched up with positions, so drop them
+			if (_out.normals.size() != _out.positions.size()) _out.normals.clear();
+			if (_out.uvs.size() != _out.positions.size()) _out.uvs.clear();
 
-	void Mesh::LoadOBJ(std::string _filename)
-	{
-		// Find file
-		std::ifstream inputFile(_filename);
+			// Share corners with identical attributes. The remap of an un-indexed stream is its index buffer.
+			WeldVertices(_out.positions, _out.normals, _out.uvs, _out.indices);
 
-		if (inputFile.is_open())
-		{
-			// OBJ files can store texture coordinates, positions and normals
-			std::vector<glm::vec2> rawUVData;
-			std::vector<glm::vec3> rawPositionData;
-			std::vector<glm::vec3> rawNormalData;
+			if (_options.optimiseMesh)
+			{
+				std::cout << "Optimising " << _filename << ":\n";
+				OptimiseAndReport(_out.indices, _out.positions, _out.normals, _out.uvs);
+			}
 
-			std::vector<glm::vec2> orderedUVData;
-			std::vector<glm::vec3> orderedPositionData;
-			std::vector<glm::vec3> orderedNormalData;
-			std::vector<glm::vec3> orderedTangentVectors;
-			std::vector <glm::vec3> orderedBitangentVectors;
+			GenerateTangents(_out, &ThreadPool::GetShared());
 
-			std::string currentLine;
+			_out.ComputeBounds();
 
-			while (std::getline(inputFile, currentLine))
+			// Regroups the triangles the optimiser ordered, in exchange for skipping whole meshlets when drawing
+			if (_options.buildMeshlets)
 			{
-				std::stringstream currentLineStream(currentLine);
+				BuildMeshlets(_out);
+				std::cout << "Split " << _filename << " into " << _out.meshlets.size() << " meshlets\n";
+			}
 
-				if (!currentLine.substr(0, 2).compare(0, 2, "vt"))
-				{
-					std::string junk;
-					float x, y;
-					currentLineStream >> junk >> x >> y;
-					rawUVData.push_back(glm::vec2(x, y));
-				}
-				else if (!currentLine.substr(0, 2).compare(0, 2, "vn"))
-				{
-					std::string junk;
-					float x, y, z;
-					currentLineStream >> junk >> x >> y >> z;
-					rawNormalData.push_back(glm::vec3(x, y, z));
-				}
-				else if (!currentLine.substr(0, 2).compare(0, 1, "v"))
-				{
-					std::string junk;
-					float x, y, z;
-					currentLineStream >> junk >> x >> y >> z;
-					rawPositionData.push_back(glm::vec3(x, y, z));
-				}
-				else if (!currentLine.substr(0, 2).compare(0, 1, "f"))
-				{
-					std::string junk;
-					std::string verts[4];
-
-					currentLineStream >> junk >> verts[0] >> verts[1] >> verts[2] >> verts[3];
-
-					if (verts[3].empty())
-					{
-						for (unsigned int i = 0; i < 3; i++)
-						{
-							std::stringstream currentSection(verts[i]);
-
-							// There is just position data
-							unsigned int posID = 0;
-							unsigned int uvID = 0;
-							unsigned int normID = 0;
-
-							if (verts[i].find('/') == std::string::npos)
-							{
-								// No texcoords or normals
-								currentSection >> posID;
-							}
-							else if (verts[i].find("//") != std::string::npos)
-							{
-								// No texcoords
-								char junk;
-								currentSection >> posID >> junk >> junk >> normID;
-							}
-							else
-							{
-								char junk;
-								currentSection >> posID >> junk >> uvID >> junk >> normID;
-							}
-
-							if (posID > 0)
-							{
-								orderedPositionData.push_back(rawPositionData[posID - 1]);
-							}
-							if (uvID > 0)
-							{
-								orderedUVData.push_back(rawUVData[uvID - 1]);
-							}
-							if (normID > 0)
-							{
-								orderedNormalData.push_back(rawNormalData[normID - 1]);
-							}
-
-						}
-					}
-					else
-					{
-						std::cerr << "WARNING: This OBJ loader only works with triangles but a quad has been detected. Please triangulate your mesh." << std::endl;
-						inputFile.close();
-						return;
-					}
+			// Appended after the full mesh, so its meshlets and vertices are untouched
+			if (_options.generateLODs)
+			{
+				GenerateLODs(_out, MAX_LOD_LEVELS, _options.optimiseMesh);
+				std::cout << "Simplified " << _filename << " into " << _out.lods.size() << " levels of detail:\n";
+				for (const MeshLOD& lod : _out.lods) std::cout << "  " << lod.indexCount / 3 << " triangles, error " << lod.error << "\n";
+			}
 
-				}
+			// Taken from the coarsest level, so must follow it
+			if (_options.buildOccluders)
+			{
+				BuildOccluder(_out);
+				std::cout << "Kept " << _out.occluder.indices.size() / 3 << " triangles of " << _filename << " as an occluder\n";
 			}
 
-			inputFile.close();
+			if (_options.quantiseVertices)
+			{
+				std::cout << "Quantising " << _filename << ":\n";
+				ReportQuantisation(_out);
+				_out.quantise = true;
+			}
 
-			size_t numVertices = orderedPositionData.size();
-			m_VAO->SetVertCount(numVertices);
+			return true;
+		}
+	}
 
-			if (numVertices > 0)
-			{
-				glBindVertexArray(m_VAO->GetID());
+	Mesh::Mesh()
+	{
+		// Initialise stuff here
+		m_boundsMin = glm::vec3(0.0f);
+		m_boundsMax = glm::vec3(0.0f);
+		m_boundsRadius = 0.0f;
+		m_positionDecode = glm::mat4(1.0f);
+		m_visibleMeshlets = 0;
+	}
 
-				std::shared_ptr<VertexBuffer> posBuffer = std::make_shared<VertexBuffer>();
-				posBuffer->SetData(orderedPositionData);
-				m_VAO->SetBuffer(posBuffer, 0);
+	Mesh::~Mesh()
+	{
+	}
 
-				if (orderedNormalData.size() > 0)
-				{
-					std::shared_ptr<VertexBuffer> normalBuffer = std::make_shared<VertexBuffer>();
-					normalBuffer->SetData(orderedNormalData);
-					m_VAO->SetBuffer(normalBuffer, 1);
-				}
 
-				if (orderedUVData.size() > 0)
-				{
-					std::shared_ptr<VertexBuffer> texBuffer = std::make_shared<VertexBuffer>();
-					texBuffer->SetData(orderedUVData);
-					m_VAO->SetBuffer(texBuffer, 2);
-				}
+	void Mesh::LoadOBJ(std::string _filename, const ImportOptions& _options)
+	{
+		std::string cacheFile = GetMeshCachePath(_filename);
+		uint64_t cacheKey = _options.useCache ? GetMeshCacheKey(_filename, _options) : 0;
 
-				if (orderedUVData.size() > 0 && orderedNormalData.size() > 0 && numVertices) 
-				{
-					orderedTangentVectors.resize(orderedNormalData.size());
-					orderedBitangentVectors.resize(orderedNormalData.size());
-
-					for (int i = 0; i < orderedPositionData.size(); i += 3)
-					{
-						glm::vec3 edge1;
-						glm::vec3 edge2;
-						glm::vec2 deltaUV1;
-						glm::vec2 deltaUV2;
-						float f;
-
-						// Vertex 1
-						edge1 = orderedPositionData[i + 1] - orderedPositionData[i];
-						edge2 = orderedPositionData[i + 2] - orderedPositionData[i];
-						deltaUV1 = orderedUVData[i + 1] - orderedUVData[i];
-						deltaUV2 = orderedUVData[i + 2] - orderedUVData[i];
-
-						f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
-
-						orderedTangentVectors[i].x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
-						orderedTangentVectors[i].y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
-						orderedTangentVectors[i].z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
-						orderedBitangentVectors[i].x = f * (-deltaUV2.x * edge1.x + deltaUV1.x * edge2.x);
-						orderedBitangentVectors[i].y = f * (-deltaUV2.x * edge1.y + deltaUV1.x * edge2.y);
-						orderedBitangentVectors[i].z = f * (-deltaUV2.x * edge1.z + deltaUV1.x * edge2.z);
-
-						// Vertex 2
-						edge1 = orderedPositionData[i] - orderedPositionData[i + 1];
-						edge2 = orderedPositionData[i + 2] - orderedPositionData[i + 1];
-						deltaUV1 = orderedUVData[i] - orderedUVData[i + 1];
-						deltaUV2 = orderedUVData[i + 2] - orderedUVData[i + 1];
-
-						f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
-
-						orderedTangentVectors[i + 1].x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
-						orderedTangentVectors[i + 1].y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
-						orderedTangentVectors[i + 1].z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
-						orderedBitangentVectors[i + 1].x = f * (-deltaUV2.x * edge1.x + deltaUV1.x * edge2.x);
-						orderedBitangentVectors[i + 1].y = f * (-deltaUV2.x * edge1.y + deltaUV1.x * edge2.y);
-						orderedBitangentVectors[i + 1].z = f * (-deltaUV2.x * edge1.z + deltaUV1.x * edge2.z);
-
-						// Vertex 3
-						edge1 = orderedPositionData[i + 1] - orderedPositionData[i + 2];
-						edge2 = orderedPositionData[i] - orderedPositionData[i + 2];
-						deltaUV1 = orderedUVData[i + 1] - orderedUVData[i + 2];
-						deltaUV2 = orderedUVData[i] - orderedUVData[i + 2];
-
-						f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
-
-						orderedTangentVectors[i + 2].x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
-						orderedTangentVectors[i + 2].y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
-						orderedTangentVectors[i + 2].z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
-						orderedBitangentVectors[i + 2].x = f * (-deltaUV2.x * edge1.x + deltaUV1.x * edge2.x);
-						orderedBitangentVectors[i + 2].y = f * (-deltaUV2.x * edge1.y + deltaUV1.x * edge2.y);
-						orderedBitangentVectors[i + 2].z = f * (-deltaUV2.x * edge1.z + deltaUV1.x * edge2.z);
-					}
-
-					std::shared_ptr<VertexBuffer> tangentBuffer = std::make_shared<VertexBuffer>();
-					tangentBuffer->SetData(orderedTangentVectors);
-					m_VAO->SetBuffer(tangentBuffer, 3);
-
-					std::shared_ptr<VertexBuffer> bitangentBuffer = std::make_shared<VertexBuffer>();
-					bitangentBuffer->SetData(orderedBitangentVectors);
-					m_VAO->SetBuffer(bitangentBuffer, 4);
-				}
-			}
+		// A cache written from the same file and options holds exactly what importing would produce
+		std::vector<CachedMesh> cachedMeshes;
+		std::vector<MaterialBinding> materials;
+		if (cacheKey && LoadMeshCache(cacheFile, cacheKey, cachedMeshes, materials) && cachedMeshes.size() == 1)
+		{
+			SetGeometry(cachedMeshes[0].geometry);
+			SetBounds(cachedMeshes[0].boundsMin, cachedMeshes[0].boundsMax, cachedMeshes[0].boundsRadius);
+			m_positionDecode = cachedMeshes[0].positionDecode;
+			m_meshlets = cachedMeshes[0].meshlets;
+			m_lods = cachedMeshes[0].lods;
+			m_occluder = cachedMeshes[0].occluder;
+			return;
+		}
+
+		MeshData meshData;
+		if (ImportOBJ(_filename, _options, meshData))
+		{
+			SetMeshData(meshData);
+
+			if (cacheKey) WriteMeshCache(cacheFile, cacheKey, { meshData }, {});
+		}
+	}
+
+	void Mesh::SetMeshData(const MeshData& _data)
+	{
+		// Float or quantised depending on the mesh, interleaved into one buffer
+		PackedVertices packed;
+		PackVertices(_data, packed);
+
+		// Indices go in the narrowest type which holds them, and meshes share an arena with others of the same format and index type
+		bool fitsShort = std::all_of(_data.indices.begin(), _data.indices.end(), [](unsigned int _index) { return _index <= 0xFFFF; });
+		std::shared_ptr<GeometryArena> arena = GeometryArena::GetShared(packed.layout, fitsShort ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT);
+
+		size_t vertexCount = _data.positions.size();
+		if (fitsShort)
+		{
+			std::vector<GLushort> shortIndices(_data.indices.begin(), _data.indices.end());
+			SetGeometry(arena->Allocate(packed.data.data(), vertexCount, shortIndices.data(), shortIndices.size()));
 		}
 		else
 		{
-			std::cerr << "WARNING: File not found: " << _filename << std::endl;
+			SetGeometry(arena->Allocate(packed.data.data(), vertexCount, _data.indices.data(), _data.indices.size()));
 		}
+
+		SetBounds(_data.boundsMin, _data.boundsMax, _data.boundsRadius);
+		m_positionDecode = packed.position.GetDecode();
+		m_meshlets = _data.meshlets;
+		m_lods = _data.lods;
+		m_occluder = _data.occluder;
 	}
 
 	void Mesh::SetAsCube(float _hw) 
@@ -409,109 +334,17 @@ namespace ePBR
 			glm::vec3(0, -1, 0) // Bottom right of bottom face
 		};
 
-		// Generated tangent vectors
-		std::vector<glm::vec3> orderedTangentVectors =
-		{
-			glm::vec3(1, -0, -0),
-			glm::vec3(1, 0, 0),
-			glm::vec3(1, -0, -0),
-			glm::vec3(1, 0, 0),
-			glm::vec3(1, -0, -0),
-			glm::vec3(1, -0, -0),
-			glm::vec3(-1, 0, 0),
-			glm::vec3(-1, -0, -0),
-			glm::vec3(-1, 0, 0),
-			glm::vec3(-1, 0, 0),
-			glm::vec3(-1, 0, -0),
-			glm::vec3(-1, -0, -0),
-			glm::vec3(-0, -0, 1),
-			glm::vec3(0, 0, 1),
-			glm::vec3(-0, -0, 1),
-			glm::vec3(0, 0, 1),
-			glm::vec3(-0, -0, 1),
-			glm::vec3(-0, -0, 1),
-			glm::vec3(-0, -0, -1),
-			glm::vec3(0, 0, -1),
-			glm::vec3(-0, -0, -1),
-			glm::vec3(0, 0, -1),
-			glm::vec3(-0, -0, -1),
-			glm::vec3(-0, -0, -1),
-			glm::vec3(1, -0, -0),
-			glm::vec3(1, 0, 0),
-			glm::vec3(1, -0, -0),
-			glm::vec3(1, 0, 0),
-			glm::vec3(1, -0, -0),
-			glm::vec3(1, -0, -0),
-			glm::vec3(-1, -0, -0),
-			glm::vec3(-1, 0, 0),
-			glm::vec3(-1, -0, 0),
-			glm::vec3(-1, -0, -0),
-			glm::vec3(-1, 0, 0),
-			glm::vec3(-1, 0, 0)
-		};
-
-		// Generated bitangent vectors
-		std::vector <glm::vec3> orderedBitangentVectors =
-		{
-			glm::vec3(0, -1, 0),
-			glm::vec3(-0, -1, -0),
-			glm::vec3(-0, -1, -0),
-			glm::vec3(0, -1, 0),
-			glm::vec3(-0, -1, 0),
-			glm::vec3(-0, -1, -0),
-			glm::vec3(0, -1, 0),
-			glm::vec3(-0, -1, -0),
-			glm::vec3(-0, -1, -0),
-			glm::vec3(-0, -1, 0),
-			glm::vec3(0, -1, -0),
-			glm::vec3(-0, -1, -0),
-			glm::vec3(0, -1, 0),
-			glm::vec3(-0, -1, -0),
-			glm::vec3(-0, -1, -0),
-			glm::vec3(0, -1, 0),
-			glm::vec3(0, -1, -0),
-			glm::vec3(-0, -1, -0),
-			glm::vec3(0, -1, 0),
-			glm::vec3(-0, -1, -0),
-			glm::vec3(-0, -1, 0),
-			glm::vec3(0, -1, 0),
-			glm::vec3(0, -1, 0),
-			glm::vec3(-0, -1, -0),
-			glm::vec3(0, 0, -1),
-			glm::vec3(-0, -0, -1),
-			glm::vec3(-0, -0, -1),
-			glm::vec3(0, 0, -1),
-			glm::vec3(-0, 0, -1),
-			glm::vec3(-0, -0, -1),
-			glm::vec3(0, -0, 1),
-			glm::vec3(-0, 0, 1),
-			glm::vec3(0, 0, 1),
-			glm::vec3(-0, -0, 1),
-			glm::vec3(0, 0, 1),
-			glm::vec3(0, 0, 1)
-		};
-
-		m_VAO->SetVertCount(orderedPositions.size());
-
-		std::shared_ptr<VertexBuffer> positionsBuffer = std::make_shared<VertexBuffer>();
-		positionsBuffer->SetData(orderedPositions);
-		m_VAO->SetBuffer(positionsBuffer, 0);
-
-		std::shared_ptr<VertexBuffer> normalsBuffer = std::make_shared<VertexBuffer>();
-		normalsBuffer->SetData(orderedNormals);
-		m_VAO->SetBuffer(normalsBuffer, 1);
+		MeshData data;
+		data.positions = orderedPositions;
+		data.normals = orderedNormals;
+		data.uvs = orderedUVs;
 
-		std::shared_ptr<VertexBuffer> uvBuffer = std::make_shared<VertexBuffer>();
-		uvBuffer->SetData(orderedUVs);
-		m_VAO->SetBuffer(uvBuffer, 2);
+		// Corners shared between triangles of a face become one vertex
+		WeldVertices(data.positions, data.normals, data.uvs, data.indices);
+		GenerateTangents(data);
+		data.ComputeBounds();
 
-		std::shared_ptr<VertexBuffer> tangentBuffer = std::make_shared<VertexBuffer>();
-		tangentBuffer->SetData(orderedTangentVectors);
-		m_VAO->SetBuffer(tangentBuffer, 3);
-
-		std::shared_ptr<VertexBuffer> bitangentBuffer = std::make_shared<VertexBuffer>();
-		bitangentBuffer->SetData(orderedBitangentVectors);
-		m_VAO->SetBuffer(bitangentBuffer, 4);
+		SetMeshData(data);
 	}
 
 	void Mesh::SetAsQuad(float _w, float _h) 
@@ -558,68 +391,180 @@ namespace ePBR
 			glm::vec2(1, 1) // Bottom right
 		};
 
-		// Generated tangent vectors
-		std::vector<glm::vec3> orderedTangentVectors = 
-		{
-			// Tri 1
-			glm::vec3(2,-0,-0),
-			glm::vec3(2,0,0),
-			glm::vec3(2,-0,-0),
-
-			// Tri 2
-			glm::vec3(2,0,0),
-			glm::vec3(2,-0,-0),
-			glm::vec3(2,-0,-0)
+		MeshData data;
+		data.positions = orderedPositions;
+		data.normals = orderedNormals;
+		data.uvs = orderedUVs;
 
-		};
+		// Corners shared between triangles of a face become one vertex
+		WeldVertices(data.positions, data.normals, data.uvs, data.indices);
+		GenerateTangents(data);
+		data.ComputeBounds();
 
-		// Generated bitangent vectors
-		std::vector<glm::vec3> orderedBitangentVectors = 
-		{
-			// Tri 1
-			glm::vec3(0,-2,0),
-			glm::vec3(-0,-2,-0),
-			glm::vec3(-0,-2,-0),
-
-			// Tri 2
-			glm::vec3(0,-2,0),
-			glm::vec3(-0,-2,0),
-			glm::vec3(-0,-2,-0)
-		};
+		SetMeshData(data);
+	}
 
-		m_VAO->SetVertCount(orderedPositions.size());
+	size_t Mesh::SelectLOD(const glm::mat4& _modelMatrix, const glm::mat4& _projMatrix, const glm::vec3& _camPos, float _maxScreenError) const
+	{
+		if (m_lods.size() < 2) return 0;
 
-		std::shared_ptr<VertexBuffer> positionsBuffer = std::make_shared<VertexBuffer>();
-		positionsBuffer->SetData(orderedPositions);
-		m_VAO->SetBuffer(positionsBuffer, 0);
+		// Errors are in model space, so scale them by the largest stretch of the model matrix
+		glm::mat3 linear(_modelMatrix);
+		float scale = std::sqrt(std::max(glm::dot(linear[0], linear[0]), std::max(glm::dot(linear[1], linear[1]), glm::dot(linear[2], linear[2]))));
 
-		std::shared_ptr<VertexBuffer> normalsBuffer = std::make_shared<VertexBuffer>();
-		normalsBuffer->SetData(orderedNormals);
-		m_VAO->SetBuffer(normalsBuffer, 1);
+		glm::vec3 center = glm::vec3(_modelMatrix * glm::vec4((m_boundsMin + m_boundsMax) * 0.5f, 1.0f));
+		float radius = m_boundsRadius * scale;
 
-		std::shared_ptr<VertexBuffer> uvBuffer = std::make_shared<VertexBuffer>();
-		uvBuffer->SetData(orderedUVs);
-		m_VAO->SetBuffer(uvBuffer, 2);
+		float distance = glm::length(center - _camPos) - radius;
+		if (distance <= 0.0f) return 0;
 
-		std::shared_ptr<VertexBuffer> tangentBuffer = std::make_shared<VertexBuffer>();
-		tangentBuffer->SetData(orderedTangentVectors);
-		m_VAO->SetBuffer(tangentBuffer, 3);
+		// Viewport heights covered by one model space unit at the nearest point of the bounding sphere. Clip space y spans 2.
+		float screenPerUnit = scale * _projMatrix[1][1] * 0.5f / distance;
 
-		std::shared_ptr<VertexBuffer> bitangentBuffer = std::make_shared<VertexBuffer>();
-		bitangentBuffer->SetData(orderedBitangentVectors);
-		m_VAO->SetBuffer(bitangentBuffer, 4);
+		size_t lod = 0;
+		while (lod + 1 < m_lods.size() && m_lods[lod + 1].error * screenPerUnit <= _maxScreenError) lod++;
+		return lod;
 	}
 
-	void Mesh::Draw()
+	void Mesh::Draw(size_t _lod)
 	{
+		if (m_geometry)
+		{
+			GeometryArena& arena = m_geometry->GetArena();
+
+			// Shared by every mesh of the arena, so left bound for the next one
+			StateCache::GetShared().BindVertexArray(arena.GetVertexArrayID());
+
+			if (m_geometry->GetIndexCount() > 0)
+			{
+				// The index buffer holds every level, so draw just the one asked for
+				unsigned int indexOffset = 0;
+				unsigned int indexCount = m_geometry->GetIndexCount();
+				if (!m_lods.empty())
+				{
+					const MeshLOD& lod = m_lods[std::min(_lod, m_lods.size() - 1)];
+					indexOffset = lod.indexOffset;
+					indexCount = lod.indexCount;
+				}
+
+				const void* offset = (const void*)((m_geometry->GetFirstIndex() + indexOffset) * arena.GetIndexSize());
+				glDrawElementsBaseVertex(GL_TRIANGLES, indexCount, arena.GetIndexType(), offset, m_geometry->GetBaseVertex());
+			}
+			else
+			{
+				glDrawArrays(GL_TRIANGLES, m_geometry->GetBaseVertex(), m_geometry->GetVertexCount());
+			}
+			return;
+		}
+
+		if (!m_VAO) return;
+
 		// Activate the VAO
-		glBindVertexArray(m_VAO->GetID());
+		StateCache::GetShared().BindVertexArray(m_VAO->GetID());
 
 		// Tell OpenGL to draw it
-		// Must specify the type of geometry to draw and the number of vertices
-		glDrawArrays(GL_TRIANGLES, 0, m_VAO->GetVertCount());
+		// Indexed meshes draw through their element buffer, anything else is a plain list of triangles
+		if (!m_lods.empty())
+		{
+			// The index buffer holds every level, so draw just the one asked for
+			const MeshLOD& lod = m_lods[std::min(_lod, m_lods.size() - 1)];
+			size_t indexSize = m_VAO->GetIndexType() == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+			glDrawElements(GL_TRIANGLES, lod.indexCount, m_VAO->GetIndexType(), (void*)(lod.indexOffset * indexSize));
+		}
+		else if (m_VAO->GetIndexCount() > 0)
+		{
+			glDrawElements(GL_TRIANGLES, m_VAO->GetIndexCount(), m_VAO->GetIndexType(), (void*)0);
+		}
+		else
+		{
+			glDrawArrays(GL_TRIANGLES, 0, m_VAO->GetVertCount());
+		}
 
 		// Unbind VAO
-		glBindVertexArray(0);
+		StateCache::GetShared().BindVertexArray(0);
+	}
+
+	void Mesh::Draw(const glm::mat4& _modelMatrix, const glm::mat4& _viewProjection, const glm::vec3& _camPos, size_t _lod)
+	{
+		if (_lod > 0 && m_lods.size() > 1)
+		{
+			m_visibleMeshlets = 0;
+			Draw(_lod);
+			return;
+		}
+
+		m_visibleMeshlets = m_meshlets.size();
+		bool indexed = m_geometry ? m_geometry->GetIndexCount() > 0 : m_VAO && m_VAO->GetIndexCount() > 0;
+		if (m_meshlets.empty() || !indexed)
+		{
+			Draw();
+			return;
+		}
+
+		// A mirroring model matrix flips the winding, and so which side of a meshlet faces away.
+		// Front faces are taken to be GL_CCW, as nothing in the library changes them, and culling is read from the cache so GL is never queried mid-frame.
+		bool coneCulling = StateCache::GetShared().GetCullFace() && glm::determinant(glm::mat3(_modelMatrix)) > 0.0f;
+
+		// Meshlet bounds are in model space, so take the camera there rather than every meshlet to world space
+		glm::vec3 camPos = glm::vec3(glm::inverse(_modelMatrix) * glm::vec4(_camPos, 1.0f));
+		m_visibleMeshlets = CullMeshlets(m_meshlets, _viewProjection * _modelMatrix, camPos, coneCulling, m_visibleRanges);
+		if (m_visibleRanges.empty()) return;
+
+		GLenum indexType = m_geometry ? m_geometry->GetArena().GetIndexType() : m_VAO->GetIndexType();
+		size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+		size_t firstIndex = m_geometry ? m_geometry->GetFirstIndex() : 0;
+
+		m_drawCounts.resize(m_visibleRanges.size());
+		m_drawOffsets.resize(m_visibleRanges.size());
+		for (size_t i = 0; i < m_visibleRanges.size(); i++)
+		{
+			m_drawCounts[i] = m_visibleRanges[i].indexCount;
+			m_drawOffsets[i] = (const void*)((firstIndex + m_visibleRanges[i].indexOffset) * indexSize);
+		}
+
+		if (m_geometry)
+		{
+			// Left bound, as in Draw()
+			m_drawBaseVertices.assign(m_drawCounts.size(), m_geometry->GetBaseVertex());
+			StateCache::GetShared().BindVertexArray(m_geometry->GetArena().GetVertexArrayID());
+			glMultiDrawElementsBaseVertex(GL_TRIANGLES, m_drawCounts.data(), indexType, m_drawOffsets.data(), (GLsizei)m_drawCounts.size(), m_drawBaseVertices.data());
+		}
+		else
+		{
+			StateCache::GetShared().BindVertexArray(m_VAO->GetID());
+			glMultiDrawElements(GL_TRIANGLES, m_drawCounts.data(), indexType, m_drawOffsets.data(), (GLsizei)m_drawCounts.size());
+			StateCache::GetShared().BindVertexArray(0);
+		}
+	}
+
+	bool Mesh::DrawInstanced(size_t _instanceCount, GLuint _baseInstance, size_t _lod)
+	{
+		if (!m_geometry) return false;
+
+		GeometryArena& arena = m_geometry->GetArena();
+
+		// Left bound, as in Draw()
+		StateCache::GetShared().BindVertexArray(arena.GetVertexArrayID());
+
+		if (m_geometry->GetIndexCount() > 0)
+		{
+			unsigned int indexOffset = 0;
+			unsigned int indexCount = m_geometry->GetIndexCount();
+			if (!m_lods.empty())
+			{
+				const MeshLOD& lod = m_lods[std::min(_lod, m_lods.size() - 1)];
+				indexOffset = lod.indexOffset;
+				indexCount = lod.indexCount;
+			}
+
+			const void* offset = (const void*)((m_geometry->GetFirstIndex() + indexOffset) * arena.GetIndexSize());
+			glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, indexCount, arena.GetIndexType(), offset, (GLsizei)_instanceCount, m_geometry->GetBaseVertex(), _baseInstance);
+		}
+		else
+		{
+			glDrawArraysInstancedBaseInstance(GL_TRIANGLES, m_geometry->GetBaseVertex(), m_geometry->GetVertexCount(), (GLsizei)_instanceCount, _baseInstance);
+		}
+
+		return true;
 	}
 }
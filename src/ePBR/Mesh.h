@@ -3,12 +3,18 @@
 #define EPBR_MESH
 
 #include "VertexArray.h"
+#include "GeometryArena.h"
+#include "ImportOptions.h"
+#include "MeshData.h"
+#include "Meshlets.h"
+#include "Culling.h"
 
 #include <glm/glm.hpp>
 #include <SDL2/SDL.h>
 #include <GL/glew.h>
 #include <string>
 #include <memory>
+#include <vector>
 
 namespace ePBR 
 {
@@ -19,9 +25,11 @@ namespace ePBR
 		Mesh();
 		~Mesh();
 
-		/// @brief Load a mesh from a wavefront OBJ file. The mesh must be triangulated.
+		/// @brief Load a mesh from a wavefront OBJ file. The file is memory mapped and tokenised in place. Polygons are triangulated as fans.
+		/// @details The imported geometry is written to a .epbrmesh cache next to the file, which later loads with matching options read instead.
 		/// @param _filename The path to the OBJ mesh to import.
-		void LoadOBJ(std::string _filename);
+		/// @param _options Processing to apply to the imported geometry.
+		void LoadOBJ(std::string _filename, const ImportOptions& _options = ImportOptions());
 
 		/// @brief Set this mesh to a uniform cube.
 		/// @param _halfWidth Half of the desired cube's width.
@@ -32,17 +40,138 @@ namespace ePBR
 		/// @param _halfHeight Half the height of the desired quad.
 		void SetAsQuad(float _halfWidth, float _halfHeight);
 
-		/// @brief Swap out the vertex array of this Mesh.
+		/// @brief Upload geometry into the shared GeometryArena for its vertex format, and take its bounds, meshlets and levels of detail.
+		/// @param _data The geometry.
+		void SetMeshData(const MeshData& _data);
+
+		/// @brief Set the bounds of this mesh, in model space.
+		/// @param _min The minimum corner of the axis aligned bounds.
+		/// @param _max The maximum corner of the axis aligned bounds.
+		/// @param _radius The radius of the bounding sphere about the centre of the axis aligned bounds.
+		void SetBounds(const glm::vec3& _min, const glm::vec3& _max, float _radius) { m_boundsMin = _min; m_boundsMax = _max; m_boundsRadius = _radius; }
+
+		/// @brief Get the minimum corner of this mesh's bounds, in model space.
+		/// @return The minimum corner.
+		glm::vec3 GetBoundsMin() const { return m_boundsMin; }
+
+		/// @brief Get the maximum corner of this mesh's bounds, in model space.
+		/// @return The maximum corner.
+		glm::vec3 GetBoundsMax() const { return m_boundsMax; }
+
+		/// @brief Get the bounding sphere of this mesh, in model space.
+		/// @return The sphere, centred on the axis aligned bounds.
+		BoundingSphere GetBoundingSphere() const { return { (m_boundsMin + m_boundsMax) * 0.5f, m_boundsRadius }; }
+
+		/// @brief Set the matrix which maps the positions stored in this mesh's vertex array to model space.
+		/// @param _decode The matrix. Identity for float positions.
+		void SetPositionDecode(const glm::mat4& _decode) { m_positionDecode = _decode; }
+
+		/// @brief Get the matrix which maps the positions stored in this mesh's vertex array to model space.
+		/// @details Quantised positions are stored relative to the mesh bounds. Apply this before the model matrix.
+		/// @return The matrix.
+		glm::mat4 GetPositionDecode() const { return m_positionDecode; }
+
+		/// @brief Set the meshlets which cover this mesh's index buffer.
+		/// @param _meshlets The meshlets, in index buffer order, or none to always draw the whole mesh.
+		void SetMeshlets(const std::vector<Meshlet>& _meshlets) { m_meshlets = _meshlets; }
+
+		/// @brief Get the meshlets which cover this mesh's index buffer.
+		/// @return The meshlets. Empty if the mesh was imported without them.
+		const std::vector<Meshlet>& GetMeshlets() const { return m_meshlets; }
+
+		/// @brief Get how many meshlets survived culling in the last clustered draw.
+		/// @return The number of meshlets drawn. Equal to the total for meshes without meshlets, and 0 when a coarser level of detail was drawn.
+		size_t GetVisibleMeshletCount() const { return m_visibleMeshlets; }
+
+		/// @brief Set the levels of detail held in this mesh's index buffer.
+		/// @param _lods The levels, from the full mesh down, or none if the index buffer only holds the full mesh.
+		void SetLODs(const std::vector<MeshLOD>& _lods) { m_lods = _lods; }
+
+		/// @brief Get the levels of detail held in this mesh's index buffer.
+		/// @return The levels, from the full mesh down. Empty if the mesh was imported without them.
+		const std::vector<MeshLOD>& GetLODs() const { return m_lods; }
+
+		/// @brief Set the simplified surface this mesh hides other meshes behind.
+		/// @param _occluder The surface, in model space, or an empty one to hide nothing.
+		void SetOccluder(const OccluderMesh& _occluder) { m_occluder = _occluder; }
+
+		/// @brief Get the simplified surface this mesh hides other meshes behind.
+		/// @return The surface. Empty if the mesh was imported without one.
+		const OccluderMesh& GetOccluder() const { return m_occluder; }
+
+		/// @brief Pick the coarsest level of detail whose error, projected onto the screen at the nearest point of the bounding sphere, stays within a limit.
+		/// @param _modelMatrix The model matrix, without the position decode.
+		/// @param _projMatrix The projection matrix.
+		/// @param _camPos The position of the camera, in world space.
+		/// @param _maxScreenError The largest error to allow, as a fraction of the viewport height.
+		/// @return The level to draw. 0, the full mesh, when the camera is inside the bounds or the mesh has no levels.
+		size_t SelectLOD(const glm::mat4& _modelMatrix, const glm::mat4& _projMatrix, const glm::vec3& _camPos, float _maxScreenError) const;
+
+		/// @brief Swap out the vertex array of this Mesh. The mesh stops drawing from any GeometryArena.
 		/// @param _newVAO The new vertex array this mesh will use.
-		void SetVertexArray(std::shared_ptr<VertexArray> _newVAO) { m_VAO = _newVAO; };
+		void SetVertexArray(std::shared_ptr<VertexArray> _newVAO) { m_VAO = _newVAO; m_geometry.reset(); };
+
+		/// @brief Draw this mesh from space in a GeometryArena, in place of its own vertex array.
+		/// @param _geometry The allocation holding this mesh's vertices and indices.
+		void SetGeometry(std::shared_ptr<GeometryAllocation> _geometry) { m_geometry = _geometry; m_VAO.reset(); }
+
+		/// @brief Get the space this mesh draws from in a GeometryArena.
+		/// @return The allocation, or nullptr if the mesh has its own vertex array.
+		std::shared_ptr<GeometryAllocation> GetGeometry() const { return m_geometry; }
 
 		/// @brief Bind and draw this mesh. Does not apply any material or shader.
-		void Draw();
+		/// @details Meshes in a GeometryArena leave its vertex array bound, so that the next mesh of the same format needn't switch.
+		/// @param _lod The level of detail to draw. Clamped to the coarsest level the mesh has.
+		void Draw(size_t _lod = 0);
+
+		/// @brief Bind and draw the meshlets of this mesh which may be visible, as one glMultiDrawElements call. Meshes without meshlets are drawn whole.
+		/// @details Meshlets outside the frustum are skipped. So are meshlets facing away from the camera, while GL_CULL_FACE culls back faces of counter-clockwise triangles.
+		/// Meshlets only cover the full mesh, so coarser levels of detail are drawn whole. Does not apply any material or shader.
+		/// @param _modelMatrix The model matrix, without the position decode.
+		/// @param _viewProjection The projection matrix times the view matrix.
+		/// @param _camPos The position of the camera, in world space.
+		/// @param _lod The level of detail to draw.
+		void Draw(const glm::mat4& _modelMatrix, const glm::mat4& _viewProjection, const glm::vec3& _camPos, size_t _lod = 0);
+
+		/// @brief Draw copies of this mesh with glDrawElementsInstanced, each reading its own ModelInstance from the instance buffer.
+		/// @details Only meshes in a GeometryArena can be instanced, as only arena vertex arrays have the per-instance attributes. Does not apply any material or shader.
+		/// @param _instanceCount The number of copies.
+		/// @param _baseInstance The first instance within the instance buffer.
+		/// @param _lod The level of detail to draw every copy at.
+		/// @return Whether the mesh could be drawn. False for meshes with their own vertex array.
+		bool DrawInstanced(size_t _instanceCount, GLuint _baseInstance, size_t _lod = 0);
 
 	protected:
 
-		// OpenGL Vertex Array Object
+		// OpenGL Vertex Array Object, for meshes with their own
 		std::shared_ptr<VertexArray> m_VAO;
+
+		// Space in a shared arena, for everything else
+		std::shared_ptr<GeometryAllocation> m_geometry;
+
+		// Model space bounds
+		glm::vec3 m_boundsMin;
+		glm::vec3 m_boundsMax;
+		float m_boundsRadius;
+
+		// Maps stored positions to model space
+		glm::mat4 m_positionDecode;
+
+		// Clusters of the index buffer, culled each draw
+		std::vector<Meshlet> m_meshlets;
+		size_t m_visibleMeshlets;
+
+		// Ranges of the index buffer, from the full mesh down
+		std::vector<MeshLOD> m_lods;
+
+		// Simplified surface for software occlusion culling
+		OccluderMesh m_occluder;
+
+		// Kept between draws to save reallocating them each frame
+		std::vector<MeshletRange> m_visibleRanges;
+		std::vector<GLsizei> m_drawCounts;
+		std::vector<const void*> m_drawOffsets;
+		std::vector<GLint> m_drawBaseVertices;
 	};
 }
 #endif // EPBR_MESH
@@ -0,0 +1,510 @@
+#include "MeshCache.h"
+#include "MappedFile.h"
+#include "GeometryArena.h"
+#include "VertexQuantisation.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace ePBR
+{
+	namespace
+	{
+		// Bump whenever the file layout or the output of the import pipeline changes, so stale caches are rebuilt
+		const uint32_t MESH_CACHE_VERSION = 8;
+
+		const char MESH_CACHE_MAGIC[8] = { 'E', 'P', 'B', 'R', 'M', 'E', 'S', 'H' };
+
+		// Vertices are stored interleaved, as uploaded, with the layout alongside
+		const int MESH_CACHE_MAX_ATTRIBUTES = 8;
+
+		// Stream data is aligned so that it can be read in place from the mapping
+		const uint64_t MESH_CACHE_ALIGNMENT = 16;
+
+		// The file is a header, one record per mesh, the material bindings as length prefixed strings and then the stream data.
+		// Everything is stored in the byte order of the machine that wrote it.
+		struct CacheHeader
+		{
+			char magic[8];
+			uint32_t version;
+			uint32_t meshCount;
+			uint32_t materialCount;
+			uint32_t reserved;
+			uint64_t key;
+		};
+
+		struct CacheStream
+		{
+			uint32_t components; // 0 when the mesh has no such stream
+			uint32_t type;
+			uint64_t offset;
+			uint64_t bytes;
+		};
+
+		struct CacheAttribute
+		{
+			uint32_t location;
+			uint32_t components;
+			uint32_t type;
+			uint32_t normalised;
+			uint32_t offset;
+		};
+
+		struct CacheMeshRecord
+		{
+			uint32_t vertexCount;
+			uint32_t indexCount;
+			uint32_t indexType;
+			uint32_t materialIndex;
+			float boundsMin[3];
+			float boundsMax[3];
+			float boundsRadius;
+			float positionOffset[3];
+			float positionScale;
+			uint32_t vertexStride;
+			uint32_t attributeCount;
+			CacheAttribute attributes[MESH_CACHE_MAX_ATTRIBUTES];
+			CacheStream vertices;
+			CacheStream indices;
+			CacheStream meshlets;
+			CacheStream lods;
+			CacheStream occluderPositions;
+			CacheStream occluderIndices;
+		};
+
+		uint64_t Align(uint64_t _offset)
+		{
+			return (_offset + MESH_CACHE_ALIGNMENT - 1) & ~(MESH_CACHE_ALIGNMENT - 1);
+		}
+
+		// Eight bytes at a time so that hashing keeps up with the disk
+		uint64_t HashBytes(const char* _data, size_t _size, uint64_t _hash)
+		{
+			const uint64_t multiplier = 0x9E3779B97F4A7C15ull;
+
+			size_t i = 0;
+			for (; i + 8 <= _size; i += 8)
+			{
+				uint64_t word;
+				memcpy(&word, _data + i, 8);
+				_hash = (_hash ^ (word * multiplier)) * multiplier;
+				_hash ^= _hash >> 29;
+			}
+
+			for (; i < _size; i++)
+			{
+				_hash = (_hash ^ (unsigned char)_data[i]) * multiplier;
+			}
+
+			return _hash ^ (_hash >> 32);
+		}
+
+		template <typename T>
+		CacheStream DescribeStream(const std::vector<T>& _stream, uint64_t& _offset)
+		{
+			CacheStream stream = { 0, 0, 0, 0 };
+			if (_stream.empty()) return stream;
+
+			stream.components = sizeof(T) / sizeof(float);
+			stream.type = GL_FLOAT;
+			stream.offset = _offset;
+			stream.bytes = _stream.size() * sizeof(T);
+
+			_offset = Align(_offset + stream.bytes);
+			return stream;
+		}
+
+		void WriteString(std::ofstream& _file, const std::string& _string)
+		{
+			uint32_t length = (uint32_t)_string.size();
+			_file.write((const char*)&length, sizeof(length));
+			_file.write(_string.data(), length);
+		}
+
+		bool ReadString(const char*& _cursor, const char* _end, std::string& _out)
+		{
+			uint32_t length;
+			if (_end - _cursor < (ptrdiff_t)sizeof(length)) return false;
+			memcpy(&length, _cursor, sizeof(length));
+			_cursor += sizeof(length);
+
+			if ((uint64_t)(_end - _cursor) < length) return false;
+			_out.assign(_cursor, length);
+			_cursor += length;
+			return true;
+		}
+
+		// The material libraries an OBJ names on its "mtllib" lines, which the importer reads alongside it. Relative to the OBJ.
+		std::vector<std::filesystem::path> GetMaterialLibraries(const std::string& _sourceFile, const char* _data, size_t _size)
+		{
+			std::vector<std::filesystem::path> libraries;
+			std::filesystem::path directory = std::filesystem::path(_sourceFile).parent_path();
+
+			const char* end = _data + _size;
+			for (const char* line = _data; line < end;)
+			{
+				const char* lineEnd = std::find(line, end, '\n');
+
+				const char* cursor = line;
+				while (cursor < lineEnd && (*cursor == ' ' || *cursor == '\t')) cursor++;
+				if (lineEnd - cursor > 6 && memcmp(cursor, "mtllib", 6) == 0 && (cursor[6] == ' ' || cursor[6] == '\t'))
+				{
+					// The rest of the line is the name, which may contain spaces
+					const char* nameBegin = cursor + 6;
+					const char* nameEnd = lineEnd;
+					while (nameBegin < nameEnd && std::isspace((unsigned char)*nameBegin)) nameBegin++;
+					while (nameEnd > nameBegin && std::isspace((unsigned char)nameEnd[-1])) nameEnd--;
+					if (nameBegin < nameEnd) libraries.push_back(directory / std::string(nameBegin, nameEnd));
+				}
+
+				line = lineEnd + 1;
+			}
+
+			return libraries;
+		}
+
+		bool InFile(const CacheStream& _stream, size_t _fileSize)
+		{
+			return _stream.offset % MESH_CACHE_ALIGNMENT == 0 && _stream.offset <= _fileSize && _stream.bytes <= _fileSize - _stream.offset;
+		}
+	}
+
+	std::string GetMeshCachePath(const std::string& _sourceFile)
+	{
+		return _sourceFile + ".epbrmesh";
+	}
+
+	uint64_t GetMeshCacheKey(const std::string& _sourceFile, const ImportOptions& _options)
+	{
+		MappedFile source;
+		if (!source.Open(_sourceFile)) return 0;
+
+		uint64_t key = HashBytes(source.GetData(), source.GetSize(), 0xCBF29CE484222325ull ^ MESH_CACHE_VERSION);
+
+		// Every option which changes the imported geometry must be part of the key
+		const char options[] = { (char)_options.optimiseMesh, (char)_options.quantiseVertices, (char)_options.buildMeshlets, (char)_options.generateLODs, (char)_options.buildOccluders };
+		key = HashBytes(options, sizeof(options), key);
+
+		// Materials can live in separate files, so editing one must invalidate the cache too. A missing library hashes as such.
+		for (const std::filesystem::path& library : GetMaterialLibraries(_sourceFile, source.GetData(), source.GetSize()))
+		{
+			std::string name = library.string();
+			key = HashBytes(name.data(), name.size(), key);
+
+			std::error_code error;
+			const uint64_t stamp[2] = { (uint64_t)std::filesystem::file_size(library, error), (uint64_t)std::filesystem::last_write_time(library, error).time_since_epoch().count() };
+			key = HashBytes((const char*)stamp, sizeof(stamp), key);
+		}
+
+		// 0 is reserved for failure
+		return key ? key : 1;
+	}
+
+	bool WriteMeshCache(const std::string& _cacheFile, uint64_t _key, const std::vector<MeshData>& _meshes, const std::vector<MaterialBinding>& _materials)
+	{
+		CacheHeader header;
+		memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+		header.version = MESH_CACHE_VERSION;
+		header.meshCount = (uint32_t)_meshes.size();
+		header.materialCount = (uint32_t)_materials.size();
+		header.reserved = 0;
+		header.key = _key;
+
+		// Lay the stream data out after the header, records and strings
+		uint64_t offset = sizeof(CacheHeader) + _meshes.size() * sizeof(CacheMeshRecord);
+		for (const MaterialBinding& material : _materials)
+		{
+			offset += 5 * sizeof(uint32_t) + material.albedo.size() + material.normal.size() + material.metalness.size()
+				+ material.roughness.size() + material.ambientOcclusion.size();
+		}
+		offset = Align(offset);
+
+		std::vector<CacheMeshRecord> records(_meshes.size());
+		std::vector<std::vector<uint16_t>> shortIndices(_meshes.size());
+		std::vector<PackedVertices> packedVertices(_meshes.size());
+
+		for (size_t m = 0; m < _meshes.size(); m++)
+		{
+			const MeshData& mesh = _meshes[m];
+			CacheMeshRecord& record = records[m];
+
+			record.vertexCount = (uint32_t)mesh.positions.size();
+			record.indexCount = (uint32_t)mesh.indices.size();
+			record.materialIndex = mesh.materialIndex;
+			memcpy(record.boundsMin, &mesh.boundsMin.x, sizeof(record.boundsMin));
+			memcpy(record.boundsMax, &mesh.boundsMax.x, sizeof(record.boundsMax));
+			record.boundsRadius = mesh.boundsRadius;
+
+			// Store the streams exactly as Mesh::SetMeshData would upload them
+			PackVertices(mesh, packedVertices[m]);
+			const PackedVertices& packed = packedVertices[m];
+			memcpy(record.positionOffset, &packed.position.offset.x, sizeof(record.positionOffset));
+			record.positionScale = packed.position.scale;
+
+			record.vertexStride = packed.layout.stride;
+			record.attributeCount = (uint32_t)std::min(packed.layout.attributes.size(), (size_t)MESH_CACHE_MAX_ATTRIBUTES);
+			memset(record.attributes, 0, sizeof(record.attributes));
+			for (uint32_t i = 0; i < record.attributeCount; i++)
+			{
+				const VertexAttribute& attribute = packed.layout.attributes[i];
+				record.attributes[i] = { attribute.location, (uint32_t)attribute.components, attribute.type, attribute.normalised, attribute.offset };
+			}
+
+			record.vertices = DescribeStream(packed.data, offset);
+			record.vertices.components = 0;
+			record.vertices.type = 0;
+
+			// Store indices in the width Mesh will upload them at
+			bool fitsShort = std::all_of(mesh.indices.begin(), mesh.indices.end(), [](unsigned int _index) { return _index <= 0xFFFF; });
+			if (fitsShort)
+			{
+				shortIndices[m].assign(mesh.indices.begin(), mesh.indices.end());
+				record.indices = DescribeStream(shortIndices[m], offset);
+				record.indexType = GL_UNSIGNED_SHORT;
+			}
+			else
+			{
+				record.indices = DescribeStream(mesh.indices, offset);
+				record.indexType = GL_UNSIGNED_INT;
+			}
+			record.indices.components = 1;
+			record.indices.type = record.indexType;
+
+			// Meshlets and levels of detail are plain structs, stored as they are in memory
+			record.meshlets = DescribeStream(mesh.meshlets, offset);
+			record.meshlets.components = 0;
+			record.meshlets.type = 0;
+			record.lods = DescribeStream(mesh.lods, offset);
+			record.lods.components = 0;
+			record.lods.type = 0;
+
+			// The occluder is kept as floats and full indices, as the rasteriser reads it
+			record.occluderPositions = DescribeStream(mesh.occluder.positions, offset);
+			record.occluderIndices = DescribeStream(mesh.occluder.indices, offset);
+			record.occluderIndices.type = GL_UNSIGNED_INT;
+		}
+
+		std::string temporaryFile = _cacheFile + ".tmp";
+		std::ofstream file(temporaryFile, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			std::cerr << "WARNING: Could not write mesh cache " << _cacheFile << std::endl;
+			return false;
+		}
+
+		file.write((const char*)&header, sizeof(header));
+		if (!records.empty()) file.write((const char*)records.data(), records.size() * sizeof(CacheMeshRecord));
+
+		for (const MaterialBinding& material : _materials)
+		{
+			WriteString(file, material.albedo);
+			WriteString(file, material.normal);
+			WriteString(file, material.metalness);
+			WriteString(file, material.roughness);
+			WriteString(file, material.ambientOcclusion);
+		}
+
+		auto writeStream = [&](const CacheStream& _stream, const void* _data)
+		{
+			if (_stream.bytes == 0) return;
+
+			// Pad up to the aligned offset
+			static const char padding[MESH_CACHE_ALIGNMENT] = {};
+			file.write(padding, _stream.offset - (uint64_t)file.tellp());
+			file.write((const char*)_data, _stream.bytes);
+		};
+
+		for (size_t m = 0; m < _meshes.size(); m++)
+		{
+			const MeshData& mesh = _meshes[m];
+			const CacheMeshRecord& record = records[m];
+
+			writeStream(record.vertices, packedVertices[m].data.data());
+			writeStream(record.indices, record.indexType == GL_UNSIGNED_SHORT ? (const void*)shortIndices[m].data() : (const void*)mesh.indices.data());
+			writeStream(record.meshlets, mesh.meshlets.data());
+			writeStream(record.lods, mesh.lods.data());
+			writeStream(record.occluderPositions, mesh.occluder.positions.data());
+			writeStream(record.occluderIndices, mesh.occluder.indices.data());
+		}
+
+		file.close();
+		if (file.fail())
+		{
+			std::cerr << "WARNING: Could not write mesh cache " << _cacheFile << std::endl;
+			std::filesystem::remove(temporaryFile);
+			return false;
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temporaryFile, _cacheFile, error);
+		if (error)
+		{
+			std::filesystem::remove(temporaryFile, error);
+			return false;
+		}
+
+		return true;
+	}
+
+	bool LoadMeshCache(const std::string& _cacheFile, uint64_t _key, std::vector<CachedMesh>& _meshes, std::vector<MaterialBinding>& _materials)
+	{
+		_meshes.clear();
+		_materials.clear();
+
+		MappedFile file;
+		if (!file.Open(_cacheFile)) return false;
+
+		const char* data = file.GetData();
+		const size_t size = file.GetSize();
+
+		CacheHeader header;
+		if (size < sizeof(header)) return false;
+		memcpy(&header, data, sizeof(header));
+
+		if (memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic)) != 0 || header.version != MESH_CACHE_VERSION || header.key != _key)
+		{
+			return false;
+		}
+
+		if ((size - sizeof(header)) / sizeof(CacheMeshRecord) < header.meshCount) return false;
+
+		std::vector<CacheMeshRecord> records(header.meshCount);
+		if (!records.empty()) memcpy(records.data(), data + sizeof(header), records.size() * sizeof(CacheMeshRecord));
+
+		const char* cursor = data + sizeof(header) + records.size() * sizeof(CacheMeshRecord);
+		std::vector<MaterialBinding> materials(header.materialCount);
+		for (MaterialBinding& material : materials)
+		{
+			if (!ReadString(cursor, data + size, material.albedo) || !ReadString(cursor, data + size, material.normal) ||
+				!ReadString(cursor, data + size, material.metalness) || !ReadString(cursor, data + size, material.roughness) ||
+				!ReadString(cursor, data + size, material.ambientOcclusion))
+			{
+				return false;
+			}
+		}
+
+		// Check everything before creating any GL objects
+		for (const CacheMeshRecord& record : records)
+		{
+			uint64_t indexSize = record.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+			if ((record.indexType != GL_UNSIGNED_SHORT && record.indexType != GL_UNSIGNED_INT) || !InFile(record.indices, size) ||
+				record.indices.bytes != record.indexCount * indexSize)
+			{
+				return false;
+			}
+
+			if (!InFile(record.vertices, size) || record.vertices.bytes != (uint64_t)record.vertexCount * record.vertexStride ||
+				record.attributeCount > MESH_CACHE_MAX_ATTRIBUTES)
+			{
+				return false;
+			}
+
+			// Indices are followed when drawing, so must stay within the mesh's own vertices
+			const char* indices = data + record.indices.offset;
+			for (uint64_t offset = 0; offset < record.indices.bytes; offset += indexSize)
+			{
+				uint32_t index;
+				if (record.indexType == GL_UNSIGNED_SHORT)
+				{
+					uint16_t shortIndex;
+					memcpy(&shortIndex, indices + offset, sizeof(shortIndex));
+					index = shortIndex;
+				}
+				else
+				{
+					memcpy(&index, indices + offset, sizeof(index));
+				}
+
+				if (index >= record.vertexCount) return false;
+			}
+
+			for (uint32_t i = 0; i < record.attributeCount; i++)
+			{
+				if (record.attributes[i].offset >= record.vertexStride) return false;
+			}
+
+			if (!InFile(record.meshlets, size) || record.meshlets.bytes % sizeof(Meshlet) != 0) return false;
+
+			// Every meshlet must lie within the index buffer, or drawing it would read past the end
+			const char* meshlets = data + record.meshlets.offset;
+			for (uint64_t offset = 0; offset < record.meshlets.bytes; offset += sizeof(Meshlet))
+			{
+				Meshlet meshlet;
+				memcpy(&meshlet, meshlets + offset, sizeof(meshlet));
+				if (meshlet.indexOffset > record.indexCount || meshlet.indexCount > record.indexCount - meshlet.indexOffset) return false;
+			}
+
+			if (!InFile(record.lods, size) || record.lods.bytes % sizeof(MeshLOD) != 0) return false;
+
+			const char* lods = data + record.lods.offset;
+			for (uint64_t offset = 0; offset < record.lods.bytes; offset += sizeof(MeshLOD))
+			{
+				MeshLOD lod;
+				memcpy(&lod, lods + offset, sizeof(lod));
+				if (lod.indexOffset > record.indexCount || lod.indexCount > record.indexCount - lod.indexOffset) return false;
+			}
+
+			if (!InFile(record.occluderPositions, size) || record.occluderPositions.bytes % sizeof(glm::vec3) != 0) return false;
+			if (!InFile(record.occluderIndices, size) || record.occluderIndices.bytes % (3 * sizeof(unsigned int)) != 0) return false;
+
+			// Occluder indices are followed when rasterising, so must stay within the positions
+			const char* occluderIndices = data + record.occluderIndices.offset;
+			uint64_t occluderVertexCount = record.occluderPositions.bytes / sizeof(glm::vec3);
+			for (uint64_t offset = 0; offset < record.occluderIndices.bytes; offset += sizeof(unsigned int))
+			{
+				unsigned int index;
+				memcpy(&index, occluderIndices + offset, sizeof(index));
+				if (index >= occluderVertexCount) return false;
+			}
+		}
+
+		std::vector<CachedMesh> meshes(records.size());
+		for (size_t m = 0; m < records.size(); m++)
+		{
+			const CacheMeshRecord& record = records[m];
+			CachedMesh& mesh = meshes[m];
+
+			mesh.boundsMin = glm::vec3(record.boundsMin[0], record.boundsMin[1], record.boundsMin[2]);
+			mesh.boundsMax = glm::vec3(record.boundsMax[0], record.boundsMax[1], record.boundsMax[2]);
+			mesh.boundsRadius = record.boundsRadius;
+			mesh.materialIndex = record.materialIndex;
+
+			PositionQuantisation quantisation;
+			quantisation.offset = glm::vec3(record.positionOffset[0], record.positionOffset[1], record.positionOffset[2]);
+			quantisation.scale = record.positionScale;
+			mesh.positionDecode = quantisation.GetDecode();
+
+			VertexLayout layout;
+			layout.stride = record.vertexStride;
+			for (uint32_t i = 0; i < record.attributeCount; i++)
+			{
+				const CacheAttribute& attribute = record.attributes[i];
+				layout.attributes.push_back({ attribute.location, (GLint)attribute.components, attribute.type, (GLboolean)attribute.normalised, attribute.offset });
+			}
+
+			// Stored in the arena's formats, so both streams upload as they are
+			std::shared_ptr<GeometryArena> arena = GeometryArena::GetShared(layout, record.indexType);
+			mesh.geometry = arena->Allocate(data + record.vertices.offset, record.vertexCount, data + record.indices.offset, record.indexCount);
+
+			mesh.meshlets.resize(record.meshlets.bytes / sizeof(Meshlet));
+			if (!mesh.meshlets.empty()) memcpy(mesh.meshlets.data(), data + record.meshlets.offset, record.meshlets.bytes);
+
+			mesh.lods.resize(record.lods.bytes / sizeof(MeshLOD));
+			if (!mesh.lods.empty()) memcpy(mesh.lods.data(), data + record.lods.offset, record.lods.bytes);
+
+			mesh.occluder.positions.resize(record.occluderPositions.bytes / sizeof(glm::vec3));
+			if (!mesh.occluder.positions.empty()) memcpy(mesh.occluder.positions.data(), data + record.occluderPositions.offset, record.occluderPositions.bytes);
+
+			mesh.occluder.indices.resize(record.occluderIndices.bytes / sizeof(unsigned int));
+			if (!mesh.occluder.indices.empty()) memcpy(mesh.occluder.indices.data(), data + record.occluderIndices.offset, record.occluderIndices.bytes);
+		}
+
+		_meshes.swap(meshes);
+		_materials.swap(materials);
+		return true;
+	}
+}
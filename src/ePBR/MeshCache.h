@@ -0,0 +1,63 @@
+#ifndef EPBR_MESH_CACHE
+#define EPBR_MESH_CACHE
+
+#include "ImportOptions.h"
+#include "MeshData.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace ePBR
+{
+	class GeometryAllocation;
+
+	/// @brief One mesh read back from a mesh cache, already uploaded to a GeometryArena.
+	struct CachedMesh
+	{
+		std::shared_ptr<GeometryAllocation> geometry;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		float boundsRadius;
+		glm::mat4 positionDecode; // Maps stored positions to model space
+		unsigned int materialIndex;
+		std::vector<Meshlet> meshlets;
+		std::vector<MeshLOD> lods;
+		OccluderMesh occluder;
+	};
+
+	/// @brief Get the path of the .epbrmesh cache file kept next to a source model.
+	/// @param _sourceFile The path to the OBJ or assimp readable model.
+	/// @return The cache file path.
+	std::string GetMeshCachePath(const std::string& _sourceFile);
+
+	/// @brief Hash a source model's contents together with the import options and cache format version.
+	/// @details A cache file is only used when it was written under the same key. The paths, sizes and modification times
+	/// of any material libraries an OBJ names are part of the key, so editing one rebuilds the cache.
+	/// @param _sourceFile The path to the source model.
+	/// @param _options The options the model is being imported with.
+	/// @return The key, or 0 if the source file could not be read.
+	uint64_t GetMeshCacheKey(const std::string& _sourceFile, const ImportOptions& _options);
+
+	/// @brief Write imported meshes and their material bindings to a cache file.
+	/// @details The file is written next to its final path and renamed into place, so a reader never sees half a file.
+	/// @param _cacheFile The path to write to.
+	/// @param _key The key from GetMeshCacheKey() for the source and options the meshes were imported with.
+	/// @param _meshes The meshes, as uploaded.
+	/// @param _materials The material bindings the meshes' material indices refer to.
+	/// @return Whether the file was written.
+	bool WriteMeshCache(const std::string& _cacheFile, uint64_t _key, const std::vector<MeshData>& _meshes, const std::vector<MaterialBinding>& _materials);
+
+	/// @brief Memory map a cache file and copy its streams straight into the shared geometry arenas.
+	/// @param _cacheFile The path to the cache file.
+	/// @param _key The key the file must have been written under.
+	/// @param _meshes Receives the meshes. Existing contents are replaced.
+	/// @param _materials Receives the material bindings. Existing contents are replaced.
+	/// @return Whether the file existed, matched the key and was intact, with every index within its mesh's vertices.
+	bool LoadMeshCache(const std::string& _cacheFile, uint64_t _key, std::vector<CachedMesh>& _meshes, std::vector<MaterialBinding>& _materials);
+}
+
+#endif // EPBR_MESH_CACHE
@@ -0,0 +1,34 @@
+#include "MeshData.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ePBR
+{
+	void MeshData::ComputeBounds()
+	{
+		if (positions.empty())
+		{
+			boundsMin = boundsMax = glm::vec3(0.0f);
+			boundsRadius = 0.0f;
+			return;
+		}
+
+		boundsMin = boundsMax = positions[0];
+		for (const glm::vec3& position : positions)
+		{
+			boundsMin = glm::min(boundsMin, position);
+			boundsMax = glm::max(boundsMax, position);
+		}
+
+		// Tighter than half the diagonal for anything rounder than a box
+		glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+		float radiusSquared = 0.0f;
+		for (const glm::vec3& position : positions)
+		{
+			glm::vec3 offset = position - center;
+			radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+		}
+		boundsRadius = std::sqrt(radiusSquared);
+	}
+}
@@ -0,0 +1,98 @@
+#ifndef EPBR_MESH_DATA
+#define EPBR_MESH_DATA
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace ePBR
+{
+	/// @brief A small cluster of a mesh's triangles, stored as one contiguous range of its index buffer, with bounds for culling it as a whole.
+	struct Meshlet
+	{
+		unsigned int indexOffset;
+		unsigned int indexCount;
+
+		/// @brief Bounding sphere, in model space.
+		glm::vec3 center;
+		float radius;
+
+		/// @brief Every triangle normal lies within the cone around this axis.
+		glm::vec3 coneAxis;
+		/// @brief The sine of the cone's half angle. 1 when the cone is too wide to ever face away from the camera.
+		float coneCutoff;
+	};
+
+	/// @brief One level of detail of a mesh, as a range of its index buffer over the shared vertices.
+	struct MeshLOD
+	{
+		unsigned int indexOffset;
+		unsigned int indexCount;
+
+		/// @brief How far the simplified surface may stray from the full mesh, in model space units. 0 for the full mesh.
+		float error;
+	};
+
+	/// @brief A simplified copy of a mesh's surface, kept on the CPU for an OcclusionCuller to rasterise.
+	struct OccluderMesh
+	{
+		/// @brief Model space positions. Never quantised.
+		std::vector<glm::vec3> positions;
+
+		/// @brief Three indices per triangle.
+		std::vector<unsigned int> indices;
+	};
+
+	/// @brief CPU side geometry of one mesh, in the form it is uploaded to the GPU.
+	/// @details Every non-empty attribute stream holds one element per vertex. Empty streams are not uploaded.
+	struct MeshData
+	{
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec3> normals;
+		std::vector<glm::vec2> uvs;
+		/// @brief Unit tangent in xyz, bitangent sign in w. The bitangent is w * cross(normal, tangent.xyz).
+		std::vector<glm::vec4> tangents;
+
+		/// @brief Three indices per triangle. With levels of detail, the full mesh's triangles come first.
+		std::vector<unsigned int> indices;
+
+		/// @brief Clusters covering every triangle of the full mesh, in index buffer order. Empty unless built by BuildMeshlets().
+		std::vector<Meshlet> meshlets;
+
+		/// @brief Levels of detail from the full mesh down, each coarser than the last. Empty unless built by GenerateLODs().
+		/// @details The first level is the full mesh. The others' indices are appended after it, so the index buffer holds every level.
+		std::vector<MeshLOD> lods;
+
+		/// @brief The surface this mesh hides other meshes behind. Empty unless built by BuildOccluder().
+		OccluderMesh occluder;
+
+		/// @brief Axis aligned bounds of the positions. Set by ComputeBounds().
+		glm::vec3 boundsMin = glm::vec3(0.0f);
+		glm::vec3 boundsMax = glm::vec3(0.0f);
+
+		/// @brief Distance from the centre of the axis aligned bounds to the furthest position, so the radius of a bounding sphere about that centre. Set by ComputeBounds().
+		float boundsRadius = 0.0f;
+
+		/// @brief Upload the attribute streams in the packed formats of PackVertices() rather than as floats.
+		bool quantise = false;
+
+		/// @brief Index of the MaterialBinding this mesh is drawn with, within the file it came from.
+		unsigned int materialIndex = 0;
+
+		/// @brief Set the bounds and bounding sphere to enclose every position.
+		void ComputeBounds();
+	};
+
+	/// @brief The textures a material read from a model file uses. Paths are relative to the model's directory and empty where unused.
+	struct MaterialBinding
+	{
+		std::string albedo;
+		std::string normal;
+		std::string metalness;
+		std::string roughness;
+		std::string ambientOcclusion;
+	};
+}
+
+#endif // EPBR_MESH_DATA
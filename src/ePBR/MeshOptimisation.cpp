@@ -0,0 +1,456 @@
+#include "MeshOptimisation.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+
+namespace ePBR
+{
+	namespace
+	{
+		// Entries in the modelled post-transform cache. Tipsify optimises for this size too.
+		const unsigned int VERTEX_CACHE_SIZE = 16;
+
+		// Modelled vertex fetch cache: direct mapped, 64 byte lines, 128KB
+		const size_t FETCH_LINE_BYTES = 64;
+		const size_t FETCH_CACHE_LINES = 2048;
+
+		// Resolution of the software rasteriser used to measure overdraw
+		const int OVERDRAW_GRID = 256;
+
+		/// FIFO post-transform cache, modelled with one timestamp per vertex.
+		/// A vertex is resident while fewer than VERTEX_CACHE_SIZE misses have happened since it was loaded.
+		struct VertexCache
+		{
+			std::vector<unsigned int> timestamps;
+			unsigned int time;
+
+			VertexCache(size_t _vertexCount) : timestamps(_vertexCount, 0), time(VERTEX_CACHE_SIZE + 1) {}
+
+			// Returns whether the vertex had to be transformed
+			bool Access(unsigned int _vertex)
+			{
+				if (time - timestamps[_vertex] > VERTEX_CACHE_SIZE)
+				{
+					timestamps[_vertex] = time++;
+					return true;
+				}
+				return false;
+			}
+
+			void Flush()
+			{
+				time += VERTEX_CACHE_SIZE + 1;
+			}
+		};
+
+		size_t GetVertexCount(const std::vector<unsigned int>& _indices)
+		{
+			unsigned int maxIndex = 0;
+			for (unsigned int index : _indices) maxIndex = std::max(maxIndex, index);
+			return _indices.empty() ? 0 : (size_t)maxIndex + 1;
+		}
+
+		glm::vec3 GetTriangleNormal(const std::vector<unsigned int>& _indices, const std::vector<glm::vec3>& _positions, size_t _triangle)
+		{
+			const glm::vec3& a = _positions[_indices[_triangle * 3]];
+			const glm::vec3& b = _positions[_indices[_triangle * 3 + 1]];
+			const glm::vec3& c = _positions[_indices[_triangle * 3 + 2]];
+
+			// Twice the area in length
+			return glm::cross(b - a, c - a);
+		}
+
+		/// Rasterise the mesh orthographically along one axis with early depth testing, counting shaded fragments and covered pixels.
+		void RasteriseView(const std::vector<unsigned int>& _indices, const std::vector<glm::vec3>& _positions, const glm::vec3& _min, const glm::vec3& _max,
+			int _axis, bool _negative, size_t& _shaded, size_t& _covered)
+		{
+			// Screen x, screen y and depth axes, chosen so counter clockwise triangles face the viewer
+			int xAxis = (_axis + 1) % 3;
+			int yAxis = (_axis + 2) % 3;
+			if (_negative) std::swap(xAxis, yAxis);
+
+			const float depthSign = _negative ? 1.0f : -1.0f;
+			const float xScale = OVERDRAW_GRID / std::max(_max[xAxis] - _min[xAxis], std::numeric_limits<float>::min());
+			const float yScale = OVERDRAW_GRID / std::max(_max[yAxis] - _min[yAxis], std::numeric_limits<float>::min());
+
+			std::vector<float> depthBuffer(OVERDRAW_GRID * OVERDRAW_GRID, std::numeric_limits<float>::infinity());
+
+			for (size_t i = 0; i + 2 < _indices.size(); i += 3)
+			{
+				glm::vec3 screen[3];
+				for (int corner = 0; corner < 3; corner++)
+				{
+					const glm::vec3& position = _positions[_indices[i + corner]];
+					screen[corner] = glm::vec3((position[xAxis] - _min[xAxis]) * xScale, (position[yAxis] - _min[yAxis]) * yScale, position[_axis] * depthSign);
+				}
+
+				float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[2].x - screen[0].x) * (screen[1].y - screen[0].y);
+
+				// Back facing or degenerate
+				if (area <= 0.0f) continue;
+
+				int minX = std::max((int)std::min({ screen[0].x, screen[1].x, screen[2].x }), 0);
+				int maxX = std::min((int)std::max({ screen[0].x, screen[1].x, screen[2].x }), OVERDRAW_GRID - 1);
+				int minY = std::max((int)std::min({ screen[0].y, screen[1].y, screen[2].y }), 0);
+				int maxY = std::min((int)std::max({ screen[0].y, screen[1].y, screen[2].y }), OVERDRAW_GRID - 1);
+
+				for (int y = minY; y <= maxY; y++)
+				{
+					for (int x = minX; x <= maxX; x++)
+					{
+						glm::vec2 p(x + 0.5f, y + 0.5f);
+
+						// Edge functions give the barycentric weights of the pixel centre
+						float w0 = (screen[2].x - screen[1].x) * (p.y - screen[1].y) - (screen[2].y - screen[1].y) * (p.x - screen[1].x);
+						float w1 = (screen[0].x - screen[2].x) * (p.y - screen[2].y) - (screen[0].y - screen[2].y) * (p.x - screen[2].x);
+						float w2 = area - w0 - w1;
+						if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) continue;
+
+						float depth = (w0 * screen[0].z + w1 * screen[1].z + w2 * screen[2].z) / area;
+						float& stored = depthBuffer[y * OVERDRAW_GRID + x];
+
+						if (depth < stored)
+						{
+							if (stored == std::numeric_limits<float>::infinity()) _covered++;
+							stored = depth;
+							_shaded++;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	MeshStatistics AnalyseMesh(const std::vector<unsigned int>& _indices, const std::vector<glm::vec3>& _positions, size_t _vertexStride)
+	{
+		MeshStatistics stats = { 0.0f, 0.0f, 0.0f, 0.0f };
+		const size_t numTriangles = _indices.size() / 3;
+		if (numTriangles == 0) return stats;
+
+		const size_t numVertices = std::max(GetVertexCount(_indices), _positions.size());
+
+		VertexCache cache(numVertices);
+		std::vector<bool> used(numVertices, false);
+		std::vector<size_t> fetchLines(FETCH_CACHE_LINES, std::numeric_limits<size_t>::max());
+
+		size_t transforms = 0;
+		size_t usedVertices = 0;
+		size_t fetchedBytes = 0;
+
+		for (size_t i = 0; i < numTriangles * 3; i++)
+		{
+			unsigned int vertex = _indices[i];
+
+			if (!used[vertex])
+			{
+				used[vertex] = true;
+				usedVertices++;
+			}
+
+			if (!cache.Access(vertex)) continue;
+			transforms++;
+
+			// Only transformed vertices are fetched
+			size_t firstLine = vertex * _vertexStride / FETCH_LINE_BYTES;
+			size_t lastLine = ((vertex + 1) * _vertexStride - 1) / FETCH_LINE_BYTES;
+			for (size_t line = firstLine; line <= lastLine; line++)
+			{
+				size_t& slot = fetchLines[line % FETCH_CACHE_LINES];
+				if (slot != line)
+				{
+					slot = line;
+					fetchedBytes += FETCH_LINE_BYTES;
+				}
+			}
+		}
+
+		stats.acmr = (float)transforms / numTriangles;
+		stats.atvr = (float)transforms / usedVertices;
+		stats.fetchEfficiency = fetchedBytes ? (float)(usedVertices * _vertexStride) / fetchedBytes : 1.0f;
+
+		// Overdraw is averaged over views along both directions of each axis
+		glm::vec3 min(std::numeric_limits<float>::max());
+		glm::vec3 max(-std::numeric_limits<float>::max());
+		for (unsigned int index : _indices)
+		{
+			min = glm::min(min, _positions[index]);
+			max = glm::max(max, _positions[index]);
+		}
+
+		size_t shaded = 0;
+		size_t covered = 0;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			RasteriseView(_indices, _positions, min, max, axis, false, shaded, covered);
+			RasteriseView(_indices, _positions, min, max, axis, true, shaded, covered);
+		}
+		stats.overdraw = covered ? (float)shaded / covered : 1.0f;
+
+		return stats;
+	}
+
+	void OptimiseVertexCache(std::vector<unsigned int>& _indices, size_t _vertexCount, std::vector<size_t>* _clusters)
+	{
+		const size_t numTriangles = _indices.size() / 3;
+		if (_clusters) _clusters->clear();
+		if (numTriangles == 0) return;
+
+		// Triangles using each vertex, stored contiguously per vertex
+		std::vector<unsigned int> liveTriangles(_vertexCount, 0);
+		for (size_t i = 0; i < numTriangles * 3; i++) liveTriangles[_indices[i]]++;
+
+		std::vector<size_t> adjacencyOffsets(_vertexCount + 1, 0);
+		for (size_t v = 0; v < _vertexCount; v++) adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+
+		std::vector<unsigned int> adjacency(adjacencyOffsets[_vertexCount]);
+		{
+			std::vector<size_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < numTriangles * 3; i++) adjacency[fill[_indices[i]]++] = (unsigned int)(i / 3);
+		}
+
+		std::vector<unsigned int> output;
+		output.reserve(numTriangles * 3);
+
+		VertexCache cache(_vertexCount);
+		std::vector<bool> emitted(numTriangles, false);
+		std::vector<unsigned int> deadEnds;
+		std::vector<unsigned int> candidates;
+		size_t cursor = 0;
+
+		auto skipDeadEnd = [&]() -> long long
+		{
+			// Most recently used vertices first, as they may still be cached
+			while (!deadEnds.empty())
+			{
+				unsigned int vertex = deadEnds.back();
+				deadEnds.pop_back();
+				if (liveTriangles[vertex] > 0) return vertex;
+			}
+
+			// Otherwise the next vertex in input order with triangles left
+			for (; cursor < _vertexCount; cursor++)
+			{
+				if (liveTriangles[cursor] > 0) return (long long)cursor;
+			}
+
+			return -1;
+		};
+
+		long long fanVertex = skipDeadEnd();
+
+		while (fanVertex >= 0)
+		{
+			// A fan around a vertex which has dropped out of the cache starts with a cold cache
+			if (_clusters && cache.time - cache.timestamps[fanVertex] > VERTEX_CACHE_SIZE)
+			{
+				_clusters->push_back(output.size());
+			}
+
+			candidates.clear();
+
+			for (size_t a = adjacencyOffsets[fanVertex]; a < adjacencyOffsets[fanVertex + 1]; a++)
+			{
+				unsigned int triangle = adjacency[a];
+				if (emitted[triangle]) continue;
+
+				for (int corner = 0; corner < 3; corner++)
+				{
+					unsigned int vertex = _indices[triangle * 3 + corner];
+					output.push_back(vertex);
+					deadEnds.push_back(vertex);
+					candidates.push_back(vertex);
+					liveTriangles[vertex]--;
+					cache.Access(vertex);
+				}
+
+				emitted[triangle] = true;
+			}
+
+			// Prefer the candidate which will still be cached after its remaining triangles are emitted, and has been cached longest
+			long long best = -1;
+			long long bestPriority = -1;
+			for (unsigned int vertex : candidates)
+			{
+				if (liveTriangles[vertex] == 0) continue;
+
+				long long age = cache.time - cache.timestamps[vertex];
+				long long priority = 0;
+				if (age + 2 * (long long)liveTriangles[vertex] <= VERTEX_CACHE_SIZE) priority = age;
+
+				if (priority > bestPriority)
+				{
+					bestPriority = priority;
+					best = vertex;
+				}
+			}
+
+			fanVertex = best >= 0 ? best : skipDeadEnd();
+		}
+
+		_indices.swap(output);
+	}
+
+	void OptimiseOverdraw(std::vector<unsigned int>& _indices, const std::vector<glm::vec3>& _positions, const std::vector<size_t>& _clusters, float _threshold)
+	{
+		const size_t numTriangles = _indices.size() / 3;
+		if (numTriangles == 0 || _clusters.empty()) return;
+
+		// Split the clusters wherever flushing the cache costs little, so that the sort has more freedom
+		std::vector<size_t> clusterStarts;
+		VertexCache cache(std::max(GetVertexCount(_indices), _positions.size()));
+
+		for (size_t c = 0; c < _clusters.size(); c++)
+		{
+			size_t begin = _clusters[c];
+			size_t end = c + 1 < _clusters.size() ? _clusters[c + 1] : numTriangles * 3;
+
+			cache.Flush();
+			size_t clusterMisses = 0;
+			for (size_t i = begin; i < end; i++) clusterMisses += cache.Access(_indices[i]);
+
+			const float targetACMR = _threshold * clusterMisses / ((end - begin) / 3);
+
+			cache.Flush();
+			size_t start = begin;
+			size_t misses = 0;
+			clusterStarts.push_back(begin);
+
+			for (size_t i = begin; i < end; i += 3)
+			{
+				misses += cache.Access(_indices[i]) + cache.Access(_indices[i + 1]) + cache.Access(_indices[i + 2]);
+
+				size_t triangles = (i + 3 - start) / 3;
+				if (i + 3 < end && (float)misses / triangles <= targetACMR)
+				{
+					clusterStarts.push_back(i + 3);
+					start = i + 3;
+					misses = 0;
+					cache.Flush();
+				}
+			}
+		}
+
+		// Area weighted centroids and normals
+		const size_t numClusters = clusterStarts.size();
+		std::vector<glm::vec3> centroids(numClusters, glm::vec3(0.0f));
+		std::vector<glm::vec3> normals(numClusters, glm::vec3(0.0f));
+		glm::vec3 meshCentroid(0.0f);
+		float meshArea = 0.0f;
+
+		for (size_t c = 0; c < numClusters; c++)
+		{
+			size_t end = c + 1 < numClusters ? clusterStarts[c + 1] : numTriangles * 3;
+			float clusterArea = 0.0f;
+
+			for (size_t i = clusterStarts[c]; i < end; i += 3)
+			{
+				glm::vec3 normal = GetTriangleNormal(_indices, _positions, i / 3);
+				float area = glm::length(normal);
+				glm::vec3 centre = (_positions[_indices[i]] + _positions[_indices[i + 1]] + _positions[_indices[i + 2]]) / 3.0f;
+
+				centroids[c] += centre * area;
+				normals[c] += normal;
+				clusterArea += area;
+			}
+
+			meshCentroid += centroids[c];
+			meshArea += clusterArea;
+			if (clusterArea > 0.0f) centroids[c] /= clusterArea;
+		}
+
+		if (meshArea > 0.0f) meshCentroid /= meshArea;
+
+		// Clusters facing away from the middle of the mesh are likely to occlude the rest, so draw them first
+		std::vector<float> sortKeys(numClusters);
+		std::vector<size_t> order(numClusters);
+		for (size_t c = 0; c < numClusters; c++)
+		{
+			float normalLength = glm::length(normals[c]);
+			sortKeys[c] = normalLength > 0.0f ? glm::dot(centroids[c] - meshCentroid, normals[c] / normalLength) : 0.0f;
+			order[c] = c;
+		}
+
+		std::stable_sort(order.begin(), order.end(), [&](size_t _a, size_t _b) { return sortKeys[_a] > sortKeys[_b]; });
+
+		std::vector<unsigned int> output;
+		output.reserve(_indices.size());
+		for (size_t c : order)
+		{
+			size_t end = c + 1 < numClusters ? clusterStarts[c + 1] : numTriangles * 3;
+			output.insert(output.end(), _indices.begin() + clusterStarts[c], _indices.begin() + end);
+		}
+
+		_indices.swap(output);
+	}
+
+	void OptimiseVertexFetch(std::vector<unsigned int>& _indices, std::vector<glm::vec3>& _positions, std::vector<glm::vec3>& _normals, std::vector<glm::vec2>& _uvs)
+	{
+		const size_t numVertices = _positions.size();
+		const unsigned int unassigned = std::numeric_limits<unsigned int>::max();
+
+		// New index of each vertex, in order of first use
+		std::vector<unsigned int> remap(numVertices, unassigned);
+		unsigned int next = 0;
+
+		for (unsigned int& index : _indices)
+		{
+			if (remap[index] == unassigned) remap[index] = next++;
+			index = remap[index];
+		}
+
+		for (unsigned int& newIndex : remap)
+		{
+			if (newIndex == unassigned) newIndex = next++;
+		}
+
+		auto reorder = [&](auto& _stream)
+		{
+			if (_stream.empty()) return;
+
+			std::remove_reference_t<decltype(_stream)> reordered(_stream.size());
+			for (size_t v = 0; v < numVertices; v++) reordered[remap[v]] = _stream[v];
+			_stream.swap(reordered);
+		};
+
+		reorder(_positions);
+		reorder(_normals);
+		reorder(_uvs);
+	}
+
+	void OptimiseMesh(std::vector<unsigned int>& _indices, std::vector<glm::vec3>& _positions, std::vector<glm::vec3>& _normals, std::vector<glm::vec2>& _uvs)
+	{
+		std::vector<size_t> clusters;
+		OptimiseVertexCache(_indices, _positions.size(), &clusters);
+		OptimiseOverdraw(_indices, _positions, clusters);
+		OptimiseVertexFetch(_indices, _positions, _normals, _uvs);
+	}
+
+	void OptimiseAndReport(std::vector<unsigned int>& _indices, std::vector<glm::vec3>& _positions, std::vector<glm::vec3>& _normals, std::vector<glm::vec2>& _uvs)
+	{
+		size_t stride = sizeof(glm::vec3);
+		if (!_normals.empty()) stride += sizeof(glm::vec3);
+		if (!_uvs.empty()) stride += sizeof(glm::vec2);
+
+		MeshStatistics before = AnalyseMesh(_indices, _positions, stride);
+		OptimiseMesh(_indices, _positions, _normals, _uvs);
+		MeshStatistics after = AnalyseMesh(_indices, _positions, stride);
+
+		PrintMeshStatistics(std::cout, before, after);
+	}
+
+	void PrintMeshStatistics(std::ostream& _stream, const MeshStatistics& _before, const MeshStatistics& _after)
+	{
+		char line[128];
+
+		snprintf(line, sizeof(line), "  ACMR              %6.3f -> %6.3f\n", _before.acmr, _after.acmr);
+		_stream << line;
+		snprintf(line, sizeof(line), "  ATVR              %6.3f -> %6.3f\n", _before.atvr, _after.atvr);
+		_stream << line;
+		snprintf(line, sizeof(line), "  Overdraw          %6.3f -> %6.3f\n", _before.overdraw, _after.overdraw);
+		_stream << line;
+		snprintf(line, sizeof(line), "  Fetch efficiency  %6.3f -> %6.3f\n", _before.fetchEfficiency, _after.fetchEfficiency);
+		_stream << line;
+	}
+}
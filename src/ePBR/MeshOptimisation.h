@@ -0,0 +1,75 @@
+#ifndef EPBR_MESH_OPTIMISATION
+#define EPBR_MESH_OPTIMISATION
+
+#include <ostream>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace ePBR
+{
+	/// @brief Measures of how efficiently a GPU will process an indexed triangle list.
+	struct MeshStatistics
+	{
+		/// @brief Average cache miss ratio. Vertex shader invocations per triangle, 0.5 at best and 3 at worst.
+		float acmr;
+		/// @brief Average transform to vertex ratio. Vertex shader invocations per vertex, 1 at best.
+		float atvr;
+		/// @brief Fragments shaded per covered pixel, averaged over views along the six axes. 1 at best.
+		float overdraw;
+		/// @brief Vertex bytes the mesh holds over bytes pulled through the vertex fetch cache. 1 at best.
+		float fetchEfficiency;
+	};
+
+	/// @brief Measure how a mesh will perform with a FIFO post-transform cache, a small vertex fetch cache and early depth testing.
+	/// @param _indices Three indices per triangle.
+	/// @param _positions The vertex positions.
+	/// @param _vertexStride The total size in bytes of one vertex across all of its attribute buffers.
+	/// @return The statistics.
+	MeshStatistics AnalyseMesh(const std::vector<unsigned int>& _indices, const std::vector<glm::vec3>& _positions, size_t _vertexStride);
+
+	/// @brief Reorder triangles so that vertices are reused while they are still in the post-transform cache. (Tipsify, Sander et al. 2007)
+	/// @param _indices Three indices per triangle, reordered in place.
+	/// @param _vertexCount The number of vertices the indices refer to.
+	/// @param _clusters Optional. Receives the first index of each run of triangles which starts with a cold cache.
+	void OptimiseVertexCache(std::vector<unsigned int>& _indices, size_t _vertexCount, std::vector<size_t>* _clusters = nullptr);
+
+	/// @brief Reorder clusters of triangles so that outward facing clusters are drawn first, reducing overdraw from any viewpoint.
+	/// @details Clusters are split further where that costs less than _threshold times their vertex cache efficiency.
+	/// @param _indices Three indices per triangle, as output by OptimiseVertexCache. Reordered in place.
+	/// @param _positions The vertex positions.
+	/// @param _clusters The cluster starts output by OptimiseVertexCache.
+	/// @param _threshold How much worse the ACMR of a cluster may get in exchange for finer sorting.
+	void OptimiseOverdraw(std::vector<unsigned int>& _indices, const std::vector<glm::vec3>& _positions, const std::vector<size_t>& _clusters, float _threshold = 1.05f);
+
+	/// @brief Reorder vertices into the order the indices first use them, so that fetches walk linearly through the vertex buffers.
+	/// @details Vertices no triangle uses are moved to the end.
+	/// @param _indices Three indices per triangle. Rewritten to refer to the new vertex order.
+	/// @param _positions The vertex positions, reordered in place.
+	/// @param _normals The vertex normals, or empty. Reordered in place.
+	/// @param _uvs The vertex texture coordinates, or empty. Reordered in place.
+	void OptimiseVertexFetch(std::vector<unsigned int>& _indices, std::vector<glm::vec3>& _positions, std::vector<glm::vec3>& _normals, std::vector<glm::vec2>& _uvs);
+
+	/// @brief Run the vertex cache, overdraw and vertex fetch optimisations in turn.
+	/// @param _indices Three indices per triangle. Reordered in place.
+	/// @param _positions The vertex positions. Reordered in place.
+	/// @param _normals The vertex normals, or empty. Reordered in place.
+	/// @param _uvs The vertex texture coordinates, or empty. Reordered in place.
+	void OptimiseMesh(std::vector<unsigned int>& _indices, std::vector<glm::vec3>& _positions, std::vector<glm::vec3>& _normals, std::vector<glm::vec2>& _uvs);
+
+	/// @brief Run OptimiseMesh and print the mesh's statistics before and after to std::cout.
+	/// @details The modelled vertex stride covers the streams given.
+	/// @param _indices Three indices per triangle. Reordered in place.
+	/// @param _positions The vertex positions. Reordered in place.
+	/// @param _normals The vertex normals, or empty. Reordered in place.
+	/// @param _uvs The vertex texture coordinates, or empty. Reordered in place.
+	void OptimiseAndReport(std::vector<unsigned int>& _indices, std::vector<glm::vec3>& _positions, std::vector<glm::vec3>& _normals, std::vector<glm::vec2>& _uvs);
+
+	/// @brief Print statistics taken before and after optimising a mesh.
+	/// @param _stream The stream to print to.
+	/// @param _before The statistics of the original mesh.
+	/// @param _after The statistics of the optimised mesh.
+	void PrintMeshStatistics(std::ostream& _stream, const MeshStatistics& _before, const MeshStatistics& _after);
+}
+
+#endif // EPBR_MESH_OPTIMISATION
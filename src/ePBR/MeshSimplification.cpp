@@ -0,0 +1,427 @@
+#include "MeshSimplification.h"
+#include "MeshOptimisation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+namespace ePBR
+{
+	namespace
+	{
+		// A level is only kept when it has at most this fraction of the previous level's triangles
+		const float MIN_LOD_REDUCTION = 0.85f;
+
+		// Levels are not made for meshes smaller than this, where the draw call costs more than the triangles
+		const size_t MIN_LOD_TRIANGLES = 64;
+
+		// Collapses whose triangles would turn by more than this (as the cosine) count as flips
+		const double MAX_NORMAL_TURN = 0.2;
+
+		/// Sum of squared distances to a set of planes, weighted by the area of the triangles they came from.
+		/// Stored as the upper triangle of the symmetric 4x4 matrix.
+		struct Quadric
+		{
+			double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+			double a11 = 0, a12 = 0, a13 = 0;
+			double a22 = 0, a23 = 0;
+			double a33 = 0;
+			double weight = 0;
+
+			void AddPlane(const glm::dvec3& _normal, double _distance, double _weight)
+			{
+				a00 += _weight * _normal.x * _normal.x; a01 += _weight * _normal.x * _normal.y; a02 += _weight * _normal.x * _normal.z; a03 += _weight * _normal.x * _distance;
+				a11 += _weight * _normal.y * _normal.y; a12 += _weight * _normal.y * _normal.z; a13 += _weight * _normal.y * _distance;
+				a22 += _weight * _normal.z * _normal.z; a23 += _weight * _normal.z * _distance;
+				a33 += _weight * _distance * _distance;
+				weight += _weight;
+			}
+
+			Quadric& operator+=(const Quadric& _other)
+			{
+				a00 += _other.a00; a01 += _other.a01; a02 += _other.a02; a03 += _other.a03;
+				a11 += _other.a11; a12 += _other.a12; a13 += _other.a13;
+				a22 += _other.a22; a23 += _other.a23;
+				a33 += _other.a33;
+				weight += _other.weight;
+				return *this;
+			}
+
+			double Evaluate(const glm::vec3& _point) const
+			{
+				double x = _point.x, y = _point.y, z = _point.z;
+				double error = a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x
+					+ a11 * y * y + 2 * a12 * y * z + 2 * a13 * y
+					+ a22 * z * z + 2 * a23 * z
+					+ a33;
+				return std::max(error, 0.0);
+			}
+		};
+
+		const unsigned int NO_VERTEX = 0xFFFFFFFFu;
+
+		enum class VertexKind
+		{
+			Free,	// Inside a smooth, continuous patch. Can collapse onto any neighbour.
+			Seam,	// One of two copies in the middle of a seam line. Collapses along the seam with its twin.
+			Locked	// On a border, at a seam corner or junction. Never moves.
+		};
+
+		struct Collapse
+		{
+			unsigned int from;
+			unsigned int to;
+			double cost;
+		};
+
+		glm::dvec3 Cross(const glm::vec3& _a, const glm::vec3& _b, const glm::vec3& _c)
+		{
+			return glm::cross(glm::dvec3(_b - _a), glm::dvec3(_c - _a));
+		}
+
+		uint64_t EdgeKey(unsigned int _a, unsigned int _b)
+		{
+			return ((uint64_t)std::min(_a, _b) << 32) | std::max(_a, _b);
+		}
+
+		// Number vertices by position, so that the copies of a vertex split along a seam share a number
+		std::vector<unsigned int> GroupByPosition(const std::vector<glm::vec3>& _positions, size_t& _groupCount)
+		{
+			struct PositionHash
+			{
+				size_t operator()(const glm::vec3& _position) const
+				{
+					// Adding zero turns -0 into 0, which compares equal to it
+					glm::vec3 position = _position + 0.0f;
+					uint32_t bits[3];
+					memcpy(bits, &position.x, sizeof(bits));
+					return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+				}
+			};
+
+			std::unordered_map<glm::vec3, unsigned int, PositionHash> groups;
+			groups.reserve(_positions.size());
+
+			std::vector<unsigned int> group(_positions.size());
+			for (size_t v = 0; v < _positions.size(); v++)
+			{
+				group[v] = groups.emplace(_positions[v], (unsigned int)groups.size()).first->second;
+			}
+
+			_groupCount = groups.size();
+			return group;
+		}
+	}
+
+	float SimplifyMesh(const std::vector<unsigned int>& _indices, const std::vector<glm::vec3>& _positions, size_t _targetIndexCount, std::vector<unsigned int>& _out)
+	{
+		_out = _indices;
+		if (_out.size() <= _targetIndexCount) return 0.0f;
+
+		const size_t vertexCount = _positions.size();
+
+		size_t groupCount;
+		std::vector<unsigned int> group = GroupByPosition(_positions, groupCount);
+
+		std::vector<unsigned int> groupSize(groupCount, 0);
+		for (unsigned int g : group) groupSize[g]++;
+
+		// Count the triangles on each edge, both between positions and between vertices.
+		// Seams show up as edges with one triangle between vertices but two between positions.
+		std::unordered_map<uint64_t, unsigned int> groupEdgeUses;
+		std::unordered_map<uint64_t, unsigned int> vertexEdgeUses;
+		groupEdgeUses.reserve(_out.size());
+		vertexEdgeUses.reserve(_out.size());
+		for (size_t i = 0; i < _out.size(); i += 3)
+		{
+			for (int e = 0; e < 3; e++)
+			{
+				unsigned int a = _out[i + e], b = _out[i + (e + 1) % 3];
+				vertexEdgeUses[EdgeKey(a, b)]++;
+				groupEdgeUses[EdgeKey(group[a], group[b])]++;
+			}
+		}
+
+		// Open borders and non-manifold edges
+		std::vector<bool> groupOnBorder(groupCount, false);
+		for (const auto& edge : groupEdgeUses)
+		{
+			if (edge.second != 2) groupOnBorder[edge.first >> 32] = groupOnBorder[edge.first & 0xFFFFFFFFu] = true;
+		}
+
+		std::vector<unsigned int> openEdges(vertexCount, 0);
+		for (const auto& edge : vertexEdgeUses)
+		{
+			if (edge.second == 1)
+			{
+				openEdges[edge.first >> 32]++;
+				openEdges[edge.first & 0xFFFFFFFFu]++;
+			}
+		}
+
+		// A vertex in the middle of a seam line has one twin across the seam, and one seam edge either side of it
+		std::vector<VertexKind> kind(vertexCount, VertexKind::Locked);
+		std::vector<unsigned int> twin(vertexCount, NO_VERTEX);
+		std::vector<unsigned int> firstInGroup(groupCount, NO_VERTEX);
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			unsigned int g = group[v];
+			if (groupOnBorder[g]) continue;
+
+			if (groupSize[g] == 1)
+			{
+				kind[v] = VertexKind::Free;
+			}
+			else if (groupSize[g] == 2)
+			{
+				if (firstInGroup[g] == NO_VERTEX)
+				{
+					firstInGroup[g] = (unsigned int)v;
+				}
+				else
+				{
+					unsigned int other = firstInGroup[g];
+					if (openEdges[v] == 2 && openEdges[other] == 2)
+					{
+						kind[v] = kind[other] = VertexKind::Seam;
+						twin[v] = other;
+						twin[other] = (unsigned int)v;
+					}
+				}
+			}
+		}
+
+		// Every copy of a vertex sees the planes of all the triangles at its position
+		std::vector<Quadric> quadrics(groupCount);
+		for (size_t i = 0; i < _out.size(); i += 3)
+		{
+			const glm::vec3& a = _positions[_out[i]];
+			glm::dvec3 normal = Cross(a, _positions[_out[i + 1]], _positions[_out[i + 2]]);
+			double length = glm::length(normal);
+			if (length == 0.0) continue;
+
+			normal /= length;
+			double distance = -glm::dot(normal, glm::dvec3(a));
+			for (int c = 0; c < 3; c++) quadrics[group[_out[i + c]]].AddPlane(normal, distance, length * 0.5);
+		}
+
+		double maxError = 0.0;
+
+		std::vector<unsigned int> adjacencyOffsets(vertexCount + 1);
+		std::vector<unsigned int> adjacency;
+		std::vector<Collapse> collapses;
+		std::vector<bool> touched(vertexCount);
+		std::vector<unsigned int> remap(vertexCount);
+
+		// Triangles around _vertex which also use _other
+		auto sharedTriangles = [&](unsigned int _vertex, unsigned int _other)
+		{
+			size_t shared = 0;
+			for (unsigned int a = adjacencyOffsets[_vertex]; a < adjacencyOffsets[_vertex + 1]; a++)
+			{
+				const unsigned int* triangle = &_out[adjacency[a] * 3];
+				shared += triangle[0] == _other || triangle[1] == _other || triangle[2] == _other;
+			}
+			return shared;
+		};
+
+		// The copy of a seam vertex's neighbour on the same side of the seam as _vertex
+		auto seamNeighbour = [&](unsigned int _vertex, unsigned int _group)
+		{
+			for (unsigned int a = adjacencyOffsets[_vertex]; a < adjacencyOffsets[_vertex + 1]; a++)
+			{
+				const unsigned int* triangle = &_out[adjacency[a] * 3];
+				for (int c = 0; c < 3; c++)
+				{
+					if (group[triangle[c]] == _group && triangle[c] != _vertex && sharedTriangles(_vertex, triangle[c]) == 1) return triangle[c];
+				}
+			}
+			return NO_VERTEX;
+		};
+
+		// Whether moving _from onto _to keeps every remaining triangle facing the same way, and the surface manifold. Counts the triangles that would vanish.
+		std::vector<unsigned int> neighbours;
+		auto keepsOrientation = [&](unsigned int _from, unsigned int _to, size_t& _dropped)
+		{
+			// The ends of an edge may only share the neighbours of the triangles on it, or the collapse would fold two triangles onto each other
+			neighbours.clear();
+			for (unsigned int a = adjacencyOffsets[_from]; a < adjacencyOffsets[_from + 1]; a++)
+			{
+				const unsigned int* triangle = &_out[adjacency[a] * 3];
+				for (int c = 0; c < 3; c++)
+				{
+					if (triangle[c] != _from && triangle[c] != _to) neighbours.push_back(group[triangle[c]]);
+				}
+			}
+			std::sort(neighbours.begin(), neighbours.end());
+			neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+
+			size_t shared = 0;
+			for (unsigned int a = adjacencyOffsets[_to]; a < adjacencyOffsets[_to + 1]; a++)
+			{
+				const unsigned int* triangle = &_out[adjacency[a] * 3];
+				for (int c = 0; c < 3; c++)
+				{
+					auto found = std::lower_bound(neighbours.begin(), neighbours.end(), group[triangle[c]]);
+					if (triangle[c] != _to && triangle[c] != _from && found != neighbours.end() && *found == group[triangle[c]])
+					{
+						// Count each shared neighbour once
+						neighbours.erase(found);
+						shared++;
+					}
+				}
+			}
+			if (shared > sharedTriangles(_from, _to)) return false;
+
+			for (unsigned int a = adjacencyOffsets[_from]; a < adjacencyOffsets[_from + 1]; a++)
+			{
+				const unsigned int* triangle = &_out[adjacency[a] * 3];
+				if (triangle[0] == _to || triangle[1] == _to || triangle[2] == _to)
+				{
+					_dropped++;
+					continue;
+				}
+
+				glm::vec3 corners[3];
+				for (int c = 0; c < 3; c++) corners[c] = _positions[triangle[c] == _from ? _to : triangle[c]];
+
+				glm::dvec3 before = Cross(_positions[triangle[0]], _positions[triangle[1]], _positions[triangle[2]]);
+				glm::dvec3 after = Cross(corners[0], corners[1], corners[2]);
+				double lengths = glm::length(before) * glm::length(after);
+				if (lengths == 0.0 || glm::dot(before, after) < MAX_NORMAL_TURN * lengths) return false;
+			}
+			return true;
+		};
+
+		auto apply = [&](unsigned int _from, unsigned int _to)
+		{
+			remap[_from] = _to;
+
+			// The triangles around a moved vertex have changed, so leave their other corners until the next pass
+			for (unsigned int a = adjacencyOffsets[_from]; a < adjacencyOffsets[_from + 1]; a++)
+			{
+				const unsigned int* triangle = &_out[adjacency[a] * 3];
+				touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+			}
+		};
+
+		// Each pass collapses as many independent edges as it can, cheapest first, then rebuilds
+		while (_out.size() > _targetIndexCount)
+		{
+			const size_t triangleCount = _out.size() / 3;
+
+			std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+			for (unsigned int index : _out) adjacencyOffsets[index + 1]++;
+			for (size_t v = 0; v < vertexCount; v++) adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+
+			adjacency.resize(_out.size());
+			std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < _out.size(); i++) adjacency[fill[_out[i]]++] = (unsigned int)(i / 3);
+
+			// Each edge can collapse either way round, onto whichever end stays put. Seam vertices may only slide along their seam.
+			collapses.clear();
+			for (size_t i = 0; i < _out.size(); i += 3)
+			{
+				for (int e = 0; e < 3; e++)
+				{
+					unsigned int a = _out[i + e], b = _out[i + (e + 1) % 3];
+					for (int way = 0; way < 2; way++)
+					{
+						unsigned int from = way ? b : a, to = way ? a : b;
+						if (kind[from] == VertexKind::Locked) continue;
+						if (kind[from] == VertexKind::Seam && (groupSize[group[to]] < 2 || sharedTriangles(from, to) != 1)) continue;
+
+						Quadric quadric = quadrics[group[from]];
+						quadric += quadrics[group[to]];
+						collapses.push_back({ from, to, quadric.Evaluate(_positions[to]) / std::max(quadric.weight, 1e-30) });
+					}
+				}
+			}
+
+			if (collapses.empty()) break;
+
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& _a, const Collapse& _b) { return _a.cost < _b.cost; });
+
+			std::fill(touched.begin(), touched.end(), false);
+			for (size_t v = 0; v < vertexCount; v++) remap[v] = (unsigned int)v;
+
+			size_t toRemove = triangleCount - _targetIndexCount / 3;
+			size_t removed = 0;
+			for (const Collapse& collapse : collapses)
+			{
+				if (removed >= toRemove) break;
+				if (touched[collapse.from] || touched[collapse.to]) continue;
+
+				size_t dropped = 0;
+				if (!keepsOrientation(collapse.from, collapse.to, dropped)) continue;
+
+				// Both sides of a seam move together, so that it stays closed
+				if (kind[collapse.from] == VertexKind::Seam)
+				{
+					unsigned int twinFrom = twin[collapse.from];
+					unsigned int twinTo = seamNeighbour(twinFrom, group[collapse.to]);
+					if (twinTo == NO_VERTEX || twinTo == collapse.to || touched[twinFrom] || touched[twinTo]) continue;
+					if (!keepsOrientation(twinFrom, twinTo, dropped)) continue;
+
+					apply(twinFrom, twinTo);
+				}
+
+				apply(collapse.from, collapse.to);
+				quadrics[group[collapse.to]] += quadrics[group[collapse.from]];
+				maxError = std::max(maxError, collapse.cost);
+				removed += dropped;
+			}
+
+			if (removed == 0) break;
+
+			// Drop the triangles which collapsed to lines
+			size_t write = 0;
+			for (size_t i = 0; i < _out.size(); i += 3)
+			{
+				unsigned int a = remap[_out[i]], b = remap[_out[i + 1]], c = remap[_out[i + 2]];
+				if (a == b || b == c || c == a) continue;
+
+				_out[write++] = a;
+				_out[write++] = b;
+				_out[write++] = c;
+			}
+			_out.resize(write);
+		}
+
+		return (float)std::sqrt(maxError);
+	}
+
+	void GenerateLODs(MeshData& _data, size_t _levels, bool _optimise)
+	{
+		_data.lods.clear();
+
+		const size_t fullIndexCount = _data.indices.size();
+		if (fullIndexCount / 3 < MIN_LOD_TRIANGLES || _levels == 0) return;
+
+		_data.lods.push_back({ 0, (unsigned int)fullIndexCount, 0.0f });
+
+		// Copied, since appending the levels would otherwise feed them back in
+		std::vector<unsigned int> full(_data.indices.begin(), _data.indices.end());
+		std::vector<unsigned int> level;
+
+		for (size_t l = 1; l <= _levels; l++)
+		{
+			size_t target = (fullIndexCount / 3 >> l) * 3;
+			float error = SimplifyMesh(full, _data.positions, target, level);
+
+			const MeshLOD& previous = _data.lods.back();
+			if (level.size() > previous.indexCount * MIN_LOD_REDUCTION || level.size() / 3 < MIN_LOD_TRIANGLES / 4) break;
+
+			if (_optimise) OptimiseVertexCache(level, _data.positions.size());
+
+			// A coarser level can't be closer to the original than a finer one
+			_data.lods.push_back({ (unsigned int)_data.indices.size(), (unsigned int)level.size(), std::max(error, previous.error) });
+			_data.indices.insert(_data.indices.end(), level.begin(), level.end());
+		}
+
+		// A full mesh alone is no chain
+		if (_data.lods.size() == 1) _data.lods.clear();
+	}
+}
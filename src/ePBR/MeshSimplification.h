@@ -0,0 +1,37 @@
+#ifndef EPBR_MESH_SIMPLIFICATION
+#define EPBR_MESH_SIMPLIFICATION
+
+#include "MeshData.h"
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace ePBR
+{
+	/// @brief The most levels of detail GenerateLODs() adds below the full mesh by default.
+	const size_t MAX_LOD_LEVELS = 4;
+
+	/// @brief Reduce an indexed mesh by collapsing edges in order of quadric error. (Garland and Heckbert 1997)
+	/// @details Vertices collapse onto a neighbour, so the result indexes the same vertices as the input.
+	/// UV, normal and tangent seams, where two vertices share a position, only collapse along the seam with both copies moving together, so that seams stay closed.
+	/// Vertices on open borders, seam corners and junctions never move.
+	/// Collapses which would flip a triangle are skipped. Simplification stops early when nothing more can collapse.
+	/// @param _indices The triangles to simplify.
+	/// @param _positions The vertex positions.
+	/// @param _targetIndexCount The number of indices to reduce to.
+	/// @param _out Receives the simplified triangles.
+	/// @return The largest error of any collapse made, as a distance in model space.
+	float SimplifyMesh(const std::vector<unsigned int>& _indices, const std::vector<glm::vec3>& _positions, size_t _targetIndexCount, std::vector<unsigned int>& _out);
+
+	/// @brief Build a chain of levels of detail, each with about half the triangles of the one before, and append their indices to the mesh's.
+	/// @details Every level is simplified from the full mesh so that its error is measured against the original surface.
+	/// The chain stops early once a level would barely be smaller than the last.
+	/// @param _data The mesh. Its lods are replaced and its indices extended.
+	/// @param _levels The most levels to add below the full mesh.
+	/// @param _optimise Whether to reorder each level's triangles for the post-transform cache.
+	void GenerateLODs(MeshData& _data, size_t _levels = MAX_LOD_LEVELS, bool _optimise = false);
+}
+
+#endif // EPBR_MESH_SIMPLIFICATION
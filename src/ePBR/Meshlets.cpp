@@ -0,0 +1,278 @@
+#include "Meshlets.h"
+#include "Culling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace ePBR
+{
+	namespace
+	{
+		// How much bending the normal cone counts against a triangle, in new vertices per unit of (1 - cos)
+		const float CONE_WEIGHT = 2.0f;
+
+		// How much each triangle left around a candidate's vertices counts against it
+		const float LIVE_WEIGHT = 0.05f;
+
+		// Cones no narrower than this never face wholly away, so are not worth a test
+		const float MIN_CONE_DOT = 0.1f;
+
+		const unsigned int NOT_IN_MESHLET = std::numeric_limits<unsigned int>::max();
+
+		glm::vec3 TriangleNormal(const std::vector<glm::vec3>& _positions, const unsigned int* _triangle)
+		{
+			glm::vec3 normal = glm::cross(_positions[_triangle[1]] - _positions[_triangle[0]], _positions[_triangle[2]] - _positions[_triangle[0]]);
+			float length = glm::length(normal);
+			return length > 0.0f ? normal / length : glm::vec3(0.0f);
+		}
+
+		// Ritter's bounding sphere: start from two far apart points, then grow to take in any left outside
+		void ComputeBoundingSphere(const std::vector<glm::vec3>& _positions, const std::vector<unsigned int>& _vertices, glm::vec3& _center, float& _radius)
+		{
+			auto farthestFrom = [&](const glm::vec3& _point)
+			{
+				unsigned int farthest = _vertices[0];
+				float farthestDistance = -1.0f;
+				for (unsigned int vertex : _vertices)
+				{
+					float distance = glm::dot(_positions[vertex] - _point, _positions[vertex] - _point);
+					if (distance > farthestDistance)
+					{
+						farthest = vertex;
+						farthestDistance = distance;
+					}
+				}
+				return farthest;
+			};
+
+			glm::vec3 a = _positions[farthestFrom(_positions[_vertices[0]])];
+			glm::vec3 b = _positions[farthestFrom(a)];
+
+			_center = (a + b) * 0.5f;
+			_radius = glm::length(b - a) * 0.5f;
+
+			for (unsigned int vertex : _vertices)
+			{
+				float distance = glm::length(_positions[vertex] - _center);
+				if (distance > _radius)
+				{
+					// Move the far side of the sphere out to the point
+					float grownRadius = (_radius + distance) * 0.5f;
+					_center += (_positions[vertex] - _center) * ((grownRadius - _radius) / distance);
+					_radius = grownRadius;
+				}
+			}
+		}
+
+		// Fill in the bounding sphere and normal cone of a meshlet
+		void ComputeMeshletBounds(const std::vector<glm::vec3>& _positions, const std::vector<unsigned int>& _vertices, const std::vector<unsigned int>& _triangles,
+			const std::vector<glm::vec3>& _triangleNormals, Meshlet& _meshlet)
+		{
+			ComputeBoundingSphere(_positions, _vertices, _meshlet.center, _meshlet.radius);
+
+			glm::vec3 normalSum(0.0f);
+			for (unsigned int triangle : _triangles) normalSum += _triangleNormals[triangle];
+
+			float length = glm::length(normalSum);
+			_meshlet.coneAxis = length > 0.0f ? normalSum / length : glm::vec3(0.0f, 0.0f, 1.0f);
+
+			// Degenerate triangles have no normal and can't be seen, so don't widen the cone
+			float minDot = length > 0.0f ? 1.0f : -1.0f;
+			for (unsigned int triangle : _triangles)
+			{
+				if (_triangleNormals[triangle] != glm::vec3(0.0f)) minDot = std::min(minDot, glm::dot(_triangleNormals[triangle], _meshlet.coneAxis));
+			}
+
+			// The cone faces away once the view direction is past 90 degrees plus its half angle, whose cosine is -sin(half angle)
+			_meshlet.coneCutoff = minDot < MIN_CONE_DOT ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+		}
+	}
+
+	void BuildMeshlets(MeshData& _data, size_t _maxVertices, size_t _maxTriangles)
+	{
+		_data.meshlets.clear();
+
+		const size_t triangleCount = _data.indices.size() / 3;
+		const size_t vertexCount = _data.positions.size();
+		if (triangleCount == 0 || _maxVertices < 3 || _maxTriangles == 0) return;
+
+		// Triangles around each vertex, as offsets into one shared list
+		std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+		for (unsigned int index : _data.indices) adjacencyOffsets[index + 1]++;
+		for (size_t v = 0; v < vertexCount; v++) adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+
+		std::vector<unsigned int> adjacency(_data.indices.size());
+		std::vector<unsigned int> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t i = 0; i < _data.indices.size(); i++) adjacency[adjacencyFill[_data.indices[i]]++] = (unsigned int)(i / 3);
+
+		std::vector<glm::vec3> triangleNormals(triangleCount);
+		for (size_t t = 0; t < triangleCount; t++) triangleNormals[t] = TriangleNormal(_data.positions, &_data.indices[t * 3]);
+
+		// Unemitted triangles left around each vertex. Finishing off vertices with few left avoids stranding small islands of triangles.
+		std::vector<unsigned int> liveTriangles(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++) liveTriangles[v] = adjacencyOffsets[v + 1] - adjacencyOffsets[v];
+
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<unsigned int> vertexSlot(vertexCount, NOT_IN_MESHLET);
+		std::vector<unsigned int> reordered;
+		reordered.reserve(_data.indices.size());
+
+		std::vector<unsigned int> meshletVertices;
+		std::vector<unsigned int> meshletTriangles;
+		glm::vec3 normalSum(0.0f);
+		size_t nextUnemitted = 0;
+		size_t emittedCount = 0;
+
+		auto newVertices = [&](unsigned int _triangle)
+		{
+			const unsigned int* triangle = &_data.indices[_triangle * 3];
+			return (vertexSlot[triangle[0]] == NOT_IN_MESHLET) + (vertexSlot[triangle[1]] == NOT_IN_MESHLET) + (vertexSlot[triangle[2]] == NOT_IN_MESHLET);
+		};
+
+		auto addTriangle = [&](unsigned int _triangle)
+		{
+			for (int corner = 0; corner < 3; corner++)
+			{
+				unsigned int vertex = _data.indices[_triangle * 3 + corner];
+				liveTriangles[vertex]--;
+				if (vertexSlot[vertex] == NOT_IN_MESHLET)
+				{
+					vertexSlot[vertex] = (unsigned int)meshletVertices.size();
+					meshletVertices.push_back(vertex);
+				}
+			}
+
+			meshletTriangles.push_back(_triangle);
+			normalSum += triangleNormals[_triangle];
+			emitted[_triangle] = true;
+			emittedCount++;
+		};
+
+		auto finishMeshlet = [&]()
+		{
+			Meshlet meshlet;
+			meshlet.indexOffset = (unsigned int)reordered.size();
+			meshlet.indexCount = (unsigned int)meshletTriangles.size() * 3;
+
+			for (unsigned int triangle : meshletTriangles)
+			{
+				reordered.insert(reordered.end(), &_data.indices[triangle * 3], &_data.indices[triangle * 3] + 3);
+			}
+
+			ComputeMeshletBounds(_data.positions, meshletVertices, meshletTriangles, triangleNormals, meshlet);
+			_data.meshlets.push_back(meshlet);
+		};
+
+		while (emittedCount < triangleCount)
+		{
+			// Seed next to the last meshlet so that neighbouring meshlets stay neighbours in the index buffer, else at the first triangle left
+			unsigned int seed = NOT_IN_MESHLET;
+			for (size_t i = 0; i < meshletVertices.size() && seed == NOT_IN_MESHLET; i++)
+			{
+				unsigned int vertex = meshletVertices[i];
+				for (unsigned int a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1]; a++)
+				{
+					if (!emitted[adjacency[a]])
+					{
+						seed = adjacency[a];
+						break;
+					}
+				}
+			}
+
+			if (seed == NOT_IN_MESHLET)
+			{
+				while (emitted[nextUnemitted]) nextUnemitted++;
+				seed = (unsigned int)nextUnemitted;
+			}
+
+			for (unsigned int vertex : meshletVertices) vertexSlot[vertex] = NOT_IN_MESHLET;
+			meshletVertices.clear();
+			meshletTriangles.clear();
+			normalSum = glm::vec3(0.0f);
+
+			addTriangle(seed);
+
+			while (meshletTriangles.size() < _maxTriangles)
+			{
+				float length = glm::length(normalSum);
+				glm::vec3 averageNormal = length > 0.0f ? normalSum / length : glm::vec3(0.0f);
+
+				// Score every unemitted triangle touching the meshlet
+				unsigned int best = NOT_IN_MESHLET;
+				float bestScore = std::numeric_limits<float>::max();
+				for (unsigned int vertex : meshletVertices)
+				{
+					for (unsigned int a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1]; a++)
+					{
+						unsigned int triangle = adjacency[a];
+						if (emitted[triangle]) continue;
+
+						int added = newVertices(triangle);
+						if (meshletVertices.size() + added > _maxVertices) continue;
+
+						const unsigned int* corners = &_data.indices[triangle * 3];
+						float live = (float)(liveTriangles[corners[0]] + liveTriangles[corners[1]] + liveTriangles[corners[2]]);
+
+						float score = added + CONE_WEIGHT * (1.0f - glm::dot(triangleNormals[triangle], averageNormal)) + LIVE_WEIGHT * live;
+						if (score < bestScore)
+						{
+							best = triangle;
+							bestScore = score;
+						}
+					}
+				}
+
+				// Disconnected or full
+				if (best == NOT_IN_MESHLET) break;
+
+				addTriangle(best);
+			}
+
+			finishMeshlet();
+		}
+
+		_data.indices.swap(reordered);
+	}
+
+	size_t CullMeshlets(const std::vector<Meshlet>& _meshlets, const glm::mat4& _modelViewProjection, const glm::vec3& _cameraPosition, bool _coneCulling, std::vector<MeshletRange>& _ranges)
+	{
+		_ranges.clear();
+
+		// Frustum planes in model space
+		glm::vec4 planes[6];
+		ExtractFrustumPlanes(_modelViewProjection, planes);
+
+		size_t visible = 0;
+		for (const Meshlet& meshlet : _meshlets)
+		{
+			bool inside = true;
+			for (int p = 0; p < 6 && inside; p++)
+			{
+				inside = glm::dot(glm::vec3(planes[p]), meshlet.center) + planes[p].w >= -meshlet.radius;
+			}
+			if (!inside) continue;
+
+			if (_coneCulling && meshlet.coneCutoff < 1.0f)
+			{
+				glm::vec3 toMeshlet = meshlet.center - _cameraPosition;
+				if (glm::dot(toMeshlet, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(toMeshlet) + meshlet.radius) continue;
+			}
+
+			visible++;
+
+			// Extend the last range when this meshlet follows straight on from it
+			if (!_ranges.empty() && _ranges.back().indexOffset + _ranges.back().indexCount == meshlet.indexOffset)
+			{
+				_ranges.back().indexCount += meshlet.indexCount;
+			}
+			else
+			{
+				_ranges.push_back({ meshlet.indexOffset, meshlet.indexCount });
+			}
+		}
+
+		return visible;
+	}
+}
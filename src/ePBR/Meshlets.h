@@ -0,0 +1,42 @@
+#ifndef EPBR_MESHLETS
+#define EPBR_MESHLETS
+
+#include "MeshData.h"
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace ePBR
+{
+	/// @brief The largest meshlet BuildMeshlets() makes by default.
+	const size_t MESHLET_MAX_VERTICES = 64;
+	const size_t MESHLET_MAX_TRIANGLES = 124;
+
+	/// @brief A run of visible meshlets which sit next to each other in the index buffer, drawn as one range.
+	struct MeshletRange
+	{
+		unsigned int indexOffset;
+		unsigned int indexCount;
+	};
+
+	/// @brief Split an indexed mesh into meshlets and reorder its triangles so that each meshlet is one contiguous range of indices.
+	/// @details Meshlets are grown greedily from a seed triangle, preferring neighbours which add the fewest new vertices and bend the meshlet's normal cone the least.
+	/// Each gets a bounding sphere and a normal cone, from which Mesh::Draw culls it whole when it is off-screen or faces away from the camera.
+	/// @param _data The mesh. Its indices are reordered and its meshlets replaced.
+	/// @param _maxVertices The most unique vertices one meshlet may reference.
+	/// @param _maxTriangles The most triangles one meshlet may hold.
+	void BuildMeshlets(MeshData& _data, size_t _maxVertices = MESHLET_MAX_VERTICES, size_t _maxTriangles = MESHLET_MAX_TRIANGLES);
+
+	/// @brief Find the meshlets which may be visible and merge neighbouring ones into index ranges.
+	/// @param _meshlets The meshlets, in index buffer order.
+	/// @param _modelViewProjection The matrix from model space to clip space.
+	/// @param _cameraPosition The camera position, in model space.
+	/// @param _coneCulling Whether to drop meshlets that face away from the camera. Only valid while back faces of counter-clockwise triangles are culled.
+	/// @param _ranges Receives the ranges to draw. Existing contents are replaced.
+	/// @return The number of meshlets which passed.
+	size_t CullMeshlets(const std::vector<Meshlet>& _meshlets, const glm::mat4& _modelViewProjection, const glm::vec3& _cameraPosition, bool _coneCulling, std::vector<MeshletRange>& _ranges);
+}
+
+#endif // EPBR_MESHLETS
@@ -5,7 +5,20 @@
 #include "Material.h"
 #include "Texture.h"
 #include "PBRMaterial.h"
-
+#include "VertexWelding.h"
+#include "MeshOptimisation.h"
+#include "MeshCache.h"
+#include "TangentGeneration.h"
+#include "ThreadPool.h"
+#include "VertexQuantisation.h"
+#include "Meshlets.h"
+#include "MeshSimplification.h"
+#include "Occlusion.h"
+#include "IndirectDraw.h"
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <memory>
 #include <iostream>
@@ -17,20 +30,26 @@
 
 namespace ePBR 
 {
-	void LoadTextureOfType(aiTextureType _type, aiMaterial* _material, std::unordered_map<std::string, std::shared_ptr<Texture>>& _matMap, const std::string& _modelDirectory) 
+	namespace
 	{
-		if (_material->GetTextureCount(_type))
+		// On-screen error allowed at a bias of 0, as a fraction of the viewport height: about a pixel at 1080p
+		const float LOD_SCREEN_ERROR = 1.0f / 1080.0f;
+
+		// Shared by every model, set through Model::SetLODBias
+		float lodBias = 0.0f;
+
+		// Get the path, relative to the model's directory, of the first texture of a type on a material. Empty if there is none.
+		std::string GetTexturePath(aiTextureType _type, const aiMaterial* _material)
 		{
+			if (!_material->GetTextureCount(_type)) return std::string();
+
 			aiString path;
 			_material->GetTexture(_type, 0, &path);
 
-			if (_matMap.find(path.data) != _matMap.end())
-			{
-				return;
-			}
-
 			// Remove extraneous information at beginning of path
 			std::string sPath = path.data;
+			if (sPath.empty()) return sPath;
+
 			if (sPath.at(0) == '.') 
 			{
 				sPath = sPath.substr(3);
@@ -40,12 +59,119 @@ namespace ePBR
 				sPath = sPath.substr(1);
 			}
 
-			std::cout << "Loading " << path.data << std::endl;
+			return sPath;
+		}
 
-			_matMap[path.data] = std::make_shared<Texture>(_modelDirectory + sPath);
+		// Load a texture once per model, however many materials use it
+		std::shared_ptr<Texture> GetTexture(const std::string& _path, std::unordered_map<std::string, std::shared_ptr<Texture>>& _texMap, const std::string& _modelDirectory)
+		{
+			if (_path.empty()) return nullptr;
+
+			std::shared_ptr<Texture>& texture = _texMap[_path];
+			if (!texture)
+			{
+				std::cout << "Loading " << _path << std::endl;
+				texture = std::make_shared<Texture>(_modelDirectory + _path);
+			}
+
+			return texture;
+		}
+
+		// Read one assimp mesh into welded, indexed streams
+		void ImportMesh(const aiMesh* _mesh, const ImportOptions& _options, MeshData& _out)
+		{
+			std::vector<unsigned int> remap;
+
+			// Copy out vertex attributes
+			if (_mesh->HasPositions()) 
+			{
+				_out.positions.resize(_mesh->mNumVertices);
+				for (int i = 0; i < _mesh->mNumVertices; i++) 
+				{
+					_out.positions[i] = glm::vec3(_mesh->mVertices[i].x, _mesh->mVertices[i].y, _mesh->mVertices[i].z);
+				}
+			}
+
+			if (_mesh->HasNormals()) 
+			{
+				_out.normals.resize(_mesh->mNumVertices);
+				for (int i = 0; i < _mesh->mNumVertices; i++)
+				{
+					_out.normals[i] = glm::vec3(_mesh->mNormals[i].x, _mesh->mNormals[i].y, _mesh->mNormals[i].z);
+				}
+			}
+
+			if (_mesh->mTextureCoords[0]) 
+			{
+				_out.uvs.resize(_mesh->mNumVertices);
+				for (int i = 0; i < _mesh->mNumVertices; i++)
+				{
+					_out.uvs[i] = glm::vec2(_mesh->mTextureCoords[0][i].x, _mesh->mTextureCoords[0][i].y);
+				}
+			}
+
+			// Share vertices with identical attributes, then point the faces at the shared vertices
+			WeldVertices(_out.positions, _out.normals, _out.uvs, remap);
+
+			_out.indices.reserve(_mesh->mNumFaces * 3);
+			for (int i = 0; i < _mesh->mNumFaces; i++)
+			{
+				const aiFace& face = _mesh->mFaces[i];
+
+				// Points and lines can't be drawn as triangles
+				if (face.mNumIndices != 3) continue;
+
+				_out.indices.push_back(remap[face.mIndices[0]]);
+				_out.indices.push_back(remap[face.mIndices[1]]);
+				_out.indices.push_back(remap[face.mIndices[2]]);
+			}
+
+			if (_options.optimiseMesh)
+			{
+				OptimiseAndReport(_out.indices, _out.positions, _out.normals, _out.uvs);
+			}
+
+			// Generated here rather than by assimp so both loaders produce the same tangent frames
+			GenerateTangents(_out, &ThreadPool::GetShared());
+
+			_out.materialIndex = _mesh->mMaterialIndex;
+			_out.ComputeBounds();
+
+			if (_options.buildMeshlets)
+			{
+				BuildMeshlets(_out);
+			}
+
+			if (_options.generateLODs)
+			{
+				GenerateLODs(_out, MAX_LOD_LEVELS, _options.optimiseMesh);
+			}
+
+			if (_options.buildOccluders)
+			{
+				BuildOccluder(_out);
+			}
+
+			if (_options.quantiseVertices)
+			{
+				ReportQuantisation(_out);
+				_out.quantise = true;
+			}
+
+			std::cout << "Loaded " << _out.positions.size() << " unique vertices from " << _mesh->mNumVertices << "...\n";
+			std::cout << "Loaded " << _out.indices.size() / 3 << " triangles...\n";
+			if (!_out.meshlets.empty()) std::cout << "Split into " << _out.meshlets.size() << " meshlets...\n";
+			if (!_out.lods.empty()) std::cout << "Simplified into " << _out.lods.size() << " levels of detail, down to " << _out.lods.back().indexCount / 3 << " triangles...\n";
+			if (!_out.occluder.indices.empty()) std::cout << "Kept " << _out.occluder.indices.size() / 3 << " triangles as an occluder...\n";
 		}
 	}
 
+	Model::Model() :
+		m_boundsMin(0.0f),
+		m_boundsMax(0.0f)
+	{
+	}
+
 	void Model::SetMaterial(int _index, std::shared_ptr<Material> _newMat) 
 	{
 		if (m_materials.size() < _index + 1) 
@@ -62,9 +188,41 @@ namespace ePBR
 			m_meshes.resize(_index + 1);
 		}
 		m_meshes.at(_index) = _newMesh;
+
+		UpdateBounds();
+	}
+
+	void Model::UpdateBounds()
+	{
+		bool first = true;
+		for (const std::shared_ptr<Mesh>& mesh : m_meshes)
+		{
+			if (!mesh) continue;
+
+			m_boundsMin = first ? mesh->GetBoundsMin() : glm::min(m_boundsMin, mesh->GetBoundsMin());
+			m_boundsMax = first ? mesh->GetBoundsMax() : glm::max(m_boundsMax, mesh->GetBoundsMax());
+			first = false;
+		}
+
+		if (first)
+		{
+			m_boundsMin = m_boundsMax = glm::vec3(0.0f);
+		}
+
+		// Around the centre of the box, taking in each mesh's sphere, but never looser than the box itself
+		m_boundingSphere.center = (m_boundsMin + m_boundsMax) * 0.5f;
+		m_boundingSphere.radius = 0.0f;
+		for (const std::shared_ptr<Mesh>& mesh : m_meshes)
+		{
+			if (!mesh) continue;
+
+			BoundingSphere sphere = mesh->GetBoundingSphere();
+			m_boundingSphere.radius = std::max(m_boundingSphere.radius, glm::length(sphere.center - m_boundingSphere.center) + sphere.radius);
+		}
+		m_boundingSphere.radius = std::min(m_boundingSphere.radius, glm::length(m_boundsMax - m_boundsMin) * 0.5f);
 	}
 
-	void Model::Load(const std::string& _filename)
+	void Model::Load(const std::string& _filename, const ImportOptions& _options)
 	{
 		std::ifstream fin(_filename.c_str());
 		if (!fin.fail())
@@ -76,168 +234,199 @@ namespace ePBR
 			throw std::runtime_error("Failed to open file at " + _filename);
 		}
 
-		// Create assimp importer
-		Assimp::Importer importer;
-		// Load scene from file!
-		// Joining identical vertices is breaking things - should be investigated
-		const aiScene* scene = importer.ReadFile(_filename, aiProcessPreset_TargetRealtime_Quality ^ aiProcess_JoinIdenticalVertices);
-
-		if (!scene)
-		{
-			throw std::runtime_error("Import failed from file at " + _filename);
-		}
-
 		// Get model location
 		std::string locString = _filename.substr(0, _filename.find_last_of('\\') + 1);
 
-		// Load Materials
-		std::unordered_map<std::string, std::shared_ptr<Texture>> matMap;
+		std::string cacheFile = GetMeshCachePath(_filename);
+		uint64_t cacheKey = _options.useCache ? GetMeshCacheKey(_filename, _options) : 0;
+
+		std::vector<CachedMesh> cachedMeshes;
+		std::vector<MaterialBinding> materials;
+		std::vector<unsigned int> materialIndices;
 
-		if (scene->HasMaterials()) 
+		if (cacheKey && LoadMeshCache(cacheFile, cacheKey, cachedMeshes, materials))
+		{
+			// Geometry is already in its arenas, only the textures remain to be loaded
+			m_meshes.resize(cachedMeshes.size());
+			for (size_t i = 0; i < cachedMeshes.size(); i++)
+			{
+				m_meshes.at(i) = std::make_shared<Mesh>();
+				m_meshes.at(i)->SetGeometry(cachedMeshes[i].geometry);
+				m_meshes.at(i)->SetBounds(cachedMeshes[i].boundsMin, cachedMeshes[i].boundsMax, cachedMeshes[i].boundsRadius);
+				m_meshes.at(i)->SetPositionDecode(cachedMeshes[i].positionDecode);
+				m_meshes.at(i)->SetMeshlets(cachedMeshes[i].meshlets);
+				m_meshes.at(i)->SetLODs(cachedMeshes[i].lods);
+				m_meshes.at(i)->SetOccluder(cachedMeshes[i].occluder);
+				materialIndices.push_back(cachedMeshes[i].materialIndex);
+			}
+		}
+		else
 		{
+			// Create assimp importer
+			Assimp::Importer importer;
+			// Load scene from file!
+			// Identical vertices are welded by WeldVertices, which also covers OBJ meshes loaded through Mesh
+			const aiScene* scene = importer.ReadFile(_filename, aiProcessPreset_TargetRealtime_Quality ^ aiProcess_JoinIdenticalVertices ^ aiProcess_CalcTangentSpace);
+
+			if (!scene)
+			{
+				throw std::runtime_error("Import failed from file at " + _filename);
+			}
+
+			// We're only going to use a single texture for the types we want at the moment
+			materials.resize(scene->mNumMaterials);
 			for (int i = 0; i < scene->mNumMaterials; i++) 
 			{
-				aiMaterial* material = scene->mMaterials[i];
+				const aiMaterial* material = scene->mMaterials[i];
 
-				// We're only going to load a single texture for the types we want at the moment
-				LoadTextureOfType(aiTextureType_BASE_COLOR, material, matMap, locString);
-				LoadTextureOfType(aiTextureType_NORMALS, material, matMap, locString);
-				LoadTextureOfType(aiTextureType_METALNESS, material, matMap, locString);
-				LoadTextureOfType(aiTextureType_DIFFUSE_ROUGHNESS, material, matMap, locString);
-				LoadTextureOfType(aiTextureType_AMBIENT_OCCLUSION, material, matMap, locString);
+				materials[i].albedo = GetTexturePath(aiTextureType_BASE_COLOR, material);
+				materials[i].normal = GetTexturePath(aiTextureType_NORMALS, material);
+				materials[i].metalness = GetTexturePath(aiTextureType_METALNESS, material);
+				materials[i].roughness = GetTexturePath(aiTextureType_DIFFUSE_ROUGHNESS, material);
+				materials[i].ambientOcclusion = GetTexturePath(aiTextureType_AMBIENT_OCCLUSION, material);
 
 				std::cout << "Loaded material: " << material->GetName().data << "\n";
 			}
-			
-		}
 
-		if (scene->HasMeshes())
-		{
-			// Resize vectors
+			std::vector<MeshData> meshData(scene->mNumMeshes);
 			m_meshes.resize(scene->mNumMeshes);
-			m_materials.resize(scene->mNumMeshes);
 
 			for (int meshItr = 0; meshItr < scene->mNumMeshes; ++meshItr)
 			{
-				std::shared_ptr<VertexArray> vao = std::make_shared<VertexArray>();
+				std::cout << "Loading mesh '" << scene->mMeshes[meshItr]->mName.C_Str() << "':\n";
 
-				const aiMesh* mesh = scene->mMeshes[meshItr];
+				ImportMesh(scene->mMeshes[meshItr], _options, meshData[meshItr]);
 
-				vao->SetVertCount(mesh->mNumVertices);
+				m_meshes.at(meshItr) = std::make_shared<Mesh>();
+				m_meshes.at(meshItr)->SetMeshData(meshData[meshItr]);
 
-				std::cout << "Loading mesh '" << mesh->mName.C_Str() << "':\n";
+				materialIndices.push_back(meshData[meshItr].materialIndex);
+			}
 
-				// Load vertex positions
-				if (mesh->HasPositions()) 
-				{
-					std::shared_ptr<VertexBuffer> posBuffer = std::make_shared<VertexBuffer>();
+			if (cacheKey) WriteMeshCache(cacheFile, cacheKey, meshData, materials);
+		}
 
-					// Cast aiVector3D* to float* doesn't quite work. If you can create an elegant conversion we can do the below
-					//posBuffer->SetData((const float *)mesh->mVertices, mesh->mNumVertices, 3);
-					
-					for (int i = 0; i < mesh->mNumVertices; i++) 
-					{
-						posBuffer->Add(glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z));
-					}
+		UpdateBounds();
 
-					// Link VBO to VAO
-					vao->SetBuffer(posBuffer, 0);
+		// Find and assign material textures
+		std::unordered_map<std::string, std::shared_ptr<Texture>> texMap;
+		m_materials.resize(m_meshes.size());
 
-					std::cout << "Loaded " << mesh->mNumVertices << " vertices...\n";
-				}
+		for (size_t i = 0; i < m_meshes.size(); i++)
+		{
+			std::shared_ptr<PBRMaterial> pbrMaterial = std::make_shared<PBRMaterial>();
 
-				// Load vertex normals
-				if (mesh->HasNormals()) 
-				{
-					std::shared_ptr<VertexBuffer> normalBuffer = std::make_shared<VertexBuffer>();
+			if (materialIndices[i] < materials.size())
+			{
+				const MaterialBinding& binding = materials[materialIndices[i]];
 
-					// Cast aiVector3D* to float* doesn't quite work. If you can create an elegant conversion we can do the below
-					//normalBuffer->SetData((const float*)mesh->mNormals, mesh->mNumVertices, 3);
-					for (int i = 0; i < mesh->mNumVertices; i++)
-					{
-						normalBuffer->Add(glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z));
-					}
+				if (std::shared_ptr<Texture> texture = GetTexture(binding.albedo, texMap, locString)) pbrMaterial->SetAlbedoTexture(texture);
+				if (std::shared_ptr<Texture> texture = GetTexture(binding.normal, texMap, locString)) pbrMaterial->SetNormalMap(texture);
+				if (std::shared_ptr<Texture> texture = GetTexture(binding.metalness, texMap, locString)) pbrMaterial->SetMetalnessMap(texture);
+				if (std::shared_ptr<Texture> texture = GetTexture(binding.roughness, texMap, locString)) pbrMaterial->SetRoughnessMap(texture);
+				if (std::shared_ptr<Texture> texture = GetTexture(binding.ambientOcclusion, texMap, locString)) pbrMaterial->SetAmbientOcclusionMap(texture);
+			}
 
-					// Link VBO to VAO
-					vao->SetBuffer(normalBuffer, 1);
+			m_materials.at(i) = pbrMaterial;
+		}
+	}
 
-					std::cout << "Loaded " << mesh->mNumVertices << " normals...\n";
-				}
+	void Model::SetLODBias(float _bias)
+	{
+		lodBias = _bias;
+	}
 
-				// Load texture coordinates
-				if (mesh->mTextureCoords[0]) 
-				{
-					std::shared_ptr<VertexBuffer> uvBuffer = std::make_shared<VertexBuffer>();
+	float Model::GetLODBias()
+	{
+		return lodBias;
+	}
 
-					// Cast aiVector3D* to float* doesn't quite work. If you can create an elegant conversion we can do the below
-					//normalBuffer->SetData((const float*)mesh->mNormals, mesh->mNumVertices, 3);
-					for (int i = 0; i < mesh->mNumVertices; i++)
-					{
-						uvBuffer->Add(glm::vec3(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y, mesh->mTextureCoords[0][i].z));
-					}
+	void Model::Draw(glm::mat4 _modelMatrix, glm::mat4 _viewMatrix, glm::mat4 _projMatrix, glm::vec3 _camPos)
+	{
+		glm::mat4 viewProjection = _projMatrix * _viewMatrix;
+		float maxScreenError = LOD_SCREEN_ERROR * std::exp2(lodBias);
 
-					// Link VBO to VAO
-					vao->SetBuffer(uvBuffer, 2);
+		for (size_t i = 0; i < m_meshes.size(); i++) 
+		{
+			// Quantised positions are relative to the mesh bounds, so map them to model space first
+			glm::mat4 modelMatrix = _modelMatrix * m_meshes.at(i)->GetPositionDecode();
 
-					std::cout << "Loaded " << mesh->mNumVertices << " texture coordinates...\n";
-				}
+			// This activates and prepares the shader. Meshes without a material of their own share the first.
+			m_materials.at(i < m_materials.size() ? i : 0)->Apply(modelMatrix, _viewMatrix, _projMatrix, _camPos);
 
-				// Find and assign material textures
-				std::shared_ptr<PBRMaterial> pbrMaterial = std::make_shared<PBRMaterial>();
-				aiMaterial* mat = scene->mMaterials[mesh->mMaterialIndex];
-				aiString path;
+			// Bind vertex arrays and ask openGL to draw whichever meshlets may be visible
+			size_t lod = m_meshes.at(i)->SelectLOD(_modelMatrix, _projMatrix, _camPos, maxScreenError);
+			m_meshes.at(i)->Draw(_modelMatrix, viewProjection, _camPos, lod);
+		}
+	}
 
-				// Get diffuse
-				if (mat->GetTextureCount(aiTextureType_BASE_COLOR)) 
-				{
-					mat->GetTexture(aiTextureType_BASE_COLOR, 0, &path);
-					pbrMaterial->SetAlbedoTexture(matMap[path.data]);
-				}
-				// Get normal
-				if (mat->GetTextureCount(aiTextureType_NORMALS))
-				{
-					mat->GetTexture(aiTextureType_NORMALS, 0, &path);
-					pbrMaterial->SetNormalMap(matMap[path.data]);
-				}
-				// Get metalness
-				if (mat->GetTextureCount(aiTextureType_METALNESS))
-				{
-					mat->GetTexture(aiTextureType_METALNESS, 0, &path);
-					pbrMaterial->SetMetalnessMap(matMap[path.data]);
-				}
-				// Get roughness
-				if (mat->GetTextureCount(aiTextureType_DIFFUSE_ROUGHNESS))
-				{
-					mat->GetTexture(aiTextureType_DIFFUSE_ROUGHNESS, 0, &path);
-					pbrMaterial->SetRoughnessMap(matMap[path.data]);
-				}
-				// Get diffuse
-				if (mat->GetTextureCount(aiTextureType_AMBIENT_OCCLUSION))
-				{
-					mat->GetTexture(aiTextureType_AMBIENT_OCCLUSION, 0, &path);
-					pbrMaterial->SetAmbientOcclusionMap(matMap[path.data]);
-				}
+	void Model::DrawInstanced(const std::vector<ModelInstance>& _instances, glm::mat4 _viewMatrix, glm::mat4 _projMatrix, glm::vec3 _camPos)
+	{
+		// A list of this model alone goes out as one multi-draw call per mesh material
+		Enqueue(m_drawList, _instances, _projMatrix, _camPos);
+		m_drawList.Submit(_viewMatrix, _projMatrix, _camPos);
+	}
 
-				// Instantiate and store mesh
-				std::shared_ptr<Mesh> newMesh = std::make_shared<Mesh>();
-				newMesh->SetVertexArray(vao);
-				m_meshes.at(meshItr) = newMesh;
-				m_materials.at(meshItr) = pbrMaterial;
-			}
+	void Model::AddOccluders(OcclusionCuller& _culler, const glm::mat4& _modelMatrix) const
+	{
+		for (const std::shared_ptr<Mesh>& mesh : m_meshes)
+		{
+			if (mesh && !mesh->GetOccluder().indices.empty()) _culler.AddOccluder(mesh->GetOccluder(), _modelMatrix);
 		}
+	}
 
-		// FREE SCENE?
+	void Model::Enqueue(IndirectDrawList& _list, glm::mat4 _modelMatrix, glm::mat4 _projMatrix, glm::vec3 _camPos)
+	{
+		float maxScreenError = LOD_SCREEN_ERROR * std::exp2(lodBias);
+
+		for (size_t i = 0; i < m_meshes.size(); i++)
+		{
+			std::shared_ptr<Mesh> mesh = m_meshes.at(i);
+			std::shared_ptr<Material> material = m_materials.at(i < m_materials.size() ? i : 0);
+
+			ModelInstance instance;
+			instance.modelMatrix = _modelMatrix * mesh->GetPositionDecode();
+
+			// Instanced shaders read the modifiers per instance rather than from the material
+			material->GetInstanceModifiers(instance);
+
+			size_t lod = mesh->SelectLOD(_modelMatrix, _projMatrix, _camPos, maxScreenError);
+			_list.Add(mesh.get(), material.get(), &instance, 1, lod);
+		}
 	}
 
-	void Model::Draw(glm::mat4 _modelMatrix, glm::mat4 _viewMatrix, glm::mat4 _projMatrix, glm::vec3 _camPos)
+	void Model::Enqueue(IndirectDrawList& _list, const std::vector<ModelInstance>& _instances, glm::mat4 _projMatrix, glm::vec3 _camPos)
 	{
-		for (int i = 0; i < m_meshes.size(); i++) 
+		if (_instances.empty()) return;
+
+		float maxScreenError = LOD_SCREEN_ERROR * std::exp2(lodBias);
+
+		for (size_t i = 0; i < m_meshes.size(); i++)
 		{
-			// This activates and prepares the shader
-			m_materials.at(0)->Apply(_modelMatrix, glm::inverse(_modelMatrix), _viewMatrix, _projMatrix, _camPos);
+			std::shared_ptr<Mesh> mesh = m_meshes.at(i);
+			std::shared_ptr<Material> material = m_materials.at(i < m_materials.size() ? i : 0);
+
+			// Quantised positions are relative to the mesh bounds, so map them to model space first
+			glm::mat4 positionDecode = mesh->GetPositionDecode();
+			m_meshInstances.assign(_instances.begin(), _instances.end());
+			for (ModelInstance& instance : m_meshInstances) instance.modelMatrix = instance.modelMatrix * positionDecode;
+
+			size_t lod = SIZE_MAX;
+			for (const ModelInstance& instance : _instances) lod = std::min(lod, mesh->SelectLOD(instance.modelMatrix, _projMatrix, _camPos, maxScreenError));
 
-			// Bind vertex arrays and ask openGL to draw
-			m_meshes.at(0)->Draw();
+			_list.Add(mesh.get(), material.get(), m_meshInstances.data(), m_meshInstances.size(), lod);
+		}
+	}
+
+	void Model::Enqueue(CommandBuffer& _buffer, glm::mat4 _modelMatrix, glm::mat4 _projMatrix, glm::vec3 _camPos) const
+	{
+		float maxScreenError = LOD_SCREEN_ERROR * std::exp2(lodBias);
+
+		for (size_t i = 0; i < m_meshes.size(); i++)
+		{
+			Mesh* mesh = m_meshes.at(i).get();
+			size_t lod = mesh->SelectLOD(_modelMatrix, _projMatrix, _camPos, maxScreenError);
+			_buffer.Add(mesh, m_materials.at(i < m_materials.size() ? i : 0).get(), _modelMatrix, lod);
 		}
 	}
 }
\ No newline at end of file
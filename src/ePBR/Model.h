@@ -7,6 +7,13 @@
 
 #include <glm/glm.hpp>
 
+#include "ImportOptions.h"
+#include "Instancing.h"
+#include "IndirectDraw.h"
+#include "RenderQueue.h"
+#include "Culling.h"
+#include "Occlusion.h"
+
 namespace ePBR 
 {
 	class Material;
@@ -18,7 +25,21 @@ namespace ePBR
 		std::vector<std::shared_ptr<Mesh>> m_meshes;
 		std::vector<std::shared_ptr<Material>> m_materials;
 
+		// Union of the meshes' bounds, in model space
+		glm::vec3 m_boundsMin;
+		glm::vec3 m_boundsMax;
+		BoundingSphere m_boundingSphere;
+
+		// Kept between instanced draws to save reallocating them
+		std::vector<ModelInstance> m_meshInstances;
+		IndirectDrawList m_drawList;
+
+		// Recombine the meshes' bounds
+		void UpdateBounds();
+
 	public:
+		Model();
+
 		/// @brief Get this Model's meshes.
 		/// @return A vector containing this Model's meshes
 		std::vector<std::shared_ptr<Mesh>> GetMeshes() { return m_meshes; }
@@ -37,16 +58,74 @@ namespace ePBR
 		/// @param _newMesh The new Mesh.
 		void SetMesh(int _index, std::shared_ptr<Mesh> _newMesh);
 
+		/// @brief Get the minimum corner of the bounds enclosing every mesh, in model space.
+		/// @return The minimum corner.
+		glm::vec3 GetBoundsMin() const { return m_boundsMin; }
+
+		/// @brief Get the maximum corner of the bounds enclosing every mesh, in model space.
+		/// @return The maximum corner.
+		glm::vec3 GetBoundsMax() const { return m_boundsMax; }
+
+		/// @brief Get a sphere enclosing every mesh, in model space.
+		/// @return The sphere.
+		const BoundingSphere& GetBoundingSphere() const { return m_boundingSphere; }
+
 		/// @brief Load a model from a file. (WARNING - NOT VALIDATED)
 		/// @param _filename The path to the model to load.
-		void Load(const std::string& _filename);
+		/// @param _options Processing to apply to the imported geometry.
+		void Load(const std::string& _filename, const ImportOptions& _options = ImportOptions());
+
+		/// @brief Set the level of detail bias shared by every model. Each step up doubles the on-screen error allowed before switching to a coarser level.
+		/// @param _bias The bias. 0 allows about a pixel of error at 1080p, negative values favour detail.
+		static void SetLODBias(float _bias);
 
-		/// @brief Draw a model.
+		/// @brief Get the level of detail bias shared by every model.
+		/// @return The bias.
+		static float GetLODBias();
+
+		/// @brief Draw a model, each mesh at the coarsest level of detail which looks the same at its size on screen.
 		/// @param _modelMatrix The model matrix.
 		/// @param _viewMatrix The view matrix.
 		/// @param _projMatrix The projection matrix.
 		/// @param _camPos The position of the camera.
 		void Draw(glm::mat4 _modelMatrix, glm::mat4 _viewMatrix, glm::mat4 _projMatrix, glm::vec3 _camPos);
+
+		/// @brief Draw many copies of a model, with one indirect multi-draw call per material.
+		/// @details Every copy of a mesh is drawn at the level of detail its nearest copy needs.
+		/// Meshes with their own vertex array, materials without an instanced variant and frames past MAX_INSTANCES_PER_FRAME fall back to drawing copies one at a time, without the per-instance material modifiers.
+		/// @param _instances The copies, each with its own model matrix and material modifiers.
+		/// @param _viewMatrix The view matrix.
+		/// @param _projMatrix The projection matrix.
+		/// @param _camPos The position of the camera.
+		void DrawInstanced(const std::vector<ModelInstance>& _instances, glm::mat4 _viewMatrix, glm::mat4 _projMatrix, glm::vec3 _camPos);
+
+		/// @brief Add the occluders of this model's meshes to an occlusion culler.
+		/// @param _culler The culler.
+		/// @param _modelMatrix The model matrix.
+		void AddOccluders(OcclusionCuller& _culler, const glm::mat4& _modelMatrix) const;
+
+		/// @brief Add a model's meshes to an indirect draw list, each at the coarsest level of detail which looks the same at its size on screen.
+		/// @details Each mesh carries its PBR material's modifiers as instance data, so it looks as Draw() would draw it.
+		/// @param _list The list. The model must outlive its next Submit().
+		/// @param _modelMatrix The model matrix.
+		/// @param _projMatrix The projection matrix.
+		/// @param _camPos The position of the camera.
+		void Enqueue(IndirectDrawList& _list, glm::mat4 _modelMatrix, glm::mat4 _projMatrix, glm::vec3 _camPos);
+
+		/// @brief Add copies of a model's meshes to an indirect draw list, as DrawInstanced() would draw them.
+		/// @param _list The list. The model must outlive its next Submit().
+		/// @param _instances The copies, each with its own model matrix and material modifiers.
+		/// @param _projMatrix The projection matrix.
+		/// @param _camPos The position of the camera.
+		void Enqueue(IndirectDrawList& _list, const std::vector<ModelInstance>& _instances, glm::mat4 _projMatrix, glm::vec3 _camPos);
+
+		/// @brief Record a model's meshes into a render queue's command buffer as packets, each at the coarsest level of detail which looks the same at its size on screen.
+		/// @details Makes no OpenGL calls, so can be called from RenderQueue::Record() workers.
+		/// @param _buffer The buffer. The model must outlive the next RenderQueue::Submit().
+		/// @param _modelMatrix The model matrix.
+		/// @param _projMatrix The projection matrix.
+		/// @param _camPos The position of the camera.
+		void Enqueue(CommandBuffer& _buffer, glm::mat4 _modelMatrix, glm::mat4 _projMatrix, glm::vec3 _camPos) const;
 	};
 }
 
@@ -0,0 +1,471 @@
+#include "OBJParser.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+
+namespace ePBR
+{
+	namespace
+	{
+		inline bool IsBlank(char _c)
+		{
+			return _c == ' ' || _c == '\t' || _c == '\r';
+		}
+
+		inline const char* SkipBlanks(const char* _p, const char* _end)
+		{
+			while (_p < _end && IsBlank(*_p)) ++_p;
+			return _p;
+		}
+
+		inline const char* FindLineEnd(const char* _p, const char* _end)
+		{
+			const char* newline = (const char*)memchr(_p, '\n', _end - _p);
+			return newline ? newline : _end;
+		}
+
+		inline const char* NextLine(const char* _lineEnd, const char* _end)
+		{
+			return _lineEnd < _end ? _lineEnd + 1 : _end;
+		}
+
+		inline const char* ParseFloat(const char* _p, const char* _end, float& _out)
+		{
+			_p = SkipBlanks(_p, _end);
+
+			// from_chars does not accept an explicit plus sign
+			if (_p < _end && *_p == '+') ++_p;
+
+			std::from_chars_result result = std::from_chars(_p, _end, _out);
+			if (result.ec == std::errc())
+			{
+				return result.ptr;
+			}
+
+			// Values too small or large for a float still consume their characters
+			_out = 0.0f;
+			return result.ec == std::errc::result_out_of_range ? result.ptr : _p;
+		}
+
+		inline const char* ParseIndex(const char* _p, const char* _end, int& _out)
+		{
+			bool negative = false;
+			if (_p < _end && (*_p == '-' || *_p == '+'))
+			{
+				negative = *_p == '-';
+				++_p;
+			}
+
+			int value = 0;
+			while (_p < _end && (unsigned int)(*_p - '0') < 10)
+			{
+				value = value * 10 + (*_p - '0');
+				++_p;
+			}
+
+			_out = negative ? -value : value;
+			return _p;
+		}
+
+		// Chunks are parsed without knowing how many attributes came before them. Relative (negative) indices
+		// are therefore stored against the chunk's own arrays, flagged, and resolved once the chunk offsets are known.
+		const unsigned int RELATIVE_INDEX_FLAG = 0x80000000u;
+
+		// Parallel parsing is only worth it for chunks at least this large
+		const size_t MIN_CHUNK_BYTES = 256 * 1024;
+
+		// Stays within a chunk while the index is absolute; flags it for later otherwise. 0 stays 0 (missing).
+		inline unsigned int EncodeIndex(int _index, size_t _chunkCount, bool& _hasRelative)
+		{
+			if (_index >= 0) return (unsigned int)_index;
+
+			// 0-based position relative to the start of this chunk's array, possibly negative
+			long long chunkRelative = (long long)_chunkCount + _index;
+			_hasRelative = true;
+			return ((unsigned int)chunkRelative & ~RELATIVE_INDEX_FLAG) | RELATIVE_INDEX_FLAG;
+		}
+
+		inline unsigned int ResolveIndex(unsigned int _index, size_t _chunkOffset)
+		{
+			if (!(_index & RELATIVE_INDEX_FLAG)) return _index;
+
+			// Sign extend the 31 bit chunk relative index
+			int chunkRelative = (int)(_index << 1) >> 1;
+			long long absolute = (long long)_chunkOffset + chunkRelative + 1;
+			return absolute > 0 ? (unsigned int)absolute : 0;
+		}
+
+		struct Chunk
+		{
+			const char* begin;
+			const char* end;
+			OBJData data;
+			bool hasRelative;
+
+			// Where this chunk's arrays start in the merged output
+			size_t positionOffset;
+			size_t uvOffset;
+			size_t normalOffset;
+			size_t cornerOffset;
+		};
+
+		inline const char* ParseCorner(const char* _p, const char* _end, Chunk& _chunk, OBJCorner& _out)
+		{
+			int position = 0;
+			int uv = 0;
+			int normal = 0;
+
+			_p = ParseIndex(_p, _end, position);
+			if (_p < _end && *_p == '/')
+			{
+				++_p;
+				// v//vn has no texture coordinate
+				if (_p < _end && *_p != '/')
+				{
+					_p = ParseIndex(_p, _end, uv);
+				}
+				if (_p < _end && *_p == '/')
+				{
+					_p = ParseIndex(_p + 1, _end, normal);
+				}
+			}
+
+			_out.position = EncodeIndex(position, _chunk.data.positions.size(), _chunk.hasRelative);
+			_out.uv = EncodeIndex(uv, _chunk.data.uvs.size(), _chunk.hasRelative);
+			_out.normal = EncodeIndex(normal, _chunk.data.normals.size(), _chunk.hasRelative);
+
+			// Skip anything we don't understand up to the next corner
+			while (_p < _end && !IsBlank(*_p)) ++_p;
+			return _p;
+		}
+
+		void ParseFace(const char* _p, const char* _end, Chunk& _chunk)
+		{
+			std::vector<OBJCorner>& corners = _chunk.data.corners;
+			OBJCorner first, previous, current;
+			int cornerCount = 0;
+
+			for (_p = SkipBlanks(_p, _end); _p < _end; _p = SkipBlanks(_p, _end))
+			{
+				_p = ParseCorner(_p, _end, _chunk, current);
+
+				// Fan triangulation of polygons: (0, n-1, n)
+				if (cornerCount >= 2)
+				{
+					corners.push_back(first);
+					corners.push_back(previous);
+					corners.push_back(current);
+				}
+				else if (cornerCount == 0)
+				{
+					first = current;
+				}
+
+				previous = current;
+				cornerCount++;
+			}
+		}
+
+		// Quick pass over the line starts so the attribute arrays only allocate once.
+		void ReserveOBJData(const char* _begin, const char* _end, OBJData& _data)
+		{
+			size_t positions = 0;
+			size_t uvs = 0;
+			size_t normals = 0;
+			size_t faces = 0;
+
+			for (const char* line = _begin; line < _end; line = NextLine(FindLineEnd(line, _end), _end))
+			{
+				if (*line == 'v' && line + 1 < _end)
+				{
+					char next = line[1];
+					if (next == 't') uvs++;
+					else if (next == 'n') normals++;
+					else if (IsBlank(next)) positions++;
+				}
+				else if (*line == 'f')
+				{
+					faces++;
+				}
+			}
+
+			_data.positions.reserve(positions);
+			_data.uvs.reserve(uvs);
+			_data.normals.reserve(normals);
+			_data.corners.reserve(faces * 3);
+		}
+
+		void ParseChunk(Chunk& _chunk)
+		{
+			const char* begin = _chunk.begin;
+			const char* end = _chunk.end;
+			OBJData& data = _chunk.data;
+
+			ReserveOBJData(begin, end, data);
+
+			const char* lineEnd = begin;
+			for (const char* line = begin; line < end; line = NextLine(lineEnd, end))
+			{
+				lineEnd = FindLineEnd(line, end);
+				const char* p = SkipBlanks(line, lineEnd);
+
+				if (lineEnd - p < 2) continue;
+
+				if (p[0] == 'v')
+				{
+					if (IsBlank(p[1]))
+					{
+						glm::vec3 position;
+						p = ParseFloat(p + 2, lineEnd, position.x);
+						p = ParseFloat(p, lineEnd, position.y);
+						ParseFloat(p, lineEnd, position.z);
+						data.positions.push_back(position);
+					}
+					else if (p[1] == 't')
+					{
+						glm::vec2 uv;
+						p = ParseFloat(p + 2, lineEnd, uv.x);
+						ParseFloat(p, lineEnd, uv.y);
+						data.uvs.push_back(uv);
+					}
+					else if (p[1] == 'n')
+					{
+						glm::vec3 normal;
+						p = ParseFloat(p + 2, lineEnd, normal.x);
+						p = ParseFloat(p, lineEnd, normal.y);
+						ParseFloat(p, lineEnd, normal.z);
+						data.normals.push_back(normal);
+					}
+				}
+				else if (p[0] == 'f' && IsBlank(p[1]))
+				{
+					ParseFace(p + 2, lineEnd, _chunk);
+				}
+			}
+		}
+
+		void ResolveCorners(OBJCorner* _begin, OBJCorner* _end, const Chunk& _chunk)
+		{
+			for (OBJCorner* corner = _begin; corner < _end; ++corner)
+			{
+				corner->position = ResolveIndex(corner->position, _chunk.positionOffset);
+				corner->uv = ResolveIndex(corner->uv, _chunk.uvOffset);
+				corner->normal = ResolveIndex(corner->normal, _chunk.normalOffset);
+			}
+		}
+
+		template <typename T>
+		void MoveInto(std::vector<T>& _source, std::vector<T>& _destination, size_t _offset)
+		{
+			std::copy(_source.begin(), _source.end(), _destination.begin() + _offset);
+			std::vector<T>().swap(_source);
+		}
+
+		// Streams written by one range of corners during assembly
+		struct AssemblyRange
+		{
+			size_t firstCorner;
+			size_t lastCorner;
+			size_t positionOffset;
+			size_t uvOffset;
+			size_t normalOffset;
+			size_t positionCount;
+			size_t uvCount;
+			size_t normalCount;
+			bool outOfRange;
+		};
+	}
+
+	void ParseOBJ(const char* _begin, const char* _end, OBJData& _out, ThreadPool* _pool)
+	{
+		const size_t size = _end - _begin;
+		size_t chunkCount = 1;
+
+		if (_pool && _pool->GetThreadCount() > 1)
+		{
+			// A few chunks per thread keeps the threads busy when some chunks are all faces and others all vertices
+			chunkCount = std::min(std::max<size_t>(size / MIN_CHUNK_BYTES, 1), (size_t)_pool->GetThreadCount() * 4);
+		}
+
+		// Split at line boundaries
+		std::vector<Chunk> chunks(chunkCount);
+		const char* chunkBegin = _begin;
+		for (size_t i = 0; i < chunkCount; i++)
+		{
+			const char* chunkEnd = _end;
+			if (i + 1 < chunkCount)
+			{
+				chunkEnd = std::max(chunkBegin, _begin + size * (i + 1) / chunkCount);
+				chunkEnd = NextLine(FindLineEnd(chunkEnd, _end), _end);
+			}
+
+			chunks[i].begin = chunkBegin;
+			chunks[i].end = chunkEnd;
+			chunks[i].hasRelative = false;
+			chunkBegin = chunkEnd;
+		}
+
+		if (chunkCount == 1)
+		{
+			Chunk& chunk = chunks[0];
+			ParseChunk(chunk);
+
+			chunk.positionOffset = chunk.uvOffset = chunk.normalOffset = chunk.cornerOffset = 0;
+			if (chunk.hasRelative)
+			{
+				ResolveCorners(chunk.data.corners.data(), chunk.data.corners.data() + chunk.data.corners.size(), chunk);
+			}
+
+			_out = std::move(chunk.data);
+			return;
+		}
+
+		_pool->ParallelFor(chunkCount, [&](size_t _index) { ParseChunk(chunks[_index]); });
+
+		// Prefix sum of the chunk sizes gives each chunk its place in the merged arrays
+		size_t positions = 0, uvs = 0, normals = 0, corners = 0;
+		for (Chunk& chunk : chunks)
+		{
+			chunk.positionOffset = positions;
+			chunk.uvOffset = uvs;
+			chunk.normalOffset = normals;
+			chunk.cornerOffset = corners;
+
+			positions += chunk.data.positions.size();
+			uvs += chunk.data.uvs.size();
+			normals += chunk.data.normals.size();
+			corners += chunk.data.corners.size();
+		}
+
+		_out.positions.resize(positions);
+		_out.uvs.resize(uvs);
+		_out.normals.resize(normals);
+		_out.corners.resize(corners);
+
+		_pool->ParallelFor(chunkCount, [&](size_t _index)
+		{
+			Chunk& chunk = chunks[_index];
+
+			if (chunk.hasRelative)
+			{
+				ResolveCorners(chunk.data.corners.data(), chunk.data.corners.data() + chunk.data.corners.size(), chunk);
+			}
+
+			MoveInto(chunk.data.positions, _out.positions, chunk.positionOffset);
+			MoveInto(chunk.data.uvs, _out.uvs, chunk.uvOffset);
+			MoveInto(chunk.data.normals, _out.normals, chunk.normalOffset);
+			MoveInto(chunk.data.corners, _out.corners, chunk.cornerOffset);
+		});
+	}
+
+	bool LoadOBJFile(const std::string& _filename, OBJData& _out, ThreadPool* _pool)
+	{
+		MappedFile file;
+		if (!file.Open(_filename))
+		{
+			std::cerr << "WARNING: File not found: " << _filename << std::endl;
+			return false;
+		}
+
+		ParseOBJ(file.GetData(), file.GetData() + file.GetSize(), _out, _pool);
+		return true;
+	}
+
+	void AssembleOBJStreams(const OBJData& _data, std::vector<glm::vec3>& _positions, std::vector<glm::vec2>& _uvs, std::vector<glm::vec3>& _normals, ThreadPool* _pool)
+	{
+		const size_t numPositions = _data.positions.size();
+		const size_t numUVs = _data.uvs.size();
+		const size_t numNormals = _data.normals.size();
+		const size_t numCorners = _data.corners.size();
+
+		size_t rangeCount = 1;
+		if (_pool && _pool->GetThreadCount() > 1)
+		{
+			rangeCount = std::min(std::max<size_t>(numCorners / (64 * 1024), 1), (size_t)_pool->GetThreadCount() * 4);
+		}
+
+		std::vector<AssemblyRange> ranges(rangeCount);
+		for (size_t i = 0; i < rangeCount; i++)
+		{
+			ranges[i].firstCorner = numCorners * i / rangeCount;
+			ranges[i].lastCorner = numCorners * (i + 1) / rangeCount;
+		}
+
+		// Corners missing an attribute write nothing, so count what each range writes before placing it
+		auto countRange = [&](size_t _index)
+		{
+			AssemblyRange& range = ranges[_index];
+			range.positionCount = range.uvCount = range.normalCount = 0;
+			range.outOfRange = false;
+
+			for (size_t i = range.firstCorner; i < range.lastCorner; i++)
+			{
+				const OBJCorner& corner = _data.corners[i];
+				if (corner.position > 0)
+				{
+					if (corner.position <= numPositions) range.positionCount++;
+					else range.outOfRange = true;
+				}
+				if (corner.uv > 0)
+				{
+					if (corner.uv <= numUVs) range.uvCount++;
+					else range.outOfRange = true;
+				}
+				if (corner.normal > 0)
+				{
+					if (corner.normal <= numNormals) range.normalCount++;
+					else range.outOfRange = true;
+				}
+			}
+		};
+
+		auto fillRange = [&](size_t _index)
+		{
+			const AssemblyRange& range = ranges[_index];
+			glm::vec3* position = _positions.data() + range.positionOffset;
+			glm::vec2* uv = _uvs.data() + range.uvOffset;
+			glm::vec3* normal = _normals.data() + range.normalOffset;
+
+			for (size_t i = range.firstCorner; i < range.lastCorner; i++)
+			{
+				const OBJCorner& corner = _data.corners[i];
+				if (corner.position > 0 && corner.position <= numPositions) *position++ = _data.positions[corner.position - 1];
+				if (corner.uv > 0 && corner.uv <= numUVs) *uv++ = _data.uvs[corner.uv - 1];
+				if (corner.normal > 0 && corner.normal <= numNormals) *normal++ = _data.normals[corner.normal - 1];
+			}
+		};
+
+		if (rangeCount > 1) _pool->ParallelFor(rangeCount, countRange);
+		else countRange(0);
+
+		size_t positions = 0, uvs = 0, normals = 0;
+		bool outOfRange = false;
+		for (AssemblyRange& range : ranges)
+		{
+			range.positionOffset = positions;
+			range.uvOffset = uvs;
+			range.normalOffset = normals;
+
+			positions += range.positionCount;
+			uvs += range.uvCount;
+			normals += range.normalCount;
+			outOfRange = outOfRange || range.outOfRange;
+		}
+
+		_positions.resize(positions);
+		_uvs.resize(uvs);
+		_normals.resize(normals);
+
+		if (rangeCount > 1) _pool->ParallelFor(rangeCount, fillRange);
+		else fillRange(0);
+
+		if (outOfRange)
+		{
+			std::cerr << "WARNING: OBJ face references a vertex attribute which does not exist. It has been skipped." << std::endl;
+		}
+	}
+}
@@ -0,0 +1,57 @@
+#ifndef EPBR_OBJ_PARSER
+#define EPBR_OBJ_PARSER
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace ePBR
+{
+	class ThreadPool;
+
+	/// @brief One corner of a face read from an OBJ file.
+	/// @details Indices are 1-based into the raw attribute arrays of OBJData. 0 marks an attribute the corner does not reference.
+	struct OBJCorner
+	{
+		unsigned int position;
+		unsigned int uv;
+		unsigned int normal;
+	};
+
+	/// @brief The raw contents of a wavefront OBJ file. Every three corners make up one triangle.
+	struct OBJData
+	{
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec2> uvs;
+		std::vector<glm::vec3> normals;
+		std::vector<OBJCorner> corners;
+	};
+
+	/// @brief Tokenise OBJ text in place.
+	/// @details Only v, vt, vn and f statements are read. Polygons with more than three corners are triangulated as fans.
+	/// When a pool is given, the text is split at line boundaries and the chunks are parsed on its threads into chunk-local arrays.
+	/// A prefix sum over the chunk sizes then places them and fixes up relative indices, so the result is identical to a serial parse.
+	/// @param _begin The first character of the OBJ text.
+	/// @param _end One past the last character of the OBJ text.
+	/// @param _out The OBJData to fill. Any existing contents are replaced.
+	/// @param _pool The threads to parse on, or nullptr to parse on the calling thread.
+	void ParseOBJ(const char* _begin, const char* _end, OBJData& _out, ThreadPool* _pool = nullptr);
+
+	/// @brief Memory map and parse a wavefront OBJ file.
+	/// @param _filename The path to the OBJ file.
+	/// @param _out The OBJData to fill. Any existing contents are replaced.
+	/// @param _pool The threads to parse on, or nullptr to parse on the calling thread.
+	/// @return Whether the file could be opened.
+	bool LoadOBJFile(const std::string& _filename, OBJData& _out, ThreadPool* _pool = nullptr);
+
+	/// @brief Un-index parsed OBJ faces into per-corner vertex streams, in face order. Corners missing an attribute add nothing to that stream.
+	/// @param _data The parsed OBJ file.
+	/// @param _positions Receives one position per corner. Existing contents are replaced.
+	/// @param _uvs Receives one texture coordinate per corner. Existing contents are replaced.
+	/// @param _normals Receives one normal per corner. Existing contents are replaced.
+	/// @param _pool The threads to assemble on, or nullptr to assemble on the calling thread.
+	void AssembleOBJStreams(const OBJData& _data, std::vector<glm::vec3>& _positions, std::vector<glm::vec2>& _uvs, std::vector<glm::vec3>& _normals, ThreadPool* _pool = nullptr);
+}
+
+#endif // EPBR_OBJ_PARSER
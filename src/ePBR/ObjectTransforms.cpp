@@ -0,0 +1,151 @@
+#include "ObjectTransforms.h"
+#include "Simd.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace ePBR
+{
+	namespace
+	{
+		// Objects per task, a multiple of the lane count
+		const size_t TRANSFORM_CHUNK_SIZE = 4096;
+
+		// Four matrices, one per lane, indexed [column][row] as glm is
+		struct Matrix4
+		{
+			Float4 m[4][4];
+		};
+
+		void Load(const glm::mat4* _matrices, Matrix4& _out)
+		{
+			for (int column = 0; column < 4; column++)
+			{
+				Float4 a = Float4::LoadUnaligned(&_matrices[0][column][0]);
+				Float4 b = Float4::LoadUnaligned(&_matrices[1][column][0]);
+				Float4 c = Float4::LoadUnaligned(&_matrices[2][column][0]);
+				Float4 d = Float4::LoadUnaligned(&_matrices[3][column][0]);
+				Transpose(a, b, c, d);
+				_out.m[column][0] = a;
+				_out.m[column][1] = b;
+				_out.m[column][2] = c;
+				_out.m[column][3] = d;
+			}
+		}
+
+		// Turn lanes back into one matrix per object, _out[object][column]
+		void Unpack(const Matrix4& _matrices, Float4 _out[4][4])
+		{
+			for (int column = 0; column < 4; column++)
+			{
+				Float4 a = _matrices.m[column][0];
+				Float4 b = _matrices.m[column][1];
+				Float4 c = _matrices.m[column][2];
+				Float4 d = _matrices.m[column][3];
+				Transpose(a, b, c, d);
+				_out[0][column] = a;
+				_out[1][column] = b;
+				_out[2][column] = c;
+				_out[3][column] = d;
+			}
+		}
+
+		void Cross(const Float4 _a[4], const Float4 _b[4], Float4 _out[4])
+		{
+			_out[0] = _a[1] * _b[2] - _a[2] * _b[1];
+			_out[1] = _a[2] * _b[0] - _a[0] * _b[2];
+			_out[2] = _a[0] * _b[1] - _a[1] * _b[0];
+		}
+
+		void ComputeFour(const glm::mat4* _modelMatrices, const GLuint* _materialIndices, const Float4 _viewProj[4][4], ObjectData* _objects)
+		{
+			Matrix4 model;
+			Load(_modelMatrices, model);
+
+			Matrix4 mvp;
+			for (int column = 0; column < 4; column++)
+			{
+				for (int row = 0; row < 4; row++)
+				{
+					mvp.m[column][row] = _viewProj[0][row] * model.m[column][0] + _viewProj[1][row] * model.m[column][1] + _viewProj[2][row] * model.m[column][2] + _viewProj[3][row] * model.m[column][3];
+				}
+			}
+
+			// The inverse transpose of a 3x3 is its cofactor matrix over its determinant, and the cofactor columns are cross products of the other two
+			Matrix4 normal;
+			Cross(model.m[1], model.m[2], normal.m[0]);
+			Cross(model.m[2], model.m[0], normal.m[1]);
+			Cross(model.m[0], model.m[1], normal.m[2]);
+			Float4 invDet = Float4(1.0f) / (model.m[0][0] * normal.m[0][0] + model.m[0][1] * normal.m[0][1] + model.m[0][2] * normal.m[0][2]);
+			for (int column = 0; column < 3; column++)
+			{
+				for (int row = 0; row < 3; row++) normal.m[column][row] = normal.m[column][row] * invDet;
+				normal.m[column][3] = Float4(0.0f);
+			}
+			normal.m[3][0] = normal.m[3][1] = normal.m[3][2] = Float4(0.0f);
+			normal.m[3][3] = Float4(1.0f);
+
+			Float4 normals[4][4];
+			Float4 mvps[4][4];
+			Unpack(normal, normals);
+			Unpack(mvp, mvps);
+
+			// Each object is written front to back, which suits write combined mapped memory
+			for (int i = 0; i < 4; i++)
+			{
+				ObjectData& object = _objects[i];
+				for (int column = 0; column < 4; column++) Float4::LoadUnaligned(&_modelMatrices[i][column][0]).StoreUnaligned(&object.modelMatrix[column][0]);
+				for (int column = 0; column < 4; column++) normals[i][column].StoreUnaligned(&object.normalMatrix[column][0]);
+				for (int column = 0; column < 4; column++) mvps[i][column].StoreUnaligned(&object.mvpMatrix[column][0]);
+
+				GLuint tail[4] = { _materialIndices ? _materialIndices[i] : 0, 0, 0, 0 };
+				memcpy(&object.materialIndex, tail, sizeof(tail));
+			}
+		}
+
+		void ComputeOne(const glm::mat4& _modelMatrix, GLuint _materialIndex, const glm::mat4& _viewProjMatrix, ObjectData& _object)
+		{
+			glm::mat3 linear(_modelMatrix);
+			glm::mat3 normal(glm::cross(linear[1], linear[2]), glm::cross(linear[2], linear[0]), glm::cross(linear[0], linear[1]));
+			normal /= glm::dot(linear[0], normal[0]);
+
+			ObjectData object;
+			object.modelMatrix = _modelMatrix;
+			object.normalMatrix = glm::mat4(normal);
+			object.mvpMatrix = _viewProjMatrix * _modelMatrix;
+			object.materialIndex = _materialIndex;
+			_object = object;
+		}
+
+		void ComputeRange(const glm::mat4* _modelMatrices, const GLuint* _materialIndices, size_t _begin, size_t _end, const glm::mat4& _viewProjMatrix, ObjectData* _objects)
+		{
+			Float4 viewProj[4][4];
+			for (int column = 0; column < 4; column++)
+			{
+				for (int row = 0; row < 4; row++) viewProj[column][row] = Float4(_viewProjMatrix[column][row]);
+			}
+
+			size_t i = _begin;
+			for (; i + 4 <= _end; i += 4) ComputeFour(_modelMatrices + i, _materialIndices ? _materialIndices + i : nullptr, viewProj, _objects + i);
+			for (; i < _end; i++) ComputeOne(_modelMatrices[i], _materialIndices ? _materialIndices[i] : 0, _viewProjMatrix, _objects[i]);
+		}
+	}
+
+	void ComputeObjectData(const glm::mat4* _modelMatrices, const GLuint* _materialIndices, size_t _count, const glm::mat4& _viewProjMatrix, ObjectData* _objects, ThreadPool* _pool)
+	{
+		size_t chunkCount = (_count + TRANSFORM_CHUNK_SIZE - 1) / TRANSFORM_CHUNK_SIZE;
+		if (_pool && chunkCount > 1)
+		{
+			_pool->ParallelFor(chunkCount, [&](size_t _chunk)
+			{
+				size_t begin = _chunk * TRANSFORM_CHUNK_SIZE;
+				ComputeRange(_modelMatrices, _materialIndices, begin, std::min(begin + TRANSFORM_CHUNK_SIZE, _count), _viewProjMatrix, _objects);
+			});
+		}
+		else
+		{
+			ComputeRange(_modelMatrices, _materialIndices, 0, _count, _viewProjMatrix, _objects);
+		}
+	}
+}
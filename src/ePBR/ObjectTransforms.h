@@ -0,0 +1,27 @@
+#ifndef EPBR_OBJECT_TRANSFORMS
+#define EPBR_OBJECT_TRANSFORMS
+
+#include "ShaderBlocks.h"
+
+#include <cstddef>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+namespace ePBR
+{
+	class ThreadPool;
+
+	/// @brief Fill the ObjectData of many objects at once: the model matrix, the inverse transpose of its upper 3x3 for normals, and the model view projection matrix.
+	/// @details Objects are done four at a time, one per SIMD lane, with the normal matrix built from cross products rather than a general inverse.
+	/// Each object is written whole and in order, and nothing is read back, so _objects can be a mapped buffer from MapObjects(). Large batches are split across the pool.
+	/// @param _modelMatrices The model matrix of each object.
+	/// @param _materialIndices The TextureResidency record of each object, or nullptr for 0.
+	/// @param _count The number of objects.
+	/// @param _viewProjMatrix The projection matrix times the view matrix, shared by every object.
+	/// @param _objects Receives each object's data.
+	/// @param _pool The pool to split large batches across, or nullptr to run on the calling thread alone.
+	void ComputeObjectData(const glm::mat4* _modelMatrices, const GLuint* _materialIndices, size_t _count, const glm::mat4& _viewProjMatrix, ObjectData* _objects, ThreadPool* _pool = nullptr);
+}
+
+#endif // EPBR_OBJECT_TRANSFORMS
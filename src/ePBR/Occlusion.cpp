@@ -0,0 +1,264 @@
+#include "Occlusion.h"
+#include "Simd.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+namespace ePBR
+{
+	namespace
+	{
+		// Window space x, y and depth of a clip space position in front of the near plane
+		glm::vec3 ToWindow(const glm::vec4& _clip, int _width, int _height)
+		{
+			glm::vec3 ndc = glm::vec3(_clip) / _clip.w;
+			return glm::vec3((ndc.x * 0.5f + 0.5f) * _width, (ndc.y * 0.5f + 0.5f) * _height, std::min(ndc.z * 0.5f + 0.5f, 1.0f));
+		}
+
+		// In front of the near plane, and far enough from the eye to divide by
+		bool InFrontOfNear(const glm::vec4& _clip)
+		{
+			return _clip.w > 1e-6f && _clip.z >= -_clip.w;
+		}
+
+		// The edge from _a to _b as A * x + B * y + C, positive on the inside of an anticlockwise triangle
+		glm::vec3 EdgeFunction(const glm::vec3& _a, const glm::vec3& _b)
+		{
+			return glm::vec3(_a.y - _b.y, _b.x - _a.x, (_b.y - _a.y) * _a.x - (_b.x - _a.x) * _a.y);
+		}
+	}
+
+	void BuildOccluder(MeshData& _data)
+	{
+		_data.occluder = OccluderMesh();
+
+		// The coarsest level, or the full mesh, which comes first in the index buffer
+		size_t indexOffset = 0;
+		size_t indexCount = _data.indices.size();
+		if (!_data.lods.empty())
+		{
+			indexOffset = _data.lods.back().indexOffset;
+			indexCount = _data.lods.back().indexCount;
+		}
+		indexCount -= indexCount % 3;
+
+		// Keep only the vertices the level uses
+		std::unordered_map<unsigned int, unsigned int> remap;
+		_data.occluder.indices.reserve(indexCount);
+		for (size_t i = indexOffset; i < indexOffset + indexCount; i++)
+		{
+			auto found = remap.emplace(_data.indices[i], (unsigned int)_data.occluder.positions.size());
+			if (found.second) _data.occluder.positions.push_back(_data.positions[_data.indices[i]]);
+			_data.occluder.indices.push_back(found.first->second);
+		}
+	}
+
+	OcclusionCuller::OcclusionCuller(int _width, int _height) :
+		m_viewProjection(1.0f)
+	{
+		m_binsX = std::max(1, (_width + OCCLUSION_BIN_WIDTH - 1) / OCCLUSION_BIN_WIDTH);
+		m_binsY = std::max(1, (_height + OCCLUSION_BIN_HEIGHT - 1) / OCCLUSION_BIN_HEIGHT);
+		m_width = m_binsX * OCCLUSION_BIN_WIDTH;
+		m_height = m_binsY * OCCLUSION_BIN_HEIGHT;
+
+		m_depth.assign((size_t)m_width * m_height, 1.0f);
+		m_tileMax.assign((size_t)(m_width / OCCLUSION_TILE_WIDTH) * (m_height / OCCLUSION_TILE_HEIGHT), 1.0f);
+		m_binTriangles.resize((size_t)m_binsX * m_binsY);
+	}
+
+	void OcclusionCuller::Begin(const glm::mat4& _viewProjection)
+	{
+		m_viewProjection = _viewProjection;
+
+		std::fill(m_depth.begin(), m_depth.end(), 1.0f);
+		std::fill(m_tileMax.begin(), m_tileMax.end(), 1.0f);
+
+		m_triangles.clear();
+		for (std::vector<unsigned int>& bin : m_binTriangles) bin.clear();
+	}
+
+	void OcclusionCuller::AddOccluder(const OccluderMesh& _occluder, const glm::mat4& _modelMatrix)
+	{
+		glm::mat4 modelViewProjection = m_viewProjection * _modelMatrix;
+
+		m_clipPositions.resize(_occluder.positions.size());
+		for (size_t i = 0; i < _occluder.positions.size(); i++)
+		{
+			m_clipPositions[i] = modelViewProjection * glm::vec4(_occluder.positions[i], 1.0f);
+		}
+
+		for (size_t i = 0; i + 2 < _occluder.indices.size(); i += 3)
+		{
+			const glm::vec4& a = m_clipPositions[_occluder.indices[i]];
+			const glm::vec4& b = m_clipPositions[_occluder.indices[i + 1]];
+			const glm::vec4& c = m_clipPositions[_occluder.indices[i + 2]];
+
+			// Dropping a triangle only ever hides less, so those crossing the near plane aren't worth clipping
+			if (!InFrontOfNear(a) || !InFrontOfNear(b) || !InFrontOfNear(c)) continue;
+
+			ScreenTriangle triangle;
+			triangle.vertices[0] = ToWindow(a, m_width, m_height);
+			triangle.vertices[1] = ToWindow(b, m_width, m_height);
+			triangle.vertices[2] = ToWindow(c, m_width, m_height);
+
+			// Either face hides what is behind it, so wind every triangle the same way
+			glm::vec2 edge1 = glm::vec2(triangle.vertices[1] - triangle.vertices[0]);
+			glm::vec2 edge2 = glm::vec2(triangle.vertices[2] - triangle.vertices[0]);
+			float area = edge1.x * edge2.y - edge1.y * edge2.x;
+			if (area == 0.0f) continue;
+			if (area < 0.0f) std::swap(triangle.vertices[1], triangle.vertices[2]);
+
+			// Pixels whose centres the bounds take in
+			glm::vec3 low = glm::min(triangle.vertices[0], glm::min(triangle.vertices[1], triangle.vertices[2]));
+			glm::vec3 high = glm::max(triangle.vertices[0], glm::max(triangle.vertices[1], triangle.vertices[2]));
+			triangle.minX = std::max(0, (int)std::ceil(low.x - 0.5f));
+			triangle.minY = std::max(0, (int)std::ceil(low.y - 0.5f));
+			triangle.maxX = std::min(m_width - 1, (int)std::floor(high.x - 0.5f));
+			triangle.maxY = std::min(m_height - 1, (int)std::floor(high.y - 0.5f));
+			if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) continue;
+
+			unsigned int index = (unsigned int)m_triangles.size();
+			m_triangles.push_back(triangle);
+
+			for (int binY = triangle.minY / OCCLUSION_BIN_HEIGHT; binY <= triangle.maxY / OCCLUSION_BIN_HEIGHT; binY++)
+			{
+				for (int binX = triangle.minX / OCCLUSION_BIN_WIDTH; binX <= triangle.maxX / OCCLUSION_BIN_WIDTH; binX++)
+				{
+					m_binTriangles[(size_t)binY * m_binsX + binX].push_back(index);
+				}
+			}
+		}
+	}
+
+	void OcclusionCuller::Rasterise(ThreadPool* _pool)
+	{
+		size_t binCount = m_binTriangles.size();
+		auto rasteriseBin = [this](size_t _bin) { RasteriseBin(_bin); };
+
+		if (_pool && !m_triangles.empty()) _pool->ParallelFor(binCount, rasteriseBin);
+		else for (size_t b = 0; b < binCount; b++) rasteriseBin(b);
+	}
+
+	void OcclusionCuller::RasteriseBin(size_t _bin)
+	{
+		int binX0 = (int)(_bin % m_binsX) * OCCLUSION_BIN_WIDTH;
+		int binY0 = (int)(_bin / m_binsX) * OCCLUSION_BIN_HEIGHT;
+		int binX1 = binX0 + OCCLUSION_BIN_WIDTH;
+		int binY1 = binY0 + OCCLUSION_BIN_HEIGHT;
+
+		const float laneOffsets[4] = { 0.5f, 1.5f, 2.5f, 3.5f };
+		Float4 lanes = Float4::LoadUnaligned(laneOffsets);
+		Float4 zero(0.0f);
+
+		for (unsigned int index : m_binTriangles[_bin])
+		{
+			const ScreenTriangle& triangle = m_triangles[index];
+			const glm::vec3* v = triangle.vertices;
+
+			// Each edge is named for the vertex opposite it, whose barycentric weight it gives
+			glm::vec3 edges[3] = { EdgeFunction(v[1], v[2]), EdgeFunction(v[2], v[0]), EdgeFunction(v[0], v[1]) };
+			float area = edges[2].x * v[2].x + edges[2].y * v[2].y + edges[2].z;
+
+			// Depth as a plane over the screen, from the weighted vertex depths
+			glm::vec3 depthPlane = (edges[0] * v[0].z + edges[1] * v[1].z + edges[2] * v[2].z) / area;
+
+			Float4 edgeA[3] = { Float4(edges[0].x), Float4(edges[1].x), Float4(edges[2].x) };
+			Float4 depthA(depthPlane.x);
+
+			int minY = std::max(triangle.minY, binY0);
+			int maxY = std::min(triangle.maxY, binY1 - 1);
+			int minX = std::max(triangle.minX, binX0) & ~3;
+			int maxX = std::min(triangle.maxX, binX1 - 1);
+
+			for (int y = minY; y <= maxY; y++)
+			{
+				float centreY = y + 0.5f;
+				Float4 edgeRow[3];
+				for (int e = 0; e < 3; e++) edgeRow[e] = Float4(edges[e].y * centreY + edges[e].z);
+				Float4 depthRow(depthPlane.y * centreY + depthPlane.z);
+
+				float* row = &m_depth[(size_t)y * m_width];
+				for (int x = minX; x <= maxX; x += 4)
+				{
+					// Bins are a whole number of four pixel steps wide, so the last step never leaves the bin
+					Float4 centreX = Float4((float)x) + lanes;
+					Float4 inside = (edgeA[0] * centreX + edgeRow[0] >= zero) & (edgeA[1] * centreX + edgeRow[1] >= zero) & (edgeA[2] * centreX + edgeRow[2] >= zero);
+					if (!MoveMask(inside)) continue;
+
+					Float4 depth = Float4::LoadUnaligned(row + x);
+					Float4 triangleDepth = depthA * centreX + depthRow;
+					Select(inside, Min(depth, triangleDepth), depth).StoreUnaligned(row + x);
+				}
+			}
+		}
+
+		// Refresh the coarse level over this bin alone, as no other task writes to it
+		int tilesX = m_width / OCCLUSION_TILE_WIDTH;
+		for (int tileY = binY0 / OCCLUSION_TILE_HEIGHT; tileY < binY1 / OCCLUSION_TILE_HEIGHT; tileY++)
+		{
+			for (int tileX = binX0 / OCCLUSION_TILE_WIDTH; tileX < binX1 / OCCLUSION_TILE_WIDTH; tileX++)
+			{
+				float farthest = 0.0f;
+				for (int y = tileY * OCCLUSION_TILE_HEIGHT; y < (tileY + 1) * OCCLUSION_TILE_HEIGHT; y++)
+				{
+					const float* row = &m_depth[(size_t)y * m_width + tileX * OCCLUSION_TILE_WIDTH];
+					for (int x = 0; x < OCCLUSION_TILE_WIDTH; x++) farthest = std::max(farthest, row[x]);
+				}
+				m_tileMax[(size_t)tileY * tilesX + tileX] = farthest;
+			}
+		}
+	}
+
+	bool OcclusionCuller::IsVisible(const glm::vec3& _boundsMin, const glm::vec3& _boundsMax, const glm::mat4& _modelMatrix) const
+	{
+		glm::mat4 modelViewProjection = m_viewProjection * _modelMatrix;
+
+		glm::vec3 low(0.0f), high(0.0f);
+		for (int corner = 0; corner < 8; corner++)
+		{
+			glm::vec3 position((corner & 1) ? _boundsMax.x : _boundsMin.x, (corner & 2) ? _boundsMax.y : _boundsMin.y, (corner & 4) ? _boundsMax.z : _boundsMin.z);
+			glm::vec4 clip = modelViewProjection * glm::vec4(position, 1.0f);
+
+			// The camera may be inside or beside the box, so it can't be shown to be hidden
+			if (!InFrontOfNear(clip)) return true;
+
+			glm::vec3 window = ToWindow(clip, m_width, m_height);
+			low = corner ? glm::min(low, window) : window;
+			high = corner ? glm::max(high, window) : window;
+		}
+
+		// Every pixel the box touches
+		int minX = std::max(0, (int)std::floor(low.x));
+		int minY = std::max(0, (int)std::floor(low.y));
+		int maxX = std::min(m_width - 1, (int)std::floor(high.x));
+		int maxY = std::min(m_height - 1, (int)std::floor(high.y));
+		if (minX > maxX || minY > maxY) return false;
+
+		// The box's nearest point must be behind the occluders at every pixel
+		float nearest = low.z;
+		int tilesX = m_width / OCCLUSION_TILE_WIDTH;
+		for (int tileY = minY / OCCLUSION_TILE_HEIGHT; tileY <= maxY / OCCLUSION_TILE_HEIGHT; tileY++)
+		{
+			for (int tileX = minX / OCCLUSION_TILE_WIDTH; tileX <= maxX / OCCLUSION_TILE_WIDTH; tileX++)
+			{
+				// Wholly hidden tiles need no closer look
+				if (m_tileMax[(size_t)tileY * tilesX + tileX] < nearest) continue;
+
+				int y0 = std::max(minY, tileY * OCCLUSION_TILE_HEIGHT), y1 = std::min(maxY, (tileY + 1) * OCCLUSION_TILE_HEIGHT - 1);
+				int x0 = std::max(minX, tileX * OCCLUSION_TILE_WIDTH), x1 = std::min(maxX, (tileX + 1) * OCCLUSION_TILE_WIDTH - 1);
+				for (int y = y0; y <= y1; y++)
+				{
+					const float* row = &m_depth[(size_t)y * m_width];
+					for (int x = x0; x <= x1; x++)
+					{
+						if (row[x] >= nearest) return true;
+					}
+				}
+			}
+		}
+
+		return false;
+	}
+}
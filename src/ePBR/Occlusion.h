@@ -0,0 +1,115 @@
+#ifndef EPBR_OCCLUSION
+#define EPBR_OCCLUSION
+
+#include "MeshData.h"
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace ePBR
+{
+	class ThreadPool;
+
+	/// @brief The default resolution of an OcclusionCuller's depth buffer.
+	const int OCCLUSION_DEFAULT_WIDTH = 320;
+	const int OCCLUSION_DEFAULT_HEIGHT = 192;
+
+	/// @brief Pixels per tile of the coarse depth level, which holds the farthest depth in each tile.
+	const int OCCLUSION_TILE_WIDTH = 8;
+	const int OCCLUSION_TILE_HEIGHT = 8;
+
+	/// @brief Pixels per bin. Each bin is rasterised as one task, so the depth buffer is split between threads without sharing any pixel.
+	const int OCCLUSION_BIN_WIDTH = 64;
+	const int OCCLUSION_BIN_HEIGHT = 32;
+
+	/// @brief Keep a mesh's coarsest level of detail, or its full surface when it has no levels, as its occluder.
+	/// @details Simplification only ever collapses vertices onto others, so the occluder lies within the mesh's bounds and never hides the mesh itself.
+	/// @param _data The mesh. Its occluder is replaced.
+	void BuildOccluder(MeshData& _data);
+
+	/// @brief Hides meshes behind others by rasterising occluders into a small depth buffer on the CPU and testing bounding boxes against it.
+	/// @details Needs no GPU readback, so results are available before anything is submitted and are the same on every run.
+	/// Triangles are binned by screen region and each bin is rasterised as one task, four pixels per SIMD instruction.
+	/// A coarse level holding the farthest depth of each tile lets most boxes be rejected without visiting their pixels.
+	/// Occluder triangles which cross the near plane are dropped, and boxes which cross it are always visible, so the test only ever errs towards drawing.
+	class OcclusionCuller
+	{
+	public:
+		/// @brief Create an occlusion culler.
+		/// @param _width The width of the depth buffer. Rounded up to a whole number of bins.
+		/// @param _height The height of the depth buffer. Rounded up to a whole number of bins.
+		OcclusionCuller(int _width = OCCLUSION_DEFAULT_WIDTH, int _height = OCCLUSION_DEFAULT_HEIGHT);
+
+		/// @brief Clear the depth buffer and drop every occluder, ready for a new view.
+		/// @param _viewProjection The projection matrix times the view matrix.
+		void Begin(const glm::mat4& _viewProjection);
+
+		/// @brief Add an occluder's triangles to be rasterised.
+		/// @param _occluder The occluder, in model space.
+		/// @param _modelMatrix The model matrix.
+		void AddOccluder(const OccluderMesh& _occluder, const glm::mat4& _modelMatrix);
+
+		/// @brief Rasterise every occluder added since Begin(). Must come before any IsVisible().
+		/// @param _pool The pool to split the bins across, or nullptr to run on the calling thread alone.
+		void Rasterise(ThreadPool* _pool = nullptr);
+
+		/// @brief Test whether any part of a box may be in front of the occluders.
+		/// @param _boundsMin The minimum corner of the box, in model space.
+		/// @param _boundsMax The maximum corner of the box, in model space.
+		/// @param _modelMatrix The model matrix.
+		/// @return False when the box is wholly behind the occluders or off-screen.
+		bool IsVisible(const glm::vec3& _boundsMin, const glm::vec3& _boundsMax, const glm::mat4& _modelMatrix) const;
+
+		/// @brief Get the width of the depth buffer.
+		/// @return The width in pixels.
+		int GetWidth() const { return m_width; }
+
+		/// @brief Get the height of the depth buffer.
+		/// @return The height in pixels.
+		int GetHeight() const { return m_height; }
+
+		/// @brief Get the depth of the nearest occluder at a pixel.
+		/// @param _x The pixel's column.
+		/// @param _y The pixel's row, from the bottom.
+		/// @return The window space depth, from 0 at the near plane to 1 where nothing was drawn.
+		float GetDepth(int _x, int _y) const { return m_depth[(size_t)_y * m_width + _x]; }
+
+		/// @brief Get the number of occluder triangles which reached the screen since Begin().
+		/// @return The triangle count.
+		size_t GetTriangleCount() const { return m_triangles.size(); }
+
+	private:
+		// One occluder triangle in window space, wound anticlockwise, with the pixels its bounds cover
+		struct ScreenTriangle
+		{
+			glm::vec3 vertices[3];
+			int minX;
+			int minY;
+			int maxX;
+			int maxY;
+		};
+
+		void RasteriseBin(size_t _bin);
+
+		int m_width;
+		int m_height;
+		int m_binsX;
+		int m_binsY;
+
+		glm::mat4 m_viewProjection;
+
+		// Nearest depth per pixel, and farthest depth per tile
+		std::vector<float> m_depth;
+		std::vector<float> m_tileMax;
+
+		std::vector<ScreenTriangle> m_triangles;
+		std::vector<std::vector<unsigned int>> m_binTriangles;
+
+		// Kept between occluders to save reallocating it
+		std::vector<glm::vec4> m_clipPositions;
+	};
+}
+
+#endif // EPBR_OCCLUSION
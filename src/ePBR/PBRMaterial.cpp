@@ -1,7 +1,13 @@
 #include "PBRMaterial.h"
 #include "Shader.h"
 #include "CubeMap.h"
+#include "Instancing.h"
+#include "ObjectTransforms.h"
+#include "ShaderBlocks.h"
+#include "StateCache.h"
+#include "StreamBuffer.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 
@@ -10,36 +16,104 @@
 
 namespace ePBR 
 {
+	namespace
+	{
+		// FNV-1a over texture and program IDs
+		size_t HashIDs(const GLuint* _ids, size_t _count)
+		{
+			size_t hash = 14695981039346656037ull;
+			for (size_t i = 0; i < _count; i++)
+			{
+				hash ^= _ids[i];
+				hash *= 1099511628211ull;
+			}
+			return hash;
+		}
+	}
+
 	PBRMaterial::PBRMaterial() :
 		// Initialising GLuints to max value as 0 is a valid id/location - this makes for simpler debugging.
-		m_albedo(glm::vec3(1)),
-		m_metalness(0),
-		m_roughness(0),
+		m_shaderProgram(std::make_shared<Shader>()),
+		m_objectIndexLocation(-1),
 		m_albedoLocation(-1),
 		m_metalnessLocation(-1),
 		m_roughnessLocation(-1),
-		m_MVPMatLocation(-1),
-		m_modelMatLocation(-1),
-		m_camPosLocation(-1),
 		m_albedoSamplerLocation(-1),
-		m_ambientOcclusionMapSamplerLocation(-1),
+		m_normalMapSamplerLocation(-1),
 		m_metalnessMapSamplerLocation(-1),
 		m_roughnessMapSamplerLocation(-1),
-		m_normalMapSamplerLocation(-1),
+		m_ambientOcclusionMapSamplerLocation(-1),
 		m_irradianceMapSamplerLocation(-1),
 		m_prefilteredEnvironmentMapSamplerLocation(-1),
 		m_brdfLookupTextureSamplerLocation(-1),
-		m_shaderProgram(std::make_shared<Shader>()),
+		m_materialIndex(NO_RESIDENT_MATERIAL),
+		m_residentReleaseCount(0),
+		m_albedo(glm::vec3(1)),
+		m_roughness(0),
+		m_metalness(0),
 		m_albedoTexture(std::make_shared<Texture>()),
 		m_normalMap(std::make_shared<Texture>()),
 		m_metalnessMap(std::make_shared<Texture>()),
-		m_ambientOcclusionMap(std::make_shared<Texture>()),
-		m_roughnessMap(std::make_shared<Texture>())
+		m_roughnessMap(std::make_shared<Texture>()),
+		m_ambientOcclusionMap(std::make_shared<Texture>())
+	{
+		std::fill(m_residentTextures, m_residentTextures + RESIDENT_MAP_COUNT, 0);
+	}
+
+	PBRMaterial::PBRMaterial(const PBRMaterial& _other) :
+		Material(_other),
+		m_materialIndex(NO_RESIDENT_MATERIAL)
 	{
+		*this = _other;
+	}
+
+	PBRMaterial& PBRMaterial::operator=(const PBRMaterial& _other)
+	{
+		if (this == &_other) return *this;
+
+		// A residency record belongs to one material, so a copy makes its own on first use rather than sharing, and freeing, the original's
+		if (m_materialIndex != NO_RESIDENT_MATERIAL) TextureResidency::GetShared().RemoveMaterial(m_materialIndex);
+		m_materialIndex = NO_RESIDENT_MATERIAL;
+		std::fill(m_residentTextures, m_residentTextures + RESIDENT_MAP_COUNT, 0);
+		m_residentReleaseCount = 0;
+
+		Material::operator=(_other);
+		m_shaderProgram = _other.m_shaderProgram;
+		ResetProgram();
+		m_gbufferDefine = _other.m_gbufferDefine;
+
+		m_objectIndexLocation = _other.m_objectIndexLocation;
+		m_albedoLocation = _other.m_albedoLocation;
+		m_metalnessLocation = _other.m_metalnessLocation;
+		m_roughnessLocation = _other.m_roughnessLocation;
+		m_albedoSamplerLocation = _other.m_albedoSamplerLocation;
+		m_normalMapSamplerLocation = _other.m_normalMapSamplerLocation;
+		m_metalnessMapSamplerLocation = _other.m_metalnessMapSamplerLocation;
+		m_roughnessMapSamplerLocation = _other.m_roughnessMapSamplerLocation;
+		m_ambientOcclusionMapSamplerLocation = _other.m_ambientOcclusionMapSamplerLocation;
+		m_irradianceMapSamplerLocation = _other.m_irradianceMapSamplerLocation;
+		m_prefilteredEnvironmentMapSamplerLocation = _other.m_prefilteredEnvironmentMapSamplerLocation;
+		m_brdfLookupTextureSamplerLocation = _other.m_brdfLookupTextureSamplerLocation;
+
+		m_albedo = _other.m_albedo;
+		m_roughness = _other.m_roughness;
+		m_metalness = _other.m_metalness;
+
+		m_albedoTexture = _other.m_albedoTexture;
+		m_normalMap = _other.m_normalMap;
+		m_metalnessMap = _other.m_metalnessMap;
+		m_roughnessMap = _other.m_roughnessMap;
+		m_ambientOcclusionMap = _other.m_ambientOcclusionMap;
+		m_irradianceMap = _other.m_irradianceMap;
+		m_prefilterMap = _other.m_prefilterMap;
+		m_brdfLUT = _other.m_brdfLUT;
+
+		return *this;
 	}
 
 	PBRMaterial::~PBRMaterial() 
 	{
+		if (m_materialIndex != NO_RESIDENT_MATERIAL) TextureResidency::GetShared().RemoveMaterial(m_materialIndex);
 	}
 
 	std::shared_ptr<Shader> PBRMaterial::LoadShaderProgram(std::string _vertFilename, std::string _fragFilename)
@@ -49,30 +123,7 @@ namespace ePBR
 		// The 'program' stores the shaders
 		m_shaderProgram->LoadNewVertexShader(_vertFilename.c_str());
 		m_shaderProgram->LoadNewFragmentShader(_fragFilename.c_str());
-
-		// Calling GetID will compile and link the newly created shader program
-		GLint id = m_shaderProgram->GetID();
-		
-		glUseProgram(id);
-
-		// Get uniform locations
-		m_modelMatLocation = glGetUniformLocation(id, "modelMat");
-		m_MVPMatLocation = glGetUniformLocation(id, "MVPMat");
-
-		m_camPosLocation = glGetUniformLocation(id, "camPos");
-		m_albedoLocation = glGetUniformLocation(id, "albedo");
-		m_metalnessLocation = glGetUniformLocation(id, "metalness");
-		m_roughnessLocation = glGetUniformLocation(id, "roughness");
-
-		// Get texture sampler locations
-		m_albedoSamplerLocation = glGetUniformLocation(id, "albedoMap");
-		m_normalMapSamplerLocation = glGetUniformLocation(id, "normalMap");
-		m_metalnessMapSamplerLocation = glGetUniformLocation(id, "metalnessMap");
-		m_roughnessMapSamplerLocation = glGetUniformLocation(id, "roughnessMap");
-		m_ambientOcclusionMapSamplerLocation = glGetUniformLocation(id, "ambientOcclusionMap");
-		m_irradianceMapSamplerLocation = glGetUniformLocation(id, "irradianceMap");
-		m_prefilteredEnvironmentMapSamplerLocation = glGetUniformLocation(id, "prefilterMap");
-		m_brdfLookupTextureSamplerLocation = glGetUniformLocation(id, "brdfLUT");
+		ResetProgram();
 
 		return m_shaderProgram;
 	}
@@ -80,22 +131,34 @@ namespace ePBR
 	void PBRMaterial::SetShader(std::shared_ptr<Shader> _newShader)
 	{
 		m_shaderProgram = _newShader;
+		ResetProgram();
+	}
 
-		// Calling GetID will compile and link the newly created shader program
-		GLuint id = m_shaderProgram->GetID();
+	void PBRMaterial::ResetProgram()
+	{
+		// Calling GetID will compile and link the shader program, so errors show as it is set rather than drawn with
+		m_shaderProgram->GetID();
 
-		glUseProgram(id);
+		// Which variant is drawn with depends on the material's residency, so UpdateResidency() picks it on first use
+		m_activeShaderProgram = nullptr;
+		m_activeGBufferDefine.clear();
+		m_instancedShaderProgram = nullptr;
+	}
+
+	void PBRMaterial::SetupProgram()
+	{
+		// Calling GetID will compile and link the newly created shader program
+		GLuint id = m_activeShaderProgram->GetID();
 
-		// Get uniform locations
-		m_modelMatLocation = glGetUniformLocation(id, "modelMat");
-		m_MVPMatLocation = glGetUniformLocation(id, "MVPMat");
+		StateCache::GetShared().UseProgram(id);
 
-		m_camPosLocation = glGetUniformLocation(id, "camPos");
+		// Get uniform locations. Matrices and the camera come from the view and object blocks.
+		m_objectIndexLocation = glGetUniformLocation(id, "objectIndex");
 		m_albedoLocation = glGetUniformLocation(id, "albedo");
 		m_metalnessLocation = glGetUniformLocation(id, "metalness");
 		m_roughnessLocation = glGetUniformLocation(id, "roughness");
 
-		// Get texture sampler locations
+		// Get texture sampler locations. Resident variants sample the first five maps through their material record instead.
 		m_albedoSamplerLocation = glGetUniformLocation(id, "albedoMap");
 		m_normalMapSamplerLocation = glGetUniformLocation(id, "normalMap");
 		m_metalnessMapSamplerLocation = glGetUniformLocation(id, "metalnessMap");
@@ -105,63 +168,214 @@ namespace ePBR
 		m_prefilteredEnvironmentMapSamplerLocation = glGetUniformLocation(id, "prefilterMap");
 		m_brdfLookupTextureSamplerLocation = glGetUniformLocation(id, "brdfLUT");
 
+		// Sampler units are program state, so they only need setting once
+		glUniform1i(m_albedoSamplerLocation, 0);
+		glUniform1i(m_normalMapSamplerLocation, 1);
+		glUniform1i(m_metalnessMapSamplerLocation, 2);
+		glUniform1i(m_roughnessMapSamplerLocation, 3);
+		glUniform1i(m_ambientOcclusionMapSamplerLocation, 4);
+		glUniform1i(m_irradianceMapSamplerLocation, 5);
+		glUniform1i(m_prefilteredEnvironmentMapSamplerLocation, 6);
+		glUniform1i(m_brdfLookupTextureSamplerLocation, 7);
 	}
 
-	void PBRMaterial::Apply(glm::mat4 _modelMatrix, glm::mat4 _invModelMatrix, glm::mat4 _viewMatrix, glm::mat4 _projMatrix, glm::vec3 _camPos) 
+	void PBRMaterial::UpdateResidency()
 	{
-		glUseProgram(m_shaderProgram->GetID());
+		const GLuint textures[RESIDENT_MAP_COUNT] =
+		{
+			m_albedoTexture->GetID(),
+			m_normalMap->GetID(),
+			m_metalnessMap->GetID(),
+			m_roughnessMap->GetID(),
+			m_ambientOcclusionMap->GetID()
+		};
+
+		// A reloaded texture can get its old ID back, so a release anywhere also remakes the record
+		TextureResidency& residency = TextureResidency::GetShared();
+		bool texturesChanged = !m_activeShaderProgram || residency.GetReleaseCount() != m_residentReleaseCount || !std::equal(textures, textures + RESIDENT_MAP_COUNT, m_residentTextures);
+		if (!texturesChanged && m_gbufferDefine == m_activeGBufferDefine) return;
+
+		if (texturesChanged)
+		{
+			std::copy(textures, textures + RESIDENT_MAP_COUNT, m_residentTextures);
+			m_residentReleaseCount = residency.GetReleaseCount();
+
+			if (m_materialIndex == NO_RESIDENT_MATERIAL) m_materialIndex = residency.AddMaterial(textures);
+			else if (!residency.UpdateMaterial(m_materialIndex, textures)) m_materialIndex = NO_RESIDENT_MATERIAL;
+		}
 
-		// Calculate MVP
-		glm::mat4 MVP = _projMatrix * _viewMatrix * _modelMatrix;
+		// Materials whose textures couldn't all be made resident bind them as before
+		std::shared_ptr<Shader> program = m_shaderProgram;
+		if (m_materialIndex != NO_RESIDENT_MATERIAL) program = m_shaderProgram->GetVariant("RESIDENT_TEXTURES")->GetVariant(residency.GetModeDefine());
+		if (!m_gbufferDefine.empty()) program = program->GetVariant(m_gbufferDefine);
+		m_activeGBufferDefine = m_gbufferDefine;
 
-		// Upload matrices
-		glUniformMatrix4fv(m_modelMatLocation, 1, GL_FALSE, glm::value_ptr(_modelMatrix));
-		glUniformMatrix4fv(m_MVPMatLocation, 1, GL_FALSE, glm::value_ptr(MVP));
+		if (program != m_activeShaderProgram)
+		{
+			m_activeShaderProgram = program;
+			m_instancedShaderProgram = nullptr;
+			SetupProgram();
+		}
+	}
+
+	void PBRMaterial::GetInstanceModifiers(ModelInstance& _instance) const
+	{
+		_instance.albedo = m_albedo;
+		_instance.roughness = m_roughness;
+		_instance.metalness = m_metalness;
+	}
+
+	bool PBRMaterial::SetGBufferVariant(const std::string& _define)
+	{
+		// Picked up by UpdateResidency(), so only a pass which draws with this material switches its program
+		m_gbufferDefine = _define;
+		return !_define.empty();
+	}
+
+	void PBRMaterial::Apply(glm::mat4 _modelMatrix, glm::mat4 _viewMatrix, glm::mat4 _projMatrix, glm::vec3 _camPos) 
+	{
+		UpdateResidency();
+		StateCache::GetShared().UseProgram(m_activeShaderProgram->GetID());
+
+		// Uploaded once per view rather than once per draw
+		SetViewUniforms(_viewMatrix, _projMatrix, _camPos);
 
-		glUniform3fv(m_camPosLocation, 1, glm::value_ptr(_camPos));
 		glUniform3fv(m_albedoLocation, 1, glm::value_ptr(m_albedo));
 		glUniform1f(m_metalnessLocation, m_metalness);
 		glUniform1f(m_roughnessLocation, m_roughness);
 
-		glActiveTexture(GL_TEXTURE0);
-		glUniform1i(m_albedoSamplerLocation, 0);
-		glBindTexture(GL_TEXTURE_2D, m_albedoTexture->GetID());
+		BindTextures();
+		ApplyObject(_modelMatrix, _viewMatrix, _projMatrix, _camPos);
+	}
 
-		glActiveTexture(GL_TEXTURE1);
-		glUniform1i(m_normalMapSamplerLocation, 1);
-		glBindTexture(GL_TEXTURE_2D, m_normalMap->GetID());
+	void PBRMaterial::ApplyObject(glm::mat4 _modelMatrix, glm::mat4 _viewMatrix, glm::mat4 _projMatrix, glm::vec3 /*_camPos*/)
+	{
+		// The program, textures, modifiers and view are still bound from Apply()
+		ObjectData object;
+		GLuint materialIndex = GetMaterialIndex();
+		ComputeObjectData(&_modelMatrix, &materialIndex, 1, _projMatrix * _viewMatrix, &object);
 
-		glActiveTexture(GL_TEXTURE2);
-		glUniform1i(m_metalnessMapSamplerLocation, 2);
-		glBindTexture(GL_TEXTURE_2D, m_metalnessMap->GetID());
+		size_t offset = WriteObjects(&object, 1);
+		if (offset == StreamBuffer::NO_SPACE) return;
 
-		glActiveTexture(GL_TEXTURE3);
-		glUniform1i(m_roughnessMapSamplerLocation, 3);
-		glBindTexture(GL_TEXTURE_2D, m_roughnessMap->GetID());
+		BindObjects(offset, 1);
+		glUniform1ui(m_objectIndexLocation, 0);
+	}
 
-		glActiveTexture(GL_TEXTURE4);
-		glUniform1i(m_ambientOcclusionMapSamplerLocation, 4);
-		glBindTexture(GL_TEXTURE_2D, m_ambientOcclusionMap->GetID());
+	bool PBRMaterial::ApplyObjectIndex(GLuint _index)
+	{
+		glUniform1ui(m_objectIndexLocation, _index);
+		return true;
+	}
+
+	GLuint PBRMaterial::GetProgramID()
+	{
+		UpdateResidency();
+		return m_activeShaderProgram->GetID();
+	}
+
+	size_t PBRMaterial::GetTextureSetID() const
+	{
+		// Resident maps aren't bound, so only the environment maps tell texture sets apart
+		bool resident = m_materialIndex != NO_RESIDENT_MATERIAL;
+		GLuint ids[8] =
+		{
+			resident ? 0 : m_albedoTexture->GetID(),
+			resident ? 0 : m_normalMap->GetID(),
+			resident ? 0 : m_metalnessMap->GetID(),
+			resident ? 0 : m_roughnessMap->GetID(),
+			resident ? 0 : m_ambientOcclusionMap->GetID(),
+			m_irradianceMap ? m_irradianceMap->GetMapID() : 0,
+			m_prefilterMap ? m_prefilterMap->GetMapID() : 0,
+			m_brdfLUT ? m_brdfLUT->GetID() : 0
+		};
+		return HashIDs(ids, 8);
+	}
+
+	GLuint PBRMaterial::GetMaterialIndex()
+	{
+		UpdateResidency();
+		return m_materialIndex != NO_RESIDENT_MATERIAL ? m_materialIndex : 0;
+	}
+
+	size_t PBRMaterial::GetBatchID()
+	{
+		UpdateResidency();
+		if (m_materialIndex == NO_RESIDENT_MATERIAL) return Material::GetBatchID();
 
-		if (m_irradianceMap) 
+		// Resident materials differ only in their record, so any sharing a program and environment maps can be drawn together
+		GLuint ids[4] =
 		{
-			glActiveTexture(GL_TEXTURE5);
-			glUniform1i(m_irradianceMapSamplerLocation, 5);
-			glBindTexture(GL_TEXTURE_CUBE_MAP, m_irradianceMap->GetMapID());
+			m_activeShaderProgram->GetID(),
+			m_irradianceMap ? m_irradianceMap->GetMapID() : 0,
+			m_prefilterMap ? m_prefilterMap->GetMapID() : 0,
+			m_brdfLUT ? m_brdfLUT->GetID() : 0
+		};
+		return HashIDs(ids, 4);
+	}
+
+	bool PBRMaterial::ApplyInstanced(glm::mat4 _viewMatrix, glm::mat4 _projMatrix, glm::vec3 _camPos)
+	{
+		UpdateResidency();
+
+		if (!m_instancedShaderProgram)
+		{
+			m_instancedShaderProgram = m_activeShaderProgram->GetVariant("INSTANCED");
+			GLuint id = m_instancedShaderProgram->GetID();
+
+			StateCache::GetShared().UseProgram(id);
+
+			// Sampler units are program state, so they only need setting once
+			glUniform1i(glGetUniformLocation(id, "albedoMap"), 0);
+			glUniform1i(glGetUniformLocation(id, "normalMap"), 1);
+			glUniform1i(glGetUniformLocation(id, "metalnessMap"), 2);
+			glUniform1i(glGetUniformLocation(id, "roughnessMap"), 3);
+			glUniform1i(glGetUniformLocation(id, "ambientOcclusionMap"), 4);
+			glUniform1i(glGetUniformLocation(id, "irradianceMap"), 5);
+			glUniform1i(glGetUniformLocation(id, "prefilterMap"), 6);
+			glUniform1i(glGetUniformLocation(id, "brdfLUT"), 7);
 		}
 
-		if (m_prefilterMap) 
+		StateCache::GetShared().UseProgram(m_instancedShaderProgram->GetID());
+
+		SetViewUniforms(_viewMatrix, _projMatrix, _camPos);
+
+		BindTextures();
+		return true;
+	}
+
+	void PBRMaterial::BindTextures()
+	{
+		// Unloaded maps bind texture 0, so nothing is read from the last material, while environment maps which aren't set are left as they were. Repeats bind nothing at all.
+		const GLenum targets[8] = { GL_TEXTURE_2D, GL_TEXTURE_2D, GL_TEXTURE_2D, GL_TEXTURE_2D, GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_2D };
+		const GLuint textures[8] =
+		{
+			m_albedoTexture->GetID(),
+			m_normalMap->GetID(),
+			m_metalnessMap->GetID(),
+			m_roughnessMap->GetID(),
+			m_ambientOcclusionMap->GetID(),
+			m_irradianceMap ? m_irradianceMap->GetMapID() : 0,
+			m_prefilterMap ? m_prefilterMap->GetMapID() : 0,
+			m_brdfLUT ? m_brdfLUT->GetID() : 0
+		};
+		bool environment = m_irradianceMap && m_prefilterMap && m_brdfLUT;
+
+		// Resident maps are read through the material record, leaving only the environment maps to bind
+		GLuint first = 0;
+		if (m_materialIndex != NO_RESIDENT_MATERIAL)
 		{
-			glActiveTexture(GL_TEXTURE6);
-			glUniform1i(m_prefilteredEnvironmentMapSamplerLocation, 6);
-			glBindTexture(GL_TEXTURE_CUBE_MAP, m_prefilterMap->GetMapID());
+			TextureResidency::GetShared().Bind();
+			first = RESIDENT_MAP_COUNT;
 		}
 
-		if (m_brdfLUT) 
+		StateCache& cache = StateCache::GetShared();
+		GLuint end = environment ? 8 : RESIDENT_MAP_COUNT;
+		cache.BindTextures(first, end - first, targets + first, textures + first);
+
+		for (GLuint unit = end; unit < 8; unit++)
 		{
-			glActiveTexture(GL_TEXTURE7);
-			glUniform1i(m_brdfLookupTextureSamplerLocation, 7);
-			glBindTexture(GL_TEXTURE_2D, m_brdfLUT->GetID());
+			if (textures[unit]) cache.BindTexture(unit, targets[unit], textures[unit]);
 		}
 	}
 
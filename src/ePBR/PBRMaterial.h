@@ -3,6 +3,7 @@
 
 #include "Texture.h"
 #include "Material.h"
+#include "TextureResidency.h"
 
 #include <string>
 #include <memory>
@@ -22,6 +23,16 @@ namespace ePBR
 		PBRMaterial();
 		~PBRMaterial();
 
+		/// @brief Copy a material's shader, modifiers and textures.
+		/// @details The copy gets a residency record of its own when first drawn, rather than sharing the original's.
+		/// @param _other The material to copy.
+		PBRMaterial(const PBRMaterial& _other);
+
+		/// @brief Copy a material's shader, modifiers and textures, giving up this material's residency record.
+		/// @param _other The material to copy.
+		/// @return This material.
+		PBRMaterial& operator=(const PBRMaterial& _other);
+
 		/// @brief Set this material's shader.
 		/// @param _newShader The new shader.
 		void SetShader(std::shared_ptr<Shader> _newShader);
@@ -120,22 +131,86 @@ namespace ePBR
 
 		/// @brief Apply this material in preparation for drawing something it applies to.
 		/// @param _modelMatrix The model matrix of the object to draw.
-		/// @param _invModelMatrix The inverse model matrix of the object to draw.
 		/// @param _viewMatrix The view matrix which should be used to draw.
 		/// @param _projMatrix The projection matrix which should be used to draw.
 		/// @param _camPos The position of the camera corresponds to the view matrix.
-		void Apply(glm::mat4 _modelMatrix, glm::mat4 _invModelMatrix, glm::mat4 _viewMatrix, glm::mat4 _projMatrix, glm::vec3 _camPos);
+		void Apply(glm::mat4 _modelMatrix, glm::mat4 _viewMatrix, glm::mat4 _projMatrix, glm::vec3 _camPos);
+
+		/// @brief Apply the INSTANCED variant of this material's shader. Each instance's albedo, roughness and metalness replace this material's modifiers.
+		/// @param _viewMatrix The view matrix which should be used to draw.
+		/// @param _projMatrix The projection matrix which should be used to draw.
+		/// @param _camPos The position of the camera corresponds to the view matrix.
+		/// @return True, as every PBR shader has an instanced variant.
+		bool ApplyInstanced(glm::mat4 _viewMatrix, glm::mat4 _projMatrix, glm::vec3 _camPos);
+
+		/// @brief Write just the matrices of another object drawn with this material to the object buffer, straight after Apply().
+		/// @param _modelMatrix The model matrix of the object to draw.
+		/// @param _viewMatrix The view matrix which should be used to draw.
+		/// @param _projMatrix The projection matrix which should be used to draw.
+		/// @param _camPos The position of the camera corresponds to the view matrix.
+		void ApplyObject(glm::mat4 _modelMatrix, glm::mat4 _viewMatrix, glm::mat4 _projMatrix, glm::vec3 _camPos);
+
+		/// @brief Select an object from those bound to OBJECT_STORAGE_BINDING, straight after Apply().
+		/// @param _index The object's index within the bound range.
+		/// @return True, as every PBR shader reads the object block.
+		bool ApplyObjectIndex(GLuint _index);
+
+		/// @brief Copy this material's albedo, roughness and metalness into an instance, for the INSTANCED variant to read.
+		/// @param _instance The instance.
+		void GetInstanceModifiers(ModelInstance& _instance) const;
+
+		/// @brief Select the variant Apply() binds for a deferred G-buffer pass. Every PBR shader has one, writing its albedo, metalness, normal and roughness.
+		/// @details The program is switched on the next Apply(), so switching back and forth between passes without drawing costs nothing.
+		/// @param _define The variant's define, from DeferredShading::GetGBufferDefine(), or empty to shade forward again.
+		/// @return True, unless _define is empty.
+		bool SetGBufferVariant(const std::string& _define);
+
+		/// @brief Get the shader program Apply() binds, which is the RESIDENT_TEXTURES variant while this material's textures are resident, and the G-buffer variant while one is selected.
+		/// @return The OpenGL ID of the program.
+		GLuint GetProgramID();
+
+		/// @brief Get a value shared by materials which bind the same textures.
+		/// @return A hash of every bound texture's ID. Resident maps aren't bound, so aren't included.
+		size_t GetTextureSetID() const;
+
+		/// @brief Get this material's record in the TextureResidency, making its textures resident if they have changed.
+		/// @return The record's index, or 0 if its textures couldn't be made resident.
+		GLuint GetMaterialIndex();
+
+		/// @brief Get a value shared by materials which can be drawn in one multi-draw.
+		/// @return A hash of the program and environment maps while resident, otherwise a value unique to this material.
+		size_t GetBatchID();
 
 	protected:
 
+		// Bind every texture to its unit, or only the environment maps while resident. Sampler uniforms must already point at the units.
+		void BindTextures();
+
+		// Compile a newly set program and leave the variant to draw with to be picked again
+		void ResetProgram();
+
+		// Get uniform locations from the active program and point its samplers at their units
+		void SetupProgram();
+
+		// Make the current maps resident if they have changed, then switch to the resident and G-buffer variants they call for, or back to the base program
+		void UpdateResidency();
+
 		std::shared_ptr<Shader> m_shaderProgram;
 
+		// m_shaderProgram, or its RESIDENT_TEXTURES variant while this material's textures are resident, either of which may be a G-buffer variant
+		std::shared_ptr<Shader> m_activeShaderProgram;
+
+		// The G-buffer variant selected, and the one m_activeShaderProgram was chosen with. Empty for forward shading.
+		std::string m_gbufferDefine;
+		std::string m_activeGBufferDefine;
+
+		// Compiled from m_activeShaderProgram's files on first instanced draw, with its sampler units set once
+		std::shared_ptr<Shader> m_instancedShaderProgram;
+
 		// Vertex shader uniform locations
-		GLuint m_MVPMatLocation;
-		GLuint m_modelMatLocation;
+		GLuint m_objectIndexLocation;
 
 		// Fragment shader uniform locations
-		GLuint m_camPosLocation;
 		GLuint m_albedoLocation;
 		GLuint m_metalnessLocation;
 		GLuint m_roughnessLocation;
@@ -150,6 +225,11 @@ namespace ePBR
 		GLuint m_prefilteredEnvironmentMapSamplerLocation;
 		GLuint m_brdfLookupTextureSamplerLocation;
 
+		// Record in the TextureResidency, and the maps and release count it was made from
+		GLuint m_materialIndex;
+		GLuint m_residentTextures[RESIDENT_MAP_COUNT];
+		size_t m_residentReleaseCount;
+
 		// PBR modifiers
 		glm::vec3 m_albedo;
 		float m_roughness;
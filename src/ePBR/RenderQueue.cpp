@@ -0,0 +1,361 @@
+#include "RenderQueue.h"
+#include "DeferredShading.h"
+#include "Material.h"
+#include "Mesh.h"
+#include "ObjectTransforms.h"
+#include "StateCache.h"
+#include "StreamBuffer.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <limits>
+
+#include <GL/glew.h>
+
+namespace ePBR
+{
+	namespace
+	{
+		// Key layout, from the most significant bit down. G-buffer keys are laid out as opaque ones.
+		// Opaque:      pass (2) | program (12) | texture set (12) | material (14) | depth (24)
+		// Transparent: pass (2) | inverted depth (24) | program (12) | texture set (12) | material (14)
+		const int PASS_SHIFT = 62;
+		const uint64_t PROGRAM_MASK = (1 << 12) - 1;
+		const uint64_t TEXTURE_SET_MASK = (1 << 12) - 1;
+		const uint64_t MATERIAL_MASK = (1 << 14) - 1;
+		const uint64_t DEPTH_MASK = (1 << RENDER_QUEUE_DEPTH_BITS) - 1;
+
+		// Fewest items a worker records into a buffer of its own
+		const size_t RECORD_CHUNK_SIZE = 64;
+
+		// Passes in the order they are drawn. Lighting comes between the G-buffer pass and the rest.
+		const uint64_t GBUFFER_PASS = 0;
+		const uint64_t OPAQUE_PASS = 1;
+		const uint64_t TRANSPARENT_PASS = 2;
+
+		// Sort by key, one byte per pass, keeping equal keys in the order they were added
+		template <typename T>
+		void RadixSort(std::vector<T>& _items, std::vector<T>& _scratch)
+		{
+			size_t counts[8][256] = {};
+			for (const T& item : _items)
+			{
+				for (int digit = 0; digit < 8; digit++) counts[digit][(item.key >> (digit * 8)) & 0xFF]++;
+			}
+
+			_scratch.resize(_items.size());
+			for (int digit = 0; digit < 8; digit++)
+			{
+				// Bytes every key shares need no pass. Most are, as the fields are rarely full.
+				if (counts[digit][(_items[0].key >> (digit * 8)) & 0xFF] == _items.size()) continue;
+
+				size_t offset = 0;
+				for (size_t& count : counts[digit])
+				{
+					size_t next = offset + count;
+					count = offset;
+					offset = next;
+				}
+
+				for (const T& item : _items) _scratch[counts[digit][(item.key >> (digit * 8)) & 0xFF]++] = item;
+				_items.swap(_scratch);
+			}
+		}
+	}
+
+	RenderQueue::RenderQueue() :
+		m_buffers(1),
+		m_lastProgramChanges(0),
+		m_lastMaterialChanges(0),
+		m_lastBufferCount(0)
+	{
+	}
+
+	void RenderQueue::Add(Mesh* _mesh, Material* _material, const glm::mat4& _modelMatrix, size_t _lod)
+	{
+		m_buffers[0].Add(_mesh, _material, _modelMatrix, _lod);
+	}
+
+	void RenderQueue::Record(size_t _count, const std::function<void(size_t, CommandBuffer&)>& _record, ThreadPool* _pool)
+	{
+		// Enough items per buffer that a worker's share outweighs waking it
+		size_t bufferCount = 1;
+		if (_pool) bufferCount = std::max<size_t>(1, std::min<size_t>(_pool->GetThreadCount(), _count / RECORD_CHUNK_SIZE));
+		if (m_buffers.size() < bufferCount) m_buffers.resize(bufferCount);
+
+		auto recordBuffer = [&](size_t _buffer)
+		{
+			size_t begin = _count * _buffer / bufferCount;
+			size_t end = _count * (_buffer + 1) / bufferCount;
+			for (size_t i = begin; i < end; i++) _record(i, m_buffers[_buffer]);
+		};
+
+		if (bufferCount > 1) _pool->ParallelFor(bufferCount, recordBuffer);
+		else recordBuffer(0);
+	}
+
+	size_t RenderQueue::GetPacketCount() const
+	{
+		size_t count = 0;
+		for (const CommandBuffer& buffer : m_buffers) count += buffer.GetCount();
+		return count;
+	}
+
+	void RenderQueue::Submit(const glm::mat4& _viewMatrix, const glm::mat4& _projMatrix, const glm::vec3& _camPos, ThreadPool* _pool, DeferredShading* _deferred)
+	{
+		m_lastProgramChanges = 0;
+		m_lastMaterialChanges = 0;
+
+		m_activeBuffers.clear();
+		for (size_t i = 0; i < m_buffers.size(); i++)
+		{
+			if (m_buffers[i].GetCount() > 0) m_activeBuffers.push_back(i);
+		}
+		m_lastBufferCount = m_activeBuffers.size();
+		if (m_activeBuffers.empty())
+		{
+			if (_deferred) _deferred->Shade(_viewMatrix, _projMatrix, _camPos);
+			return;
+		}
+
+		if (m_bufferItems.size() < m_buffers.size()) m_bufferItems.resize(m_buffers.size());
+		auto forEachBuffer = [&](const std::function<void(size_t)>& _task)
+		{
+			if (_pool && m_activeBuffers.size() > 1) _pool->ParallelFor(m_activeBuffers.size(), [&](size_t _index) { _task(m_activeBuffers[_index]); });
+			else for (size_t buffer : m_activeBuffers) _task(buffer);
+		};
+
+		forEachBuffer([&](size_t _buffer) { BuildDepths(_buffer, _viewMatrix); });
+
+		// Quantised across this frame's range, so the bits are spent where the draws are
+		float nearest = std::numeric_limits<float>::max();
+		float farthest = -std::numeric_limits<float>::max();
+		for (size_t buffer : m_activeBuffers)
+		{
+			nearest = std::min(nearest, m_bufferItems[buffer].nearest);
+			farthest = std::max(farthest, m_bufferItems[buffer].farthest);
+		}
+		float depthScale = farthest > nearest ? (float)DEPTH_MASK / (farthest - nearest) : 0.0f;
+
+		// Materials can compile shaders and make textures resident, so they are resolved here rather than on the workers.
+		// They are numbered as they are first seen, so the field stays small.
+		m_materialKeys.clear();
+		for (size_t buffer : m_activeBuffers)
+		{
+			for (Material* material : m_buffers[buffer].GetMaterials())
+			{
+				if (m_materialKeys.count(material)) continue;
+
+				// Selected before the program is read, so that draws sort by the variant they will use
+				bool deferred = _deferred && !material->IsTransparent() && material->SetGBufferVariant(_deferred->GetGBufferDefine());
+
+				size_t textureHash = material->GetTextureSetID();
+				MaterialKey key;
+				key.program = material->GetProgramID() & PROGRAM_MASK;
+				key.textureSet = (textureHash ^ (textureHash >> 12) ^ (textureHash >> 24) ^ (textureHash >> 36)) & TEXTURE_SET_MASK;
+				key.index = m_materialKeys.size() & MATERIAL_MASK;
+				key.residentIndex = material->GetMaterialIndex();
+				key.transparent = material->IsTransparent();
+				key.deferred = deferred;
+				m_materialKeys[material] = key;
+			}
+		}
+
+		forEachBuffer([&](size_t _buffer) { BuildKeys(_buffer, nearest, depthScale); });
+		MergeBuffers();
+
+		// Every object's matrices are computed in one batch, in draw order, for materials which read them by index
+		m_objectMatrices.resize(m_items.size());
+		m_objectMaterials.resize(m_items.size());
+		for (size_t i = 0; i < m_items.size(); i++)
+		{
+			const DrawPacket& packet = m_buffers[m_items[i].buffer].GetPackets()[m_items[i].packet];
+			m_objectMatrices[i] = packet.objectMatrix;
+			m_objectMaterials[i] = m_materialKeys[packet.material].residentIndex;
+		}
+
+		// Straight into the object buffer where it is mapped, otherwise copied up after
+		glm::mat4 viewProjection = _projMatrix * _viewMatrix;
+		size_t objectCount = m_items.size();
+		size_t objectsOffset = StreamBuffer::NO_SPACE;
+		if (ObjectData* mapped = MapObjects(objectCount, objectsOffset))
+		{
+			ComputeObjectData(m_objectMatrices.data(), m_objectMaterials.data(), objectCount, viewProjection, mapped, _pool);
+		}
+		else
+		{
+			m_objects.resize(objectCount);
+			ComputeObjectData(m_objectMatrices.data(), m_objectMaterials.data(), objectCount, viewProjection, m_objects.data(), _pool);
+			objectsOffset = WriteObjects(m_objects.data(), objectCount);
+		}
+
+		Material* currentMaterial = nullptr;
+		GLuint currentProgram = 0;
+		uint64_t currentPass = GBUFFER_PASS;
+
+		StateCache& cache = StateCache::GetShared();
+		cache.SetBlend(false);
+		cache.SetDepthWrite(true);
+
+		for (size_t i = 0; i < m_items.size(); i++)
+		{
+			const SortItem& item = m_items[i];
+			const DrawPacket& packet = m_buffers[item.buffer].GetPackets()[item.packet];
+
+			// Pass state changes at most twice, as keys sort by pass first
+			uint64_t pass = item.key >> PASS_SHIFT;
+			if (pass != currentPass)
+			{
+				// Whatever is drawn after the G-buffer is forward shaded over its lighting
+				if (currentPass == GBUFFER_PASS && _deferred)
+				{
+					_deferred->Shade(_viewMatrix, _projMatrix, _camPos);
+					currentMaterial = nullptr;
+					currentProgram = 0;
+				}
+
+				cache.SetBlend(pass == TRANSPARENT_PASS);
+				cache.SetDepthWrite(pass != TRANSPARENT_PASS);
+				currentPass = pass;
+			}
+
+			const glm::mat4& modelMatrix = m_objectMatrices[i];
+			bool indexed = objectsOffset != StreamBuffer::NO_SPACE;
+			if (packet.material != currentMaterial)
+			{
+				packet.material->Apply(modelMatrix, _viewMatrix, _projMatrix, _camPos);
+				currentMaterial = packet.material;
+				m_lastMaterialChanges++;
+
+				GLuint program = packet.material->GetProgramID();
+				if (program != currentProgram || program == 0) m_lastProgramChanges++;
+				currentProgram = program;
+			}
+			else
+			{
+				// Apply() binds a range of its own, so the shared one is bound back before indexing it
+				if (indexed) BindObjects(objectsOffset, objectCount);
+				if (!indexed || !packet.material->ApplyObjectIndex((GLuint)i))
+				{
+					packet.material->ApplyObject(modelMatrix, _viewMatrix, _projMatrix, _camPos);
+				}
+			}
+
+			packet.mesh->Draw(packet.modelMatrix, viewProjection, _camPos, packet.lod);
+		}
+
+		if (currentPass == GBUFFER_PASS && _deferred) _deferred->Shade(_viewMatrix, _projMatrix, _camPos);
+
+		// Materials go back to forward shading, for anything drawing them outside a queue. Their programs only switch if they are drawn.
+		if (_deferred)
+		{
+			for (const std::pair<Material* const, MaterialKey>& material : m_materialKeys)
+			{
+				if (material.second.deferred) material.first->SetGBufferVariant(std::string());
+			}
+		}
+
+		Clear();
+	}
+
+	void RenderQueue::Clear()
+	{
+		for (CommandBuffer& buffer : m_buffers) buffer.Clear();
+		m_materialKeys.clear();
+	}
+
+	void RenderQueue::BuildDepths(size_t _buffer, const glm::mat4& _viewMatrix)
+	{
+		const std::vector<DrawPacket>& packets = m_buffers[_buffer].GetPackets();
+		BufferItems& items = m_bufferItems[_buffer];
+
+		// Distance along the view direction to the centre of each mesh's bounds
+		items.depths.resize(packets.size());
+		items.nearest = std::numeric_limits<float>::max();
+		items.farthest = -std::numeric_limits<float>::max();
+		for (size_t i = 0; i < packets.size(); i++)
+		{
+			items.depths[i] = -(_viewMatrix * glm::vec4(packets[i].center, 1.0f)).z;
+			items.nearest = std::min(items.nearest, items.depths[i]);
+			items.farthest = std::max(items.farthest, items.depths[i]);
+		}
+	}
+
+	void RenderQueue::BuildKeys(size_t _buffer, float _nearest, float _depthScale)
+	{
+		const std::vector<DrawPacket>& packets = m_buffers[_buffer].GetPackets();
+		BufferItems& items = m_bufferItems[_buffer];
+
+		// Only read here, as every material was resolved before the workers started
+		const MaterialKey* material = nullptr;
+		Material* lastMaterial = nullptr;
+
+		items.items.resize(packets.size());
+		for (size_t i = 0; i < packets.size(); i++)
+		{
+			if (packets[i].material != lastMaterial)
+			{
+				lastMaterial = packets[i].material;
+				material = &m_materialKeys.find(lastMaterial)->second;
+			}
+
+			uint64_t depth = std::min((uint64_t)((items.depths[i] - _nearest) * _depthScale), DEPTH_MASK);
+
+			uint64_t key;
+			if (material->transparent)
+			{
+				key = (TRANSPARENT_PASS << PASS_SHIFT) | ((DEPTH_MASK - depth) << 38) | (material->program << 26) | (material->textureSet << 14) | material->index;
+			}
+			else
+			{
+				uint64_t pass = material->deferred ? GBUFFER_PASS : OPAQUE_PASS;
+				key = (pass << PASS_SHIFT) | (material->program << 50) | (material->textureSet << 38) | (material->index << 24) | depth;
+			}
+
+			items.items[i] = { key, (uint32_t)_buffer, (uint32_t)i };
+		}
+
+		RadixSort(items.items, items.scratch);
+	}
+
+	void RenderQueue::MergeBuffers()
+	{
+		m_items.clear();
+		if (m_activeBuffers.size() == 1)
+		{
+			m_items.swap(m_bufferItems[m_activeBuffers[0]].items);
+			return;
+		}
+
+		// Each buffer is already sorted, so a heap of their heads merges them. Ties go to the earlier buffer, keeping the order packets were recorded in.
+		struct Head
+		{
+			uint64_t key;
+			size_t buffer;
+			size_t next;
+		};
+		auto later = [](const Head& _a, const Head& _b) { return _a.key != _b.key ? _a.key > _b.key : _a.buffer > _b.buffer; };
+
+		std::vector<Head> heads;
+		for (size_t buffer : m_activeBuffers) heads.push_back({ m_bufferItems[buffer].items[0].key, buffer, 0 });
+		std::make_heap(heads.begin(), heads.end(), later);
+
+		while (!heads.empty())
+		{
+			std::pop_heap(heads.begin(), heads.end(), later);
+			Head& head = heads.back();
+			const std::vector<SortItem>& items = m_bufferItems[head.buffer].items;
+			m_items.push_back(items[head.next]);
+
+			if (++head.next < items.size())
+			{
+				head.key = items[head.next].key;
+				std::push_heap(heads.begin(), heads.end(), later);
+			}
+			else
+			{
+				heads.pop_back();
+			}
+		}
+	}
+}
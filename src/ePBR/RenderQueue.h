@@ -0,0 +1,134 @@
+#ifndef EPBR_RENDER_QUEUE
+#define EPBR_RENDER_QUEUE
+
+#include "CommandBuffer.h"
+#include "ShaderBlocks.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace ePBR
+{
+	class DeferredShading;
+	class Mesh;
+	class Material;
+	class ThreadPool;
+
+	/// @brief Bits of each sort key given to the depth of a draw, quantised across the depth range of the frame.
+	const int RENDER_QUEUE_DEPTH_BITS = 24;
+
+	/// @brief Gathers a frame's mesh draws as packets, each with a 64 bit sort key, then draws them in key order in one pass.
+	/// @details Opaque keys hold the shader program, texture set and material ahead of the depth, so state changes only when it must and draws sharing it go front to back for early depth rejection.
+	/// Transparent keys hold the depth first, inverted, so blended draws go back to front after everything opaque. Keys are sorted with a least significant digit radix sort.
+	/// Every object's matrices are computed in one SIMD batch straight into the object buffer, and materials which read it select theirs by index rather than uploading them.
+	/// Packets are recorded into CommandBuffers, one per worker, without touching OpenGL. Submit() keys and sorts each buffer on the pool, merges them by key, then draws on the calling thread.
+	/// Given a DeferredShading, opaque draws whose materials have a G-buffer variant sort ahead of everything else, and are lit in one pass before the rest are drawn forward.
+	class RenderQueue
+	{
+	public:
+		RenderQueue();
+
+		/// @brief Add a mesh draw to the queue, from the thread which will submit it.
+		/// @param _mesh The mesh. Must outlive the next Submit().
+		/// @param _material The material to draw it with. Must outlive the next Submit().
+		/// @param _modelMatrix The model matrix, without the mesh's position decode.
+		/// @param _lod The level of detail to draw.
+		void Add(Mesh* _mesh, Material* _material, const glm::mat4& _modelMatrix, size_t _lod);
+
+		/// @brief Record draws for many items across a thread pool, each worker into a command buffer of its own.
+		/// @details _record must make no OpenGL calls, and may only touch the buffer it is given and what it reads.
+		/// @param _count The number of items.
+		/// @param _record Records the draws of one item into a buffer.
+		/// @param _pool The pool to spread items across, or nullptr to record them all on the calling thread.
+		void Record(size_t _count, const std::function<void(size_t, CommandBuffer&)>& _record, ThreadPool* _pool = nullptr);
+
+		/// @brief Sort and draw everything in the queue, then empty it.
+		/// @details Blending and depth writes are set once per pass rather than per draw, and left as the last pass set them.
+		/// Materials are resolved to sort keys on the calling thread, as that can compile shaders. Everything else before drawing is spread across the pool.
+		/// @param _viewMatrix The view matrix.
+		/// @param _projMatrix The projection matrix.
+		/// @param _camPos The position of the camera.
+		/// @param _pool The pool to key and sort buffers on, or nullptr to do it all on the calling thread.
+		/// @param _deferred Shades opaque draws deferred, or nullptr to shade everything forward. Its Begin() must already have been called, and its Shade() is called between the G-buffer pass and the forward passes.
+		void Submit(const glm::mat4& _viewMatrix, const glm::mat4& _projMatrix, const glm::vec3& _camPos, ThreadPool* _pool = nullptr, DeferredShading* _deferred = nullptr);
+
+		/// @brief Empty the queue without drawing it.
+		void Clear();
+
+		/// @brief Get the number of packets in the queue.
+		/// @return The number of packets.
+		size_t GetPacketCount() const;
+
+		/// @brief Get how many command buffers the last Submit() merged.
+		/// @return The number of non-empty buffers.
+		size_t GetLastBufferCount() const { return m_lastBufferCount; }
+
+		/// @brief Get how many times the last Submit() switched shader program.
+		/// @return The number of switches.
+		size_t GetLastProgramChanges() const { return m_lastProgramChanges; }
+
+		/// @brief Get how many times the last Submit() fully applied a material.
+		/// @return The number of full applies.
+		size_t GetLastMaterialChanges() const { return m_lastMaterialChanges; }
+
+	private:
+		struct SortItem
+		{
+			uint64_t key;
+			uint32_t buffer;
+			uint32_t packet;
+		};
+
+		// What a material contributes to each key, resolved once per Submit()
+		struct MaterialKey
+		{
+			uint64_t program;
+			uint64_t textureSet;
+			uint64_t index;
+			GLuint residentIndex;
+			bool transparent;
+			bool deferred;
+		};
+
+		// Everything a worker needs to key and sort one buffer
+		struct BufferItems
+		{
+			std::vector<float> depths;
+			std::vector<SortItem> items;
+			std::vector<SortItem> scratch;
+			float nearest;
+			float farthest;
+		};
+
+		// Fill a buffer's depths and their range
+		void BuildDepths(size_t _buffer, const glm::mat4& _viewMatrix);
+
+		// Key and sort a buffer's packets, now the frame's depth range and every material key are known
+		void BuildKeys(size_t _buffer, float _nearest, float _depthScale);
+
+		// Merge every buffer's sorted items into m_items
+		void MergeBuffers();
+
+		std::vector<CommandBuffer> m_buffers;
+
+		// Kept between submits to save reallocating them
+		std::vector<BufferItems> m_bufferItems;
+		std::vector<size_t> m_activeBuffers;
+		std::vector<SortItem> m_items;
+		std::vector<glm::mat4> m_objectMatrices;
+		std::vector<GLuint> m_objectMaterials;
+		std::vector<ObjectData> m_objects;
+		std::unordered_map<Material*, MaterialKey> m_materialKeys;
+
+		size_t m_lastProgramChanges;
+		size_t m_lastMaterialChanges;
+		size_t m_lastBufferCount;
+	};
+}
+
+#endif // EPBR_RENDER_QUEUE
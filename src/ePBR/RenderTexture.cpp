@@ -1,37 +1,52 @@
 #include "RenderTexture.h"
 #include "Mesh.h"
 #include "Shader.h"
+#include "StateCache.h"
 
 namespace ePBR 
 {
+	namespace
+	{
+		// No pixels are uploaded, so any format matching the internal format's channels will do
+		void FitColourTexture(GLuint _texture, GLenum _internalFormat, unsigned int _width, unsigned int _height)
+		{
+			GLenum format = _internalFormat == GL_RGB ? GL_RGB : GL_RGBA;
+			glBindTexture(GL_TEXTURE_2D, _texture);
+			glTexImage2D(GL_TEXTURE_2D, 0, _internalFormat, _width, _height, 0, format, GL_UNSIGNED_BYTE, NULL);
+			glBindTexture(GL_TEXTURE_2D, 0);
+		}
+	}
+
 	void RenderTexture::Resize(unsigned int _width, unsigned int _height)
 	{
 		m_width = _width;
 		m_height = _height;
 
-		//Refit texture
-		glBindTexture(GL_TEXTURE_2D, m_fbt);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, _width, _height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+		//Refit textures
+		for (size_t i = 0; i < m_colourTextures.size(); i++)
+		{
+			FitColourTexture(m_colourTextures[i], m_colourFormats[i], _width, _height);
+		}
+		//Refit depth texture
+		glBindTexture(GL_TEXTURE_2D, m_depthTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, _width, _height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
 		glBindTexture(GL_TEXTURE_2D, 0);
-		//Refit renderBufferStorage
-		glBindRenderbuffer(GL_RENDERBUFFER, m_rbo);
-		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, _width, _height);
-		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		StateCache::GetShared().Invalidate();
 	}
 
 	void RenderTexture::Bind() const 
 	{
-		glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+		StateCache::GetShared().BindFramebuffer(m_fbo);
 	}
 
 	void RenderTexture::Unbind() const
 	{
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		StateCache::GetShared().BindFramebuffer(0);
 	}
 
 	GLuint RenderTexture::GetTextureID() const
 	{
-		return m_fbt;
+		return m_colourTextures[0];
 	}
 
 	GLuint RenderTexture::GetFBOID() const
@@ -39,11 +54,24 @@ namespace ePBR
 		return m_fbo;
 	}
 
-	RenderTexture::RenderTexture(unsigned int _width, unsigned int _height)
+	RenderTexture::RenderTexture(unsigned int _width, unsigned int _height) :
+		m_colourFormats(1, GL_RGB)
+	{
+		m_width = _width;
+		m_height = _height;
+		Create();
+	}
+
+	RenderTexture::RenderTexture(unsigned int _width, unsigned int _height, const std::vector<GLenum>& _colourFormats) :
+		m_colourFormats(_colourFormats)
 	{
 		m_width = _width;
 		m_height = _height;
+		Create();
+	}
 
+	void RenderTexture::Create()
+	{
 		//Create FrameBufferObject
 		m_fbo = 0;
 		glGenFramebuffers(1, &m_fbo);
@@ -53,35 +81,48 @@ namespace ePBR
 		}
 		glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
 
-		//Create FrameBufferTexture
-		m_fbt = 0;
-		glGenTextures(1, &m_fbt);
-		glBindTexture(GL_TEXTURE_2D, m_fbt);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, m_width, m_height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		//Create FrameBufferTextures, one per colour attachment
+		std::vector<GLenum> drawBuffers;
+		m_colourTextures.assign(m_colourFormats.size(), 0);
+		glGenTextures((GLsizei)m_colourTextures.size(), m_colourTextures.data());
+		for (size_t i = 0; i < m_colourTextures.size(); i++)
+		{
+			FitColourTexture(m_colourTextures[i], m_colourFormats[i], m_width, m_height);
+			glBindTexture(GL_TEXTURE_2D, m_colourTextures[i]);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glBindTexture(GL_TEXTURE_2D, 0);
+			//Attach FrameBufferTexture to FrameBufferObject
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + (GLenum)i, GL_TEXTURE_2D, m_colourTextures[i], 0);
+			drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + (GLenum)i);
+		}
+		//Fragment outputs at each location go to the attachment of the same number
+		glDrawBuffers((GLsizei)drawBuffers.size(), drawBuffers.data());
+
+		//Create depth texture. A texture rather than a renderbuffer, so that GPU culling can sample it.
+		m_depthTexture = 0;
+		glGenTextures(1, &m_depthTexture);
+		glBindTexture(GL_TEXTURE_2D, m_depthTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, m_width, m_height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 		glBindTexture(GL_TEXTURE_2D, 0);
-		//Attach FrameBufferTexture to FrameBufferObject
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_fbt, 0);
-
-		//Create RenderBufferObject
-		m_rbo = 0;
-		glGenRenderbuffers(1, &m_rbo);
-		glBindRenderbuffer(GL_RENDERBUFFER, m_rbo);
-		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, m_width, m_height);
-		glBindRenderbuffer(GL_RENDERBUFFER, 0);
-		//Attach RenderBufferObject to FrameBufferObject
-		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_rbo);
+		//Attach depth texture to FrameBufferObject
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, m_depthTexture, 0);
 
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		StateCache::GetShared().Invalidate();
 	}
 
 	RenderTexture::~RenderTexture() 
 	{
 		glDeleteFramebuffers(1, &m_fbo);
-		glDeleteRenderbuffers(1, &m_rbo);
-		glDeleteTextures(1, &m_fbt);
+		glDeleteTextures(1, &m_depthTexture);
+		glDeleteTextures((GLsizei)m_colourTextures.size(), m_colourTextures.data());
+		StateCache::GetShared().Invalidate();
 	}
-}
\ No newline at end of file
+}
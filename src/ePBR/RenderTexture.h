@@ -5,6 +5,7 @@
 #include <glm/glm.hpp>
 
 #include <memory>
+#include <vector>
 
 namespace ePBR 
 {
@@ -14,8 +15,14 @@ namespace ePBR
 	class RenderTexture 
 	{
 		GLuint m_fbo;
-		GLuint m_rbo;
-		GLuint m_fbt;
+		GLuint m_depthTexture;
+
+		// One texture per colour attachment, and the internal format each was made with
+		std::vector<GLuint> m_colourTextures;
+		std::vector<GLenum> m_colourFormats;
+
+		// Create the framebuffer and its textures
+		void Create();
 
 		GLuint m_width;
 		GLuint m_height;
@@ -32,6 +39,19 @@ namespace ePBR
 		/// @return The ID.
 		GLuint GetTextureID() const;
 
+		/// @brief Get the OpenGL ID of one of this RenderTexture's colour textures.
+		/// @param _index The texture's attachment, counted from GL_COLOR_ATTACHMENT0.
+		/// @return The ID.
+		GLuint GetTextureID(size_t _index) const { return m_colourTextures.at(_index); }
+
+		/// @brief Get the number of colour textures this RenderTexture draws to at once.
+		/// @return The number of textures.
+		size_t GetTextureCount() const { return m_colourTextures.size(); }
+
+		/// @brief Get the OpenGL ID of this RenderTexture's depth and stencil texture, which can be sampled for its depth.
+		/// @return The ID.
+		GLuint GetDepthTextureID() const { return m_depthTexture; }
+
 		/// @brief Get the OpenGL ID of the this RenderTexture's Framebuffer.
 		/// @return The ID.
 		GLuint GetFBOID() const;
@@ -48,7 +68,16 @@ namespace ePBR
 		/// @param _width The width.
 		/// @param _height The height.
 		RenderTexture(unsigned int _width, unsigned int _height);
+
+		/// @brief Create a RenderTexture with several colour textures, which fragment shaders write to as multiple render targets.
+		/// @param _width The width.
+		/// @param _height The height.
+		/// @param _colourFormats The internal format of each colour texture, such as GL_RGBA8, in the order they are attached from GL_COLOR_ATTACHMENT0.
+		RenderTexture(unsigned int _width, unsigned int _height, const std::vector<GLenum>& _colourFormats);
 		~RenderTexture();
+
+		RenderTexture(const RenderTexture&) = delete;
+		RenderTexture& operator=(const RenderTexture&) = delete;
 	};
 }
 
@@ -1,4 +1,9 @@
 #include "Renderer.h"
+#include "ShaderBlocks.h"
+#include "StateCache.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
 
 #include <GL/glew.h>
 
@@ -15,8 +20,11 @@ namespace ePBR
 		m_depthTest(true),
 		m_backfaceCull(true),
 		m_blend(true),
+		m_frustumCull(true),
+		m_occlusionCull(false),
 		m_width(_width),
-		m_height(_height)
+		m_height(_height),
+		m_lastMultiDrawCalls(0)
 	{
 	}
 
@@ -31,66 +39,199 @@ namespace ePBR
 		m_depthTest(true),
 		m_backfaceCull(true),
 		m_blend(true),
+		m_frustumCull(true),
+		m_occlusionCull(false),
 		m_width(_renderTarget->GetWidth()),
-		m_height(_renderTarget->GetHeight())
+		m_height(_renderTarget->GetHeight()),
+		m_lastMultiDrawCalls(0)
 	{
 	}
 
 	void Renderer::Draw() 
 	{
-		// Prepare GL state
-		if (m_renderTexture) 
+		BeginDraw();
+
+		// Draw model if we have one!
+		if (m_model && !m_instances.empty() && m_gpuCuller)
 		{
-			glViewport(0, 0, m_renderTexture->GetWidth(), m_renderTexture->GetHeight());
-			m_renderTexture->Bind();
+			m_model->Enqueue(m_drawList, m_instances, m_projectionMat, m_camPos);
+			m_gpuCuller->Submit(m_drawList, m_viewMat, m_projectionMat, m_camPos, m_renderTexture.get());
+			m_cullingStats.tested += m_instances.size();
 		}
-		else 
+		else if (m_model && !m_instances.empty())
 		{
-			glViewport(0, 0, m_width, m_height);
+			m_cullModels.assign(m_instances.size(), m_model.get());
+			m_cullMatrices.clear();
+			for (const ModelInstance& instance : m_instances) m_cullMatrices.push_back(instance.modelMatrix);
+			CullListed();
+
+			m_visibleInstances.clear();
+			for (size_t i = 0; i < m_instances.size(); i++)
+			{
+				if (m_visible[i]) m_visibleInstances.push_back(m_instances[i]);
+			}
+
+			if (!m_visibleInstances.empty())
+			{
+				m_model->DrawInstanced(m_visibleInstances, m_viewMat, m_projectionMat, m_camPos);
+			}
 		}
-		if (m_blend) 
+		else if (m_model) 
 		{
-			glEnable(GL_BLEND);
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			m_cullModels.assign(1, m_model.get());
+			m_cullMatrices.assign(1, m_modelMat);
+			CullListed();
+
+			if (m_visible[0])
+			{
+				m_model->Draw(m_modelMat, m_viewMat, m_projectionMat, m_camPos);
+			}
 		}
-		if (m_backfaceCull) 
+
+		EndDraw();
+	}
+
+	void Renderer::DrawScene(const std::vector<std::shared_ptr<Model>>& _models, const std::vector<glm::mat4>& _modelMats)
+	{
+		BeginDraw();
+
+		if (m_gpuCuller)
 		{
-			glEnable(GL_CULL_FACE);
+			for (size_t i = 0; i < _models.size(); i++)
+			{
+				_models[i]->Enqueue(m_drawList, _modelMats[i], m_projectionMat, m_camPos);
+			}
+			m_lastMultiDrawCalls = m_gpuCuller->Submit(m_drawList, m_viewMat, m_projectionMat, m_camPos, m_renderTexture.get());
+			m_cullingStats.tested += _models.size();
+
+			EndDraw();
+			return;
 		}
-		if (m_depthTest) 
+
+		m_cullModels.clear();
+		for (const std::shared_ptr<Model>& model : _models) m_cullModels.push_back(model.get());
+		m_cullMatrices = _modelMats;
+		CullListed();
+
+		// Gather every visible mesh, then submit them grouped by vertex format and material
+		for (size_t i = 0; i < _models.size(); i++)
 		{
-			glEnable(GL_DEPTH_TEST);
-			glDepthFunc(GL_LESS);
+			if (!m_visible[i]) continue;
+
+			_models[i]->Enqueue(m_drawList, _modelMats[i], m_projectionMat, m_camPos);
 		}
+		m_lastMultiDrawCalls = m_drawList.Submit(m_viewMat, m_projectionMat, m_camPos);
 
-		// Draw model if we have one!
-		if (m_model) 
+		EndDraw();
+	}
+
+	void Renderer::Queue(std::shared_ptr<Model> _model, const glm::mat4& _modelMat)
+	{
+		m_queuedModels.push_back(_model);
+		m_queuedMatrices.push_back(_modelMat);
+	}
+
+	void Renderer::Flush()
+	{
+		BeginDraw();
+		if (m_deferredShading) m_deferredShading->Begin(m_renderTexture.get(), m_width, m_height);
+
+		m_cullModels.clear();
+		for (const std::shared_ptr<Model>& model : m_queuedModels) m_cullModels.push_back(model.get());
+		m_cullMatrices = m_queuedMatrices;
+		CullListed();
+
+		// LOD selection and object packing are recorded on the pool, then merged and drawn on this thread
+		m_renderQueue.Record(m_queuedModels.size(), [&](size_t _index, CommandBuffer& _buffer)
 		{
-			m_model->Draw(m_modelMat, m_viewMat, m_projectionMat, m_camPos);
+			if (m_visible[_index]) m_queuedModels[_index]->Enqueue(_buffer, m_queuedMatrices[_index], m_projectionMat, m_camPos);
+		}, &ThreadPool::GetShared());
+		m_renderQueue.Submit(m_viewMat, m_projectionMat, m_camPos, &ThreadPool::GetShared(), m_deferredShading.get());
+
+		m_queuedModels.clear();
+		m_queuedMatrices.clear();
+
+		EndDraw();
+	}
+
+	void Renderer::CullListed()
+	{
+		size_t count = m_cullModels.size();
+		m_visible.assign(count, 1);
+
+		// Large instance sets are split across the shared pool
+		if (m_frustumCull)
+		{
+			m_culler.Clear();
+			for (size_t i = 0; i < count; i++)
+			{
+				m_culler.Add(TransformSphere(m_cullModels[i]->GetBoundingSphere(), m_cullMatrices[i]));
+			}
+
+			const CullingStats& stats = m_culler.Cull(m_viewMat, m_projectionMat, m_camPos, m_cullingOptions, &ThreadPool::GetShared());
+			m_cullingStats.frustumCulled += stats.frustumCulled;
+			m_cullingStats.distanceCulled += stats.distanceCulled;
+			m_cullingStats.sizeCulled += stats.sizeCulled;
+
+			for (size_t i = 0; i < count; i++) m_visible[i] = m_culler.IsVisible(i);
 		}
 
-		// Reset GL state
-		if (m_renderTexture)
+		// Whatever survived hides the rest behind its occluders
+		if (m_occlusionCull)
 		{
-			m_renderTexture->Unbind();
+			m_occlusionCuller.Begin(m_projectionMat * m_viewMat);
+			for (size_t i = 0; i < count; i++)
+			{
+				if (m_visible[i]) m_cullModels[i]->AddOccluders(m_occlusionCuller, m_cullMatrices[i]);
+			}
+			m_occlusionCuller.Rasterise(&ThreadPool::GetShared());
+
+			for (size_t i = 0; i < count; i++)
+			{
+				if (m_visible[i] && !m_occlusionCuller.IsVisible(m_cullModels[i]->GetBoundsMin(), m_cullModels[i]->GetBoundsMax(), m_cullMatrices[i]))
+				{
+					m_visible[i] = 0;
+					m_cullingStats.occlusionCulled++;
+				}
+			}
 		}
-		if (m_blend)
+
+		m_cullingStats.tested += count;
+		m_cullingStats.visible += std::count(m_visible.begin(), m_visible.end(), (unsigned char)1);
+	}
+
+	void Renderer::BeginDraw()
+	{
+		// Prepare GL state. Only what differs from the last draw reaches the driver.
+		if (m_renderTexture) 
 		{
-			glDisable(GL_BLEND);
+			glViewport(0, 0, m_renderTexture->GetWidth(), m_renderTexture->GetHeight());
+			m_renderTexture->Bind();
 		}
-		if (m_backfaceCull)
+		else 
 		{
-
-			glDisable(GL_CULL_FACE);
+			glViewport(0, 0, m_width, m_height);
 		}
-		if (m_depthTest)
+		StateCache::GetShared().ApplyPipeline(PipelineState(m_blend, m_depthTest, true, m_backfaceCull));
+		SetViewUniforms(m_viewMat, m_projectionMat, m_camPos);
+	}
+
+	void Renderer::EndDraw()
+	{
+		// Raster state is left as it is, for the next BeginDraw() to diff against
+		if (m_renderTexture)
 		{
-			glDisable(GL_DEPTH_TEST);
+			m_renderTexture->Unbind();
 		}
 	}
 
 	void Renderer::Clear() 
 	{
+		m_cullingStats = CullingStats();
+
+		// Depth is only cleared where it can be written
+		StateCache::GetShared().SetDepthWrite(true);
+
 		if (m_renderTexture) 
 		{
 			m_renderTexture->Bind();
@@ -2,8 +2,11 @@
 #define EPBR_RENDERER
 
 #include <memory>
+#include <vector>
 #include <glm/glm.hpp>
 
+#include "DeferredShading.h"
+#include "GpuCuller.h"
 #include "Model.h"
 #include "RenderTexture.h"
 
@@ -13,6 +16,7 @@ namespace ePBR
 	{
 		std::shared_ptr<RenderTexture> m_renderTexture;
 		std::shared_ptr<Model> m_model;
+		std::vector<ModelInstance> m_instances;
 
 		glm::mat4 m_projectionMat;
 		glm::mat4 m_viewMat;
@@ -25,10 +29,46 @@ namespace ePBR
 		bool m_depthTest;
 		bool m_backfaceCull;
 		bool m_blend;
+		bool m_frustumCull;
+		bool m_occlusionCull;
 
 		int m_width;
 		int m_height;
 
+		// Reused by DrawScene() each frame
+		IndirectDrawList m_drawList;
+		size_t m_lastMultiDrawCalls;
+
+		// Bounds tested before each draw, and the results since the last Clear()
+		FrustumCuller m_culler;
+		OcclusionCuller m_occlusionCuller;
+		CullingOptions m_cullingOptions;
+		CullingStats m_cullingStats;
+
+		// Culls on the GPU in place of the CPU tests, when set
+		std::shared_ptr<GpuCuller> m_gpuCuller;
+
+		// Lights opaque queued meshes in one pass, when set
+		std::shared_ptr<DeferredShading> m_deferredShading;
+
+		// Models queued since the last Flush(), each placed by the matching matrix, and the packets they become
+		std::vector<std::shared_ptr<Model>> m_queuedModels;
+		std::vector<glm::mat4> m_queuedMatrices;
+		RenderQueue m_renderQueue;
+
+		// The models to cull, each placed by the matching matrix, and whether each may be visible
+		std::vector<const Model*> m_cullModels;
+		std::vector<glm::mat4> m_cullMatrices;
+		std::vector<unsigned char> m_visible;
+		std::vector<ModelInstance> m_visibleInstances;
+
+		// Set and reset GL state around drawing
+		void BeginDraw();
+		void EndDraw();
+
+		// Fill m_visible for the listed models, and add the results to m_cullingStats
+		void CullListed();
+
 	public:
 		/// @brief Create a renderer with specified width and height which will render to whatever framebuffer is bound unless a RenderTexture is set.
 		/// @param _width The width.
@@ -40,8 +80,64 @@ namespace ePBR
 		Renderer(std::shared_ptr<RenderTexture> _renderTarget);
 
 		/// @brief Draw using whatever parameters are set on this renderer.
+		/// @details The model, or each of its instances, is skipped when its bounding sphere is outside the view or, with occlusion culling, hidden behind the occluders of the other instances.
 		virtual void Draw();
 
+		/// @brief Draw many models at once, with one glMultiDrawElementsIndirect call per geometry arena and material, using the view and projection set on this renderer.
+		/// @details CPU cost grows with the number of distinct formats and materials rather than the number of models. Models outside the view, or with occlusion culling hidden behind other models' occluders, are skipped.
+		/// @param _models The models.
+		/// @param _modelMats The model matrix of each model.
+		void DrawScene(const std::vector<std::shared_ptr<Model>>& _models, const std::vector<glm::mat4>& _modelMats);
+
+		/// @brief Add a model to this frame's render queue, to be drawn by the next Flush().
+		/// @param _model The model.
+		/// @param _modelMat The model matrix.
+		void Queue(std::shared_ptr<Model> _model, const glm::mat4& _modelMat);
+
+		/// @brief Cull every queued model, then draw the rest sorted by render state and depth, using the view and projection set on this renderer.
+		/// @details Opaque meshes are drawn first, grouped by shader program, textures and material, front to back within each group. Meshes with transparent materials follow, back to front.
+		/// GL state is set once for the whole queue rather than once per model.
+		/// With deferred shading set, opaque meshes whose materials support it are drawn into its G-buffer and lit together before the rest are drawn forward.
+		void Flush();
+
+		/// @brief Get the render queue Flush() draws with, for its state change counts.
+		/// @return The queue.
+		const RenderQueue& GetRenderQueue() const { return m_renderQueue; }
+
+		/// @brief Get how many multi-draw calls the last DrawScene() made.
+		/// @return The number of calls.
+		size_t GetLastMultiDrawCalls() const { return m_lastMultiDrawCalls; }
+
+		/// @brief Get how many models and instances passed and failed culling since the last Clear().
+		/// @return The counts.
+		const CullingStats& GetCullingStats() const { return m_cullingStats; }
+
+		/// @brief Set the culling tests made on top of the frustum test.
+		/// @param _newOptions The new options.
+		void SetCullingOptions(const CullingOptions& _newOptions) { m_cullingOptions = _newOptions; }
+
+		/// @brief Get the culling tests made on top of the frustum test.
+		/// @return The options.
+		const CullingOptions& GetCullingOptions() const { return m_cullingOptions; }
+
+		/// @brief Set a GPU culler to cull instanced draws and DrawScene() in place of the CPU tests and culling options.
+		/// @details With a RenderTexture, its depth buffer hides instances through a Hi-Z pyramid. Results stay on the GPU, so culling stats only count what was tested.
+		/// @param _newGpuCuller The culler, from Context::CreateGpuCuller(), or nullptr to cull on the CPU.
+		void SetGpuCuller(std::shared_ptr<GpuCuller> _newGpuCuller) { m_gpuCuller = _newGpuCuller; }
+
+		/// @brief Get the GPU culler used in place of the CPU tests.
+		/// @return The culler, or nullptr when culling on the CPU.
+		std::shared_ptr<GpuCuller> GetGpuCuller() const { return m_gpuCuller; }
+
+		/// @brief Set deferred shading for Flush() to light opaque meshes with, in place of each material's own forward lights.
+		/// @details Only Flush() draws deferred. Draw() and DrawScene() shade everything forward either way.
+		/// @param _newDeferredShading The deferred shading, from Context::CreateDeferredShading(), or nullptr to shade everything forward.
+		void SetDeferredShading(std::shared_ptr<DeferredShading> _newDeferredShading) { m_deferredShading = _newDeferredShading; }
+
+		/// @brief Get the deferred shading Flush() lights opaque meshes with.
+		/// @return The deferred shading, or nullptr when shading everything forward.
+		std::shared_ptr<DeferredShading> GetDeferredShading() const { return m_deferredShading; }
+
 		// Getters and setters past this point:
 		
 		/// @brief Set the dimensions of this renderer.
@@ -85,6 +181,14 @@ namespace ePBR
 		/// @return The model.
 		std::shared_ptr<Model> GetModel() const { return m_model; }
 
+		/// @brief Set copies of the model for this renderer to draw with instancing, in place of the model matrix.
+		/// @param _newInstances The copies, or none to draw the model once with the model matrix.
+		void SetInstances(const std::vector<ModelInstance>& _newInstances) { m_instances = _newInstances; }
+
+		/// @brief Get the copies of the model this renderer will draw.
+		/// @return The copies. Empty if the model is drawn once.
+		const std::vector<ModelInstance>& GetInstances() const { return m_instances; }
+
 		/// @brief Set the projection matrix this renderer will use to draw.
 		/// @param _newProjectionMat The new projection matrix.
 		void SetProjectionMat(const glm::mat4& _newProjectionMat) { m_projectionMat = _newProjectionMat; }
@@ -132,7 +236,7 @@ namespace ePBR
 		/// @return The clear colour.
 		glm::vec4 GetClearColour() const { return m_clearColour; }
 
-		/// @brief Clear the render target using the current clear colour.
+		/// @brief Clear the render target using the current clear colour, and start counting culling results afresh.
 		void Clear();
 
 		/// @brief Set whether this renderer should perform depth tests when drawing. Disabling will cause new objects to always be drawn overtop others.
@@ -158,6 +262,22 @@ namespace ePBR
 		/// @brief Get whether or not this renderer will perform blending.
 		/// @return The flag state.
 		bool GetFlagBlend() const { return m_blend; }
+
+		/// @brief Set whether this renderer should skip models and instances whose bounds are outside the view.
+		/// @param _doFrustumCulling The new flag state.
+		void SetFlagFrustumCull(bool _doFrustumCulling) { m_frustumCull = _doFrustumCulling; }
+
+		/// @brief Get whether this renderer will skip models and instances whose bounds are outside the view.
+		/// @return The flag state.
+		bool GetFlagFrustumCull() const { return m_frustumCull; }
+
+		/// @brief Set whether this renderer should skip models and instances hidden behind the occluders of others, found by rasterising them on the CPU. Only meshes imported with ImportOptions::buildOccluders hide anything.
+		/// @param _doOcclusionCulling The new flag state.
+		void SetFlagOcclusionCull(bool _doOcclusionCulling) { m_occlusionCull = _doOcclusionCulling; }
+
+		/// @brief Get whether this renderer will skip models and instances hidden behind the occluders of others.
+		/// @return The flag state.
+		bool GetFlagOcclusionCull() const { return m_occlusionCull; }
 	};
 }
 
@@ -4,9 +4,81 @@
 #include <iostream>
 
 #include "Shader.h"
+#include "StateCache.h"
 
 namespace ePBR
 {
+	namespace
+	{
+		// Put definitions straight after the #version line, which must come before anything else
+		std::string InsertDefines(const std::string& _source, const std::vector<std::string>& _defines)
+		{
+			if (_defines.empty()) return _source;
+
+			std::string defines;
+			for (const std::string& define : _defines) defines += "#define " + define + "\n";
+
+			size_t version = _source.find("#version");
+			if (version == std::string::npos) return defines + _source;
+
+			size_t lineEnd = _source.find('\n', version);
+			if (lineEnd == std::string::npos) return _source + "\n" + defines;
+
+			return _source.substr(0, lineEnd + 1) + defines + _source.substr(lineEnd + 1);
+		}
+
+		// Replace each #include "file" line with that file, found beside the file including it, so that shaders can share functions
+		std::string ExpandIncludes(const std::string& _source, const std::string& _path, int _depth = 0)
+		{
+			if (_source.find("#include") == std::string::npos) return _source;
+
+			// Files including each other would otherwise never finish
+			if (_depth > 8)
+			{
+				std::cerr << "Shader includes nest too deeply at " << _path << std::endl;
+				throw std::exception();
+			}
+
+			size_t slash = _path.find_last_of("/\\");
+			std::string directory = slash == std::string::npos ? std::string() : _path.substr(0, slash + 1);
+
+			std::string expanded;
+			std::istringstream lines(_source);
+			std::string line;
+			while (std::getline(lines, line))
+			{
+				size_t directive = line.find_first_not_of(" \t");
+				if (directive == std::string::npos || line.compare(directive, 8, "#include") != 0)
+				{
+					expanded += line + "\n";
+					continue;
+				}
+
+				size_t open = line.find('"', directive);
+				size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+				if (close == std::string::npos)
+				{
+					std::cerr << "Malformed shader include in " << _path << ": " << line << std::endl;
+					throw std::exception();
+				}
+
+				std::string includePath = directory + line.substr(open + 1, close - open - 1);
+				std::ifstream includeRead(includePath);
+				if (!includeRead.is_open())
+				{
+					std::cerr << "Failed to open shader include at " << includePath << std::endl;
+					throw std::exception();
+				}
+
+				std::stringstream includeStream;
+				includeStream << includeRead.rdbuf();
+				expanded += ExpandIncludes(includeStream.str(), includePath, _depth + 1) + "\n";
+			}
+
+			return expanded;
+		}
+	}
+
 	void Shader::LoadNewVertexShader(const char* _path)
 	{
 		std::ifstream fileRead;
@@ -26,9 +98,10 @@ namespace ePBR
 		}
 
 		strStream << fileRead.rdbuf();
-		stringSrc = strStream.str();
+		stringSrc = InsertDefines(ExpandIncludes(strStream.str(), _path), m_defines);
 		const char* src = stringSrc.c_str();
 		fileRead.close();
+		m_vertPath = _path;
 
 		// Create a new vertex shader, attach source code, compile it and
 		// check for errors.
@@ -70,9 +143,10 @@ namespace ePBR
 		}
 
 		strStream << fileRead.rdbuf();
-		stringSrc = strStream.str();
+		stringSrc = InsertDefines(ExpandIncludes(strStream.str(), _path), m_defines);
 		const char* src = stringSrc.c_str();
 		fileRead.close();
+		m_fragPath = _path;
 
 		// Create a new fragment shader, attach source code, compile it and
 		// check for errors.
@@ -166,6 +240,32 @@ namespace ePBR
 		m_id = glCreateProgram();
 	}
 
+	Shader::Shader(const std::string& _vertexPath, const std::string& _fragmentPath, const std::vector<std::string>& _defines) :
+		m_vertID(0),
+		m_fragID(0),
+		m_id(0),
+		m_defines(_defines),
+		m_dirty(true)
+	{
+		LoadNewVertexShader(_vertexPath.c_str());
+		LoadNewFragmentShader(_fragmentPath.c_str());
+
+		m_id = glCreateProgram();
+	}
+
+	std::shared_ptr<Shader> Shader::GetVariant(const std::string& _define)
+	{
+		std::shared_ptr<Shader>& variant = m_variants[_define];
+		if (!variant)
+		{
+			std::vector<std::string> defines = m_defines;
+			defines.push_back(_define);
+			variant = std::make_shared<Shader>(m_vertPath, m_fragPath, defines);
+		}
+
+		return variant;
+	}
+
 	Shader::Shader() :
 		m_dirty(true),
 		m_vertID(0),
@@ -181,5 +281,65 @@ namespace ePBR
 		glDetachShader(m_id, m_fragID);
 		glDeleteShader(m_fragID);
 		glDeleteProgram(m_id);
+		StateCache::GetShared().Invalidate();
+	}
+
+	ComputeShader::ComputeShader(const std::string& _path, const std::vector<std::string>& _defines) :
+		m_shaderID(0),
+		m_id(0)
+	{
+		std::ifstream fileRead(_path);
+		if (!fileRead.is_open())
+		{
+			std::cerr << "Failed to open compute shader at " << _path << std::endl;
+			throw std::exception();
+		}
+
+		std::stringstream strStream;
+		strStream << fileRead.rdbuf();
+		std::string stringSrc = InsertDefines(ExpandIncludes(strStream.str(), _path), _defines);
+		const char* src = stringSrc.c_str();
+
+		m_shaderID = glCreateShader(GL_COMPUTE_SHADER);
+		glShaderSource(m_shaderID, 1, &src, NULL);
+		glCompileShader(m_shaderID);
+		GLint success = 0;
+		glGetShaderiv(m_shaderID, GL_COMPILE_STATUS, &success);
+
+		if (!success)
+		{
+			GLint maxLength = 0;
+			glGetShaderiv(m_shaderID, GL_INFO_LOG_LENGTH, &maxLength);
+			std::vector<GLchar> errorLog(maxLength + 1);
+			glGetShaderInfoLog(m_shaderID, maxLength, &maxLength, &errorLog[0]);
+			std::cerr << _path << ": " << &errorLog.at(0) << std::endl;
+			glDeleteShader(m_shaderID);
+			throw std::exception();
+		}
+
+		m_id = glCreateProgram();
+		glAttachShader(m_id, m_shaderID);
+		glLinkProgram(m_id);
+		glGetProgramiv(m_id, GL_LINK_STATUS, &success);
+
+		if (!success)
+		{
+			GLint maxLength = 0;
+			glGetProgramiv(m_id, GL_INFO_LOG_LENGTH, &maxLength);
+			std::vector<GLchar> errorLog(maxLength + 1);
+			glGetProgramInfoLog(m_id, maxLength, &maxLength, &errorLog[0]);
+			std::cerr << _path << ": " << &errorLog.at(0) << std::endl;
+			glDeleteProgram(m_id);
+			glDeleteShader(m_shaderID);
+			throw std::exception();
+		}
+	}
+
+	ComputeShader::~ComputeShader()
+	{
+		glDetachShader(m_id, m_shaderID);
+		glDeleteShader(m_shaderID);
+		glDeleteProgram(m_id);
+		StateCache::GetShared().Invalidate();
 	}
-}
\ No newline at end of file
+}
@@ -2,11 +2,15 @@
 #define EPBR_SHADER
 
 #include <GL/glew.h>
+#include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace ePBR
 {
 	/// @brief Shader wrapper with lazy compilation
+	/// @details Lines of the form #include "file" are replaced with that file, found beside the shader including it, so shaders can share functions.
 	class Shader
 	{
 	public:
@@ -39,6 +43,18 @@ namespace ePBR
 		/// @param _fragmentPath The path to the fragment shader.
 		Shader(const std::string& _vertexPath, const std::string& _fragmentPath);
 
+		/// @brief Create a shader program using a vertex and fragment shader, each compiled with a set of preprocessor definitions.
+		/// @param _vertexPath The path to the vertex shader.
+		/// @param _fragmentPath The path to the fragment shader.
+		/// @param _defines Names to #define straight after each shader's #version line.
+		Shader(const std::string& _vertexPath, const std::string& _fragmentPath, const std::vector<std::string>& _defines);
+
+		/// @brief Get a variant of this shader program compiled from the same files with one more name defined, such as INSTANCED.
+		/// @details Variants are compiled on first use and kept for as long as this shader.
+		/// @param _define The name to define.
+		/// @return The variant.
+		std::shared_ptr<Shader> GetVariant(const std::string& _define);
+
 		/// @brief Create an empty shader.
 		Shader();
 		~Shader();
@@ -47,10 +63,38 @@ namespace ePBR
 		GLuint m_fragID;
 		GLuint m_id;
 
+		// Kept to compile variants from
+		std::string m_vertPath;
+		std::string m_fragPath;
+		std::vector<std::string> m_defines;
+		std::map<std::string, std::shared_ptr<Shader>> m_variants;
+
 		//If attributes or shaders are changed, program will need to be relinked.
 		//Dirty is used to track if there have been changes since last link.
 		bool m_dirty;
 	};
+
+	/// @brief A compute shader program, compiled and linked when created. Expands #include lines as Shader does.
+	class ComputeShader
+	{
+	public:
+		/// @brief Load, compile and link a compute shader.
+		/// @param _path The path to the compute shader.
+		/// @param _defines Names to #define straight after the shader's #version line.
+		ComputeShader(const std::string& _path, const std::vector<std::string>& _defines = std::vector<std::string>());
+		~ComputeShader();
+
+		ComputeShader(const ComputeShader&) = delete;
+		ComputeShader& operator=(const ComputeShader&) = delete;
+
+		/// @brief Get the OpenGL ID of this shader program.
+		/// @return The ID.
+		GLuint GetID() const { return m_id; }
+
+	private:
+		GLuint m_shaderID;
+		GLuint m_id;
+	};
 }
 
 #endif // EPBR_SHADER
\ No newline at end of file
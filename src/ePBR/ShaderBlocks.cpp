@@ -0,0 +1,101 @@
+#include "ShaderBlocks.h"
+#include "StreamBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace ePBR
+{
+	namespace
+	{
+		// What the view block holds, so that unchanged views upload nothing
+		ViewUniforms currentView;
+		GLuint viewBuffer = 0;
+
+		// The object range at OBJECT_STORAGE_BINDING
+		size_t boundObjectsOffset = StreamBuffer::NO_SPACE;
+		size_t boundObjectsCount = 0;
+
+		size_t GetStorageAlignment()
+		{
+			static size_t alignment = 0;
+			if (!alignment)
+			{
+				GLint value = 0;
+				glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &value);
+				alignment = std::max<size_t>(4, (size_t)value);
+			}
+			return alignment;
+		}
+	}
+
+	void SetViewUniforms(const glm::mat4& _viewMatrix, const glm::mat4& _projMatrix, const glm::vec3& _camPos)
+	{
+		ViewUniforms view;
+		view.viewMatrix = _viewMatrix;
+		view.projMatrix = _projMatrix;
+		view.viewProjMatrix = _projMatrix * _viewMatrix;
+		view.camPos = glm::vec4(_camPos, 1.0f);
+
+		if (viewBuffer && std::memcmp(&view, &currentView, sizeof(ViewUniforms)) == 0) return;
+
+		// Bound to the copy target so that no other uniform buffer binding changes
+		if (!viewBuffer)
+		{
+			glGenBuffers(1, &viewBuffer);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, viewBuffer);
+			glBufferData(GL_COPY_WRITE_BUFFER, sizeof(ViewUniforms), &view, GL_DYNAMIC_DRAW);
+			glBindBufferBase(GL_UNIFORM_BUFFER, VIEW_UNIFORM_BINDING, viewBuffer);
+		}
+		else
+		{
+			glBindBuffer(GL_COPY_WRITE_BUFFER, viewBuffer);
+			glBufferSubData(GL_COPY_WRITE_BUFFER, 0, sizeof(ViewUniforms), &view);
+		}
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+		currentView = view;
+	}
+
+	StreamBuffer& GetObjectBuffer()
+	{
+		// Created on first use, as it needs a GL context, and left for the context to clean up
+		static StreamBuffer* buffer = new StreamBuffer(MAX_OBJECTS_PER_FRAME * sizeof(ObjectData));
+		return *buffer;
+	}
+
+	size_t WriteObjects(const ObjectData* _objects, size_t _count)
+	{
+		size_t offset = GetObjectBuffer().Write(_objects, _count * sizeof(ObjectData), GetStorageAlignment());
+
+		static bool warned = false;
+		if (offset == StreamBuffer::NO_SPACE && !warned)
+		{
+			std::cerr << "WARNING: More objects were drawn this frame than MAX_OBJECTS_PER_FRAME. Some have been skipped." << std::endl;
+			warned = true;
+		}
+		return offset;
+	}
+
+	ObjectData* MapObjects(size_t _count, size_t& _offset)
+	{
+		StreamBuffer& buffer = GetObjectBuffer();
+		if (!buffer.IsPersistent()) return nullptr;
+
+		// Left to WriteObjects() to warn about
+		_offset = buffer.Allocate(_count * sizeof(ObjectData), GetStorageAlignment());
+		if (_offset == StreamBuffer::NO_SPACE) return nullptr;
+
+		return (ObjectData*)buffer.GetMappedPointer(_offset);
+	}
+
+	void BindObjects(size_t _offset, size_t _count)
+	{
+		if (_offset == boundObjectsOffset && _count == boundObjectsCount) return;
+
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, OBJECT_STORAGE_BINDING, GetObjectBuffer().GetID(), _offset, _count * sizeof(ObjectData));
+		boundObjectsOffset = _offset;
+		boundObjectsCount = _count;
+	}
+}
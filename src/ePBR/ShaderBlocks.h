@@ -0,0 +1,69 @@
+#ifndef EPBR_SHADER_BLOCKS
+#define EPBR_SHADER_BLOCKS
+
+#include <cstddef>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+namespace ePBR
+{
+	class StreamBuffer;
+
+	/// @brief The uniform block binding the PBR shaders read ViewUniforms from.
+	const GLuint VIEW_UNIFORM_BINDING = 0;
+
+	/// @brief The shader storage binding the PBR shaders read ObjectData from. Above the bindings GpuCuller uses, so culling never disturbs it.
+	const GLuint OBJECT_STORAGE_BINDING = 5;
+
+	/// @brief The most objects which can be written to the object buffer in one frame.
+	const size_t MAX_OBJECTS_PER_FRAME = 1 << 16;
+
+	/// @brief Everything the PBR shaders need which is the same for every draw of a view, laid out as the std140 ViewBlock.
+	struct ViewUniforms
+	{
+		glm::mat4 viewMatrix = glm::mat4(1.0f);
+		glm::mat4 projMatrix = glm::mat4(1.0f);
+		glm::mat4 viewProjMatrix = glm::mat4(1.0f);
+		glm::vec4 camPos = glm::vec4(0.0f); // w unused
+	};
+
+	/// @brief One drawn object, laid out as an element of the std430 ObjectBlock. The shader picks its element with the objectIndex uniform.
+	struct ObjectData
+	{
+		glm::mat4 modelMatrix = glm::mat4(1.0f);
+		glm::mat4 normalMatrix = glm::mat4(1.0f); // Inverse transpose of the model matrix's upper 3x3
+		glm::mat4 mvpMatrix = glm::mat4(1.0f); // View projection times model
+		GLuint materialIndex = 0; // Record in the TextureResidency, read by RESIDENT_TEXTURES variants
+		GLuint padding[3] = { 0, 0, 0 }; // std430 rounds the struct up to its mat4 alignment
+	};
+
+	/// @brief Make these the view uniforms every PBR shader reads, uploading them only if they differ from the current ones.
+	/// @param _viewMatrix The view matrix.
+	/// @param _projMatrix The projection matrix.
+	/// @param _camPos The position of the camera.
+	void SetViewUniforms(const glm::mat4& _viewMatrix, const glm::mat4& _projMatrix, const glm::vec3& _camPos);
+
+	/// @brief Get the stream buffer objects are written to, creating it on first use.
+	/// @return The buffer.
+	StreamBuffer& GetObjectBuffer();
+
+	/// @brief Copy objects into the current frame's region of the object buffer.
+	/// @param _objects The objects.
+	/// @param _count The number of objects.
+	/// @return The offset of the first within the buffer, or StreamBuffer::NO_SPACE.
+	size_t WriteObjects(const ObjectData* _objects, size_t _count);
+
+	/// @brief Claim room for objects in the current frame's region of the object buffer, to be filled in place rather than copied.
+	/// @param _count The number of objects.
+	/// @param _offset Receives the offset of the first within the buffer.
+	/// @return Where to write the objects, or nullptr if the buffer isn't persistently mapped or has no room, in which case use WriteObjects().
+	ObjectData* MapObjects(size_t _count, size_t& _offset);
+
+	/// @brief Bind objects written by WriteObjects() or MapObjects() to OBJECT_STORAGE_BINDING, so that objectIndex 0 reads the first. Skipped if they are already bound.
+	/// @param _offset The offset WriteObjects() returned.
+	/// @param _count The number of objects.
+	void BindObjects(size_t _offset, size_t _count);
+}
+
+#endif // EPBR_SHADER_BLOCKS
@@ -0,0 +1,118 @@
+#ifndef EPBR_SIMD
+#define EPBR_SIMD
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EPBR_SSE 1
+#include <emmintrin.h>
+#else
+#define EPBR_SSE 0
+#include <cmath>
+#include <cstring>
+#endif
+
+namespace ePBR
+{
+	/// @brief Four floats processed together. Used for structure of arrays batches, one element per lane.
+	/// @details Maps onto SSE where the compiler targets it, and onto plain loops elsewhere.
+	/// Comparisons return lane masks, all bits set where true, for use with Select() and MoveMask().
+	struct Float4
+	{
+#if EPBR_SSE
+		__m128 v;
+
+		Float4() {}
+		Float4(__m128 _v) : v(_v) {}
+		explicit Float4(float _value) : v(_mm_set1_ps(_value)) {}
+
+		/// @brief Load four floats from 16 byte aligned memory.
+		static Float4 Load(const float* _aligned) { return _mm_load_ps(_aligned); }
+		/// @brief Store four floats to 16 byte aligned memory.
+		void Store(float* _aligned) const { _mm_store_ps(_aligned, v); }
+		/// @brief Load four floats from any address.
+		static Float4 LoadUnaligned(const float* _data) { return _mm_loadu_ps(_data); }
+		/// @brief Store four floats to any address.
+		void StoreUnaligned(float* _data) const { _mm_storeu_ps(_data, v); }
+
+		friend Float4 operator+(Float4 _a, Float4 _b) { return _mm_add_ps(_a.v, _b.v); }
+		friend Float4 operator-(Float4 _a, Float4 _b) { return _mm_sub_ps(_a.v, _b.v); }
+		friend Float4 operator*(Float4 _a, Float4 _b) { return _mm_mul_ps(_a.v, _b.v); }
+		friend Float4 operator/(Float4 _a, Float4 _b) { return _mm_div_ps(_a.v, _b.v); }
+		friend Float4 operator&(Float4 _a, Float4 _b) { return _mm_and_ps(_a.v, _b.v); }
+		friend Float4 operator|(Float4 _a, Float4 _b) { return _mm_or_ps(_a.v, _b.v); }
+
+		friend Float4 operator<(Float4 _a, Float4 _b) { return _mm_cmplt_ps(_a.v, _b.v); }
+		friend Float4 operator<=(Float4 _a, Float4 _b) { return _mm_cmple_ps(_a.v, _b.v); }
+		friend Float4 operator>(Float4 _a, Float4 _b) { return _mm_cmpgt_ps(_a.v, _b.v); }
+		friend Float4 operator>=(Float4 _a, Float4 _b) { return _mm_cmpge_ps(_a.v, _b.v); }
+		friend Float4 operator!=(Float4 _a, Float4 _b) { return _mm_cmpneq_ps(_a.v, _b.v); }
+
+		friend Float4 Min(Float4 _a, Float4 _b) { return _mm_min_ps(_a.v, _b.v); }
+		friend Float4 Max(Float4 _a, Float4 _b) { return _mm_max_ps(_a.v, _b.v); }
+		friend Float4 Sqrt(Float4 _a) { return _mm_sqrt_ps(_a.v); }
+		friend Float4 Abs(Float4 _a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), _a.v); }
+
+		/// @brief Take _a in lanes where _mask is set and _b elsewhere.
+		friend Float4 Select(Float4 _mask, Float4 _a, Float4 _b) { return _mm_or_ps(_mm_and_ps(_mask.v, _a.v), _mm_andnot_ps(_mask.v, _b.v)); }
+		/// @brief Get one bit per lane, set where the lane's sign bit is set.
+		friend int MoveMask(Float4 _mask) { return _mm_movemask_ps(_mask.v); }
+#else
+		float v[4];
+
+		Float4() {}
+		explicit Float4(float _value) { for (int i = 0; i < 4; i++) v[i] = _value; }
+
+		static Float4 Load(const float* _aligned) { Float4 r; for (int i = 0; i < 4; i++) r.v[i] = _aligned[i]; return r; }
+		void Store(float* _aligned) const { for (int i = 0; i < 4; i++) _aligned[i] = v[i]; }
+		static Float4 LoadUnaligned(const float* _data) { return Load(_data); }
+		void StoreUnaligned(float* _data) const { Store(_data); }
+
+		template <typename Op>
+		static Float4 Map(Float4 _a, Float4 _b, Op _op) { Float4 r; for (int i = 0; i < 4; i++) r.v[i] = _op(_a.v[i], _b.v[i]); return r; }
+
+		static float Mask(bool _set) { float f; unsigned int bits = _set ? 0xFFFFFFFFu : 0u; memcpy(&f, &bits, 4); return f; }
+		static unsigned int Bits(float _f) { unsigned int bits; memcpy(&bits, &_f, 4); return bits; }
+
+		friend Float4 operator+(Float4 _a, Float4 _b) { return Map(_a, _b, [](float _x, float _y) { return _x + _y; }); }
+		friend Float4 operator-(Float4 _a, Float4 _b) { return Map(_a, _b, [](float _x, float _y) { return _x - _y; }); }
+		friend Float4 operator*(Float4 _a, Float4 _b) { return Map(_a, _b, [](float _x, float _y) { return _x * _y; }); }
+		friend Float4 operator/(Float4 _a, Float4 _b) { return Map(_a, _b, [](float _x, float _y) { return _x / _y; }); }
+		friend Float4 operator&(Float4 _a, Float4 _b) { Float4 r; for (int i = 0; i < 4; i++) { unsigned int bits = Bits(_a.v[i]) & Bits(_b.v[i]); memcpy(&r.v[i], &bits, 4); } return r; }
+		friend Float4 operator|(Float4 _a, Float4 _b) { Float4 r; for (int i = 0; i < 4; i++) { unsigned int bits = Bits(_a.v[i]) | Bits(_b.v[i]); memcpy(&r.v[i], &bits, 4); } return r; }
+
+		friend Float4 operator<(Float4 _a, Float4 _b) { return Map(_a, _b, [](float _x, float _y) { return Mask(_x < _y); }); }
+		friend Float4 operator<=(Float4 _a, Float4 _b) { return Map(_a, _b, [](float _x, float _y) { return Mask(_x <= _y); }); }
+		friend Float4 operator>(Float4 _a, Float4 _b) { return Map(_a, _b, [](float _x, float _y) { return Mask(_x > _y); }); }
+		friend Float4 operator>=(Float4 _a, Float4 _b) { return Map(_a, _b, [](float _x, float _y) { return Mask(_x >= _y); }); }
+		friend Float4 operator!=(Float4 _a, Float4 _b) { return Map(_a, _b, [](float _x, float _y) { return Mask(_x != _y); }); }
+
+		friend Float4 Min(Float4 _a, Float4 _b) { return Map(_a, _b, [](float _x, float _y) { return _y < _x ? _y : _x; }); }
+		friend Float4 Max(Float4 _a, Float4 _b) { return Map(_a, _b, [](float _x, float _y) { return _x < _y ? _y : _x; }); }
+		friend Float4 Sqrt(Float4 _a) { Float4 r; for (int i = 0; i < 4; i++) r.v[i] = std::sqrt(_a.v[i]); return r; }
+		friend Float4 Abs(Float4 _a) { Float4 r; for (int i = 0; i < 4; i++) r.v[i] = std::fabs(_a.v[i]); return r; }
+
+		friend Float4 Select(Float4 _mask, Float4 _a, Float4 _b) { Float4 r; for (int i = 0; i < 4; i++) r.v[i] = Bits(_mask.v[i]) ? _a.v[i] : _b.v[i]; return r; }
+		friend int MoveMask(Float4 _mask) { int r = 0; for (int i = 0; i < 4; i++) r |= (Bits(_mask.v[i]) >> 31) << i; return r; }
+#endif
+	};
+
+	/// @brief Transpose four Float4s as the rows of a 4x4 matrix, turning four vectors into one Float4 per component, and back.
+	inline void Transpose(Float4& _a, Float4& _b, Float4& _c, Float4& _d)
+	{
+#if EPBR_SSE
+		_MM_TRANSPOSE4_PS(_a.v, _b.v, _c.v, _d.v);
+#else
+		Float4* rows[4] = { &_a, &_b, &_c, &_d };
+		for (int i = 0; i < 4; i++)
+		{
+			for (int j = i + 1; j < 4; j++)
+			{
+				float value = rows[i]->v[j];
+				rows[i]->v[j] = rows[j]->v[i];
+				rows[j]->v[i] = value;
+			}
+		}
+#endif
+	}
+}
+
+#endif // EPBR_SIMD
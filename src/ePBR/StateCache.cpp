@@ -0,0 +1,232 @@
+#include "StateCache.h"
+
+#include <cstring>
+
+namespace ePBR
+{
+	StateCache& StateCache::GetShared()
+	{
+		static StateCache sharedCache;
+		return sharedCache;
+	}
+
+	bool StateCache::HasExtension(const char* _name)
+	{
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i = 0; i < count; i++)
+		{
+			if (std::strcmp(reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)), _name) == 0) return true;
+		}
+		return false;
+	}
+
+	StateCache::StateCache() :
+		m_multiBind(Flag::Unknown)
+	{
+		Invalidate();
+	}
+
+	void StateCache::Invalidate()
+	{
+		m_program = UNKNOWN;
+		m_vertexArray = UNKNOWN;
+		m_framebuffer = UNKNOWN;
+		m_activeUnit = UNKNOWN;
+
+		for (GLuint unit = 0; unit < STATE_CACHE_TEXTURE_UNITS; unit++)
+		{
+			m_textures[unit] = UNKNOWN;
+			m_textureTargets[unit] = 0;
+		}
+
+		m_blend = Flag::Unknown;
+		m_depthTest = Flag::Unknown;
+		m_depthWrite = Flag::Unknown;
+		m_cullFace = Flag::Unknown;
+		m_blendFuncSet = false;
+		m_depthFuncSet = false;
+	}
+
+	void StateCache::UseProgram(GLuint _program)
+	{
+		if (_program == m_program)
+		{
+			m_stats.elided++;
+			return;
+		}
+
+		glUseProgram(_program);
+		m_program = _program;
+		m_stats.issued++;
+	}
+
+	void StateCache::BindVertexArray(GLuint _vertexArray)
+	{
+		if (_vertexArray == m_vertexArray)
+		{
+			m_stats.elided++;
+			return;
+		}
+
+		glBindVertexArray(_vertexArray);
+		m_vertexArray = _vertexArray;
+		m_stats.issued++;
+	}
+
+	void StateCache::BindFramebuffer(GLuint _framebuffer)
+	{
+		if (_framebuffer == m_framebuffer)
+		{
+			m_stats.elided++;
+			return;
+		}
+
+		glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+		m_framebuffer = _framebuffer;
+		m_stats.issued++;
+	}
+
+	void StateCache::BindTexture(GLuint _unit, GLenum _target, GLuint _texture)
+	{
+		if (_unit < STATE_CACHE_TEXTURE_UNITS && m_textures[_unit] == _texture && m_textureTargets[_unit] == _target)
+		{
+			m_stats.elided++;
+			return;
+		}
+
+		ActiveTexture(_unit);
+		glBindTexture(_target, _texture);
+		m_stats.issued++;
+
+		if (_unit < STATE_CACHE_TEXTURE_UNITS)
+		{
+			m_textures[_unit] = _texture;
+			m_textureTargets[_unit] = _target;
+		}
+	}
+
+	void StateCache::BindTextures(GLuint _firstUnit, GLuint _count, const GLenum* _targets, const GLuint* _textures)
+	{
+		for (GLuint i = 0; i < _count;)
+		{
+			GLuint unit = _firstUnit + i;
+			// Texture 0 is bound like any other, so a unit never keeps a texture the caller didn't ask for
+			bool changed = !(unit < STATE_CACHE_TEXTURE_UNITS && m_textures[unit] == _textures[i] && m_textureTargets[unit] == _targets[i]);
+			if (!changed)
+			{
+				m_stats.elided++;
+				i++;
+				continue;
+			}
+
+			// Find the run of units which change, each of which multi-bind binds to its texture's own target
+			GLuint end = i + 1;
+			while (end < _count)
+			{
+				GLuint endUnit = _firstUnit + end;
+				if (endUnit < STATE_CACHE_TEXTURE_UNITS && m_textures[endUnit] == _textures[end] && m_textureTargets[endUnit] == _targets[end]) break;
+				end++;
+			}
+
+			// Looked up on first use, as the cache may be created before the context
+			if (m_multiBind == Flag::Unknown) m_multiBind = HasExtension("GL_ARB_multi_bind") ? Flag::On : Flag::Off;
+
+			if (end - i > 1 && m_multiBind == Flag::On)
+			{
+				glBindTextures(unit, end - i, &_textures[i]);
+				m_stats.issued++;
+
+				for (GLuint j = i; j < end; j++)
+				{
+					if (_firstUnit + j >= STATE_CACHE_TEXTURE_UNITS) continue;
+					m_textures[_firstUnit + j] = _textures[j];
+					m_textureTargets[_firstUnit + j] = _targets[j];
+				}
+			}
+			else
+			{
+				for (GLuint j = i; j < end; j++) BindTexture(_firstUnit + j, _targets[j], _textures[j]);
+			}
+
+			i = end;
+		}
+	}
+
+	void StateCache::ApplyPipeline(const PipelineState& _state)
+	{
+		SetBlend(_state.GetBlend());
+		SetDepthTest(_state.GetDepthTest());
+		SetDepthWrite(_state.GetDepthWrite());
+		SetCullFace(_state.GetCullFace());
+		if (_state.GetProgram()) UseProgram(_state.GetProgram());
+	}
+
+	void StateCache::SetBlend(bool _blend)
+	{
+		SetCapability(GL_BLEND, m_blend, _blend);
+
+		// Every blended draw in the library uses the same function
+		if (_blend && !m_blendFuncSet)
+		{
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			m_blendFuncSet = true;
+			m_stats.issued++;
+		}
+	}
+
+	void StateCache::SetDepthWrite(bool _depthWrite)
+	{
+		Flag wanted = _depthWrite ? Flag::On : Flag::Off;
+		if (wanted == m_depthWrite)
+		{
+			m_stats.elided++;
+			return;
+		}
+
+		glDepthMask(_depthWrite ? GL_TRUE : GL_FALSE);
+		m_depthWrite = wanted;
+		m_stats.issued++;
+	}
+
+	void StateCache::SetDepthTest(bool _depthTest)
+	{
+		SetCapability(GL_DEPTH_TEST, m_depthTest, _depthTest);
+
+		if (_depthTest && !m_depthFuncSet)
+		{
+			glDepthFunc(GL_LESS);
+			m_depthFuncSet = true;
+			m_stats.issued++;
+		}
+	}
+
+	void StateCache::SetCullFace(bool _cullFace)
+	{
+		SetCapability(GL_CULL_FACE, m_cullFace, _cullFace);
+	}
+
+	void StateCache::SetCapability(GLenum _capability, Flag& _current, bool _enable)
+	{
+		Flag wanted = _enable ? Flag::On : Flag::Off;
+		if (wanted == _current)
+		{
+			m_stats.elided++;
+			return;
+		}
+
+		if (_enable) glEnable(_capability);
+		else glDisable(_capability);
+		_current = wanted;
+		m_stats.issued++;
+	}
+
+	void StateCache::ActiveTexture(GLuint _unit)
+	{
+		if (_unit == m_activeUnit) return;
+
+		glActiveTexture(GL_TEXTURE0 + _unit);
+		m_activeUnit = _unit;
+		m_stats.issued++;
+	}
+}
@@ -0,0 +1,166 @@
+#ifndef EPBR_STATE_CACHE
+#define EPBR_STATE_CACHE
+
+#include <cstddef>
+
+#include <GL/glew.h>
+
+namespace ePBR
+{
+	/// @brief The most texture units a StateCache tracks. Binds to higher units are always issued.
+	const GLuint STATE_CACHE_TEXTURE_UNITS = 16;
+
+	/// @brief Fixed function state for drawing, fixed when created so that it can be compared against what is current and only the differences applied.
+	class PipelineState
+	{
+	public:
+		/// @brief Create a pipeline state.
+		/// @param _blend Whether to blend with GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA.
+		/// @param _depthTest Whether to test depth with GL_LESS.
+		/// @param _depthWrite Whether to write depth.
+		/// @param _cullFace Whether to cull back faces.
+		/// @param _program The shader program to use, or 0 to leave it to the material.
+		PipelineState(bool _blend = false, bool _depthTest = false, bool _depthWrite = true, bool _cullFace = false, GLuint _program = 0) :
+			m_blend(_blend),
+			m_depthTest(_depthTest),
+			m_depthWrite(_depthWrite),
+			m_cullFace(_cullFace),
+			m_program(_program)
+		{
+		}
+
+		bool GetBlend() const { return m_blend; }
+		bool GetDepthTest() const { return m_depthTest; }
+		bool GetDepthWrite() const { return m_depthWrite; }
+		bool GetCullFace() const { return m_cullFace; }
+		GLuint GetProgram() const { return m_program; }
+
+	private:
+		bool m_blend;
+		bool m_depthTest;
+		bool m_depthWrite;
+		bool m_cullFace;
+		GLuint m_program;
+	};
+
+	/// @brief How many state changing GL calls a StateCache issued, and how many it skipped as redundant.
+	struct StateCacheStats
+	{
+		size_t issued = 0;
+		size_t elided = 0;
+	};
+
+	/// @brief A shadow copy of the bound program, textures, vertex array, framebuffer and raster state, so that binds which change nothing are never sent to the driver.
+	/// @details Code which changes tracked state without going through the cache must call Invalidate() afterwards.
+	/// Texture units changed together are bound with one glBindTextures call where GL_ARB_multi_bind is available.
+	class StateCache
+	{
+	public:
+		/// @brief Get the cache for the library's GL context.
+		/// @return The shared cache.
+		static StateCache& GetShared();
+
+		StateCache();
+
+		/// @brief Ask the driver whether the context supports an extension.
+		/// @details GLEW's flags aren't used, as with glewExperimental set they report any extension whose functions happen to load.
+		/// @param _name The extension's name, such as "GL_ARB_buffer_storage".
+		/// @return Whether the extension is in the context's list. Callers on hot paths should keep the result.
+		static bool HasExtension(const char* _name);
+
+		/// @brief Forget every tracked value, so that the next bind of each is issued. Needed after state is changed behind the cache's back.
+		void Invalidate();
+
+		/// @brief Bind a shader program.
+		/// @param _program The program's ID.
+		void UseProgram(GLuint _program);
+
+		/// @brief Bind a vertex array.
+		/// @param _vertexArray The vertex array's ID.
+		void BindVertexArray(GLuint _vertexArray);
+
+		/// @brief Bind a framebuffer for drawing and reading.
+		/// @param _framebuffer The framebuffer's ID. 0 for the window.
+		void BindFramebuffer(GLuint _framebuffer);
+
+		/// @brief Bind a texture to a unit.
+		/// @param _unit The unit, counted from 0 rather than GL_TEXTURE0.
+		/// @param _target The texture's target, such as GL_TEXTURE_2D.
+		/// @param _texture The texture's ID.
+		void BindTexture(GLuint _unit, GLenum _target, GLuint _texture);
+
+		/// @brief Bind textures to consecutive units, with one call for the units that change where multi-bind is available.
+		/// @param _firstUnit The first unit, counted from 0.
+		/// @param _count The number of units.
+		/// @param _targets The target of each texture.
+		/// @param _textures The ID of each texture. 0 unbinds the unit, and is elided only when the unit is already unbound.
+		void BindTextures(GLuint _firstUnit, GLuint _count, const GLenum* _targets, const GLuint* _textures);
+
+		/// @brief Change only the fixed function state which differs from a pipeline state, and its program if it has one.
+		/// @param _state The state.
+		void ApplyPipeline(const PipelineState& _state);
+
+		/// @brief Enable or disable blending.
+		/// @param _blend Whether to blend with GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA.
+		void SetBlend(bool _blend);
+
+		/// @brief Enable or disable depth writes.
+		/// @param _depthWrite Whether to write depth.
+		void SetDepthWrite(bool _depthWrite);
+
+		/// @brief Enable or disable depth testing.
+		/// @param _depthTest Whether to test depth with GL_LESS.
+		void SetDepthTest(bool _depthTest);
+
+		/// @brief Enable or disable back face culling.
+		/// @param _cullFace Whether to cull back faces.
+		void SetCullFace(bool _cullFace);
+
+		/// @brief Get whether back faces are culled, from the tracked value rather than by querying GL.
+		/// @return True only when the cache itself enabled culling. False while it doesn't know.
+		bool GetCullFace() const { return m_cullFace == Flag::On; }
+
+		/// @brief Get how many calls were issued and elided since the last ResetStats().
+		/// @return The counts.
+		const StateCacheStats& GetStats() const { return m_stats; }
+
+		/// @brief Start counting calls afresh.
+		void ResetStats() { m_stats = StateCacheStats(); }
+
+	private:
+		// Tri-state flags, so that nothing is assumed of state the cache hasn't set
+		enum class Flag { Unknown, Off, On };
+
+		// Change a capability when it differs from the tracked value
+		void SetCapability(GLenum _capability, Flag& _current, bool _enable);
+
+		// Make a unit active for glBindTexture
+		void ActiveTexture(GLuint _unit);
+
+		// A name no GL object has, marking values which must be reissued
+		static const GLuint UNKNOWN = 0xFFFFFFFFu;
+
+		GLuint m_program;
+		GLuint m_vertexArray;
+		GLuint m_framebuffer;
+		GLuint m_activeUnit;
+
+		// One binding per unit, along with the target it was made on
+		GLuint m_textures[STATE_CACHE_TEXTURE_UNITS];
+		GLenum m_textureTargets[STATE_CACHE_TEXTURE_UNITS];
+
+		Flag m_blend;
+		Flag m_depthTest;
+		Flag m_depthWrite;
+		Flag m_cullFace;
+		bool m_blendFuncSet;
+		bool m_depthFuncSet;
+
+		// Whether glBindTextures is available. Kept through Invalidate(), as it belongs to the context rather than its state.
+		Flag m_multiBind;
+
+		StateCacheStats m_stats;
+	};
+}
+
+#endif // EPBR_STATE_CACHE
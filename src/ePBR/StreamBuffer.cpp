@@ -0,0 +1,135 @@
+#include "StreamBuffer.h"
+#include "StateCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace ePBR
+{
+	namespace
+	{
+		// How long to wait for a fence before asking again, in nanoseconds
+		const GLuint64 FENCE_WAIT_TIMEOUT = 1000000;
+
+		// Every live stream buffer, for EndFrameAll()
+		std::vector<StreamBuffer*>& GetStreamBuffers()
+		{
+			static std::vector<StreamBuffer*> buffers;
+			return buffers;
+		}
+
+		void WaitForFence(GLsync& _fence)
+		{
+			if (!_fence) return;
+
+			// Flush on the first wait, so that the fence is sure to be signalled eventually
+			GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+			while (true)
+			{
+				GLenum result = glClientWaitSync(_fence, flags, FENCE_WAIT_TIMEOUT);
+				if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED) break;
+				flags = 0;
+			}
+
+			glDeleteSync(_fence);
+			_fence = nullptr;
+		}
+	}
+
+	void StreamBuffer::EndFrameAll()
+	{
+		for (StreamBuffer* buffer : GetStreamBuffers()) buffer->EndFrame();
+	}
+
+	StreamBuffer::StreamBuffer(size_t _frameBytes)
+	{
+		m_frameBytes = _frameBytes;
+		m_mapped = nullptr;
+		m_frame = 0;
+		m_frameUsed = 0;
+		std::fill(m_fences, m_fences + STREAM_BUFFER_FRAMES, nullptr);
+
+		glGenBuffers(1, &m_id);
+		if (!m_id)
+		{
+			throw std::exception();
+		}
+
+		// Bound to the copy target so that no vertex array's element buffer changes
+		glBindBuffer(GL_COPY_WRITE_BUFFER, m_id);
+
+		size_t bytes = m_frameBytes * STREAM_BUFFER_FRAMES;
+		if (StateCache::HasExtension("GL_ARB_buffer_storage"))
+		{
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(GL_COPY_WRITE_BUFFER, bytes, nullptr, flags);
+			m_mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, bytes, flags);
+		}
+		else
+		{
+			glBufferData(GL_COPY_WRITE_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+		}
+
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+		GetStreamBuffers().push_back(this);
+	}
+
+	StreamBuffer::~StreamBuffer()
+	{
+		std::vector<StreamBuffer*>& buffers = GetStreamBuffers();
+		buffers.erase(std::remove(buffers.begin(), buffers.end(), this), buffers.end());
+
+		for (GLsync& fence : m_fences)
+		{
+			if (fence) glDeleteSync(fence);
+		}
+
+		// Deleting a mapped buffer unmaps it
+		glDeleteBuffers(1, &m_id);
+	}
+
+	size_t StreamBuffer::Allocate(size_t _bytes, size_t _alignment)
+	{
+		// Alignment needn't be a power of two, as vertex strides often aren't. It applies to the offset within the whole buffer.
+		size_t frameStart = m_frame * m_frameBytes;
+		size_t offset = (frameStart + m_frameUsed + _alignment - 1) / _alignment * _alignment;
+		if (offset + _bytes > frameStart + m_frameBytes) return NO_SPACE;
+
+		m_frameUsed = offset + _bytes - frameStart;
+		return offset;
+	}
+
+	size_t StreamBuffer::Write(const void* _data, size_t _bytes, size_t _alignment)
+	{
+		size_t offset = Allocate(_bytes, _alignment);
+		if (offset == NO_SPACE) return NO_SPACE;
+
+		if (m_mapped)
+		{
+			memcpy(m_mapped + offset, _data, _bytes);
+		}
+		else
+		{
+			glBindBuffer(GL_COPY_WRITE_BUFFER, m_id);
+			glBufferSubData(GL_COPY_WRITE_BUFFER, offset, _bytes, _data);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		}
+
+		return offset;
+	}
+
+	void StreamBuffer::EndFrame()
+	{
+		// Draws reading this frame's region have all been issued by now
+		if (m_frameUsed > 0) m_fences[m_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+		m_frame = (m_frame + 1) % STREAM_BUFFER_FRAMES;
+		m_frameUsed = 0;
+
+		// Only blocks if the GPU is more than STREAM_BUFFER_FRAMES - 1 frames behind
+		WaitForFence(m_fences[m_frame]);
+	}
+}
@@ -0,0 +1,81 @@
+#ifndef EPBR_STREAM_BUFFER
+#define EPBR_STREAM_BUFFER
+
+#include <cstddef>
+
+#include <GL/glew.h>
+
+namespace ePBR
+{
+	/// @brief How many frames of data a StreamBuffer holds. The CPU writes one while the GPU may still be reading the others.
+	const size_t STREAM_BUFFER_FRAMES = 3;
+
+	/// @brief A ring of per-frame regions in one GL buffer, for geometry rewritten every frame.
+	/// @details Where glBufferStorage is available the buffer is mapped once, persistently and coherently, so a write is a memcpy into GPU visible memory.
+	/// Otherwise writes fall back to glBufferSubData. Each region is fenced when its frame ends and waited on before it is reused, so writes never race the GPU.
+	class StreamBuffer
+	{
+	public:
+		/// @brief Returned by Write() and Allocate() when the current frame's region has no room left.
+		static const size_t NO_SPACE = (size_t)-1;
+
+		/// @brief End the frame of every stream buffer. Called by Context::DisplayFrame().
+		static void EndFrameAll();
+
+		/// @param _frameBytes The most bytes which can be written in one frame.
+		StreamBuffer(size_t _frameBytes);
+		~StreamBuffer();
+
+		StreamBuffer(const StreamBuffer&) = delete;
+		StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+		/// @brief Copy data into the current frame's region.
+		/// @param _data The data.
+		/// @param _bytes The size of _data in bytes.
+		/// @param _alignment The offset is rounded up to a multiple of this. Pass the vertex stride to draw from the offset with a first vertex rather than new attribute pointers.
+		/// @return The offset of the data within the buffer, or NO_SPACE.
+		size_t Write(const void* _data, size_t _bytes, size_t _alignment = 4);
+
+		/// @brief Claim space in the current frame's region without writing to it, for the GPU to fill.
+		/// @param _bytes The size of the space in bytes.
+		/// @param _alignment The offset is rounded up to a multiple of this.
+		/// @return The offset of the space within the buffer, or NO_SPACE.
+		size_t Allocate(size_t _bytes, size_t _alignment = 4);
+
+		/// @brief Get where to fill space claimed by Allocate() from the CPU, when the buffer is persistently mapped.
+		/// @param _offset The offset Allocate() returned.
+		/// @return The mapped address, or nullptr if the buffer isn't mapped. Write only, as mapped memory is slow to read.
+		void* GetMappedPointer(size_t _offset) const { return m_mapped ? m_mapped + _offset : nullptr; }
+
+		/// @brief Fence the current frame's region and move on to the next, waiting for the GPU to finish with it if it must.
+		void EndFrame();
+
+		/// @brief Get whether the buffer is persistently mapped, rather than written with glBufferSubData.
+		/// @return Whether it is mapped.
+		bool IsPersistent() const { return m_mapped != nullptr; }
+
+		/// @brief Get the most bytes which can be written in one frame.
+		/// @return The size of one region.
+		size_t GetFrameBytes() const { return m_frameBytes; }
+
+		/// @brief Get the OpenGL ID of this buffer.
+		/// @return The ID.
+		GLuint GetID() const { return m_id; }
+
+	private:
+		GLuint m_id;
+		size_t m_frameBytes;
+
+		// Null when falling back to glBufferSubData
+		unsigned char* m_mapped;
+
+		// The region being written, and how far into it
+		size_t m_frame;
+		size_t m_frameUsed;
+
+		// Signalled once the GPU is done with each region. Null if the region is free.
+		GLsync m_fences[STREAM_BUFFER_FRAMES];
+	};
+}
+
+#endif // EPBR_STREAM_BUFFER
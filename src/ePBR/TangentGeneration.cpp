@@ -0,0 +1,296 @@
+#include "TangentGeneration.h"
+#include "MeshData.h"
+#include "Simd.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ePBR
+{
+	namespace
+	{
+		// Multiple of the batch width. Small enough to balance across threads, large enough to amortise the dispatch.
+		const size_t TRIANGLES_PER_TASK = 8192;
+
+		const unsigned int NO_VERTEX = 0xFFFFFFFFu;
+
+		// Per triangle flags
+		const unsigned char TRIANGLE_VALID = 1;
+		const unsigned char TRIANGLE_ORIENT_PRESERVING = 2;
+
+		// Per vertex flags, from the triangles using it
+		const unsigned char VERTEX_POSITIVE = 1;
+		const unsigned char VERTEX_NEGATIVE = 2;
+
+		struct Float4x3
+		{
+			Float4 x, y, z;
+		};
+
+		inline Float4 Dot(const Float4x3& _a, const Float4x3& _b)
+		{
+			return _a.x * _b.x + _a.y * _b.y + _a.z * _b.z;
+		}
+
+		inline Float4x3 Sub(const Float4x3& _a, const Float4x3& _b)
+		{
+			return { _a.x - _b.x, _a.y - _b.y, _a.z - _b.z };
+		}
+
+		inline Float4x3 Scale(const Float4x3& _a, Float4 _s)
+		{
+			return { _a.x * _s, _a.y * _s, _a.z * _s };
+		}
+
+		// Remove the component along a unit normal
+		inline Float4x3 Project(const Float4x3& _v, const Float4x3& _n)
+		{
+			return Sub(_v, Scale(_n, Dot(_n, _v)));
+		}
+
+		// Lanes too short to normalise become zero
+		inline Float4x3 Normalise(const Float4x3& _v)
+		{
+			Float4 lengthSquared = Dot(_v, _v);
+			Float4 scale = Select(lengthSquared > Float4(1e-20f), Float4(1.0f) / Sqrt(lengthSquared), Float4(0.0f));
+			return Scale(_v, scale);
+		}
+
+		// Gather one attribute of four vertices into structure of arrays form
+		inline Float4x3 Gather(const std::vector<glm::vec3>& _stream, const unsigned int _vertices[4])
+		{
+			alignas(16) float x[4], y[4], z[4];
+			for (int lane = 0; lane < 4; lane++)
+			{
+				const glm::vec3& value = _stream[_vertices[lane]];
+				x[lane] = value.x;
+				y[lane] = value.y;
+				z[lane] = value.z;
+			}
+			return { Float4::Load(x), Float4::Load(y), Float4::Load(z) };
+		}
+
+		inline void Gather(const std::vector<glm::vec2>& _stream, const unsigned int _vertices[4], Float4& _u, Float4& _v)
+		{
+			alignas(16) float u[4], v[4];
+			for (int lane = 0; lane < 4; lane++)
+			{
+				u[lane] = _stream[_vertices[lane]].x;
+				v[lane] = _stream[_vertices[lane]].y;
+			}
+			_u = Float4::Load(u);
+			_v = Float4::Load(v);
+		}
+
+		// Structure of arrays scratch space, padded to whole batches
+		struct Vec3Array
+		{
+			std::vector<float> x, y, z;
+
+			void Resize(size_t _size) { x.assign(_size, 0.0f); y.assign(_size, 0.0f); z.assign(_size, 0.0f); }
+			Float4x3 Load(size_t _i) const { return { Float4::LoadUnaligned(&x[_i]), Float4::LoadUnaligned(&y[_i]), Float4::LoadUnaligned(&z[_i]) }; }
+			void Store(size_t _i, const Float4x3& _v) { _v.x.StoreUnaligned(&x[_i]); _v.y.StoreUnaligned(&y[_i]); _v.z.StoreUnaligned(&z[_i]); }
+		};
+
+		// Indices of the corners of four triangles. Lanes past the end repeat the last triangle and are never written back.
+		inline void GetBatchCorners(const std::vector<unsigned int>& _indices, size_t _firstTriangle, size_t _numTriangles, int _corner, unsigned int _out[4])
+		{
+			for (int lane = 0; lane < 4; lane++)
+			{
+				size_t triangle = std::min(_firstTriangle + lane, _numTriangles - 1);
+				_out[lane] = _indices[triangle * 3 + _corner];
+			}
+		}
+
+		void ParallelTasks(ThreadPool* _pool, size_t _count, const std::function<void(size_t)>& _task)
+		{
+			if (_pool) _pool->ParallelFor(_count, _task);
+			else for (size_t i = 0; i < _count; i++) _task(i);
+		}
+	}
+
+	void GenerateTangents(MeshData& _data, ThreadPool* _pool)
+	{
+		_data.tangents.clear();
+
+		const size_t numTriangles = _data.indices.size() / 3;
+		if (_data.normals.empty() || _data.uvs.empty() || numTriangles == 0) return;
+
+		const size_t paddedTriangles = (numTriangles + 3) & ~(size_t)3;
+		const size_t numTasks = (numTriangles + TRIANGLES_PER_TASK - 1) / TRIANGLES_PER_TASK;
+
+		// Face tangents: unit length, pointing along increasing u whichever way the texture is mirrored
+		Vec3Array faceTangents;
+		faceTangents.Resize(paddedTriangles);
+		std::vector<unsigned char> triangleFlags(paddedTriangles, 0);
+
+		ParallelTasks(_pool, numTasks, [&](size_t _task)
+		{
+			size_t end = std::min((_task + 1) * TRIANGLES_PER_TASK, numTriangles);
+			for (size_t first = _task * TRIANGLES_PER_TASK; first < end; first += 4)
+			{
+				unsigned int v0[4], v1[4], v2[4];
+				GetBatchCorners(_data.indices, first, numTriangles, 0, v0);
+				GetBatchCorners(_data.indices, first, numTriangles, 1, v1);
+				GetBatchCorners(_data.indices, first, numTriangles, 2, v2);
+
+				Float4x3 p0 = Gather(_data.positions, v0);
+				Float4x3 d1 = Sub(Gather(_data.positions, v1), p0);
+				Float4x3 d2 = Sub(Gather(_data.positions, v2), p0);
+
+				Float4 u0, w0, u1, w1, u2, w2;
+				Gather(_data.uvs, v0, u0, w0);
+				Gather(_data.uvs, v1, u1, w1);
+				Gather(_data.uvs, v2, u2, w2);
+				Float4 st1u = u1 - u0, st1v = w1 - w0;
+				Float4 st2u = u2 - u0, st2v = w2 - w0;
+
+				Float4 signedArea = st1u * st2v - st1v * st2u;
+				Float4x3 tangent = Sub(Scale(d1, st2v), Scale(d2, st1v));
+
+				// Dividing by the signed area would flip mirrored triangles the right way round, only the sign of it matters
+				Float4 orientPreserving = signedArea > Float4(0.0f);
+				tangent = Scale(Normalise(tangent), Select(orientPreserving, Float4(1.0f), Float4(-1.0f)));
+				Float4 valid = (signedArea != Float4(0.0f)) & (Dot(tangent, tangent) > Float4(0.0f));
+
+				faceTangents.Store(first, tangent);
+
+				int validBits = MoveMask(valid);
+				int orientBits = MoveMask(orientPreserving);
+				for (int lane = 0; lane < 4 && first + lane < end; lane++)
+				{
+					triangleFlags[first + lane] = ((validBits >> lane) & 1 ? TRIANGLE_VALID : 0) | ((orientBits >> lane) & 1 ? TRIANGLE_ORIENT_PRESERVING : 0);
+				}
+			}
+		});
+
+		// Split vertices used by both handedness so that each can carry a single bitangent sign
+		const size_t originalVertices = _data.positions.size();
+		std::vector<unsigned char> vertexFlags(originalVertices, 0);
+
+		for (size_t t = 0; t < numTriangles; t++)
+		{
+			if (!(triangleFlags[t] & TRIANGLE_VALID)) continue;
+
+			unsigned char flag = triangleFlags[t] & TRIANGLE_ORIENT_PRESERVING ? VERTEX_POSITIVE : VERTEX_NEGATIVE;
+			for (int corner = 0; corner < 3; corner++) vertexFlags[_data.indices[t * 3 + corner]] |= flag;
+		}
+
+		std::vector<unsigned int> mirroredCopy(originalVertices, NO_VERTEX);
+		for (size_t v = 0; v < originalVertices; v++)
+		{
+			if (vertexFlags[v] != (VERTEX_POSITIVE | VERTEX_NEGATIVE)) continue;
+
+			mirroredCopy[v] = (unsigned int)_data.positions.size();
+			_data.positions.push_back(_data.positions[v]);
+			_data.normals.push_back(_data.normals[v]);
+			_data.uvs.push_back(_data.uvs[v]);
+		}
+
+		const size_t numVertices = _data.positions.size();
+		if (numVertices != originalVertices)
+		{
+			for (size_t t = 0; t < numTriangles; t++)
+			{
+				if ((triangleFlags[t] & (TRIANGLE_VALID | TRIANGLE_ORIENT_PRESERVING)) != TRIANGLE_VALID) continue;
+
+				for (int corner = 0; corner < 3; corner++)
+				{
+					unsigned int& index = _data.indices[t * 3 + corner];
+					if (index < originalVertices && mirroredCopy[index] != NO_VERTEX) index = mirroredCopy[index];
+				}
+			}
+		}
+
+		// Per corner: the face tangent in the plane of the vertex normal, and the cosine of the corner's angle in that plane.
+		// Stored corner major so that each batch of four triangles writes whole lanes.
+		Vec3Array cornerTangents;
+		cornerTangents.Resize(paddedTriangles * 3);
+		std::vector<float> cornerCosines(paddedTriangles * 3, 1.0f);
+
+		ParallelTasks(_pool, numTasks, [&](size_t _task)
+		{
+			size_t end = std::min((_task + 1) * TRIANGLES_PER_TASK, numTriangles);
+			for (size_t first = _task * TRIANGLES_PER_TASK; first < end; first += 4)
+			{
+				Float4x3 faceTangent = faceTangents.Load(first);
+
+				for (int corner = 0; corner < 3; corner++)
+				{
+					unsigned int current[4], next[4], previous[4];
+					GetBatchCorners(_data.indices, first, numTriangles, corner, current);
+					GetBatchCorners(_data.indices, first, numTriangles, (corner + 1) % 3, next);
+					GetBatchCorners(_data.indices, first, numTriangles, (corner + 2) % 3, previous);
+
+					Float4x3 normal = Normalise(Gather(_data.normals, current));
+					Float4x3 position = Gather(_data.positions, current);
+					Float4x3 edge1 = Normalise(Project(Sub(Gather(_data.positions, next), position), normal));
+					Float4x3 edge2 = Normalise(Project(Sub(Gather(_data.positions, previous), position), normal));
+
+					Float4 cosine = Max(Min(Dot(edge1, edge2), Float4(1.0f)), Float4(-1.0f));
+
+					cornerTangents.Store(corner * paddedTriangles + first, Normalise(Project(faceTangent, normal)));
+					cosine.StoreUnaligned(&cornerCosines[corner * paddedTriangles + first]);
+				}
+			}
+		});
+
+		// Corners grouped by vertex, so vertices can be resolved in parallel without atomics
+		std::vector<unsigned int> cornerOffsets(numVertices + 1, 0);
+		for (size_t c = 0; c < numTriangles * 3; c++) cornerOffsets[_data.indices[c] + 1]++;
+		for (size_t v = 0; v < numVertices; v++) cornerOffsets[v + 1] += cornerOffsets[v];
+
+		// Degenerate triangles contribute no corners, so each vertex's range ends where its fill stopped
+		std::vector<unsigned int> vertexCorners(numTriangles * 3);
+		std::vector<unsigned int> cornerEnds(cornerOffsets.begin(), cornerOffsets.end() - 1);
+		for (size_t t = 0; t < numTriangles; t++)
+		{
+			if (!(triangleFlags[t] & TRIANGLE_VALID)) continue;
+
+			// Index into the corner major arrays
+			for (int corner = 0; corner < 3; corner++) vertexCorners[cornerEnds[_data.indices[t * 3 + corner]]++] = (unsigned int)(corner * paddedTriangles + t);
+		}
+
+		_data.tangents.resize(numVertices);
+		const size_t verticesPerTask = TRIANGLES_PER_TASK;
+		const size_t vertexTasks = (numVertices + verticesPerTask - 1) / verticesPerTask;
+
+		ParallelTasks(_pool, vertexTasks, [&](size_t _task)
+		{
+			size_t end = std::min((_task + 1) * verticesPerTask, numVertices);
+			for (size_t v = _task * verticesPerTask; v < end; v++)
+			{
+				glm::vec3 sum(0.0f);
+
+				for (size_t i = cornerOffsets[v]; i < cornerEnds[v]; i++)
+				{
+					unsigned int c = vertexCorners[i];
+					float angle = std::acos(cornerCosines[c]);
+					sum += angle * glm::vec3(cornerTangents.x[c], cornerTangents.y[c], cornerTangents.z[c]);
+				}
+
+				glm::vec3 normal = _data.normals[v];
+				float length = glm::length(sum);
+				glm::vec3 tangent;
+
+				if (length > 1e-10f)
+				{
+					tangent = sum / length;
+				}
+				else
+				{
+					// No usable texture mapping. Any direction in the tangent plane will do, or any direction at all without a normal.
+					glm::vec3 axis = std::fabs(normal.x) < 0.9f * glm::length(normal) ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+					glm::vec3 perpendicular = glm::cross(axis, normal);
+					float perpendicularLength = glm::length(perpendicular);
+					tangent = perpendicularLength > 1e-10f ? perpendicular / perpendicularLength : glm::vec3(1, 0, 0);
+				}
+
+				// Copies made for mirrored triangles, and vertices only mirrored triangles use, have a negative bitangent sign
+				bool mirrored = v >= originalVertices || vertexFlags[v] == VERTEX_NEGATIVE;
+				_data.tangents[v] = glm::vec4(tangent, mirrored ? -1.0f : 1.0f);
+			}
+		});
+	}
+}
@@ -0,0 +1,20 @@
+#ifndef EPBR_TANGENT_GENERATION
+#define EPBR_TANGENT_GENERATION
+
+namespace ePBR
+{
+	struct MeshData;
+	class ThreadPool;
+
+	/// @brief Generate a MikkTSpace style tangent frame for every vertex of an indexed mesh.
+	/// @details Each tangent is the angle weighted average of its triangles' texture space tangents, projected onto the plane of the vertex normal.
+	/// The w component holds the bitangent sign, so that bitangent = w * cross(normal, tangent.xyz).
+	/// Vertices shared by triangles of opposite texture space handedness, as on mirrored UV seams, are split so that each copy has one sign.
+	/// This appends vertices and rewrites indices. Triangles are processed in SIMD batches of four, spread across _pool.
+	/// Meshes without normals or texture coordinates are left without tangents.
+	/// @param _data The mesh. Its tangents are replaced.
+	/// @param _pool The threads to generate on, or nullptr to generate on the calling thread.
+	void GenerateTangents(MeshData& _data, ThreadPool* _pool = nullptr);
+}
+
+#endif // EPBR_TANGENT_GENERATION
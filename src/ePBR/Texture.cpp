@@ -1,4 +1,6 @@
 #include "Texture.h"
+#include "StateCache.h"
+#include "TextureResidency.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -12,6 +14,7 @@ namespace ePBR
 		// If we've already loaded a texture, unload it first
 		if (m_ID) 
 		{
+			TextureResidency::GetShared().Release(m_ID);
 			glDeleteTextures(1, &m_ID);
 		}
 
@@ -60,6 +63,9 @@ namespace ePBR
 		glGenerateMipmap(GL_TEXTURE_2D);
 		glBindTexture(GL_TEXTURE_2D, 0);
 		free(data);
+
+		// The bind above went around the cache, and the deleted texture's name may be reused
+		StateCache::GetShared().Invalidate();
 	}
 
 	void Texture::LoadHDR(std::string _fileName)
@@ -67,6 +73,7 @@ namespace ePBR
 		// If we've already loaded a texture, unload it first
 		if (m_ID)
 		{
+			TextureResidency::GetShared().Release(m_ID);
 			glDeleteTextures(1, &m_ID);
 		}
 
@@ -115,6 +122,9 @@ namespace ePBR
 		glGenerateMipmap(GL_TEXTURE_2D);
 		glBindTexture(GL_TEXTURE_2D, 0);
 		free(data);
+
+		// The bind above went around the cache, and the deleted texture's name may be reused
+		StateCache::GetShared().Invalidate();
 	}
 
 	const GLuint Texture::GetID() const 
@@ -134,6 +144,8 @@ namespace ePBR
 
 	Texture::~Texture() 
 	{
+		TextureResidency::GetShared().Release(m_ID);
 		glDeleteTextures(1, &m_ID);
+		StateCache::GetShared().Invalidate();
 	}
 }
\ No newline at end of file
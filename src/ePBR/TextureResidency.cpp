@@ -0,0 +1,259 @@
+#include "TextureResidency.h"
+#include "StateCache.h"
+
+#include <algorithm>
+
+namespace ePBR
+{
+	namespace
+	{
+		// Loaded textures may report the unsized format they were created with. Texture storage won't take one, and copies only go between matching formats.
+		bool IsUnsizedFormat(GLenum _format)
+		{
+			switch (_format)
+			{
+			case GL_RED:
+			case GL_RG:
+			case GL_RGB:
+			case GL_RGBA:
+				return true;
+			default:
+				return false;
+			}
+		}
+	}
+
+	TextureResidency& TextureResidency::GetShared()
+	{
+		// Created on first use, as it needs a GL context, and left for the context to clean up
+		static TextureResidency* residency = new TextureResidency();
+		return *residency;
+	}
+
+	TextureResidency::TextureResidency() :
+		m_mode(StateCache::HasExtension("GL_ARB_bindless_texture") ? ResidencyMode::Bindless : ResidencyMode::ArrayPools),
+		m_blackTexture(0),
+		m_releaseCount(0),
+		m_recordBuffer(0),
+		m_recordBufferSize(0),
+		m_recordsDirty(true)
+	{
+	}
+
+	const char* TextureResidency::GetModeDefine() const
+	{
+		return m_mode == ResidencyMode::Bindless ? "BINDLESS" : "TEXTURE_POOLS";
+	}
+
+	GLuint TextureResidency::AddMaterial(const GLuint (&_textures)[RESIDENT_MAP_COUNT])
+	{
+		MaterialRecord record;
+		if (!MakeRecord(_textures, record)) return NO_RESIDENT_MATERIAL;
+
+		GLuint index;
+		if (!m_freeRecords.empty())
+		{
+			index = m_freeRecords.back();
+			m_freeRecords.pop_back();
+			m_records[index] = record;
+		}
+		else
+		{
+			index = (GLuint)m_records.size();
+			m_records.push_back(record);
+		}
+
+		m_recordsDirty = true;
+		return index;
+	}
+
+	bool TextureResidency::UpdateMaterial(GLuint _index, const GLuint (&_textures)[RESIDENT_MAP_COUNT])
+	{
+		MaterialRecord record;
+		if (!MakeRecord(_textures, record))
+		{
+			RemoveMaterial(_index);
+			return false;
+		}
+
+		m_records.at(_index) = record;
+		m_recordsDirty = true;
+		return true;
+	}
+
+	void TextureResidency::RemoveMaterial(GLuint _index)
+	{
+		// Freeing a record twice would hand it to two materials
+		if (_index >= m_records.size() || std::find(m_freeRecords.begin(), m_freeRecords.end(), _index) != m_freeRecords.end()) return;
+		m_freeRecords.push_back(_index);
+	}
+
+	void TextureResidency::Release(GLuint _texture)
+	{
+		auto found = m_slots.find(_texture);
+		if (found == m_slots.end()) return;
+
+		if (m_mode == ResidencyMode::Bindless)
+		{
+			GLuint64 handle = (GLuint64)found->second.x | ((GLuint64)found->second.y << 32);
+			glMakeTextureHandleNonResidentARB(handle);
+		}
+		else
+		{
+			m_pools[found->second.x].freeLayers.push_back((GLsizei)found->second.y);
+		}
+
+		m_slots.erase(found);
+		m_releaseCount++;
+	}
+
+	void TextureResidency::Bind()
+	{
+		if (m_recordsDirty)
+		{
+			// Never empty, as an empty buffer can't be bound
+			size_t bytes = std::max<size_t>(1, m_records.size()) * sizeof(MaterialRecord);
+			if (!m_recordBuffer) glGenBuffers(1, &m_recordBuffer);
+
+			// Bound to the copy target so that no other storage buffer binding changes
+			glBindBuffer(GL_COPY_WRITE_BUFFER, m_recordBuffer);
+			if (bytes > m_recordBufferSize)
+			{
+				// Grown in steps, so that loading materials one at a time doesn't reallocate each time
+				m_recordBufferSize = std::max(bytes, m_recordBufferSize * 2);
+				glBufferData(GL_COPY_WRITE_BUFFER, m_recordBufferSize, nullptr, GL_DYNAMIC_DRAW);
+				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_STORAGE_BINDING, m_recordBuffer);
+			}
+			if (!m_records.empty()) glBufferSubData(GL_COPY_WRITE_BUFFER, 0, m_records.size() * sizeof(MaterialRecord), m_records.data());
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+			m_recordsDirty = false;
+		}
+
+		if (m_mode == ResidencyMode::ArrayPools && !m_pools.empty())
+		{
+			GLenum targets[MAX_TEXTURE_POOLS];
+			GLuint textures[MAX_TEXTURE_POOLS];
+			for (size_t i = 0; i < m_pools.size(); i++)
+			{
+				targets[i] = GL_TEXTURE_2D_ARRAY;
+				textures[i] = m_pools[i].texture;
+			}
+			StateCache::GetShared().BindTextures(TEXTURE_POOL_UNIT, (GLuint)m_pools.size(), targets, textures);
+		}
+	}
+
+	bool TextureResidency::MakeRecord(const GLuint (&_textures)[RESIDENT_MAP_COUNT], MaterialRecord& _record)
+	{
+		for (GLuint map = 0; map < RESIDENT_MAP_COUNT; map++)
+		{
+			GLuint texture = _textures[map] ? _textures[map] : GetBlackTexture();
+			if (!GetSlot(texture, _record.maps[map])) return false;
+		}
+		return true;
+	}
+
+	bool TextureResidency::GetSlot(GLuint _texture, glm::uvec2& _slot)
+	{
+		auto found = m_slots.find(_texture);
+		if (found != m_slots.end())
+		{
+			_slot = found->second;
+			return true;
+		}
+
+		if (m_mode == ResidencyMode::Bindless)
+		{
+			GLuint64 handle = glGetTextureHandleARB(_texture);
+			if (!handle) return false;
+
+			glMakeTextureHandleResidentARB(handle);
+			_slot = glm::uvec2((GLuint)(handle & 0xFFFFFFFFu), (GLuint)(handle >> 32));
+		}
+		else if (!AddToPool(_texture, _slot))
+		{
+			return false;
+		}
+
+		m_slots[_texture] = _slot;
+		return true;
+	}
+
+	bool TextureResidency::AddToPool(GLuint _texture, glm::uvec2& _slot)
+	{
+		StateCache& cache = StateCache::GetShared();
+		cache.BindTexture(0, GL_TEXTURE_2D, _texture);
+
+		GLint width = 0, height = 0, format = 0;
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+		if (width <= 0 || height <= 0) return false;
+
+		size_t poolIndex = 0;
+		GLsizei layer = -1;
+		for (; poolIndex < m_pools.size(); poolIndex++)
+		{
+			Pool& pool = m_pools[poolIndex];
+			if (pool.width != width || pool.height != height || pool.format != (GLenum)format) continue;
+
+			if (!pool.freeLayers.empty())
+			{
+				layer = pool.freeLayers.back();
+				pool.freeLayers.pop_back();
+				break;
+			}
+			if (pool.nextLayer < TEXTURE_POOL_LAYERS)
+			{
+				layer = pool.nextLayer++;
+				break;
+			}
+		}
+
+		if (layer < 0)
+		{
+			if (m_pools.size() >= MAX_TEXTURE_POOLS) return false;
+
+			// Textures sample only their top level, so pools hold just the one
+			Pool pool = { 0, width, height, (GLenum)format, 1, {} };
+			glGenTextures(1, &pool.texture);
+			cache.BindTexture(TEXTURE_POOL_UNIT + (GLuint)m_pools.size(), GL_TEXTURE_2D_ARRAY, pool.texture);
+			if (IsUnsizedFormat(pool.format))
+			{
+				glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, format, width, height, TEXTURE_POOL_LAYERS, 0, pool.format, GL_UNSIGNED_BYTE, nullptr);
+				glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+			}
+			else
+			{
+				glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, pool.format, width, height, TEXTURE_POOL_LAYERS);
+			}
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+			poolIndex = m_pools.size();
+			layer = 0;
+			m_pools.push_back(pool);
+		}
+
+		glCopyImageSubData(_texture, GL_TEXTURE_2D, 0, 0, 0, 0, m_pools[poolIndex].texture, GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height, 1);
+
+		_slot = glm::uvec2((GLuint)poolIndex, (GLuint)layer);
+		return true;
+	}
+
+	GLuint TextureResidency::GetBlackTexture()
+	{
+		if (m_blackTexture) return m_blackTexture;
+
+		// Unloaded maps sample as an incomplete texture does when bound
+		const GLubyte black[4] = { 0, 0, 0, 255 };
+		glGenTextures(1, &m_blackTexture);
+		StateCache::GetShared().BindTexture(0, GL_TEXTURE_2D, m_blackTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, black);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		return m_blackTexture;
+	}
+}
@@ -0,0 +1,140 @@
+#ifndef EPBR_TEXTURE_RESIDENCY
+#define EPBR_TEXTURE_RESIDENCY
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+namespace ePBR
+{
+	/// @brief The shader storage binding the resident PBR shader variants read MaterialRecords from.
+	const GLuint MATERIAL_STORAGE_BINDING = 6;
+
+	/// @brief The number of maps in a MaterialRecord: albedo, normal, metalness, roughness and ambient occlusion, in the units PBRMaterial binds them to.
+	const GLuint RESIDENT_MAP_COUNT = 5;
+
+	/// @brief The texture unit of the first texture pool. Pools take this and the units after it.
+	const GLuint TEXTURE_POOL_UNIT = 8;
+
+	/// @brief The most texture pools there can be, each one texture array of same-sized, same-format textures.
+	const GLuint MAX_TEXTURE_POOLS = 8;
+
+	/// @brief The number of layers in each texture pool.
+	const GLsizei TEXTURE_POOL_LAYERS = 64;
+
+	/// @brief Returned by TextureResidency::AddMaterial() when a material's textures can't all be made resident.
+	const GLuint NO_RESIDENT_MATERIAL = 0xFFFFFFFFu;
+
+	/// @brief How textures are made available to shaders without being bound per draw.
+	enum class ResidencyMode
+	{
+		/// @brief GL_ARB_bindless_texture handles, one per texture.
+		Bindless,
+		/// @brief Layers of GL_TEXTURE_2D_ARRAY pools, bound once to the units from TEXTURE_POOL_UNIT.
+		ArrayPools
+	};
+
+	/// @brief A material's maps as the resident shader variants read them, laid out as an element of the std430 MaterialBlock.
+	/// @details Each map is a bindless handle split into two words, or a pool index and layer, depending on the ResidencyMode.
+	struct MaterialRecord
+	{
+		glm::uvec2 maps[RESIDENT_MAP_COUNT];
+	};
+
+	/// @brief Keeps material textures resident, so that materials select theirs by index from a storage buffer instead of binding them.
+	/// @details Any number of materials sharing a shader and environment maps can then be drawn in one multi-draw, each instance reading its material's record.
+	/// Bindless handles are used where GL_ARB_bindless_texture is available. Otherwise each texture is copied into a layer of a texture array pool holding textures of its size and format.
+	/// Textures must be released with Release() before they are deleted, which Texture does itself.
+	class TextureResidency
+	{
+	public:
+		/// @brief Get the residency for the library's GL context, creating it on first use.
+		/// @return The shared residency.
+		static TextureResidency& GetShared();
+
+		TextureResidency();
+
+		TextureResidency(const TextureResidency&) = delete;
+		TextureResidency& operator=(const TextureResidency&) = delete;
+
+		/// @brief Get how textures are made resident.
+		/// @return The mode.
+		ResidencyMode GetMode() const { return m_mode; }
+
+		/// @brief Get the shader define the resident shader variants are compiled with for the mode, alongside RESIDENT_TEXTURES.
+		/// @return BINDLESS or TEXTURE_POOLS.
+		const char* GetModeDefine() const;
+
+		/// @brief Make a material's textures resident and give it a record.
+		/// @param _textures The ID of each map, in MaterialRecord order. 0 for a missing map, which reads as black.
+		/// @return The index of the material's record, or NO_RESIDENT_MATERIAL if the pools are full or a texture's format can't be pooled.
+		GLuint AddMaterial(const GLuint (&_textures)[RESIDENT_MAP_COUNT]);
+
+		/// @brief Point an existing record at new textures.
+		/// @param _index The index AddMaterial() returned.
+		/// @param _textures The ID of each map, in MaterialRecord order.
+		/// @return False if the textures couldn't all be made resident, in which case the record is removed.
+		bool UpdateMaterial(GLuint _index, const GLuint (&_textures)[RESIDENT_MAP_COUNT]);
+
+		/// @brief Free a material's record for reuse. An index that is already free is ignored.
+		/// @param _index The index AddMaterial() returned.
+		void RemoveMaterial(GLuint _index);
+
+		/// @brief Stop keeping a texture resident, ahead of it being deleted. Records still naming it read garbage until updated.
+		/// @param _texture The texture's ID.
+		void Release(GLuint _texture);
+
+		/// @brief Get the number of textures released so far. Deleted IDs are reused, so records should be remade when this changes even if their IDs haven't.
+		/// @return The count.
+		size_t GetReleaseCount() const { return m_releaseCount; }
+
+		/// @brief Upload any changed records, then bind the record buffer and, with pools, every pool.
+		void Bind();
+
+		/// @brief Get the number of textures currently resident.
+		/// @return The count.
+		size_t GetResidentTextureCount() const { return m_slots.size(); }
+
+	private:
+		struct Pool
+		{
+			GLuint texture;
+			GLsizei width;
+			GLsizei height;
+			GLenum format;
+			GLsizei nextLayer;
+			std::vector<GLsizei> freeLayers;
+		};
+
+		// Fill a record with each texture's handle or pool slot, making them resident. False if one couldn't be.
+		bool MakeRecord(const GLuint (&_textures)[RESIDENT_MAP_COUNT], MaterialRecord& _record);
+
+		// Get a texture's handle or pool slot, making it resident first if it isn't
+		bool GetSlot(GLuint _texture, glm::uvec2& _slot);
+
+		// Copy a texture into a free layer of a pool matching its size and format, creating the pool if there is none
+		bool AddToPool(GLuint _texture, glm::uvec2& _slot);
+
+		// A 1x1 black texture standing in for missing maps
+		GLuint GetBlackTexture();
+
+		ResidencyMode m_mode;
+
+		// Handle or pool slot of every resident texture, by ID
+		std::unordered_map<GLuint, glm::uvec2> m_slots;
+		std::vector<Pool> m_pools;
+		GLuint m_blackTexture;
+		size_t m_releaseCount;
+
+		std::vector<MaterialRecord> m_records;
+		std::vector<GLuint> m_freeRecords;
+		GLuint m_recordBuffer;
+		size_t m_recordBufferSize;
+		bool m_recordsDirty;
+	};
+}
+
+#endif // EPBR_TEXTURE_RESIDENCY
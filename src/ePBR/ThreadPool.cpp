@@ -0,0 +1,124 @@
+#include "ThreadPool.h"
+
+namespace ePBR
+{
+	namespace
+	{
+		// Set on pool workers, and on the submitting thread while it helps out, so nested loops don't deadlock
+		thread_local bool t_insidePool = false;
+	}
+
+	void ThreadPool::ParallelFor(size_t _count, const std::function<void(size_t)>& _task)
+	{
+		if (_count == 0) return;
+
+		if (m_workers.empty() || _count == 1 || t_insidePool)
+		{
+			for (size_t i = 0; i < _count; i++) _task(i);
+			return;
+		}
+
+		std::lock_guard<std::mutex> submitLock(m_submitMutex);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_task = &_task;
+			m_count = _count;
+			m_next = 0;
+			m_busyWorkers = m_workers.size();
+			m_exception = nullptr;
+			m_generation++;
+		}
+		m_wake.notify_all();
+
+		t_insidePool = true;
+		RunTasks();
+		t_insidePool = false;
+
+		std::exception_ptr exception;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_done.wait(lock, [this] { return m_busyWorkers == 0; });
+			m_task = nullptr;
+			exception = m_exception;
+		}
+
+		if (exception) std::rethrow_exception(exception);
+	}
+
+	void ThreadPool::RunTasks()
+	{
+		for (size_t i = m_next++; i < m_count; i = m_next++)
+		{
+			try
+			{
+				(*m_task)(i);
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (!m_exception) m_exception = std::current_exception();
+			}
+		}
+	}
+
+	void ThreadPool::WorkerLoop()
+	{
+		t_insidePool = true;
+		unsigned long long seenGeneration = 0;
+
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_wake.wait(lock, [&] { return m_stopping || m_generation != seenGeneration; });
+				if (m_stopping) return;
+				seenGeneration = m_generation;
+			}
+
+			RunTasks();
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (--m_busyWorkers == 0) m_done.notify_one();
+		}
+	}
+
+	ThreadPool& ThreadPool::GetShared()
+	{
+		static ThreadPool sharedPool;
+		return sharedPool;
+	}
+
+	ThreadPool::ThreadPool(unsigned int _threadCount) :
+		m_task(nullptr),
+		m_count(0),
+		m_next(0),
+		m_generation(0),
+		m_busyWorkers(0),
+		m_stopping(false)
+	{
+		if (_threadCount == 0)
+		{
+			_threadCount = std::thread::hardware_concurrency();
+		}
+
+		for (unsigned int i = 1; i < _threadCount; i++)
+		{
+			m_workers.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+		m_wake.notify_all();
+
+		for (std::thread& worker : m_workers)
+		{
+			worker.join();
+		}
+	}
+}
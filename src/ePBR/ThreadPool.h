@@ -0,0 +1,65 @@
+#ifndef EPBR_THREAD_POOL
+#define EPBR_THREAD_POOL
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ePBR
+{
+	/// @brief A fixed set of worker threads for data-parallel loops. None of the work submitted to it may make OpenGL calls.
+	class ThreadPool
+	{
+	public:
+		/// @brief Call _task once for every index in [0, _count), spread across the pool, and wait for all of them to finish.
+		/// @details The calling thread works too. Calls made from inside a task run serially on that thread.
+		/// If any task throws, the first exception is rethrown here once every task has finished.
+		/// @param _count The number of indices.
+		/// @param _task The work to do for one index.
+		void ParallelFor(size_t _count, const std::function<void(size_t)>& _task);
+
+		/// @brief Get the number of threads which run tasks, including the thread calling ParallelFor.
+		/// @return The thread count.
+		unsigned int GetThreadCount() const { return (unsigned int)m_workers.size() + 1; }
+
+		/// @brief Get a pool shared by the whole library, with one thread per hardware thread.
+		/// @return The shared pool.
+		static ThreadPool& GetShared();
+
+		/// @brief Create a thread pool.
+		/// @param _threadCount The total number of threads to run tasks on, including the caller of ParallelFor. 0 uses one per hardware thread.
+		ThreadPool(unsigned int _threadCount = 0);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+	private:
+		void WorkerLoop();
+		void RunTasks();
+
+		std::vector<std::thread> m_workers;
+
+		// Serialises ParallelFor calls made from different threads
+		std::mutex m_submitMutex;
+
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		std::condition_variable m_done;
+
+		const std::function<void(size_t)>* m_task;
+		size_t m_count;
+		std::atomic<size_t> m_next;
+		unsigned long long m_generation;
+		size_t m_busyWorkers;
+		bool m_stopping;
+
+		std::exception_ptr m_exception;
+	};
+}
+
+#endif // EPBR_THREAD_POOL
@@ -0,0 +1,301 @@
+#include "TransformHierarchy.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <functional>
+
+namespace ePBR
+{
+	namespace
+	{
+		// Marks a root's parent, and a destroyed node's index
+		const uint32_t NO_INDEX = 0xFFFFFFFFu;
+
+		// Fewest nodes of one depth worth handing to a worker
+		const size_t UPDATE_CHUNK_SIZE = 1024;
+
+		// Call _range over [0, _count) in chunks, spread across the pool when there is more than one
+		void ForEachChunk(size_t _count, ThreadPool* _pool, const std::function<void(size_t, size_t)>& _range)
+		{
+			size_t chunkCount = (_count + UPDATE_CHUNK_SIZE - 1) / UPDATE_CHUNK_SIZE;
+			if (_pool && chunkCount > 1)
+			{
+				_pool->ParallelFor(chunkCount, [&](size_t _chunk)
+				{
+					size_t begin = _chunk * UPDATE_CHUNK_SIZE;
+					_range(begin, std::min(begin + UPDATE_CHUNK_SIZE, _count));
+				});
+			}
+			else if (_count > 0)
+			{
+				_range(0, _count);
+			}
+		}
+	}
+
+	TransformHierarchy::TransformHierarchy() :
+		m_deadCount(0),
+		m_orderDirty(false),
+		m_recomputeAll(false),
+		m_lastUpdatedCount(0)
+	{
+	}
+
+	TransformID TransformHierarchy::Create(TransformID _parent)
+	{
+		TransformID handle;
+		if (!m_freeHandles.empty())
+		{
+			handle = m_freeHandles.back();
+			m_freeHandles.pop_back();
+		}
+		else
+		{
+			handle = (TransformID)m_indices.size();
+			m_indices.push_back(NO_INDEX);
+		}
+
+		// Appended for now, and moved to its place by the next Update()
+		m_indices[handle] = (uint32_t)m_handles.size();
+		m_handles.push_back(handle);
+		m_positions.push_back(glm::vec3(0.0f));
+		m_rotations.push_back(glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+		m_scales.push_back(glm::vec3(1.0f));
+		m_parents.push_back(_parent == NO_TRANSFORM ? NO_INDEX : m_indices[_parent]);
+		m_firstChildren.push_back(0);
+		m_childCounts.push_back(0);
+		m_depths.push_back(0);
+		m_worldMatrices.push_back(glm::mat4(1.0f));
+		m_dirty.push_back(0);
+
+		m_orderDirty = true;
+		return handle;
+	}
+
+	void TransformHierarchy::Destroy(TransformID _node)
+	{
+		// Child ranges are needed to find everything below the node
+		if (m_orderDirty) Rebuild();
+
+		std::vector<uint32_t> stack(1, m_indices[_node]);
+		while (!stack.empty())
+		{
+			uint32_t index = stack.back();
+			stack.pop_back();
+			for (uint32_t i = 0; i < m_childCounts[index]; i++) stack.push_back(m_firstChildren[index] + i);
+
+			TransformID handle = m_handles[index];
+			m_indices[handle] = NO_INDEX;
+			m_freeHandles.push_back(handle);
+			m_handles[index] = NO_TRANSFORM;
+			m_deadCount++;
+		}
+
+		m_orderDirty = true;
+	}
+
+	bool TransformHierarchy::SetParent(TransformID _node, TransformID _parent)
+	{
+		uint32_t index = m_indices[_node];
+		uint32_t parent = _parent == NO_TRANSFORM ? NO_INDEX : m_indices[_parent];
+
+		for (uint32_t ancestor = parent; ancestor != NO_INDEX; ancestor = m_parents[ancestor])
+		{
+			if (ancestor == index) return false;
+		}
+
+		m_parents[index] = parent;
+		m_orderDirty = true;
+		return true;
+	}
+
+	TransformID TransformHierarchy::GetParent(TransformID _node) const
+	{
+		uint32_t parent = m_parents[m_indices[_node]];
+		return parent == NO_INDEX ? NO_TRANSFORM : m_handles[parent];
+	}
+
+	void TransformHierarchy::SetPosition(TransformID _node, const glm::vec3& _position)
+	{
+		uint32_t index = m_indices[_node];
+		m_positions[index] = _position;
+		MarkDirty(index);
+	}
+
+	void TransformHierarchy::SetRotation(TransformID _node, const glm::quat& _rotation)
+	{
+		uint32_t index = m_indices[_node];
+		m_rotations[index] = _rotation;
+		MarkDirty(index);
+	}
+
+	void TransformHierarchy::SetScale(TransformID _node, const glm::vec3& _scale)
+	{
+		uint32_t index = m_indices[_node];
+		m_scales[index] = _scale;
+		MarkDirty(index);
+	}
+
+	void TransformHierarchy::Update(ThreadPool* _pool)
+	{
+		if (m_orderDirty) Rebuild();
+
+		m_lastUpdatedCount = 0;
+		size_t levelCount = m_levelStarts.empty() ? 0 : m_levelStarts.size() - 1;
+
+		// Every node, one depth at a time, as parents must be done before their children
+		if (m_recomputeAll)
+		{
+			for (size_t level = 0; level < levelCount; level++)
+			{
+				uint32_t begin = m_levelStarts[level];
+				ForEachChunk(m_levelStarts[level + 1] - begin, _pool, [&](size_t _begin, size_t _end)
+				{
+					for (size_t i = _begin; i < _end; i++) UpdateNode(begin + (uint32_t)i);
+				});
+			}
+
+			m_lastUpdatedCount = m_handles.size();
+			for (uint32_t index : m_dirtyNodes) m_dirty[index] = 0;
+			m_dirtyNodes.clear();
+			m_recomputeAll = false;
+			return;
+		}
+
+		if (m_dirtyNodes.empty()) return;
+
+		// Changed nodes start at their own depth, and each depth queues the children of what it updated
+		if (m_levels.size() < levelCount) m_levels.resize(levelCount);
+		for (uint32_t index : m_dirtyNodes) m_levels[m_depths[index]].push_back(index);
+		m_dirtyNodes.clear();
+
+		for (size_t level = 0; level < levelCount; level++)
+		{
+			std::vector<uint32_t>& nodes = m_levels[level];
+			if (nodes.empty()) continue;
+
+			ForEachChunk(nodes.size(), _pool, [&](size_t _begin, size_t _end)
+			{
+				for (size_t i = _begin; i < _end; i++) UpdateNode(nodes[i]);
+			});
+			m_lastUpdatedCount += nodes.size();
+
+			// Children already queued by a change of their own are only updated once
+			for (uint32_t index : nodes)
+			{
+				uint32_t end = m_firstChildren[index] + m_childCounts[index];
+				for (uint32_t child = m_firstChildren[index]; child < end; child++)
+				{
+					if (m_dirty[child]) continue;
+					m_dirty[child] = 1;
+					m_levels[level + 1].push_back(child);
+				}
+				m_dirty[index] = 0;
+			}
+			nodes.clear();
+		}
+	}
+
+	void TransformHierarchy::UpdateNode(uint32_t _index)
+	{
+		// Scale, then rotate, then translate, built directly rather than as three matrix products
+		glm::mat3 rotation = glm::mat3_cast(m_rotations[_index]);
+		const glm::vec3& scale = m_scales[_index];
+
+		glm::mat4 local;
+		local[0] = glm::vec4(rotation[0] * scale.x, 0.0f);
+		local[1] = glm::vec4(rotation[1] * scale.y, 0.0f);
+		local[2] = glm::vec4(rotation[2] * scale.z, 0.0f);
+		local[3] = glm::vec4(m_positions[_index], 1.0f);
+
+		uint32_t parent = m_parents[_index];
+		m_worldMatrices[_index] = parent == NO_INDEX ? local : m_worldMatrices[parent] * local;
+	}
+
+	void TransformHierarchy::MarkDirty(uint32_t _index)
+	{
+		if (m_dirty[_index]) return;
+		m_dirty[_index] = 1;
+		m_dirtyNodes.push_back(_index);
+	}
+
+	void TransformHierarchy::Rebuild()
+	{
+		size_t count = m_handles.size();
+
+		// Children of each living node, in their current order
+		std::vector<uint32_t> childStarts(count + 1, 0);
+		for (size_t i = 0; i < count; i++)
+		{
+			if (m_handles[i] != NO_TRANSFORM && m_parents[i] != NO_INDEX) childStarts[m_parents[i] + 1]++;
+		}
+		for (size_t i = 0; i < count; i++) childStarts[i + 1] += childStarts[i];
+
+		std::vector<uint32_t> children(childStarts[count]);
+		std::vector<uint32_t> fill(childStarts.begin(), childStarts.end() - 1);
+		for (size_t i = 0; i < count; i++)
+		{
+			if (m_handles[i] != NO_TRANSFORM && m_parents[i] != NO_INDEX) children[fill[m_parents[i]]++] = (uint32_t)i;
+		}
+
+		// Breadth first from the roots, so depths are contiguous and so are each node's children
+		size_t liveCount = count - m_deadCount;
+		std::vector<uint32_t> order;
+		order.reserve(liveCount);
+		for (size_t i = 0; i < count; i++)
+		{
+			if (m_handles[i] != NO_TRANSFORM && m_parents[i] == NO_INDEX) order.push_back((uint32_t)i);
+		}
+
+		std::vector<uint32_t> newIndices(count, NO_INDEX);
+		std::vector<uint32_t> firstChildren(liveCount);
+		std::vector<uint32_t> childCounts(liveCount);
+		std::vector<uint32_t> depths(liveCount);
+
+		m_levelStarts.assign(1, 0);
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			uint32_t old = order[i];
+			newIndices[old] = (uint32_t)i;
+
+			uint32_t parent = m_parents[old];
+			depths[i] = parent == NO_INDEX ? 0 : depths[newIndices[parent]] + 1;
+			if (depths[i] == m_levelStarts.size()) m_levelStarts.push_back((uint32_t)i);
+
+			firstChildren[i] = (uint32_t)order.size();
+			childCounts[i] = childStarts[old + 1] - childStarts[old];
+			order.insert(order.end(), children.begin() + childStarts[old], children.begin() + childStarts[old + 1]);
+		}
+		m_levelStarts.push_back((uint32_t)order.size());
+
+		// Move every array into the new order
+		auto reorder = [&](auto& _values)
+		{
+			std::remove_reference_t<decltype(_values)> values(order.size());
+			for (size_t i = 0; i < order.size(); i++) values[i] = _values[order[i]];
+			_values.swap(values);
+		};
+		reorder(m_positions);
+		reorder(m_rotations);
+		reorder(m_scales);
+		reorder(m_worldMatrices);
+		reorder(m_handles);
+		reorder(m_parents);
+
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			if (m_parents[i] != NO_INDEX) m_parents[i] = newIndices[m_parents[i]];
+			m_indices[m_handles[i]] = (uint32_t)i;
+		}
+
+		m_firstChildren.swap(firstChildren);
+		m_childCounts.swap(childCounts);
+		m_depths.swap(depths);
+		m_dirty.assign(order.size(), 0);
+		m_dirtyNodes.clear();
+		m_deadCount = 0;
+
+		m_orderDirty = false;
+		m_recomputeAll = true;
+	}
+}
@@ -0,0 +1,141 @@
+#ifndef EPBR_TRANSFORM_HIERARCHY
+#define EPBR_TRANSFORM_HIERARCHY
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+namespace ePBR
+{
+	class ThreadPool;
+
+	/// @brief Identifies a node of a TransformHierarchy. Stays the same while the hierarchy reorders its nodes.
+	typedef uint32_t TransformID;
+
+	/// @brief A TransformID which names no node, used for roots' parents.
+	const TransformID NO_TRANSFORM = 0xFFFFFFFFu;
+
+	/// @brief A hierarchy of local position, rotation and scale transforms, each with a world matrix kept up to date by Update().
+	/// @details Nodes are held as structure of arrays, ordered by depth with each node's children next to each other, so that parents always come before their children.
+	/// Update() then recomputes one depth at a time, splitting each across a ThreadPool, and only visits nodes which were changed or whose parent was. Nodes which don't move cost nothing per update.
+	/// Creating, destroying or reparenting a node reorders and recomputes every node on the next Update().
+	class TransformHierarchy
+	{
+	public:
+		TransformHierarchy();
+
+		/// @brief Add a node, at the origin with no rotation and unit scale.
+		/// @param _parent The node to attach it to, or NO_TRANSFORM for a root.
+		/// @return The new node.
+		TransformID Create(TransformID _parent = NO_TRANSFORM);
+
+		/// @brief Remove a node and every node below it. Their IDs may be reused by later nodes.
+		/// @param _node The node.
+		void Destroy(TransformID _node);
+
+		/// @brief Attach a node to another, keeping its local transform.
+		/// @param _node The node.
+		/// @param _parent The new parent, or NO_TRANSFORM to make the node a root.
+		/// @return False if the parent is the node or below it, in which case nothing changes.
+		bool SetParent(TransformID _node, TransformID _parent);
+
+		/// @brief Get a node's parent.
+		/// @param _node The node.
+		/// @return The parent, or NO_TRANSFORM for a root.
+		TransformID GetParent(TransformID _node) const;
+
+		/// @brief Set a node's position relative to its parent.
+		/// @param _node The node.
+		/// @param _position The position.
+		void SetPosition(TransformID _node, const glm::vec3& _position);
+
+		/// @brief Set a node's rotation relative to its parent.
+		/// @param _node The node.
+		/// @param _rotation The rotation.
+		void SetRotation(TransformID _node, const glm::quat& _rotation);
+
+		/// @brief Set a node's scale relative to its parent.
+		/// @param _node The node.
+		/// @param _scale The scale along each axis.
+		void SetScale(TransformID _node, const glm::vec3& _scale);
+
+		/// @brief Get a node's position relative to its parent.
+		/// @param _node The node.
+		/// @return The position.
+		const glm::vec3& GetPosition(TransformID _node) const { return m_positions[m_indices[_node]]; }
+
+		/// @brief Get a node's rotation relative to its parent.
+		/// @param _node The node.
+		/// @return The rotation.
+		const glm::quat& GetRotation(TransformID _node) const { return m_rotations[m_indices[_node]]; }
+
+		/// @brief Get a node's scale relative to its parent.
+		/// @param _node The node.
+		/// @return The scale along each axis.
+		const glm::vec3& GetScale(TransformID _node) const { return m_scales[m_indices[_node]]; }
+
+		/// @brief Get a node's world matrix as of the last Update().
+		/// @param _node The node.
+		/// @return The matrix, scale then rotation then translation, under its parent's world matrix.
+		const glm::mat4& GetWorldMatrix(TransformID _node) const { return m_worldMatrices[m_indices[_node]]; }
+
+		/// @brief Recompute the world matrix of every node changed since the last update, and every node below them.
+		/// @param _pool The pool to split large depths across, or nullptr to run on the calling thread alone.
+		void Update(ThreadPool* _pool = nullptr);
+
+		/// @brief Get the number of nodes.
+		/// @return The number of nodes.
+		size_t GetCount() const { return m_handles.size() - m_deadCount; }
+
+		/// @brief Get how many world matrices the last Update() recomputed.
+		/// @return The number of nodes.
+		size_t GetLastUpdatedCount() const { return m_lastUpdatedCount; }
+
+	private:
+		// Reorder nodes by depth, children of a node together, dropping destroyed ones
+		void Rebuild();
+
+		// Recompute one node's world matrix from its local transform and its parent's world matrix
+		void UpdateNode(uint32_t _index);
+
+		// Mark a node as changed, queuing it for the next Update()
+		void MarkDirty(uint32_t _index);
+
+		// Local transform, by index
+		std::vector<glm::vec3> m_positions;
+		std::vector<glm::quat> m_rotations;
+		std::vector<glm::vec3> m_scales;
+
+		// Hierarchy, by index. Child ranges and depths are only valid while the order is.
+		std::vector<uint32_t> m_parents;
+		std::vector<uint32_t> m_firstChildren;
+		std::vector<uint32_t> m_childCounts;
+		std::vector<uint32_t> m_depths;
+
+		std::vector<glm::mat4> m_worldMatrices;
+		std::vector<unsigned char> m_dirty;
+
+		// Index of each ID, and ID of each index
+		std::vector<uint32_t> m_indices;
+		std::vector<TransformID> m_handles;
+		std::vector<TransformID> m_freeHandles;
+		size_t m_deadCount;
+
+		// First index of each depth, and one past the last
+		std::vector<uint32_t> m_levelStarts;
+
+		// Changed nodes, and the nodes to update at each depth
+		std::vector<uint32_t> m_dirtyNodes;
+		std::vector<std::vector<uint32_t>> m_levels;
+
+		// Set by structural changes, which reorder then recompute everything
+		bool m_orderDirty;
+		bool m_recomputeAll;
+		size_t m_lastUpdatedCount;
+	};
+}
+
+#endif // EPBR_TRANSFORM_HIERARCHY
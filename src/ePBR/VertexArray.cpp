@@ -1,5 +1,9 @@
 #include "VertexArray.h"
 #include "VertexBuffer.h"
+#include "StateCache.h"
+
+#include <algorithm>
+#include <cstring>
 
 namespace ePBR
 {
@@ -10,23 +14,52 @@ namespace ePBR
 		m_dirty = true; //Data has changed and so needs to be uploaded
 	}
 
+	void VertexArray::SetInterleavedBuffer(std::shared_ptr<VertexBuffer> _buffer, const VertexLayout& _layout)
+	{
+		m_interleavedBuffer = _buffer;
+		m_interleavedLayout = _layout;
+		m_dirty = true; //Data has changed and so needs to be uploaded
+	}
+
 	GLuint VertexArray::GetID()
 	{
 		if (m_dirty)
 		{
-			glBindVertexArray(m_id);
+			StateCache::GetShared().BindVertexArray(m_id);
 
 			for (unsigned int i = 0; i < m_buffers.size(); i++)
 			{
 				if (!m_buffers.at(i)) continue; //If null go to next
 
 				glBindBuffer(GL_ARRAY_BUFFER, m_buffers.at(i)->GetID());
-				glVertexAttribPointer(i, m_buffers.at(i)->GetComponents(), GL_FLOAT, GL_FALSE, 0, (void*)0);
+				// Packed buffers are converted to floats as the shader reads them
+				glVertexAttribPointer(i, m_buffers.at(i)->GetComponents(), m_buffers.at(i)->GetType(), m_buffers.at(i)->IsNormalised() ? GL_TRUE : GL_FALSE, 0, (void*)0);
 				glEnableVertexAttribArray(i);
 			}
 
+			// Every attribute of an interleaved buffer is read from the one binding
+			if (m_interleavedBuffer)
+			{
+				glBindBuffer(GL_ARRAY_BUFFER, m_interleavedBuffer->GetID());
+
+				for (const VertexAttribute& attribute : m_interleavedLayout.attributes)
+				{
+					glVertexAttribPointer(attribute.location, attribute.components, attribute.type, attribute.normalised, m_interleavedLayout.stride, (void*)(size_t)attribute.offset);
+					glEnableVertexAttribArray(attribute.location);
+				}
+			}
+
+			// The element buffer binding is part of the VAO's state
+			if (m_indexCount > 0)
+			{
+				if (!m_indexBufferID) glGenBuffers(1, &m_indexBufferID);
+
+				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBufferID);
+				glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indexData.size(), m_indexData.data(), GL_STATIC_DRAW);
+			}
+
 			//cleanup
-			glBindVertexArray(0);
+			StateCache::GetShared().BindVertexArray(0);
 			glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 			m_dirty = false;
@@ -45,6 +78,53 @@ namespace ePBR
 		m_vertCount = _count;
 	}
 
+	void VertexArray::SetIndices(const std::vector<unsigned int>& _indices)
+	{
+		unsigned int maxIndex = 0;
+		for (unsigned int index : _indices) maxIndex = std::max(maxIndex, index);
+
+		m_indexCount = (unsigned int)_indices.size();
+
+		if (maxIndex <= 0xFFFF)
+		{
+			// Half the memory and bandwidth of 32 bit indices
+			m_indexType = GL_UNSIGNED_SHORT;
+			m_indexData.resize(_indices.size() * sizeof(GLushort));
+
+			GLushort* shortIndices = (GLushort*)m_indexData.data();
+			for (size_t i = 0; i < _indices.size(); i++) shortIndices[i] = (GLushort)_indices[i];
+		}
+		else
+		{
+			m_indexType = GL_UNSIGNED_INT;
+			m_indexData.resize(_indices.size() * sizeof(GLuint));
+			memcpy(m_indexData.data(), _indices.data(), m_indexData.size());
+		}
+
+		m_dirty = true; //Indices have changed and so need to be uploaded
+	}
+
+	void VertexArray::SetIndices(const void* _data, unsigned int _count, GLenum _type)
+	{
+		size_t indexSize = _type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+
+		m_indexCount = _count;
+		m_indexType = _type;
+		m_indexData.assign((const unsigned char*)_data, (const unsigned char*)_data + _count * indexSize);
+
+		m_dirty = true; //Indices have changed and so need to be uploaded
+	}
+
+	unsigned int VertexArray::GetIndexCount() const
+	{
+		return m_indexCount;
+	}
+
+	GLenum VertexArray::GetIndexType() const
+	{
+		return m_indexType;
+	}
+
 	VertexArray::VertexArray()
 	{
 		// Create a new VAO on the GPU and bind it
@@ -58,11 +138,18 @@ namespace ePBR
 
 		m_vertCount = 0;
 		m_dirty = true;
+
+		// Element buffer is created when indices are first uploaded
+		m_indexBufferID = 0;
+		m_indexType = GL_UNSIGNED_INT;
+		m_indexCount = 0;
 	}
 
 	VertexArray::~VertexArray()
 	{
 		//Buffers should delete due to RAII
 		glDeleteVertexArrays(1, &m_id);
+		StateCache::GetShared().Invalidate();
+		if (m_indexBufferID) glDeleteBuffers(1, &m_indexBufferID);
 	}
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #ifndef EPBR_VERTEX_ARRAY
 #define EPBR_VERTEX_ARRAY
 
+#include "VertexFormat.h"
+
 #include <memory>
 #include <vector>
 
@@ -20,6 +22,11 @@ namespace ePBR
 		/// @param _index The index at which the new buffer will be placed.
 		void SetBuffer(std::shared_ptr<VertexBuffer> _buffer, int _index);
 
+		/// @brief Set a single buffer of interleaved vertices on this vertex array, in place of separate buffers per attribute.
+		/// @param _buffer The buffer.
+		/// @param _layout The stride of each vertex and the location, format and offset of each attribute.
+		void SetInterleavedBuffer(std::shared_ptr<VertexBuffer> _buffer, const VertexLayout& _layout);
+
 		/// @brief Get the OpenGL ID of this vertex array.
 		/// @return The ID.
 		GLuint GetID();
@@ -32,6 +39,25 @@ namespace ePBR
 		/// @param _count The new vertex count.
 		void SetVertCount(unsigned int _count);
 
+		/// @brief Set the triangle indices of this vertex array. They are uploaded to an element buffer lazily, when GetID() is called.
+		/// @details 16 bit indices are stored when every index fits, 32 bit indices otherwise.
+		/// @param _indices Indices into the vertex buffers, three per triangle.
+		void SetIndices(const std::vector<unsigned int>& _indices);
+
+		/// @brief Set the triangle indices of this vertex array from indices already in their GPU format, copying them in one go.
+		/// @param _data The first index.
+		/// @param _count The number of indices.
+		/// @param _type GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+		void SetIndices(const void* _data, unsigned int _count, GLenum _type);
+
+		/// @brief Get the number of indices associated with this vertex array. 0 if it is not indexed.
+		/// @return The index count.
+		unsigned int GetIndexCount() const;
+
+		/// @brief Get the type of the stored indices. Either GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+		/// @return The index type.
+		GLenum GetIndexType() const;
+
 		VertexArray();
 		~VertexArray();
 	private:
@@ -39,6 +65,14 @@ namespace ePBR
 		unsigned int m_vertCount;
 		bool m_dirty;
 		std::vector< std::shared_ptr<VertexBuffer> > m_buffers;
+
+		std::shared_ptr<VertexBuffer> m_interleavedBuffer;
+		VertexLayout m_interleavedLayout;
+
+		GLuint m_indexBufferID;
+		GLenum m_indexType;
+		unsigned int m_indexCount;
+		std::vector<unsigned char> m_indexData; // Raw GL_UNSIGNED_SHORT or GL_UNSIGNED_INT data
 	};
 }
 
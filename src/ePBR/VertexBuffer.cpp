@@ -1,5 +1,7 @@
 #include "VertexBuffer.h"
 
+#include <algorithm>
+#include <cstring>
 #include <stdexcept>
 
 namespace ePBR
@@ -9,8 +11,8 @@ namespace ePBR
 		if (m_numComponents != 2 && m_numComponents != 0) throw std::runtime_error("Incorrect number of components in attempt to add to vertex buffer!");
 
 		//Flatten data
-		m_data.push_back(_value.x);
-		m_data.push_back(_value.y);
+		Append(_value.x);
+		Append(_value.y);
 
 		m_numComponents = 2;
 		//Data yet to be uploaded
@@ -21,8 +23,8 @@ namespace ePBR
 	{
 		if (m_numComponents != 2 && m_numComponents != 0) throw std::runtime_error("Incorrect number of components in attempt to add to vertex buffer!");;
 
-		m_data.push_back(_x);
-		m_data.push_back(_y);
+		Append(_x);
+		Append(_y);
 
 		m_numComponents = 2;
 		//Data yet to be uploaded
@@ -34,9 +36,9 @@ namespace ePBR
 		if (m_numComponents != 3 && m_numComponents != 0) throw std::runtime_error("Incorrect number of components in attempt to add to vertex buffer!");;
 
 		//Flatten data
-		m_data.push_back(_value.x);
-		m_data.push_back(_value.y);
-		m_data.push_back(_value.z);
+		Append(_value.x);
+		Append(_value.y);
+		Append(_value.z);
 
 		m_numComponents = 3;
 		//Data yet to be uploaded
@@ -47,9 +49,9 @@ namespace ePBR
 	{
 		if (m_numComponents != 3 && m_numComponents != 0) throw std::runtime_error("Incorrect number of components in attempt to add to vertex buffer!");;
 
-		m_data.push_back(_x);
-		m_data.push_back(_y);
-		m_data.push_back(_z);
+		Append(_x);
+		Append(_y);
+		Append(_z);
 
 		m_numComponents = 3;
 		//Data yet to be uploaded
@@ -61,10 +63,10 @@ namespace ePBR
 		if (m_numComponents != 4 && m_numComponents != 0) throw std::runtime_error("Incorrect number of components in attempt to add to vertex buffer!");;
 
 		//Flatten data
-		m_data.push_back(_value.x);
-		m_data.push_back(_value.y);
-		m_data.push_back(_value.z);
-		m_data.push_back(_value.w);
+		Append(_value.x);
+		Append(_value.y);
+		Append(_value.z);
+		Append(_value.w);
 
 		m_numComponents = 4;
 		//Data yet to be uploaded
@@ -75,10 +77,10 @@ namespace ePBR
 	{
 		if (m_numComponents != 4 && m_numComponents != 0) throw std::runtime_error("Incorrect number of components in attempt to add to vertex buffer!");;
 
-		m_data.push_back(_x);
-		m_data.push_back(_y);
-		m_data.push_back(_z);
-		m_data.push_back(_w);
+		Append(_x);
+		Append(_y);
+		Append(_z);
+		Append(_w);
 
 		m_numComponents = 4;
 		//Data yet to be uploaded
@@ -90,55 +92,47 @@ namespace ePBR
 		if (m_numComponents != 1 && m_numComponents != 0) throw std::runtime_error("Incorrect number of components in attempt to add to vertex buffer!");;
 
 		//Flatten data
-		m_data.push_back(_value);
+		Append(_value);
 
 		m_numComponents = 1;
 		//Data yet to be uploaded
 		m_dirty = true;
 	}
 
-	void VertexBuffer::SetData(std::vector<glm::vec3> _newData) 
+	void VertexBuffer::SetData(const std::vector<glm::vec4>& _newData)
 	{
-		m_data.clear();
-		
-		// There may be a way to accelerate this significantly!! This is just quick and dirty for now.
-		for (glm::vec3 v : _newData) 
-		{
-			m_data.push_back(v.x);
-			m_data.push_back(v.y);
-			m_data.push_back(v.z);
-		}
+		// glm vectors are tightly packed floats, so the whole vector can be copied in one go
+		SetBytes(_newData.data(), _newData.size() * sizeof(_newData[0]));
+
+		m_numComponents = 4;
+
+		//Data yet to be uploaded
+		m_dirty = true;
+	}
+	void VertexBuffer::SetData(const std::vector<glm::vec3>& _newData)
+	{
+		// glm vectors are tightly packed floats, so the whole vector can be copied in one go
+		SetBytes(_newData.data(), _newData.size() * sizeof(_newData[0]));
 
 		m_numComponents = 3;
 		
 		//Data yet to be uploaded
 		m_dirty = true;
 	}
-	void VertexBuffer::SetData(std::vector<glm::vec2> _newData)
+	void VertexBuffer::SetData(const std::vector<glm::vec2>& _newData)
 	{
-		m_data.clear();
-
-		// There may be a way to accelerate this significantly!! This is just quick and dirty for now.
-		for (glm::vec2 v : _newData)
-		{
-			m_data.push_back(v.x);
-			m_data.push_back(v.y);
-		}
+		// glm vectors are tightly packed floats, so the whole vector can be copied in one go
+		SetBytes(_newData.data(), _newData.size() * sizeof(_newData[0]));
 
 		m_numComponents = 2;
 
 		//Data yet to be uploaded
 		m_dirty = true;
 	}
-	void VertexBuffer::SetData(std::vector<float> _newData)
+	void VertexBuffer::SetData(const std::vector<float>& _newData)
 	{
-		m_data.clear();
-
-		// There may be a way to accelerate this significantly!! This is just quick and dirty for now.
-		for (float v : _newData)
-		{
-			m_data.push_back(v);
-		}
+		// Vector elements are contiguous, so copy them in one go
+		SetBytes(_newData.data(), _newData.size() * sizeof(float));
 
 		m_numComponents = 1;
 
@@ -149,37 +143,116 @@ namespace ePBR
 	void VertexBuffer::SetData(const float* _newData, const size_t _size, const int _components)
 	{
 		// Replace data with new data
-		m_data.assign(_newData, _newData + _size);
+		SetBytes(_newData, _size * sizeof(float));
 
 		// Set components and dirty the object
 		m_numComponents = _components;
 		m_dirty = true;
 	}
 
+	void VertexBuffer::SetData(const void* _newData, const size_t _bytes, const int _components, const GLenum _type, const bool _normalised)
+	{
+		m_data.assign((const unsigned char*)_newData, (const unsigned char*)_newData + _bytes);
+		m_numComponents = _components;
+		m_type = _type;
+		m_normalised = _normalised;
+
+		//Data yet to be uploaded
+		m_dirty = true;
+	}
+
+	void VertexBuffer::SetData(const void* _newData, const size_t _bytes)
+	{
+		// Components and type vary per attribute, so they are left to the layout
+		SetData(_newData, _bytes, 0, GL_UNSIGNED_BYTE, false);
+	}
+
+	void VertexBuffer::Update(size_t _offset, const void* _newData, size_t _bytes)
+	{
+		if (_offset + _bytes > m_data.size()) throw std::runtime_error("Attempt to update vertex buffer data out of range!");
+
+		memcpy(&m_data[_offset], _newData, _bytes);
+
+		// Grow the range to upload, unless the whole buffer is going anyway
+		if (m_dirtyBegin == m_dirtyEnd)
+		{
+			m_dirtyBegin = _offset;
+			m_dirtyEnd = _offset + _bytes;
+		}
+		else
+		{
+			m_dirtyBegin = std::min(m_dirtyBegin, _offset);
+			m_dirtyEnd = std::max(m_dirtyEnd, _offset + _bytes);
+		}
+
+		m_dynamic = true;
+	}
+
 	int VertexBuffer::GetComponents()
 	{
 		return m_numComponents;
 	}
 
+	GLenum VertexBuffer::GetType()
+	{
+		return m_type;
+	}
+
+	bool VertexBuffer::IsNormalised()
+	{
+		return m_normalised;
+	}
+
+	void VertexBuffer::Append(float _value)
+	{
+		// Float data can't follow packed data
+		if (m_type != GL_FLOAT) throw std::runtime_error("Attempt to add floats to a packed vertex buffer!");
+
+		size_t size = m_data.size();
+		m_data.resize(size + sizeof(float));
+		memcpy(&m_data[size], &_value, sizeof(float));
+	}
+
+	void VertexBuffer::SetBytes(const void* _floats, size_t _bytes)
+	{
+		m_data.assign((const unsigned char*)_floats, (const unsigned char*)_floats + _bytes);
+		m_type = GL_FLOAT;
+		m_normalised = false;
+	}
+
 	GLuint VertexBuffer::GetID()
 	{
 		//We know that the data will be needed on the GPU after GETID is called
 		//So we upload if the data has changed
-		if (m_dirty)
+		if (m_dirty || m_dirtyBegin != m_dirtyEnd)
 		{
 			//Now when we operate, we operate on this buffer
 			glBindBuffer(GL_ARRAY_BUFFER, m_id);
 
-			// Upload a copy of the data from memory into the new VBO
-			glBufferData(GL_ARRAY_BUFFER,
-				m_data.size() * sizeof(m_data.at(0)), //Length of vector times size of datum
-				&m_data.at(0), GL_STATIC_DRAW);	//Pointer to first item (data will be contiguous)
+			if (m_dirty && m_data.size() != m_uploadedBytes)
+			{
+				// Upload a copy of the data from memory into the new VBO
+				glBufferData(GL_ARRAY_BUFFER,
+					m_data.size(), //Length of vector in bytes
+					m_data.data(), m_dynamic ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);	//Pointer to first item (data will be contiguous)
+
+				m_uploadedBytes = m_data.size();
+			}
+			else
+			{
+				// Same size as the storage, so write over just what changed rather than reallocating
+				size_t begin = m_dirty ? 0 : m_dirtyBegin;
+				size_t end = m_dirty ? m_data.size() : m_dirtyEnd;
+				glBufferSubData(GL_ARRAY_BUFFER, begin, end - begin, m_data.data() + begin);
+			}
 
 			// Reset the state
 			glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 			//Data now uploaded
 			m_dirty = false;
+			m_dirtyBegin = 0;
+			m_dirtyEnd = 0;
 		}
 
 		return m_id;
@@ -195,8 +268,14 @@ namespace ePBR
 		}
 
 		m_numComponents = 0;
+		m_type = GL_FLOAT;
+		m_normalised = false;
 		//Data yet to be uploaded
 		m_dirty = true;
+		m_dirtyBegin = 0;
+		m_dirtyEnd = 0;
+		m_uploadedBytes = 0;
+		m_dynamic = false;
 	}
 
 	VertexBuffer::~VertexBuffer()
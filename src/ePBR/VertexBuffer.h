@@ -47,17 +47,21 @@ namespace ePBR
 		/// @param _value The value.
 		void Add(float _value);
 
+		/// @brief Replace the data in this buffer with new, 4 dimensional data.
+		/// @param _newData The new data.
+		void SetData(const std::vector<glm::vec4>& _newData);
+
 		/// @brief Replace the data in this buffer with new, 3 dimensional data.
 		/// @param _newData The new data.
-		void SetData(std::vector<glm::vec3> _newData);
+		void SetData(const std::vector<glm::vec3>& _newData);
 
 		/// @brief Replace the data in this buffer with new, 2 dimensional data.
 		/// @param _newData The new data.
-		void SetData(std::vector<glm::vec2> _newData);
+		void SetData(const std::vector<glm::vec2>& _newData);
 
 		/// @brief Replace the data in this buffer with new, 1 dimensional data.
 		/// @param _newData The new data.
-		void SetData(std::vector<float> _newData);
+		void SetData(const std::vector<float>& _newData);
 
 		/// @brief Replace the data in this buffer with a raw float array.
 		/// @param _newData A pointer to the start of the new data.
@@ -65,10 +69,38 @@ namespace ePBR
 		/// @param _components The number of dimenions (i.e. 3 for vec3s) expected in the data.
 		void SetData(const float* _newData, const size_t _size, const int _components);
 
+		/// @brief Replace the data in this buffer with packed data, such as 16 bit or 10:10:10:2 attributes.
+		/// @param _newData A pointer to the start of the new data.
+		/// @param _bytes The size of _newData in bytes.
+		/// @param _components The number of components per vertex.
+		/// @param _type The OpenGL type of each component, e.g. GL_SHORT or GL_INT_2_10_10_10_REV.
+		/// @param _normalised Whether integer components are mapped to [0, 1] or [-1, 1] when read by a shader.
+		void SetData(const void* _newData, const size_t _bytes, const int _components, const GLenum _type, const bool _normalised);
+
+		/// @brief Replace the data in this buffer with interleaved vertices. Their attributes are described by the VertexLayout the buffer is bound with.
+		/// @param _newData A pointer to the first vertex.
+		/// @param _bytes The size of _newData in bytes.
+		void SetData(const void* _newData, const size_t _bytes);
+
+		/// @brief Overwrite part of the data in this buffer. Only the changed bytes are uploaded, into the existing GPU storage.
+		/// @details For geometry rewritten wholesale every frame, a StreamBuffer avoids the upload entirely.
+		/// @param _offset The byte offset to write at.
+		/// @param _newData A pointer to the new bytes.
+		/// @param _bytes The size of _newData in bytes. Must lie within the existing data.
+		void Update(size_t _offset, const void* _newData, size_t _bytes);
+
 		/// @brief Get the number of components in one unit of data for this buffer. (e.g. 3 for vec3)
 		/// @return The number of components in one unit of data for this buffer.
 		int GetComponents();
 
+		/// @brief Get the OpenGL type of each component of the data in this buffer. GL_FLOAT unless packed data was set.
+		/// @return The component type.
+		GLenum GetType();
+
+		/// @brief Get whether integer data in this buffer is read as normalised values.
+		/// @return Whether the data is normalised.
+		bool IsNormalised();
+
 		/// @brief Get the OpenGL ID of this buffer.
 		/// @return The ID.
 		GLuint GetID();
@@ -76,10 +108,22 @@ namespace ePBR
 		VertexBuffer();
 		~VertexBuffer();
 	private:
+		// Append one float to the data
+		void Append(float _value);
+
+		// Replace the data with float data
+		void SetBytes(const void* _floats, size_t _bytes);
+
 		GLuint m_id;
 		int m_numComponents;
-		std::vector<GLfloat> m_data;
+		GLenum m_type;
+		bool m_normalised;
+		std::vector<unsigned char> m_data; // Raw bytes of m_type components
 		bool m_dirty; //Used to specify whether data is yet to be uploaded to GPU
+		size_t m_dirtyBegin; // Bytes changed by Update() since the last upload
+		size_t m_dirtyEnd;
+		size_t m_uploadedBytes; // Size of the GPU storage
+		bool m_dynamic; // Whether Update() has been used, so the storage is hinted for repeated writes
 	};
 }
 
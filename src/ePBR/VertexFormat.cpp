@@ -0,0 +1,104 @@
+#include "VertexFormat.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/packing.hpp>
+
+namespace ePBR
+{
+	PositionQuantisation PositionQuantisation::FromBounds(const MeshData& _data)
+	{
+		glm::vec3 extent = _data.boundsMax - _data.boundsMin;
+
+		PositionQuantisation quantisation;
+		quantisation.offset = _data.boundsMin;
+		quantisation.scale = std::max(extent.x, std::max(extent.y, extent.z));
+		if (!(quantisation.scale > 0.0f)) quantisation.scale = 1.0f;
+
+		return quantisation;
+	}
+
+	glm::mat4 PositionQuantisation::GetDecode() const
+	{
+		return glm::scale(glm::translate(glm::mat4(1.0f), offset), glm::vec3(scale));
+	}
+
+	glm::vec2 OctahedralEncode(const glm::vec3& _direction)
+	{
+		glm::vec3 n = _direction / (std::fabs(_direction.x) + std::fabs(_direction.y) + std::fabs(_direction.z));
+		glm::vec2 encoded(n.x, n.y);
+
+		// Fold the lower hemisphere over the diagonals
+		if (n.z < 0.0f)
+		{
+			encoded.x = (1.0f - std::fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+			encoded.y = (1.0f - std::fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+		}
+
+		return encoded;
+	}
+
+	glm::vec3 OctahedralDecode(const glm::vec2& _encoded)
+	{
+		glm::vec3 n(_encoded.x, _encoded.y, 1.0f - std::fabs(_encoded.x) - std::fabs(_encoded.y));
+
+		if (n.z < 0.0f)
+		{
+			n.x = (1.0f - std::fabs(_encoded.y)) * (_encoded.x >= 0.0f ? 1.0f : -1.0f);
+			n.y = (1.0f - std::fabs(_encoded.x)) * (_encoded.y >= 0.0f ? 1.0f : -1.0f);
+		}
+
+		return glm::normalize(n);
+	}
+
+	glm::vec2 QuantiseOctahedral(const glm::vec3& _direction, float _maxValue)
+	{
+		if (glm::dot(_direction, _direction) == 0.0f) return glm::vec2(0.0f);
+
+		// Rounding each coordinate on its own is not always nearest on the sphere, so try the four surrounding grid points
+		glm::vec2 encoded = OctahedralEncode(_direction) * _maxValue;
+		glm::vec2 best = glm::round(encoded) / _maxValue;
+		float bestDot = -2.0f;
+
+		for (int i = 0; i < 4; i++)
+		{
+			glm::vec2 candidate(i & 1 ? std::ceil(encoded.x) : std::floor(encoded.x), i & 2 ? std::ceil(encoded.y) : std::floor(encoded.y));
+			candidate = glm::clamp(candidate / _maxValue, glm::vec2(-1.0f), glm::vec2(1.0f));
+
+			float dot = glm::dot(OctahedralDecode(candidate), _direction);
+			if (dot > bestDot)
+			{
+				bestDot = dot;
+				best = candidate;
+			}
+		}
+
+		return best;
+	}
+
+	UV2h::Storage UV2h::Encode(const MeshData& _data, size_t _vertex, const PositionQuantisation&)
+	{
+		return glm::packHalf2x16(_data.uvs.empty() ? glm::vec2(0.0f) : _data.uvs[_vertex]);
+	}
+
+	glm::vec2 UV2h::Decode(const Storage& _stored, const PositionQuantisation&)
+	{
+		return glm::unpackHalf2x16(_stored);
+	}
+
+	TangentOct10::Storage TangentOct10::Encode(const MeshData& _data, size_t _vertex, const PositionQuantisation&)
+	{
+		glm::vec4 tangent = _data.tangents.empty() ? glm::vec4(0, 0, 0, 1) : _data.tangents[_vertex];
+		glm::vec2 encoded = QuantiseOctahedral(glm::vec3(tangent), 511.0f);
+		return glm::packSnorm3x10_1x2(glm::vec4(encoded, 0.0f, tangent.w < 0.0f ? -1.0f : 1.0f));
+	}
+
+	glm::vec4 TangentOct10::Decode(const Storage& _stored, const PositionQuantisation&)
+	{
+		glm::vec4 stored = glm::unpackSnorm3x10_1x2(_stored);
+		return glm::vec4(OctahedralDecode(glm::vec2(stored)), stored.w);
+	}
+}
@@ -0,0 +1,265 @@
+#ifndef EPBR_VERTEX_FORMAT
+#define EPBR_VERTEX_FORMAT
+
+#include "MeshData.h"
+
+#include <array>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+namespace ePBR
+{
+	/// @brief Where one attribute lives within an interleaved vertex, and how the shader reads it.
+	struct VertexAttribute
+	{
+		GLuint location;
+		GLint components;
+		GLenum type;
+		GLboolean normalised;
+		unsigned int offset;
+	};
+
+	/// @brief The runtime description of an interleaved vertex format, as passed to glVertexAttribPointer.
+	struct VertexLayout
+	{
+		unsigned int stride = 0;
+		std::vector<VertexAttribute> attributes;
+	};
+
+	/// @brief How quantised positions map onto model space: position = offset + stored * scale.
+	/// @details The scale is uniform so that it can be folded into the model matrix without skewing normals.
+	struct PositionQuantisation
+	{
+		glm::vec3 offset = glm::vec3(0.0f);
+		float scale = 1.0f;
+
+		/// @brief Fit positions to the longest side of a mesh's bounds.
+		/// @param _data The mesh, with its bounds computed.
+		/// @return The quantisation.
+		static PositionQuantisation FromBounds(const MeshData& _data);
+
+		/// @brief Get the matrix which maps stored positions to model space.
+		/// @return The matrix.
+		glm::mat4 GetDecode() const;
+	};
+
+	/// @brief Encode a unit vector on the octahedron, mapped onto [-1, 1] squared.
+	/// @param _direction The unit vector.
+	/// @return The encoding.
+	glm::vec2 OctahedralEncode(const glm::vec3& _direction);
+
+	/// @brief Decode a unit vector from its octahedral encoding.
+	/// @param _encoded The encoding.
+	/// @return The unit vector.
+	glm::vec3 OctahedralDecode(const glm::vec2& _encoded);
+
+	/// @brief Octahedral encode a unit vector onto a grid of signed normalised integers, picking the grid point nearest on the sphere.
+	/// @param _direction The unit vector, or zero.
+	/// @param _maxValue The largest integer of the format, e.g. 32767 for 16 bits.
+	/// @return The encoding, in [-1, 1] and on the grid.
+	glm::vec2 QuantiseOctahedral(const glm::vec3& _direction, float _maxValue);
+
+	// Attributes. Each has the location and GL format the shaders expect, the type it is stored as,
+	// and converts to and from the float streams of MeshData. Missing streams read as GL's default attribute value.
+
+	/// @brief Float position, location 0.
+	struct Position3f
+	{
+		typedef glm::vec3 Storage;
+		static const GLuint LOCATION = 0;
+		static const GLint COMPONENTS = 3;
+		static const GLenum TYPE = GL_FLOAT;
+		static const GLboolean NORMALISED = GL_FALSE;
+
+		static Storage Encode(const MeshData& _data, size_t _vertex, const PositionQuantisation&) { return _data.positions[_vertex]; }
+		static glm::vec3 Decode(const Storage& _stored, const PositionQuantisation&) { return _stored; }
+	};
+
+	/// @brief 16 bit unsigned normalised position relative to the mesh bounds, location 0. w is 0, where float positions read as 1.
+	struct Position4u16
+	{
+		typedef glm::u16vec4 Storage;
+		static const GLuint LOCATION = 0;
+		static const GLint COMPONENTS = 4;
+		static const GLenum TYPE = GL_UNSIGNED_SHORT;
+		static const GLboolean NORMALISED = GL_TRUE;
+
+		static Storage Encode(const MeshData& _data, size_t _vertex, const PositionQuantisation& _quantisation)
+		{
+			glm::vec3 normalised = glm::clamp((_data.positions[_vertex] - _quantisation.offset) / _quantisation.scale, 0.0f, 1.0f);
+			return Storage(glm::round(normalised * 65535.0f), 0);
+		}
+		static glm::vec3 Decode(const Storage& _stored, const PositionQuantisation& _quantisation)
+		{
+			return _quantisation.offset + glm::vec3(_stored) / 65535.0f * _quantisation.scale;
+		}
+	};
+
+	/// @brief Float normal, location 1.
+	struct Normal3f
+	{
+		typedef glm::vec3 Storage;
+		static const GLuint LOCATION = 1;
+		static const GLint COMPONENTS = 3;
+		static const GLenum TYPE = GL_FLOAT;
+		static const GLboolean NORMALISED = GL_FALSE;
+
+		static Storage Encode(const MeshData& _data, size_t _vertex, const PositionQuantisation&) { return _data.normals.empty() ? glm::vec3(0.0f) : _data.normals[_vertex]; }
+		static glm::vec3 Decode(const Storage& _stored, const PositionQuantisation&) { return _stored; }
+	};
+
+	/// @brief Octahedral normal in two 16 bit signed normalised values, location 1.
+	struct NormalOct16
+	{
+		typedef glm::i16vec2 Storage;
+		static const GLuint LOCATION = 1;
+		static const GLint COMPONENTS = 2;
+		static const GLenum TYPE = GL_SHORT;
+		static const GLboolean NORMALISED = GL_TRUE;
+
+		static Storage Encode(const MeshData& _data, size_t _vertex, const PositionQuantisation&)
+		{
+			if (_data.normals.empty()) return Storage(0);
+			return Storage(glm::round(QuantiseOctahedral(_data.normals[_vertex], 32767.0f) * 32767.0f));
+		}
+		static glm::vec3 Decode(const Storage& _stored, const PositionQuantisation&) { return OctahedralDecode(glm::max(glm::vec2(_stored) / 32767.0f, -1.0f)); }
+	};
+
+	/// @brief Float texture coordinates, location 2.
+	struct UV2f
+	{
+		typedef glm::vec2 Storage;
+		static const GLuint LOCATION = 2;
+		static const GLint COMPONENTS = 2;
+		static const GLenum TYPE = GL_FLOAT;
+		static const GLboolean NORMALISED = GL_FALSE;
+
+		static Storage Encode(const MeshData& _data, size_t _vertex, const PositionQuantisation&) { return _data.uvs.empty() ? glm::vec2(0.0f) : _data.uvs[_vertex]; }
+		static glm::vec2 Decode(const Storage& _stored, const PositionQuantisation&) { return _stored; }
+	};
+
+	/// @brief Half float texture coordinates, location 2.
+	struct UV2h
+	{
+		typedef glm::uint32 Storage;
+		static const GLuint LOCATION = 2;
+		static const GLint COMPONENTS = 2;
+		static const GLenum TYPE = GL_HALF_FLOAT;
+		static const GLboolean NORMALISED = GL_FALSE;
+
+		static Storage Encode(const MeshData& _data, size_t _vertex, const PositionQuantisation& _quantisation);
+		static glm::vec2 Decode(const Storage& _stored, const PositionQuantisation&);
+	};
+
+	/// @brief Float tangent with the bitangent sign in w, location 3.
+	struct Tangent4f
+	{
+		typedef glm::vec4 Storage;
+		static const GLuint LOCATION = 3;
+		static const GLint COMPONENTS = 4;
+		static const GLenum TYPE = GL_FLOAT;
+		static const GLboolean NORMALISED = GL_FALSE;
+
+		static Storage Encode(const MeshData& _data, size_t _vertex, const PositionQuantisation&) { return _data.tangents.empty() ? glm::vec4(0, 0, 0, 1) : _data.tangents[_vertex]; }
+		static glm::vec4 Decode(const Storage& _stored, const PositionQuantisation&) { return _stored; }
+	};
+
+	/// @brief Octahedral tangent in the x and y of a 10:10:10:2 signed normalised value, with the bitangent sign in w, location 3.
+	struct TangentOct10
+	{
+		typedef glm::uint32 Storage;
+		static const GLuint LOCATION = 3;
+		static const GLint COMPONENTS = 4;
+		static const GLenum TYPE = GL_INT_2_10_10_10_REV;
+		static const GLboolean NORMALISED = GL_TRUE;
+
+		static Storage Encode(const MeshData& _data, size_t _vertex, const PositionQuantisation& _quantisation);
+		static glm::vec4 Decode(const Storage& _stored, const PositionQuantisation&);
+	};
+
+	/// @brief An interleaved vertex format built from a list of attributes at compile time.
+	/// @details Attributes are laid out back to back in the order given. The stride, offsets and attribute table are all constant expressions.
+	/// Usage: VertexFormat<Position3f, NormalOct16, UV2h>::Pack(meshData, quantisation, vertices).
+	template <typename... Attributes>
+	class VertexFormat
+	{
+	public:
+		static constexpr size_t ATTRIBUTE_COUNT = sizeof...(Attributes);
+		static constexpr unsigned int STRIDE = (0u + ... + (unsigned int)sizeof(typename Attributes::Storage));
+
+		static_assert(STRIDE % 4 == 0, "GL wants every vertex to start on a 4 byte boundary");
+
+		/// @brief Get the byte offset of an attribute within a vertex.
+		/// @return The offset.
+		template <typename Attribute>
+		static constexpr unsigned int OffsetOf()
+		{
+			static_assert((std::is_same<Attribute, Attributes>::value || ...), "Attribute is not part of this format");
+
+			unsigned int offset = 0;
+			bool found = false;
+			((found = found || std::is_same<Attribute, Attributes>::value, offset += found ? 0 : (unsigned int)sizeof(typename Attributes::Storage)), ...);
+			return offset;
+		}
+
+		/// @brief The attribute table, in the order of the format.
+		static constexpr std::array<VertexAttribute, ATTRIBUTE_COUNT> ATTRIBUTES =
+		{ { { Attributes::LOCATION, Attributes::COMPONENTS, Attributes::TYPE, Attributes::NORMALISED, OffsetOf<Attributes>() }... } };
+
+		/// @brief One vertex as it sits in the vertex buffer.
+		struct alignas(4) Vertex
+		{
+			unsigned char bytes[STRIDE];
+
+			/// @brief Write one attribute.
+			template <typename Attribute>
+			void Set(const typename Attribute::Storage& _value) { memcpy(bytes + OffsetOf<Attribute>(), &_value, sizeof(_value)); }
+
+			/// @brief Read one attribute.
+			template <typename Attribute>
+			typename Attribute::Storage Get() const
+			{
+				typename Attribute::Storage value;
+				memcpy(&value, bytes + OffsetOf<Attribute>(), sizeof(value));
+				return value;
+			}
+		};
+
+		static_assert(sizeof(Vertex) == STRIDE, "Vertices must be tightly packed");
+
+		/// @brief Get the runtime description of this format, for binding it to a vertex array.
+		/// @return The layout.
+		static VertexLayout GetLayout()
+		{
+			VertexLayout layout;
+			layout.stride = STRIDE;
+			layout.attributes.assign(ATTRIBUTES.begin(), ATTRIBUTES.end());
+			return layout;
+		}
+
+		/// @brief Encode every vertex of a mesh straight into vertex buffer memory.
+		/// @param _data The mesh.
+		/// @param _quantisation The mapping used by quantised position attributes.
+		/// @param _out Space for one Vertex per position of the mesh.
+		static void Pack(const MeshData& _data, const PositionQuantisation& _quantisation, Vertex* _out)
+		{
+			for (size_t i = 0; i < _data.positions.size(); i++)
+			{
+				(_out[i].template Set<Attributes>(Attributes::Encode(_data, i, _quantisation)), ...);
+			}
+		}
+	};
+
+	/// @brief The default format, with every attribute stored as floats. 48 bytes per vertex.
+	typedef VertexFormat<Position3f, Normal3f, UV2f, Tangent4f> FloatVertexFormat;
+
+	/// @brief The format used by ImportOptions::quantiseVertices. 20 bytes per vertex.
+	typedef VertexFormat<Position4u16, NormalOct16, UV2h, TangentOct10> QuantisedVertexFormat;
+}
+
+#endif // EPBR_VERTEX_FORMAT
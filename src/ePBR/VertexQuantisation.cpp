@@ -0,0 +1,116 @@
+#include "VertexQuantisation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+namespace ePBR
+{
+	namespace
+	{
+		template <typename Format>
+		void Pack(const MeshData& _data, PackedVertices& _out)
+		{
+			_out.layout = Format::GetLayout();
+			_out.data.resize(_data.positions.size() * Format::STRIDE);
+			Format::Pack(_data, _out.position, (typename Format::Vertex*)_out.data.data());
+		}
+
+		float AngleBetween(const glm::vec3& _a, const glm::vec3& _b)
+		{
+			float lengths = glm::length(_a) * glm::length(_b);
+			if (lengths == 0.0f) return 0.0f;
+			return glm::degrees(std::acos(glm::clamp(glm::dot(_a, _b) / lengths, -1.0f, 1.0f)));
+		}
+	}
+
+	void PackVertices(const MeshData& _data, PackedVertices& _out)
+	{
+		_out = PackedVertices();
+
+		if (_data.quantise)
+		{
+			_out.position = PositionQuantisation::FromBounds(_data);
+			Pack<QuantisedVertexFormat>(_data, _out);
+		}
+		else
+		{
+			Pack<FloatVertexFormat>(_data, _out);
+		}
+	}
+
+	QuantisationError MeasureQuantisationError(const MeshData& _data)
+	{
+		QuantisationError error;
+
+		size_t vertices = _data.positions.size();
+		if (vertices == 0) return error;
+
+		PositionQuantisation quantisation = PositionQuantisation::FromBounds(_data);
+		std::vector<QuantisedVertexFormat::Vertex> packed(vertices);
+		QuantisedVertexFormat::Pack(_data, quantisation, packed.data());
+
+		for (size_t i = 0; i < vertices; i++)
+		{
+			const QuantisedVertexFormat::Vertex& vertex = packed[i];
+
+			float distance = glm::length(Position4u16::Decode(vertex.Get<Position4u16>(), quantisation) - _data.positions[i]);
+			error.maxPosition = std::max(error.maxPosition, distance);
+			error.meanPosition += distance;
+
+			if (!_data.normals.empty())
+			{
+				float angle = AngleBetween(NormalOct16::Decode(vertex.Get<NormalOct16>(), quantisation), _data.normals[i]);
+				error.maxNormal = std::max(error.maxNormal, angle);
+				error.meanNormal += angle;
+			}
+
+			if (!_data.uvs.empty())
+			{
+				glm::vec2 difference = glm::abs(UV2h::Decode(vertex.Get<UV2h>(), quantisation) - _data.uvs[i]);
+				float uvDistance = std::max(difference.x, difference.y);
+				error.maxUV = std::max(error.maxUV, uvDistance);
+				error.meanUV += uvDistance;
+			}
+
+			if (!_data.tangents.empty())
+			{
+				glm::vec4 tangent = TangentOct10::Decode(vertex.Get<TangentOct10>(), quantisation);
+				float angle = AngleBetween(glm::vec3(tangent), glm::vec3(_data.tangents[i]));
+				error.maxTangent = std::max(error.maxTangent, angle);
+				error.meanTangent += angle;
+
+				if ((tangent.w < 0.0f) != (_data.tangents[i].w < 0.0f)) error.flippedSigns++;
+			}
+		}
+
+		error.meanPosition /= vertices;
+		error.meanNormal /= vertices;
+		error.meanUV /= vertices;
+		error.meanTangent /= vertices;
+
+		return error;
+	}
+
+	void ReportQuantisation(const MeshData& _data)
+	{
+		PrintQuantisationError(std::cout, MeasureQuantisationError(_data), FloatVertexFormat::STRIDE, QuantisedVertexFormat::STRIDE);
+	}
+
+	void PrintQuantisationError(std::ostream& _stream, const QuantisationError& _error, size_t _floatBytes, size_t _packedBytes)
+	{
+		char line[128];
+
+		snprintf(line, sizeof(line), "  Vertex bytes      %6zu -> %6zu (%.2fx smaller)\n", _floatBytes, _packedBytes, _packedBytes ? (float)_floatBytes / _packedBytes : 0.0f);
+		_stream << line;
+		snprintf(line, sizeof(line), "  Position error    max %.3g, mean %.3g\n", _error.maxPosition, _error.meanPosition);
+		_stream << line;
+		snprintf(line, sizeof(line), "  Normal error      max %.3g deg, mean %.3g deg\n", _error.maxNormal, _error.meanNormal);
+		_stream << line;
+		snprintf(line, sizeof(line), "  Tangent error     max %.3g deg, mean %.3g deg, %zu signs flipped\n", _error.maxTangent, _error.meanTangent, _error.flippedSigns);
+		_stream << line;
+		snprintf(line, sizeof(line), "  UV error          max %.3g, mean %.3g\n", _error.maxUV, _error.meanUV);
+		_stream << line;
+	}
+}
@@ -0,0 +1,65 @@
+#ifndef EPBR_VERTEX_QUANTISATION
+#define EPBR_VERTEX_QUANTISATION
+
+#include "MeshData.h"
+#include "VertexFormat.h"
+
+#include <ostream>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace ePBR
+{
+	/// @brief The vertices of a mesh interleaved in the format they will be uploaded in.
+	struct PackedVertices
+	{
+		VertexLayout layout;
+		std::vector<unsigned char> data;
+
+		/// @brief Maps stored positions to model space. Identity unless positions are quantised.
+		PositionQuantisation position;
+	};
+
+	/// @brief How far quantised attributes are from the float originals.
+	struct QuantisationError
+	{
+		/// @brief In model space units.
+		float maxPosition = 0.0f;
+		float meanPosition = 0.0f;
+		/// @brief In degrees.
+		float maxNormal = 0.0f;
+		float meanNormal = 0.0f;
+		/// @brief In degrees.
+		float maxTangent = 0.0f;
+		float meanTangent = 0.0f;
+		/// @brief In texture coordinate units.
+		float maxUV = 0.0f;
+		float meanUV = 0.0f;
+		/// @brief Tangents whose bitangent sign did not survive.
+		size_t flippedSigns = 0;
+	};
+
+	/// @brief Interleave a mesh's vertices in the format they will be uploaded in.
+	/// @param _data The mesh. Its quantise flag picks QuantisedVertexFormat over FloatVertexFormat.
+	/// @param _out Receives the vertices.
+	void PackVertices(const MeshData& _data, PackedVertices& _out);
+
+	/// @brief Pack a mesh in QuantisedVertexFormat, decode it again and compare it against the float streams.
+	/// @param _data The float mesh.
+	/// @return The errors.
+	QuantisationError MeasureQuantisationError(const MeshData& _data);
+
+	/// @brief Quantise a mesh and print the vertex memory saved and the errors introduced to std::cout.
+	/// @param _data The float mesh.
+	void ReportQuantisation(const MeshData& _data);
+
+	/// @brief Print quantisation errors and the vertex memory of the float and quantised formats.
+	/// @param _stream The stream to print to.
+	/// @param _error The errors.
+	/// @param _floatBytes The bytes per vertex as floats.
+	/// @param _packedBytes The bytes per vertex when packed.
+	void PrintQuantisationError(std::ostream& _stream, const QuantisationError& _error, size_t _floatBytes, size_t _packedBytes);
+}
+
+#endif // EPBR_VERTEX_QUANTISATION
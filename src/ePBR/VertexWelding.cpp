@@ -0,0 +1,85 @@
+#include "VertexWelding.h"
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace ePBR
+{
+	namespace
+	{
+		struct VertexKey
+		{
+			glm::vec3 position;
+			glm::vec3 normal;
+			glm::vec2 uv;
+
+			bool operator==(const VertexKey& _other) const
+			{
+				// Bitwise, so that welding never changes what ends up on the GPU
+				return memcmp(this, &_other, sizeof(VertexKey)) == 0;
+			}
+		};
+
+		struct VertexKeyHash
+		{
+			size_t operator()(const VertexKey& _key) const
+			{
+				uint32_t words[sizeof(VertexKey) / sizeof(uint32_t)];
+				memcpy(words, &_key, sizeof(VertexKey));
+
+				// FNV-1a over the raw float bits
+				uint64_t hash = 14695981039346656037ull;
+				for (uint32_t word : words)
+				{
+					hash = (hash ^ word) * 1099511628211ull;
+				}
+				return (size_t)(hash ^ (hash >> 32));
+			}
+		};
+	}
+
+	size_t WeldVertices(std::vector<glm::vec3>& _positions, std::vector<glm::vec3>& _normals, std::vector<glm::vec2>& _uvs, std::vector<unsigned int>& _remap)
+	{
+		const size_t numVertices = _positions.size();
+		const bool hasNormals = !_normals.empty();
+		const bool hasUVs = !_uvs.empty();
+
+		if ((hasNormals && _normals.size() != numVertices) || (hasUVs && _uvs.size() != numVertices))
+		{
+			throw std::runtime_error("Vertex streams passed to WeldVertices differ in length!");
+		}
+
+		std::unordered_map<VertexKey, unsigned int, VertexKeyHash> uniqueVertices;
+		uniqueVertices.reserve(numVertices);
+		_remap.resize(numVertices);
+
+		unsigned int numUnique = 0;
+		for (size_t i = 0; i < numVertices; i++)
+		{
+			VertexKey key;
+			key.position = _positions[i];
+			key.normal = hasNormals ? _normals[i] : glm::vec3(0.0f);
+			key.uv = hasUVs ? _uvs[i] : glm::vec2(0.0f);
+
+			auto inserted = uniqueVertices.emplace(key, numUnique);
+			_remap[i] = inserted.first->second;
+
+			if (inserted.second)
+			{
+				// A new vertex is never ahead of the one being read, so the streams can be compacted in place
+				_positions[numUnique] = _positions[i];
+				if (hasNormals) _normals[numUnique] = _normals[i];
+				if (hasUVs) _uvs[numUnique] = _uvs[i];
+				numUnique++;
+			}
+		}
+
+		_positions.resize(numUnique);
+		if (hasNormals) _normals.resize(numUnique);
+		if (hasUVs) _uvs.resize(numUnique);
+
+		return numUnique;
+	}
+}
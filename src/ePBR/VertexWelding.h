@@ -0,0 +1,21 @@
+#ifndef EPBR_VERTEX_WELDING
+#define EPBR_VERTEX_WELDING
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace ePBR
+{
+	/// @brief Merge vertices whose position, normal and texture coordinate are bitwise identical.
+	/// @details The streams are compacted in place, keeping the first occurrence of each vertex in its original order.
+	/// Normal and texture coordinate streams may be empty, in which case they take no part in the comparison.
+	/// @param _positions One position per input vertex. Receives the unique positions.
+	/// @param _normals One normal per input vertex, or empty. Receives the unique normals.
+	/// @param _uvs One texture coordinate per input vertex, or empty. Receives the unique texture coordinates.
+	/// @param _remap Receives, for every input vertex, the index of the unique vertex it was merged into.
+	/// @return The number of unique vertices.
+	size_t WeldVertices(std::vector<glm::vec3>& _positions, std::vector<glm::vec3>& _normals, std::vector<glm::vec2>& _uvs, std::vector<unsigned int>& _remap);
+}
+
+#endif // EPBR_VERTEX_WELDING
@@ -14,5 +14,33 @@
 #include "VertexArray.h"
 #include "VertexBuffer.h"
 #include "CubeMap.h"
+#include "MappedFile.h"
+#include "OBJParser.h"
+#include "ThreadPool.h"
+#include "VertexWelding.h"
+#include "ImportOptions.h"
+#include "MeshOptimisation.h"
+#include "MeshData.h"
+#include "MeshCache.h"
+#include "TangentGeneration.h"
+#include "VertexFormat.h"
+#include "VertexQuantisation.h"
+#include "Meshlets.h"
+#include "MeshSimplification.h"
+#include "GeometryArena.h"
+#include "StreamBuffer.h"
+#include "Instancing.h"
+#include "IndirectDraw.h"
+#include "Culling.h"
+#include "Occlusion.h"
+#include "GpuCuller.h"
+#include "CommandBuffer.h"
+#include "RenderQueue.h"
+#include "StateCache.h"
+#include "ShaderBlocks.h"
+#include "TextureResidency.h"
+#include "TransformHierarchy.h"
+#include "ObjectTransforms.h"
+#include "DeferredShading.h"
 
 #endif // EPBR_SINGLE_INCLUDE
\ No newline at end of file